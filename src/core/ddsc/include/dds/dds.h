@@ -1646,6 +1646,36 @@ dds_write(dds_entity_t writer, const void *data);
 DDS_EXPORT void
 dds_write_flush(dds_entity_t writer);
 
+/**
+ * @brief Set the batching policy of a writer
+ *
+ * Data written is held back until max_bytes are pending or the oldest
+ * pending data has been held back for max_delay, whichever comes first, or
+ * until it is flushed with dds_write_flush.  Either way, it is sent as soon
+ * as a message is full.  A max_delay of 0 sends all data immediately, a
+ * max_delay of DDS_INFINITY only when max_bytes are pending.  The policy of
+ * a new writer is (0, latency budget), i.e., by default data is held back
+ * only if the writer's latency budget is non-zero.  Enabling write batching
+ * for all writers (dds_write_set_batch) overrides this.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  max_bytes Number of bytes pending at which data is sent, 0 for a full message.
+ * @param[in]  max_delay Maximum time data is held back.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The policy has been set.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The entity parameter is not a valid parameter or max_delay is negative.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ */
+DDS_EXPORT dds_return_t
+dds_write_set_batch_policy(dds_entity_t writer, uint32_t max_bytes, dds_duration_t max_delay);
+
 /**
  * @brief Write a CDR serialized value of a data instance
  *
@@ -1657,6 +1687,27 @@ dds_write_flush(dds_entity_t writer);
 DDS_EXPORT dds_return_t
 dds_writecdr(dds_entity_t writer, struct ddsi_serdata *serdata);
 
+/**
+ * @brief Forward a CDR serialized value of a data instance
+ *
+ * Writes the serialized value as is, retaining the source timestamp and the
+ * dispose/unregister flags it already has, so that a sample obtained with
+ * dds_takecdr can be passed on to a writer of another topic of the same
+ * type, or the same topic in another partition, without copying it.
+ *
+ * The reference to serdata is consumed, also when an error is returned.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  serdata CDR serialized value to be written.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             serdata is NULL or of a different type than the writer's topic.
+ */
+DDS_EXPORT dds_return_t
+dds_forwardcdr(dds_entity_t writer, struct ddsi_serdata *serdata);
+
 /**
  * @brief Write the value of a data instance along with the source timestamp passed.
  *
@@ -1672,6 +1723,97 @@ dds_write_ts(
   const void *data,
   dds_time_t timestamp);
 
+/**
+ * @brief Write a sequence of data values
+ *
+ * Writes the samples in order, as if by successive calls to dds_write (or
+ * dds_write_ts if timestamps is not a null pointer), but serializes all of them
+ * before handing them to the protocol implementation in one go, so that the
+ * per-call overhead of locking the writer and flushing the messages is incurred
+ * only once for the whole sequence.
+ *
+ * Writing stops at the first sample that cannot be written, in which case the
+ * preceding samples have been written and the remaining ones have not.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  samples Array of n pointers to the values to be written.
+ * @param[in]  n Number of samples.
+ * @param[in]  timestamps Array of n source timestamps, or NULL to use the current time.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             All samples are written.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             At least one of the arguments is invalid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ * @retval DDS_RETCODE_TIMEOUT
+ *             The writer blocked for longer than the maximum blocking time.
+ */
+DDS_EXPORT dds_return_t
+dds_write_n(
+  dds_entity_t writer,
+  const void * const *samples,
+  uint32_t n,
+  const dds_time_t *timestamps);
+
+/**
+ * @brief Write the value of a data instance identified by an instance handle
+ *
+ * This operation performs the same function as dds_write, but the instance is
+ * identified by the handle obtained from dds_register_instance.  For instances
+ * registered with this writer, this avoids extracting the key value from the
+ * sample and looking up the instance.  The key fields of the data must match
+ * those of the instance; this is not verified.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  handle The handle to identify the instance.
+ * @param[in]  data Value to be written.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The sample is written.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             At least one of the arguments is invalid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET
+ *             The instance handle does not identify an existing instance.
+ */
+DDS_EXPORT dds_return_t
+dds_write_instance(
+  dds_entity_t writer,
+  dds_instance_handle_t handle,
+  const void *data);
+
+/**
+ * @brief Write the value of a data instance identified by an instance handle,
+ * along with the source timestamp passed.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  handle The handle to identify the instance.
+ * @param[in]  data Value to be written.
+ * @param[in]  timestamp Source timestamp.
+ *
+ * @returns A dds_return_t indicating success or failure (see dds_write_instance).
+ */
+DDS_EXPORT dds_return_t
+dds_write_instance_ts(
+  dds_entity_t writer,
+  dds_instance_handle_t handle,
+  const void *data,
+  dds_time_t timestamp);
+
 /**
  * @brief Creates a readcondition associated to the given reader.
  *
@@ -3195,6 +3337,55 @@ dds_get_matched_publication_data (
   dds_entity_t reader,
   dds_instance_handle_t ih);
 
+/**
+ * @brief Name and value of a statistics counter
+ */
+typedef struct dds_stat_keyvalue {
+  const char *name; /**< Name of the counter, a string literal */
+  uint64_t value;   /**< Value at the time of the call */
+} dds_stat_keyvalue_t;
+
+/**
+ * @brief Get statistics counters of an entity
+ *
+ * This operation fills the provided array with the current values of
+ * the statistics counters of the entity, in a fixed order per entity
+ * kind. For a writer these cover acknowledgements, retransmits,
+ * throttling and the writer history cache; for a reader the reader
+ * history cache and rejected/lost samples; for a participant the
+ * domain-wide transport counters (packets and bytes sent and received,
+ * malformed packets, dropped samples, socket errors, packets affected by
+ * Internal/Test/NetworkSimulation), the number of endpoint discovery
+ * re-announcements skipped because nothing changed
+ * and the number of events recorded by the flight
+ * recorder with an estimate of the time spent doing so; for a topic the count and the 50th, 90th, 99th and
+ * 100th percentile (in ns) of each stage of the latency breakdown,
+ * which are all 0 unless Internal/MeasureLatencyStages is enabled.
+ * On successful output, the number of entries of
+ * "stats" set is the minimum of the return value and "nstats".
+ *
+ * @param[in] entity   The writer, reader, participant or topic.
+ * @param[in] stats    The array to be filled.
+ * @param[in] nstats   The size of the stats array, stats = NULL and
+ *             nstats = 0 is a valid way of determining the number of
+ *             counters.
+ *
+ * @returns A dds_return_t indicating the number of counters or failure.
+ *
+ * @retval >=0
+ *             The number of counters of the entity.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The entity parameter is not valid or stats = NULL and
+ *             nstats > 0.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ */
+DDS_EXPORT dds_return_t
+dds_get_statistics (
+  dds_entity_t entity,
+  dds_stat_keyvalue_t *stats,
+  size_t nstats);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -77,6 +77,10 @@ DDS_EXPORT inline dds_entity_kind_t dds_entity_kind (const dds_entity *e) {
 
 DDS_EXPORT void dds_entity_status_signal (dds_entity *e);
 
+/* Helper for get_statistics implementations: sets stats[*i] if *i < nstats
+   and increments *i */
+DDS_EXPORT void dds_stat_add (dds_stat_keyvalue_t *stats, size_t nstats, size_t *i, const char *name, uint64_t value);
+
 DDS_EXPORT void dds_entity_invoke_listener (const dds_entity *entity, enum dds_status_id which, const void *vst);
 
 DDS_EXPORT dds_return_t
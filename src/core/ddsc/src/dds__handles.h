@@ -71,7 +71,7 @@ typedef int32_t dds_handle_t;
  */
 struct dds_handle_link {
   dds_handle_t hdl;
-  ddsrt_atomic_uint32_t cnt_flags;
+  uint32_t slot;
 };
 
 /*
@@ -55,6 +55,7 @@ dds_rhc_take(
         dds_readcond *cond);
 
 DDS_EXPORT void dds_rhc_set_qos (struct rhc * rhc, const struct dds_qos * qos);
+DDS_EXPORT void dds_rhc_get_counts (struct rhc *rhc, uint32_t *ninstances, uint32_t *nsamples);
 
 DDS_EXPORT bool dds_rhc_add_readcondition (dds_readcond * cond);
 DDS_EXPORT void dds_rhc_remove_readcondition (dds_readcond * cond);
@@ -17,6 +17,7 @@
 #include "dds/dds.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/q_time.h"
 #include "dds/ddsrt/avl.h"
 #include "dds__handles.h"
 
@@ -38,6 +39,8 @@ struct dds_statuscond;
 
 struct ddsi_sertopic;
 struct rhc;
+struct ddsrt_hh;
+struct xevent;
 
 /* Internal entity status flags */
 
@@ -110,6 +113,7 @@ typedef struct dds_entity_deriver {
     dds_return_t (*set_qos)(struct dds_entity *e, const dds_qos_t *qos, bool enabled) ddsrt_nonnull_all;
     dds_return_t (*validate_status)(uint32_t mask);
     dds_return_t (*get_instance_hdl)(struct dds_entity *e, dds_instance_handle_t *i) ddsrt_nonnull_all;
+    dds_return_t (*get_statistics)(struct dds_entity *e, dds_stat_keyvalue_t *stats, size_t nstats);
 }
 dds_entity_deriver;
 
@@ -202,6 +206,16 @@ typedef struct dds_writer
   struct nn_xpack * m_xp;
   struct writer * m_wr;
   struct whc *m_whc; /* FIXME: ownership still with underlying DDSI writer (cos of DDSI built-in writers )*/
+  struct ddsrt_hh *m_instances; /* registered instances: iid -> ddsi_tkmap_instance, protected by m_entity.m_mutex */
+
+  /* Batching: data is held in m_xp for at most m_batch_max_delay (the latency budget by
+     default, 0 = flush after every write) or until m_batch_max_bytes (0 = a full packet)
+     are pending, unless WriteBatch is set globally; protected by m_entity.m_mutex */
+  dds_duration_t m_batch_max_delay;
+  uint32_t m_batch_max_bytes;
+  unsigned m_batch_packetid; /* packet id of m_xp when m_batch_tflush was set */
+  nn_mtime_t m_batch_tflush; /* deadline for flushing m_xp, T_NEVER if none */
+  struct xevent *m_batch_xevent;
 
   /* Status metrics */
 
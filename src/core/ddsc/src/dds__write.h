@@ -21,6 +21,7 @@ extern "C" {
 #define DDS_WR_UNREGISTER_BIT 0x04
 
 struct ddsi_serdata;
+struct ddsi_tkmap_instance;
 
 typedef enum {
   DDS_WR_ACTION_WRITE = 0,
@@ -30,6 +31,7 @@ typedef enum {
 } dds_write_action;
 
 dds_return_t dds_write_impl (dds_writer *wr, const void *data, dds_time_t tstamp, dds_write_action action);
+dds_return_t dds_write_impl_tk (dds_writer *wr, struct ddsi_tkmap_instance *tk, const void *data, dds_time_t tstamp, dds_write_action action);
 dds_return_t dds_writecdr_impl (dds_writer *wr, struct ddsi_serdata *d, dds_time_t tstamp, dds_write_action action);
 dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d);
 
@@ -20,6 +20,22 @@ extern "C" {
 
 DEFINE_ENTITY_LOCK_UNLOCK(inline, dds_writer, DDS_KIND_WRITER)
 
+struct ddsi_tkmap_instance;
+
+/* Registered instances: the writer holds a reference to the tkmap instance of each
+   instance registered with it, so that writing to it by instance handle requires
+   neither extracting and hashing the key nor looking it up in the tkmap.  All of
+   these must be called with the writer locked and the thread awake; registering
+   takes over the caller's reference to the instance. */
+void dds_writer_register_instance_tk (dds_writer *wr, struct ddsi_tkmap_instance *tk);
+void dds_writer_unregister_instance_tk (dds_writer *wr, dds_instance_handle_t iid);
+struct ddsi_tkmap_instance *dds_writer_lookup_instance_ref (dds_writer *wr, dds_instance_handle_t iid);
+
+/* To be called with the writer locked and the thread awake after adding data to m_xp:
+   sends it unless the batching policy allows holding on to it for a while, in which
+   case it ensures the flush event is scheduled; returns true if the data was sent */
+bool dds_writer_maybe_flush (dds_writer *wr);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -900,6 +900,35 @@ dds_return_t dds_get_instance_handle (dds_entity_t entity, dds_instance_handle_t
   return ret;
 }
 
+dds_return_t dds_get_statistics (dds_entity_t entity, dds_stat_keyvalue_t *stats, size_t nstats)
+{
+  dds_entity *e;
+  dds_return_t ret;
+
+  if (stats == NULL && nstats > 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_entity_lock (entity, DDS_KIND_DONTCARE, &e)) != DDS_RETCODE_OK)
+    return ret;
+
+  if (e->m_deriver.get_statistics)
+    ret = e->m_deriver.get_statistics (e, stats, nstats);
+  else
+    ret = DDS_RETCODE_ILLEGAL_OPERATION;
+  dds_entity_unlock(e);
+  return ret;
+}
+
+void dds_stat_add (dds_stat_keyvalue_t *stats, size_t nstats, size_t *i, const char *name, uint64_t value)
+{
+  if (*i < nstats)
+  {
+    stats[*i].name = name;
+    stats[*i].value = value;
+  }
+  (*i)++;
+}
+
 dds_return_t dds_entity_claim (dds_entity_t hdl, dds_entity **eptr)
 {
   dds_return_t hres;
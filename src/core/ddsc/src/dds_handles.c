@@ -20,29 +20,45 @@
 #include "dds__handles.h"
 #include "dds__types.h"
 
-/* FIXME: this code isn't really correct when USE_CHH is set:
-   - the DDS entity code doesn't really play by the awake/asleep mechanism
-   - there is no provision in the code for a handle being deleted concurrent to a lookup,
-     that is, deleting handle links should also go through the GC
-   entity framework needs a fair bit of rewriting anyway ... */
-#define USE_CHH 0
-
 #define HDL_FLAG_CLOSED    (0x80000000u)
 #define HDL_COUNT_MASK     (0x00ffffffu)
 
-/* Maximum number of handles is INT32_MAX - 1, but as the allocator relies on a
-   random generator for finding a free one, the time spent in the dds_handle_create
-   increases with an increasing number of handles.  16M handles seems likely to be
-   enough and makes the likely cost of allocating a new handle somewhat more
-   reasonable */
-#define MAX_HANDLES (INT32_MAX / 128)
+/* Handles are random numbers in [1,DDS_MIN_PSEUDO_HANDLE), mapped to a
+   slot by a concurrent hash table, so that a stale handle only refers to
+   a new entity if that entity happens to draw the same number.  Looking
+   up a handle requires no locking: the table lookup only requires the
+   thread to be awake, and the reference count is incremented using a
+   CAS.
+
+   Slots are allocated in chunks that remain in existence until the handle
+   server is shut down, and the reference count and the "closed" flag live
+   in the slot rather than in the entity.  This way, a lookup concurrent
+   with the deletion of the entity never touches freed memory: deleting a
+   handle leaves the slot in the closed state and removes it from the hash
+   table, and a lookup checks that the slot still has the handle it looked
+   up after incrementing the reference count.
+
+   16M handles seems likely to be enough, and is what the slot table
+   supports. */
+#define HDL_SLOTS_LG2      24
+#define HDL_CHUNK_LG2      10
+#define HDL_CHUNK_SIZE     (1u << HDL_CHUNK_LG2)
+#define HDL_NCHUNKS        (1u << (HDL_SLOTS_LG2 - HDL_CHUNK_LG2))
+
+#define MAX_HANDLES        ((1u << HDL_SLOTS_LG2) - 1)
+
+struct dds_handle_slot {
+  ddsrt_atomic_uint32_t cnt_flags; /* closed flag + reference count; closed when free */
+  ddsrt_atomic_uint32_t hdl; /* constant while in the hash table */
+  ddsrt_atomic_voidp_t link;
+  uint32_t next_free; /* protected by handles.lock */
+};
 
 struct dds_handle_server {
-#if USE_CHH
   struct ddsrt_chh *ht;
-#else
-  struct ddsrt_hh *ht;
-#endif
+  ddsrt_atomic_voidp_t *chunks;
+  ddsrt_atomic_uint32_t nslots; /* slots [1,nslots) exist */
+  uint32_t free_first, free_last; /* FIFO of free slots, 0 = none */
   size_t count;
   ddsrt_mutex_t lock;
   ddsrt_cond_t cond;
@@ -53,25 +69,42 @@ static struct dds_handle_server handles;
 static uint32_t handle_hash (const void *va)
 {
   /* handles are already pseudo-random numbers, so not much point in hashing it again */
-  const struct dds_handle_link *a = va;
-  return (uint32_t) a->hdl;
+  const struct dds_handle_slot *a = va;
+  return ddsrt_atomic_ld32 (&a->hdl);
 }
 
 static int handle_equal (const void *va, const void *vb)
 {
-  const struct dds_handle_link *a = va;
-  const struct dds_handle_link *b = vb;
-  return a->hdl == b->hdl;
+  const struct dds_handle_slot *a = va;
+  const struct dds_handle_slot *b = vb;
+  return ddsrt_atomic_ld32 (&a->hdl) == ddsrt_atomic_ld32 (&b->hdl);
+}
+
+static struct dds_handle_slot *handle_slot (uint32_t idx)
+{
+  struct dds_handle_slot *chunk;
+  assert (idx > 0 && idx < ddsrt_atomic_ld32 (&handles.nslots));
+  chunk = ddsrt_atomic_ldvoidp (&handles.chunks[idx >> HDL_CHUNK_LG2]);
+  return &chunk[idx & (HDL_CHUNK_SIZE - 1)];
+}
+
+static struct dds_handle_slot *link_slot (const struct dds_handle_link *link)
+{
+  struct dds_handle_slot *slot = handle_slot (link->slot);
+  assert (ddsrt_atomic_ldvoidp (&slot->link) == link);
+  return slot;
 }
 
 dds_return_t dds_handle_server_init (void (*free_via_gc) (void *x))
 {
-#if USE_CHH
+  /* slots are never freed while the handle server exists, only the hash
+     table's bucket arrays need deferred freeing */
   handles.ht = ddsrt_chh_new (128, handle_hash, handle_equal, free_via_gc);
-#else
-  handles.ht = ddsrt_hh_new (128, handle_hash, handle_equal);
-  (void) free_via_gc;
-#endif
+  handles.chunks = ddsrt_malloc (HDL_NCHUNKS * sizeof (*handles.chunks));
+  for (uint32_t i = 0; i < HDL_NCHUNKS; i++)
+    ddsrt_atomic_stvoidp (&handles.chunks[i], NULL);
+  ddsrt_atomic_st32 (&handles.nslots, 1);
+  handles.free_first = handles.free_last = 0;
   handles.count = 0;
   ddsrt_mutex_init (&handles.lock);
   ddsrt_cond_init (&handles.cond);
@@ -80,90 +113,105 @@ dds_return_t dds_handle_server_init (void (*free_via_gc) (void *x))
 
 void dds_handle_server_fini (void)
 {
-#if USE_CHH
 #ifndef NDEBUG
   struct ddsrt_chh_iter it;
   assert (ddsrt_chh_iter_first (handles.ht, &it) == NULL);
 #endif
+  assert (handles.count == 0);
   ddsrt_chh_free (handles.ht);
-#else /* USE_CHH */
-#ifndef NDEBUG
-  struct ddsrt_hh_iter it;
-  assert (ddsrt_hh_iter_first (handles.ht, &it) == NULL);
-#endif
-  ddsrt_hh_free (handles.ht);
-#endif /* USE_CHH */
+  for (uint32_t i = 0; i < HDL_NCHUNKS; i++)
+    ddsrt_free (ddsrt_atomic_ldvoidp (&handles.chunks[i]));
+  ddsrt_free (handles.chunks);
   ddsrt_cond_destroy (&handles.cond);
   ddsrt_mutex_destroy (&handles.lock);
   handles.ht = NULL;
+  handles.chunks = NULL;
 }
 
-#if USE_CHH
-static bool hhadd (struct ddsrt_chh *ht, void *elem) { return ddsrt_chh_add (ht, elem); }
-#else
-static bool hhadd (struct ddsrt_hh *ht, void *elem) { return ddsrt_hh_add (ht, elem); }
-#endif
-static dds_handle_t dds_handle_create_int (struct dds_handle_link *link)
+static uint32_t dds_handle_alloc_slot (void)
 {
-  ddsrt_atomic_st32 (&link->cnt_flags, 0);
-  do {
-    do {
-      link->hdl = (int32_t) (ddsrt_random () & INT32_MAX);
-    } while (link->hdl == 0 || link->hdl >= DDS_MIN_PSEUDO_HANDLE);
-  } while (!hhadd (handles.ht, link));
-  return link->hdl;
+  /* Reusing the least recently freed slot maximizes the time before a
+     lookup of a stale handle can find the slot in use again */
+  uint32_t idx;
+  if (handles.free_first != 0)
+  {
+    idx = handles.free_first;
+    handles.free_first = handle_slot (idx)->next_free;
+    if (handles.free_first == 0)
+      handles.free_last = 0;
+  }
+  else
+  {
+    idx = ddsrt_atomic_ld32 (&handles.nslots);
+    if ((idx & (HDL_CHUNK_SIZE - 1)) == 0 || idx == 1)
+    {
+      struct dds_handle_slot *chunk = ddsrt_malloc (HDL_CHUNK_SIZE * sizeof (*chunk));
+      for (uint32_t i = 0; i < HDL_CHUNK_SIZE; i++)
+      {
+        ddsrt_atomic_st32 (&chunk[i].cnt_flags, HDL_FLAG_CLOSED);
+        ddsrt_atomic_st32 (&chunk[i].hdl, 0);
+        ddsrt_atomic_stvoidp (&chunk[i].link, NULL);
+        chunk[i].next_free = 0;
+      }
+      ddsrt_atomic_stvoidp (&handles.chunks[idx >> HDL_CHUNK_LG2], chunk);
+    }
+    ddsrt_atomic_st32 (&handles.nslots, idx + 1);
+  }
+  return idx;
 }
 
 dds_handle_t dds_handle_create (struct dds_handle_link *link)
 {
-#if USE_CHH
   struct thread_state1 * const ts1 = lookup_thread_state ();
-#endif
   dds_handle_t ret;
-#if USE_CHH
-  thread_state_awake (ts1);
-#endif
   ddsrt_mutex_lock (&handles.lock);
   if (handles.count == MAX_HANDLES)
   {
-    ddsrt_mutex_unlock (&handles.lock);
     ret = DDS_RETCODE_OUT_OF_RESOURCES;
   }
   else
   {
+    const uint32_t idx = dds_handle_alloc_slot ();
+    struct dds_handle_slot * const slot = handle_slot (idx);
     handles.count++;
-#if USE_CHH
-    ddsrt_mutex_unlock (&handles.lock);
-    ret = dds_handle_create_int (link);
-#else
-    ret = dds_handle_create_int (link);
-    ddsrt_mutex_unlock (&handles.lock);
-#endif
+    link->slot = idx;
+    ddsrt_atomic_stvoidp (&slot->link, link);
+    /* the slot is still closed, so a lookup of a stale handle that finds it
+       while it is being added can't claim it */
+    thread_state_awake (ts1);
+    do {
+      do {
+        link->hdl = (int32_t) (ddsrt_random () & INT32_MAX);
+      } while (link->hdl == 0 || link->hdl >= DDS_MIN_PSEUDO_HANDLE);
+      ddsrt_atomic_st32 (&slot->hdl, (uint32_t) link->hdl);
+    } while (!ddsrt_chh_add (handles.ht, slot));
+    thread_state_asleep (ts1);
+    ddsrt_atomic_fence_rel ();
+    ddsrt_atomic_st32 (&slot->cnt_flags, 0);
+    ret = link->hdl;
     assert (ret > 0);
   }
-#if USE_CHH
-  thread_state_asleep (ts1);
-#endif
+  ddsrt_mutex_unlock (&handles.lock);
   return ret;
 }
 
 void dds_handle_close (struct dds_handle_link *link)
 {
-  ddsrt_atomic_or32 (&link->cnt_flags, HDL_FLAG_CLOSED);
+  ddsrt_atomic_or32 (&link_slot (link)->cnt_flags, HDL_FLAG_CLOSED);
 }
 
 int32_t dds_handle_delete (struct dds_handle_link *link, dds_duration_t timeout)
 {
-#if USE_CHH
   struct thread_state1 * const ts1 = lookup_thread_state ();
-#endif
-  assert (ddsrt_atomic_ld32 (&link->cnt_flags) & HDL_FLAG_CLOSED);
+  struct dds_handle_slot * const slot = link_slot (link);
+  const uint32_t idx = link->slot;
+  assert (ddsrt_atomic_ld32 (&slot->cnt_flags) & HDL_FLAG_CLOSED);
   ddsrt_mutex_lock (&handles.lock);
-  if ((ddsrt_atomic_ld32 (&link->cnt_flags) & HDL_COUNT_MASK) != 0)
+  if ((ddsrt_atomic_ld32 (&slot->cnt_flags) & HDL_COUNT_MASK) != 0)
   {
     /* FIXME: */
     const dds_time_t abstimeout = dds_time () + timeout;
-    while ((ddsrt_atomic_ld32 (&link->cnt_flags) & HDL_COUNT_MASK) != 0)
+    while ((ddsrt_atomic_ld32 (&slot->cnt_flags) & HDL_COUNT_MASK) != 0)
     {
       if (!ddsrt_cond_waituntil (&handles.cond, &handles.lock, abstimeout))
       {
@@ -173,28 +221,42 @@ int32_t dds_handle_delete (struct dds_handle_link *link, dds_duration_t timeout)
       }
     }
   }
-#if USE_CHH
+  /* The slot remains closed, and lookups that have yet to increment the
+     reference count recheck the handle after doing so */
   thread_state_awake (ts1);
-  int x = ddsrt_chh_remove (handles.ht, link);
+  int x = ddsrt_chh_remove (handles.ht, slot);
   thread_state_asleep (ts1);
-#else
-  int x = ddsrt_hh_remove (handles.ht, link);
-#endif
-  assert(x);
-  (void)x;
+  assert (x);
+  (void) x;
+  ddsrt_atomic_stvoidp (&slot->link, NULL);
+  slot->next_free = 0;
+  if (handles.free_last == 0)
+    handles.free_first = idx;
+  else
+    handle_slot (handles.free_last)->next_free = idx;
+  handles.free_last = idx;
   assert (handles.count > 0);
   handles.count--;
   ddsrt_mutex_unlock (&handles.lock);
   return DDS_RETCODE_OK;
 }
 
+static void dds_handle_release_slot (struct dds_handle_slot *slot)
+{
+  if (ddsrt_atomic_dec32_ov (&slot->cnt_flags) == (HDL_FLAG_CLOSED | 1))
+  {
+    ddsrt_mutex_lock (&handles.lock);
+    ddsrt_cond_broadcast (&handles.cond);
+    ddsrt_mutex_unlock (&handles.lock);
+  }
+}
+
 int32_t dds_handle_claim (dds_handle_t hdl, struct dds_handle_link **link)
 {
-#if USE_CHH
-  struct thread_state1 * const ts1 = lookup_thread_state ();
-#endif
-  struct dds_handle_link dummy = { .hdl = hdl };
-  int32_t rc;
+  struct thread_state1 *ts1;
+  struct dds_handle_slot dummy, *slot;
+  uint32_t cnt_flags;
+
   /* it makes sense to check here for initialization: the first thing any operation
      (other than create_participant) does is to call dds_handle_claim on the supplied
      entity, so checking here whether the library has been initialised helps avoid
@@ -206,56 +268,51 @@ int32_t dds_handle_claim (dds_handle_t hdl, struct dds_handle_link **link)
   if (handles.ht == NULL)
     return DDS_RETCODE_PRECONDITION_NOT_MET;
 
-#if USE_CHH
+  /* Slots are never freed, so only the lookup itself needs the thread to be
+     awake */
+  ts1 = lookup_thread_state ();
+  ddsrt_atomic_st32 (&dummy.hdl, (uint32_t) hdl);
   thread_state_awake (ts1);
-  *link = ddsrt_chh_lookup (handles.ht, &dummy);
-#else
-  ddsrt_mutex_lock (&handles.lock);
-  *link = ddsrt_hh_lookup (handles.ht, &dummy);
-#endif
-  if (*link == NULL)
-    rc = DDS_RETCODE_BAD_PARAMETER;
-  else
+  slot = ddsrt_chh_lookup (handles.ht, &dummy);
+  thread_state_asleep (ts1);
+  if (slot == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  /* Bail out if the object turns out to be in the process of being deleted
+     or if the slot is free */
+  do {
+    cnt_flags = ddsrt_atomic_ld32 (&slot->cnt_flags);
+    if (cnt_flags & HDL_FLAG_CLOSED)
+      return DDS_RETCODE_BAD_PARAMETER;
+  } while (!ddsrt_atomic_cas32 (&slot->cnt_flags, cnt_flags, cnt_flags + 1));
+
+  /* The slot may have been freed and reused between the lookup and
+     incrementing the reference count, but once the reference count has
+     been incremented, it can't be deleted anymore */
+  ddsrt_atomic_fence_acq ();
+  if (ddsrt_atomic_ld32 (&slot->hdl) != (uint32_t) hdl)
   {
-    uint32_t cnt_flags;
-    /* Assume success; bail out if the object turns out to be in the process of
-       being deleted */
-    rc = DDS_RETCODE_OK;
-    do {
-      cnt_flags = ddsrt_atomic_ld32 (&(*link)->cnt_flags);
-      if (cnt_flags & HDL_FLAG_CLOSED)
-      {
-        rc = DDS_RETCODE_BAD_PARAMETER;
-        break;
-      }
-    } while (!ddsrt_atomic_cas32 (&(*link)->cnt_flags, cnt_flags, cnt_flags + 1));
+    dds_handle_release_slot (slot);
+    return DDS_RETCODE_BAD_PARAMETER;
   }
-#if USE_CHH
-  thread_state_asleep (ts1);
-#else
-  ddsrt_mutex_unlock (&handles.lock);
-#endif
-  return rc;
+  *link = ddsrt_atomic_ldvoidp (&slot->link);
+  assert (*link != NULL && (*link)->hdl == hdl);
+  return DDS_RETCODE_OK;
 }
 
 void dds_handle_claim_inc (struct dds_handle_link *link)
 {
-  uint32_t x = ddsrt_atomic_inc32_nv (&link->cnt_flags);
+  uint32_t x = ddsrt_atomic_inc32_nv (&link_slot (link)->cnt_flags);
   assert (!(x & HDL_FLAG_CLOSED));
   (void) x;
 }
 
 void dds_handle_release (struct dds_handle_link *link)
 {
-  if (ddsrt_atomic_dec32_ov (&link->cnt_flags) == (HDL_FLAG_CLOSED | 1))
-  {
-    ddsrt_mutex_lock (&handles.lock);
-    ddsrt_cond_broadcast (&handles.cond);
-    ddsrt_mutex_unlock (&handles.lock);
-  }
+  dds_handle_release_slot (link_slot (link));
 }
 
 bool dds_handle_is_closed (struct dds_handle_link *link)
 {
-  return (ddsrt_atomic_ld32 (&link->cnt_flags) & HDL_FLAG_CLOSED) != 0;
+  return (ddsrt_atomic_ld32 (&link_slot (link)->cnt_flags) & HDL_FLAG_CLOSED) != 0;
 }
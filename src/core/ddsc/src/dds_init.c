@@ -278,6 +278,7 @@ void ddsi_plugin_init (void)
   ddsi_plugin.rhc_plugin.rhc_unregister_wr_fn = dds_rhc_unregister_wr;
   ddsi_plugin.rhc_plugin.rhc_relinquish_ownership_fn = dds_rhc_relinquish_ownership;
   ddsi_plugin.rhc_plugin.rhc_set_qos_fn = dds_rhc_set_qos;
+  ddsi_plugin.rhc_plugin.rhc_get_counts_fn = dds_rhc_get_counts;
 }
 
 //provides explicit default domain id.
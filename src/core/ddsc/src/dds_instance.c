@@ -62,6 +62,16 @@ static void dds_instance_remove (const dds_topic *topic, const void *data, dds_i
   }
 }
 
+static void dds_instance_unregister_from_writer (dds_writer *wr, const void *data)
+{
+  struct ddsi_tkmap_instance *inst;
+  if ((inst = dds_instance_find (wr->m_topic, data, false)) != NULL)
+  {
+    dds_writer_unregister_instance_tk (wr, inst->m_iid);
+    ddsi_tkmap_instance_unref (inst);
+  }
+}
+
 static const dds_topic *dds_instance_info (dds_entity *e)
 {
   const dds_topic *topic;
@@ -121,6 +131,7 @@ dds_return_t dds_register_instance (dds_entity_t writer, dds_instance_handle_t *
   else
   {
     *handle = inst->m_iid;
+    dds_writer_register_instance_tk (wr, inst);
     ret = DDS_RETCODE_OK;
   }
   thread_state_asleep (ts1);
@@ -162,6 +173,7 @@ dds_return_t dds_unregister_instance_ts (dds_entity_t writer, const void *data,
     action |= DDS_WR_DISPOSE_BIT;
   }
   ret = dds_write_impl (wr, data, timestamp, action);
+  dds_instance_unregister_from_writer (wr, data);
   thread_state_asleep (ts1);
   dds_writer_unlock (wr);
   return ret;
@@ -188,15 +200,16 @@ dds_return_t dds_unregister_instance_ih_ts (dds_entity_t writer, dds_instance_ha
     dds_instance_remove (wr->m_topic, NULL, handle);
     action |= DDS_WR_DISPOSE_BIT;
   }
-  if ((tk = ddsi_tkmap_find_by_id (gv.m_tkmap, handle)) == NULL)
+  if ((tk = dds_writer_lookup_instance_ref (wr, handle)) == NULL)
     ret = DDS_RETCODE_PRECONDITION_NOT_MET;
   else
   {
     struct ddsi_sertopic *tp = wr->m_topic->m_stopic;
     void *sample = ddsi_sertopic_alloc_sample (tp);
     ddsi_serdata_topicless_to_sample (tp, tk->m_sample, sample, NULL, NULL);
+    ret = dds_write_impl_tk (wr, tk, sample, timestamp, action);
+    dds_writer_unregister_instance_tk (wr, handle);
     ddsi_tkmap_instance_unref (tk);
-    ret = dds_write_impl (wr, sample, timestamp, action);
     ddsi_sertopic_free_sample (tp, sample, DDS_FREE_ALL);
   }
   thread_state_asleep (ts1);
@@ -259,15 +272,16 @@ dds_return_t dds_dispose_ih_ts (dds_entity_t writer, dds_instance_handle_t handl
 
   struct ddsi_tkmap_instance *tk;
   thread_state_awake (ts1);
-  if ((tk = ddsi_tkmap_find_by_id (gv.m_tkmap, handle)) == NULL)
+  if ((tk = dds_writer_lookup_instance_ref (wr, handle)) == NULL)
     ret = DDS_RETCODE_PRECONDITION_NOT_MET;
   else
   {
     struct ddsi_sertopic *tp = wr->m_topic->m_stopic;
     void *sample = ddsi_sertopic_alloc_sample (tp);
     ddsi_serdata_topicless_to_sample (tp, tk->m_sample, sample, NULL, NULL);
+    if ((ret = dds_write_impl_tk (wr, tk, sample, timestamp, DDS_WR_ACTION_DISPOSE)) == DDS_RETCODE_OK)
+      dds_instance_remove (wr->m_topic, sample, handle);
     ddsi_tkmap_instance_unref (tk);
-    ret = dds_dispose_impl (wr, sample, handle, timestamp);
     ddsi_sertopic_free_sample (tp, sample, DDS_FREE_ALL);
   }
   thread_state_asleep (ts1);
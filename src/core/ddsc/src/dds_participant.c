@@ -17,6 +17,7 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_plist.h"
 #include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_flightrec.h"
 #include "dds__init.h"
 #include "dds__domain.h"
 #include "dds__participant.h"
@@ -36,6 +37,42 @@ static dds_return_t dds_participant_status_validate (uint32_t mask)
   return (mask & ~DDS_PARTICIPANT_STATUS_MASK) ? DDS_RETCODE_BAD_PARAMETER : DDS_RETCODE_OK;
 }
 
+static dds_return_t dds_participant_get_statistics (dds_entity *e, dds_stat_keyvalue_t *stats, size_t nstats)
+{
+  /* Transport and protocol counters are kept per domain */
+  size_t i = 0;
+  (void) e;
+  dds_stat_add (stats, nstats, &i, "malformed_packets", ddsrt_atomic_ld32 (&gv.stats.malformed_packets));
+  dds_stat_add (stats, nstats, &i, "oversize_samples", ddsrt_atomic_ld32 (&gv.stats.oversize_samples));
+  dds_stat_add (stats, nstats, &i, "gaps_received", ddsrt_atomic_ld32 (&gv.stats.gaps_received));
+  dds_stat_add (stats, nstats, &i, "reorder_rejects", ddsrt_atomic_ld32 (&gv.stats.reorder_rejects));
+  dds_stat_add (stats, nstats, &i, "recv_errors", ddsrt_atomic_ld32 (&gv.stats.recv_errors));
+  dds_stat_add (stats, nstats, &i, "send_errors", ddsrt_atomic_ld32 (&gv.stats.send_errors));
+  dds_stat_add (stats, nstats, &i, "packets_sent", ddsrt_atomic_ld32 (&gv.stats.packets_sent));
+#if DDSRT_HAVE_ATOMIC64
+  dds_stat_add (stats, nstats, &i, "bytes_sent", ddsrt_atomic_ld64 (&gv.stats.bytes_sent));
+#else
+  dds_stat_add (stats, nstats, &i, "bytes_sent", ddsrt_atomic_ld32 (&gv.stats.bytes_sent));
+#endif
+  dds_stat_add (stats, nstats, &i, "packets_received", ddsrt_atomic_ld32 (&gv.stats.packets_received));
+#if DDSRT_HAVE_ATOMIC64
+  dds_stat_add (stats, nstats, &i, "bytes_received", ddsrt_atomic_ld64 (&gv.stats.bytes_received));
+#else
+  dds_stat_add (stats, nstats, &i, "bytes_received", ddsrt_atomic_ld32 (&gv.stats.bytes_received));
+#endif
+  dds_stat_add (stats, nstats, &i, "netsim_dropped", ddsrt_atomic_ld32 (&gv.stats.netsim_dropped));
+  dds_stat_add (stats, nstats, &i, "netsim_duplicated", ddsrt_atomic_ld32 (&gv.stats.netsim_duplicated));
+  dds_stat_add (stats, nstats, &i, "netsim_reordered", ddsrt_atomic_ld32 (&gv.stats.netsim_reordered));
+  dds_stat_add (stats, nstats, &i, "sedp_unchanged", ddsrt_atomic_ld32 (&gv.stats.sedp_unchanged));
+  {
+    uint64_t nevents, est_ns;
+    nn_flightrec_get_stats (&nevents, &est_ns);
+    dds_stat_add (stats, nstats, &i, "flightrec_events", nevents);
+    dds_stat_add (stats, nstats, &i, "flightrec_est_ns", est_ns);
+  }
+  return (dds_return_t) i;
+}
+
 static dds_return_t dds_participant_delete (dds_entity *e) ddsrt_nonnull_all;
 
 static dds_return_t dds_participant_delete (dds_entity *e)
@@ -140,6 +177,7 @@ dds_entity_t dds_create_participant (const dds_domainid_t domain, const dds_qos_
   pp->m_entity.m_deriver.set_qos = dds_participant_qos_set;
   pp->m_entity.m_deriver.get_instance_hdl = dds_participant_instance_hdl;
   pp->m_entity.m_deriver.validate_status = dds_participant_status_validate;
+  pp->m_entity.m_deriver.get_statistics = dds_participant_get_statistics;
   pp->m_builtin_subscriber = 0;
 
   /* Add participant to extent */
@@ -47,6 +47,23 @@ static dds_return_t dds_reader_instance_hdl (dds_entity *e, dds_instance_handle_
   return DDS_RETCODE_OK;
 }
 
+static dds_return_t dds_reader_get_statistics (dds_entity *e, dds_stat_keyvalue_t *stats, size_t nstats)
+{
+  struct dds_reader * const rd = (struct dds_reader *) e;
+  uint32_t ninstances, nsamples, nrejected, nlost;
+  size_t i = 0;
+  dds_rhc_get_counts (rd->m_rd->rhc, &ninstances, &nsamples);
+  ddsrt_mutex_lock (&e->m_observers_lock);
+  nrejected = rd->m_sample_rejected_status.total_count;
+  nlost = rd->m_sample_lost_status.total_count;
+  ddsrt_mutex_unlock (&e->m_observers_lock);
+  dds_stat_add (stats, nstats, &i, "rhc_instances", ninstances);
+  dds_stat_add (stats, nstats, &i, "rhc_samples", nsamples);
+  dds_stat_add (stats, nstats, &i, "samples_rejected", nrejected);
+  dds_stat_add (stats, nstats, &i, "samples_lost", nlost);
+  return (dds_return_t) i;
+}
+
 static dds_return_t dds_reader_close (dds_entity *e) ddsrt_nonnull_all;
 
 static dds_return_t dds_reader_close (dds_entity *e)
@@ -393,6 +410,7 @@ dds_entity_t dds_create_reader (dds_entity_t participant_or_subscriber, dds_enti
   rd->m_entity.m_deriver.set_qos = dds_reader_qos_set;
   rd->m_entity.m_deriver.validate_status = dds_reader_status_validate;
   rd->m_entity.m_deriver.get_instance_hdl = dds_reader_instance_hdl;
+  rd->m_entity.m_deriver.get_statistics = dds_reader_get_statistics;
 
   /* Extra claim of this reader to make sure that the delete waits until DDSI
      has deleted its reader as well. This can be known through the callback. */
@@ -35,6 +35,7 @@
 #include "dds/ddsi/q_globals.h"
 #include "dds/ddsi/q_radmin.h" /* sampleinfo */
 #include "dds/ddsi/q_entity.h" /* proxy_writer_info */
+#include "dds/ddsi/q_lat_stages.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/sysdeps.h"
@@ -238,6 +239,7 @@ struct rhc_sample {
   bool isread;                 /* READ or NOT_READ sample state */
   uint32_t disposed_gen;       /* snapshot of instance counter at time of insertion */
   uint32_t no_writers_gen;     /* __/ */
+  dds_time_t t_store;          /* time of insertion if measuring latency stages, else 0 */
 };
 
 struct rhc_instance {
@@ -306,6 +308,7 @@ struct rhc {
   uint32_t nqconds;                  /* Number of associated query conditions */
   dds_querycond_mask_t qconds_samplest;  /* Mask of associated query conditions that check the sample state */
   void *qcond_eval_samplebuf;        /* Temporary storage for evaluating query conditions, NULL if no qconds */
+  struct nn_lat_stages *lat_stages;  /* latency breakdown for topic, NULL unless enabled */
 };
 
 struct trigger_info_cmn {
@@ -462,6 +465,7 @@ struct rhc * dds_rhc_new (dds_reader * reader, const struct ddsi_sertopic * topi
   rhc->instances = ddsrt_hh_new (1, instance_iid_hash, instance_iid_eq);
   rhc->topic = topic;
   rhc->reader = reader;
+  rhc->lat_stages = nn_lat_stages_lookup (topic->name);
 
   return rhc;
 }
@@ -480,6 +484,14 @@ void dds_rhc_set_qos (struct rhc * rhc, const dds_qos_t * qos)
   rhc->history_depth = (qos->history.kind == DDS_HISTORY_KEEP_LAST) ? (uint32_t)qos->history.depth : ~0u;
 }
 
+void dds_rhc_get_counts (struct rhc *rhc, uint32_t *ninstances, uint32_t *nsamples)
+{
+  ddsrt_mutex_lock (&rhc->lock);
+  *ninstances = rhc->n_instances;
+  *nsamples = rhc->n_vsamples + rhc->n_invsamples;
+  ddsrt_mutex_unlock (&rhc->lock);
+}
+
 static bool eval_predicate_sample (const struct rhc *rhc, const struct ddsi_serdata *sample, bool (*pred) (const void *sample))
 {
   ddsi_serdata_to_sample (sample, rhc->qcond_eval_samplebuf, NULL, NULL);
@@ -755,6 +767,13 @@ static bool add_sample (struct rhc *rhc, struct rhc_instance *inst, const struct
   s->isread = false;
   s->disposed_gen = inst->disposed_gen;
   s->no_writers_gen = inst->no_writers_gen;
+  s->t_store = 0;
+  if (rhc->lat_stages)
+  {
+    s->t_store = dds_time ();
+    if (sample->timestamp.v > 0)
+      nn_lat_stages_add (rhc->lat_stages, NN_LAT_STAGE_END_TO_END, sample->timestamp.v, s->t_store);
+  }
 
   s->conds = 0;
   if (rhc->nqconds != 0)
@@ -1748,10 +1767,22 @@ static bool take_sample_update_conditions (struct rhc *rhc, struct trigger_info_
   return trigger_waitsets;
 }
 
+static void note_first_read (const struct rhc *rhc, const struct rhc_sample *sample, dds_time_t *tnow)
+{
+  /* Samples that have already been read were accounted for then; all samples
+     read in one call share a timestamp */
+  if (sample->t_store == 0 || sample->isread)
+    return;
+  if (*tnow == 0)
+    *tnow = dds_time ();
+  nn_lat_stages_add (rhc->lat_stages, NN_LAT_STAGE_RD_STORE_READ, sample->t_store, *tnow);
+}
+
 static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, unsigned qminv, dds_instance_handle_t handle, dds_readcond *cond)
 {
   bool trigger_waitsets = false;
   uint32_t n = 0;
+  dds_time_t tnow = 0;
 
   if (lock)
   {
@@ -1797,6 +1828,7 @@ static int dds_rhc_read_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
                 if (!sample->isread)
                 {
                   TRACE ("s");
+                  note_first_read (rhc, sample, &tnow);
                   if (read_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, false))
                     trigger_waitsets = true;
                   sample->isread = true;
@@ -1875,6 +1907,7 @@ static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
   bool trigger_waitsets = false;
   uint64_t iid;
   uint32_t n = 0;
+  dds_time_t tnow = 0;
 
   if (lock)
   {
@@ -1926,6 +1959,7 @@ static int dds_rhc_take_w_qminv (struct rhc *rhc, bool lock, void **values, dds_
                 if (take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, sample->isread))
                   trigger_waitsets = true;
 
+                note_first_read (rhc, sample, &tnow);
                 set_sample_info (info_seq + n, inst, sample);
                 ddsi_serdata_to_sample (sample->sample, values[n], 0, 0);
                 rhc->n_vsamples--;
@@ -2037,6 +2071,7 @@ static int dds_rhc_takecdr_w_qminv (struct rhc *rhc, bool lock, struct ddsi_serd
   bool trigger_waitsets = false;
   uint64_t iid;
   uint32_t n = 0;
+  dds_time_t tnow = 0;
   (void)cond;
 
   if (lock)
@@ -2088,6 +2123,7 @@ static int dds_rhc_takecdr_w_qminv (struct rhc *rhc, bool lock, struct ddsi_serd
                 if (take_sample_update_conditions (rhc, &pre, &post, &trig_qc, inst, sample->conds, sample->isread))
                   trigger_waitsets = true;
 
+                note_first_read (rhc, sample, &tnow);
                 set_sample_info (info_seq + n, inst, sample);
                 values[n] = ddsi_serdata_ref(sample->sample);
                 rhc->n_vsamples--;
@@ -16,6 +16,7 @@
 #include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/string.h"
+#include "dds/ddsrt/static_assert.h"
 #include "dds__topic.h"
 #include "dds__listener.h"
 #include "dds__participant.h"
@@ -31,6 +32,7 @@
 #include "dds/ddsi/ddsi_iid.h"
 #include "dds/ddsi/q_plist.h"
 #include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_lat_stages.h"
 
 DECL_ENTITY_LOCK_UNLOCK (extern inline, dds_topic)
 
@@ -70,6 +72,36 @@ static dds_return_t dds_topic_status_validate (uint32_t mask)
   return (mask & ~DDS_TOPIC_STATUS_MASK) ? DDS_RETCODE_BAD_PARAMETER : DDS_RETCODE_OK;
 }
 
+static dds_return_t dds_topic_get_statistics (dds_entity *e, dds_stat_keyvalue_t *stats, size_t nstats)
+{
+  /* Latency breakdown, in the order of enum nn_lat_stage; all zero unless
+     Internal/MeasureLatencyStages is enabled */
+#define LAT_STAGE_KEYS(stage) { stage "_count", stage "_p50_ns", stage "_p90_ns", stage "_p99_ns", stage "_max_ns" }
+  static const char *keys[][5] = {
+    LAT_STAGE_KEYS ("wr_serialize"),
+    LAT_STAGE_KEYS ("wr_transmit"),
+    LAT_STAGE_KEYS ("rd_recv_enqueue"),
+    LAT_STAGE_KEYS ("rd_dqueue"),
+    LAT_STAGE_KEYS ("rd_recv_store"),
+    LAT_STAGE_KEYS ("rd_store_read"),
+    LAT_STAGE_KEYS ("end_to_end")
+  };
+#undef LAT_STAGE_KEYS
+  DDSRT_STATIC_ASSERT (sizeof (keys) / sizeof (keys[0]) == NN_LAT_STAGE_COUNT);
+  const struct nn_lat_stages *lat = nn_lat_stages_lookup (((dds_topic *) e)->m_stopic->name);
+  size_t i = 0;
+  for (int s = 0; s < NN_LAT_STAGE_COUNT; s++)
+  {
+    const struct nn_lat_hist *h = lat ? &lat->hist[s] : NULL;
+    dds_stat_add (stats, nstats, &i, keys[s][0], h ? ddsrt_atomic_ld32 (&h->count) : 0);
+    dds_stat_add (stats, nstats, &i, keys[s][1], h ? (uint64_t) nn_lat_hist_quantile (h, 0.5) : 0);
+    dds_stat_add (stats, nstats, &i, keys[s][2], h ? (uint64_t) nn_lat_hist_quantile (h, 0.9) : 0);
+    dds_stat_add (stats, nstats, &i, keys[s][3], h ? (uint64_t) nn_lat_hist_quantile (h, 0.99) : 0);
+    dds_stat_add (stats, nstats, &i, keys[s][4], h ? (uint64_t) nn_lat_hist_quantile (h, 1.0) : 0);
+  }
+  return (dds_return_t) i;
+}
+
 /*
   Topic status change callback handler. Supports INCONSISTENT_TOPIC
   status (only defined status on a topic).
@@ -274,6 +306,7 @@ dds_entity_t dds_create_topic_arbitrary (dds_entity_t participant, struct ddsi_s
     top->m_entity.m_deriver.delete = dds_topic_delete;
     top->m_entity.m_deriver.set_qos = dds_topic_qos_set;
     top->m_entity.m_deriver.validate_status = dds_topic_status_validate;
+    top->m_entity.m_deriver.get_statistics = dds_topic_get_statistics;
     top->m_stopic = ddsi_sertopic_ref (sertopic);
     sertopic->status_cb_entity = top;
 
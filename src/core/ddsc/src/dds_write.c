@@ -11,6 +11,7 @@
  */
 #include <assert.h>
 #include <string.h>
+#include "dds/ddsrt/heap.h"
 #include "dds__writer.h"
 #include "dds__write.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -23,6 +24,7 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_lat_stages.h"
 
 dds_return_t dds_write (dds_entity_t writer, const void *data)
 {
@@ -54,6 +56,44 @@ dds_return_t dds_writecdr (dds_entity_t writer, struct ddsi_serdata *serdata)
   return ret;
 }
 
+static dds_return_t dds_writecdr_impl_common (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d, dds_writer *wr);
+
+dds_return_t dds_forwardcdr (dds_entity_t writer, struct ddsi_serdata *serdata)
+{
+  dds_return_t ret;
+  dds_writer *wr;
+
+  if (serdata == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+  {
+    ddsi_serdata_unref (serdata);
+    return ret;
+  }
+  if (serdata->topic != wr->m_topic->m_stopic &&
+      (serdata->ops != wr->m_topic->m_stopic->serdata_ops ||
+       strcmp (serdata->topic->type_name, wr->m_topic->m_stopic->type_name) != 0))
+  {
+    /* the representation is only meaningful for the type it came from */
+    ddsi_serdata_unref (serdata);
+    ret = DDS_RETCODE_BAD_PARAMETER;
+  }
+  else if (wr->m_topic->filter_fn)
+  {
+    ddsi_serdata_unref (serdata);
+    ret = DDS_RETCODE_UNSUPPORTED;
+  }
+  else
+  {
+    /* unlike dds_writecdr, the timestamp and the dispose/unregister flags
+       are left as they are: the serdata may also be referenced by readers */
+    ret = dds_writecdr_impl_common (wr->m_wr, wr->m_xp, serdata, wr);
+  }
+  dds_writer_unlock (wr);
+  return ret;
+}
+
 dds_return_t dds_write_ts (dds_entity_t writer, const void *data, dds_time_t timestamp)
 {
   dds_return_t ret;
@@ -69,6 +109,36 @@ dds_return_t dds_write_ts (dds_entity_t writer, const void *data, dds_time_t tim
   return ret;
 }
 
+dds_return_t dds_write_instance (dds_entity_t writer, dds_instance_handle_t handle, const void *data)
+{
+  return dds_write_instance_ts (writer, handle, data, dds_time ());
+}
+
+dds_return_t dds_write_instance_ts (dds_entity_t writer, dds_instance_handle_t handle, const void *data, dds_time_t timestamp)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ddsi_tkmap_instance *tk;
+  dds_return_t ret;
+  dds_writer *wr;
+
+  if (data == NULL || timestamp < 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return ret;
+  thread_state_awake (ts1);
+  if ((tk = dds_writer_lookup_instance_ref (wr, handle)) == NULL)
+    ret = DDS_RETCODE_PRECONDITION_NOT_MET;
+  else
+  {
+    ret = dds_write_impl_tk (wr, tk, data, timestamp, DDS_WR_ACTION_WRITE);
+    ddsi_tkmap_instance_unref (tk);
+  }
+  thread_state_asleep (ts1);
+  dds_writer_unlock (wr);
+  return ret;
+}
+
 static dds_return_t try_store (struct rhc *rhc, const struct proxy_writer_info *pwr_info, struct ddsi_serdata *payload, struct ddsi_tkmap_instance *tk, dds_duration_t *max_block_ms)
 {
   while (!(ddsi_plugin.rhc_plugin.rhc_store_fn) (rhc, pwr_info, payload, tk))
@@ -140,15 +210,50 @@ static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *pay
   return ret;
 }
 
+static dds_return_t dds_write_impl_serdata (struct thread_state1 * const ts1, dds_writer *wr, struct ddsi_serdata *d, struct ddsi_tkmap_instance *tk, dds_time_t t_serialized)
+{
+  struct writer *ddsi_wr = wr->m_wr;
+  dds_return_t ret;
+  int w_rc;
+
+  ddsi_serdata_ref (d);
+  w_rc = write_sample_gc (ts1, wr->m_xp, ddsi_wr, d, tk);
+
+  if (w_rc >= 0) {
+    /* Flush out write unless configured to batch */
+    if (dds_writer_maybe_flush (wr) && t_serialized)
+      nn_lat_stages_add (ddsi_wr->lat_stages, NN_LAT_STAGE_WR_TRANSMIT, t_serialized, dds_time ());
+    ret = DDS_RETCODE_OK;
+  } else if (w_rc == DDS_RETCODE_TIMEOUT) {
+    ret = DDS_RETCODE_TIMEOUT;
+  } else if (w_rc == DDS_RETCODE_BAD_PARAMETER) {
+    ret = DDS_RETCODE_ERROR;
+  } else {
+    ret = DDS_RETCODE_ERROR;
+  }
+  if (ret == DDS_RETCODE_OK)
+    ret = deliver_locally (ddsi_wr, d, tk);
+  ddsi_serdata_unref (d);
+  return ret;
+}
+
+static void set_serdata_action (struct ddsi_serdata *d, dds_time_t tstamp, dds_write_action action)
+{
+  d->statusinfo = (((action & DDS_WR_DISPOSE_BIT) ? NN_STATUSINFO_DISPOSE : 0) |
+                   ((action & DDS_WR_UNREGISTER_BIT) ? NN_STATUSINFO_UNREGISTER : 0));
+  d->timestamp.v = tstamp;
+}
+
 dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstamp, dds_write_action action)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   const bool writekey = action & DDS_WR_KEY_BIT;
-  struct writer *ddsi_wr = wr->m_wr;
+  struct nn_lat_stages * const lat = wr->m_wr->lat_stages;
+  const dds_time_t t_entry = lat ? dds_time () : 0;
+  dds_time_t t_serialized = 0;
   struct ddsi_tkmap_instance *tk;
   struct ddsi_serdata *d;
-  dds_return_t ret = DDS_RETCODE_OK;
-  int w_rc;
+  dds_return_t ret;
 
   if (data == NULL)
     return DDS_RETCODE_BAD_PARAMETER;
@@ -161,36 +266,135 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
   thread_state_awake (ts1);
 
   /* Serialize and write data or key */
-  d = ddsi_serdata_from_sample (ddsi_wr->topic, writekey ? SDK_KEY : SDK_DATA, data);
-  d->statusinfo = (((action & DDS_WR_DISPOSE_BIT) ? NN_STATUSINFO_DISPOSE : 0) |
-                   ((action & DDS_WR_UNREGISTER_BIT) ? NN_STATUSINFO_UNREGISTER : 0));
-  d->timestamp.v = tstamp;
-  ddsi_serdata_ref (d);
+  d = ddsi_serdata_from_sample (wr->m_wr->topic, writekey ? SDK_KEY : SDK_DATA, data);
+  set_serdata_action (d, tstamp, action);
+  if (lat)
+  {
+    t_serialized = dds_time ();
+    nn_lat_stages_add (lat, NN_LAT_STAGE_WR_SERIALIZE, t_entry, t_serialized);
+  }
   tk = ddsi_tkmap_lookup_instance_ref (d);
-  w_rc = write_sample_gc (ts1, wr->m_xp, ddsi_wr, d, tk);
+  ret = dds_write_impl_serdata (ts1, wr, d, tk, t_serialized);
+  ddsi_tkmap_instance_unref (tk);
+  thread_state_asleep (ts1);
+  return ret;
+}
 
-  if (w_rc >= 0) {
-    /* Flush out write unless configured to batch */
-    if (!config.whc_batch)
-      nn_xpack_send (wr->m_xp, false);
+dds_return_t dds_write_n (dds_entity_t writer, const void * const *samples, uint32_t n, const dds_time_t *timestamps)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct nn_lat_stages *lat;
+  struct ddsi_serdata **ds;
+  struct ddsi_tkmap_instance **tks;
+  dds_time_t tstamp, t_serialized = 0;
+  uint32_t i, m, nwritten;
+  dds_return_t ret;
+  dds_writer *wr;
+  int w_rc;
+
+  if (samples == NULL && n > 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+  for (i = 0; i < n; i++)
+    if (samples[i] == NULL || (timestamps && timestamps[i] < 0))
+      return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return ret;
+  if (n == 0)
+  {
+    dds_writer_unlock (wr);
+    return DDS_RETCODE_OK;
+  }
+
+  /* Serialize everything and look up the instances first, so that the writer lock
+     in DDSI is taken only once for inserting all of them in the WHC */
+  lat = wr->m_wr->lat_stages;
+  ds = ddsrt_malloc (n * sizeof (*ds));
+  tks = ddsrt_malloc (n * sizeof (*tks));
+  tstamp = (timestamps == NULL) ? dds_time () : 0;
+  thread_state_awake (ts1);
+  for (i = m = 0; i < n; i++)
+  {
+    const dds_time_t t_entry = lat ? dds_time () : 0;
+    if (wr->m_topic->filter_fn && ! wr->m_topic->filter_fn (samples[i], wr->m_topic->filter_ctx))
+      continue;
+    ds[m] = ddsi_serdata_from_sample (wr->m_wr->topic, SDK_DATA, samples[i]);
+    set_serdata_action (ds[m], timestamps ? timestamps[i] : tstamp, DDS_WR_ACTION_WRITE);
+    if (lat)
+    {
+      t_serialized = dds_time ();
+      nn_lat_stages_add (lat, NN_LAT_STAGE_WR_SERIALIZE, t_entry, t_serialized);
+    }
+    tks[m] = ddsi_tkmap_lookup_instance_ref (ds[m]);
+    /* one reference is consumed by write_sample_gc_n, the other is for local delivery */
+    ddsi_serdata_ref (ds[m]);
+    m++;
+  }
+
+  w_rc = write_sample_gc_n (ts1, wr->m_xp, wr->m_wr, m, ds, tks, &nwritten);
+  if (nwritten > 0 && dds_writer_maybe_flush (wr) && t_serialized)
+    nn_lat_stages_add (lat, NN_LAT_STAGE_WR_TRANSMIT, t_serialized, dds_time ());
+  if (w_rc >= 0)
     ret = DDS_RETCODE_OK;
-  } else if (w_rc == DDS_RETCODE_TIMEOUT) {
+  else if (w_rc == DDS_RETCODE_TIMEOUT)
     ret = DDS_RETCODE_TIMEOUT;
-  } else if (w_rc == DDS_RETCODE_BAD_PARAMETER) {
-    ret = DDS_RETCODE_ERROR;
-  } else {
+  else
     ret = DDS_RETCODE_ERROR;
+  for (i = 0; i < nwritten; i++)
+  {
+    dds_return_t dret = deliver_locally (wr->m_wr, ds[i], tks[i]);
+    if (ret == DDS_RETCODE_OK)
+      ret = dret;
+  }
+  for (i = 0; i < m; i++)
+  {
+    ddsi_serdata_unref (ds[i]);
+    ddsi_tkmap_instance_unref (tks[i]);
   }
-  if (ret == DDS_RETCODE_OK)
-    ret = deliver_locally (ddsi_wr, d, tk);
-  ddsi_serdata_unref (d);
-  ddsi_tkmap_instance_unref (tk);
   thread_state_asleep (ts1);
+  dds_writer_unlock (wr);
+  ddsrt_free (tks);
+  ddsrt_free (ds);
   return ret;
 }
 
-dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d)
+dds_return_t dds_write_impl_tk (dds_writer *wr, struct ddsi_tkmap_instance *tk, const void * data, dds_time_t tstamp, dds_write_action action)
+{
+  /* Variant of dds_write_impl for when the instance is already known (and referenced by
+     the caller): the key hash is taken from the instance instead of being computed from
+     the sample, and there is no need for looking up the instance in the tkmap */
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  const bool writekey = action & DDS_WR_KEY_BIT;
+  struct nn_lat_stages * const lat = wr->m_wr->lat_stages;
+  const dds_time_t t_entry = lat ? dds_time () : 0;
+  dds_time_t t_serialized = 0;
+  struct ddsi_serdata *d;
+  dds_return_t ret;
+
+  if (data == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if (wr->m_topic->filter_fn && !writekey)
+    if (! wr->m_topic->filter_fn (data, wr->m_topic->filter_ctx))
+      return DDS_RETCODE_OK;
+
+  thread_state_awake (ts1);
+  d = ddsi_serdata_from_sample_keyed (wr->m_wr->topic, writekey ? SDK_KEY : SDK_DATA, data, tk->m_sample);
+  set_serdata_action (d, tstamp, action);
+  if (lat)
+  {
+    t_serialized = dds_time ();
+    nn_lat_stages_add (lat, NN_LAT_STAGE_WR_SERIALIZE, t_entry, t_serialized);
+  }
+  ret = dds_write_impl_serdata (ts1, wr, d, tk, t_serialized);
+  thread_state_asleep (ts1);
+  return ret;
+}
+
+static dds_return_t dds_writecdr_impl_common (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d, dds_writer *wr)
 {
+  /* wr is NULL for writers that have no DDS entity (the built-in topic writers), in
+     which case it is flushed right away unless batching is enabled globally */
   struct thread_state1 * const ts1 = lookup_thread_state ();
   struct ddsi_tkmap_instance * tk;
   int ret = DDS_RETCODE_OK;
@@ -202,7 +406,9 @@ dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack
   w_rc = write_sample_gc (ts1, xp, ddsi_wr, d, tk);
   if (w_rc >= 0) {
     /* Flush out write unless configured to batch */
-    if (!config.whc_batch && xp != NULL)
+    if (wr != NULL)
+      (void) dds_writer_maybe_flush (wr);
+    else if (!config.whc_batch && xp != NULL)
       nn_xpack_send (xp, false);
     ret = DDS_RETCODE_OK;
   } else if (w_rc == DDS_RETCODE_TIMEOUT) {
@@ -221,15 +427,18 @@ dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack
   return ret;
 }
 
+dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d)
+{
+  return dds_writecdr_impl_common (ddsi_wr, xp, d, NULL);
+}
+
 dds_return_t dds_writecdr_impl (dds_writer *wr, struct ddsi_serdata *d, dds_time_t tstamp, dds_write_action action)
 {
   if (wr->m_topic->filter_fn)
     abort ();
   /* Set if disposing or unregistering */
-  d->statusinfo = (((action & DDS_WR_DISPOSE_BIT) ? NN_STATUSINFO_DISPOSE : 0) |
-                   ((action & DDS_WR_UNREGISTER_BIT) ? NN_STATUSINFO_UNREGISTER : 0));
-  d->timestamp.v = tstamp;
-  return dds_writecdr_impl_lowlevel (wr->m_wr, wr->m_xp, d);
+  set_serdata_action (d, tstamp, action);
+  return dds_writecdr_impl_common (wr->m_wr, wr->m_xp, d, wr);
 }
 
 void dds_write_set_batch (bool enable)
@@ -246,6 +455,7 @@ void dds_write_flush (dds_entity_t writer)
   if ((rc = dds_writer_lock (writer, &wr)) == DDS_RETCODE_OK)
   {
     nn_xpack_send (wr->m_xp, true);
+    wr->m_batch_tflush.v = T_NEVER;
     dds_writer_unlock (wr);
   }
   thread_state_asleep (ts1);
@@ -18,6 +18,7 @@
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_xmsg.h"
+#include "dds/ddsi/q_xevent.h"
 #include "dds__writer.h"
 #include "dds__listener.h"
 #include "dds__init.h"
@@ -26,6 +27,7 @@
 #include "dds__get_status.h"
 #include "dds__qos.h"
 #include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsrt/hopscotch.h"
 #include "dds__whc.h"
 
 DECL_ENTITY_LOCK_UNLOCK (extern inline, dds_writer)
@@ -44,6 +46,27 @@ static dds_return_t dds_writer_instance_hdl (dds_entity *e, dds_instance_handle_
   return DDS_RETCODE_OK;
 }
 
+static dds_return_t dds_writer_get_statistics (dds_entity *e, dds_stat_keyvalue_t *stats, size_t nstats)
+{
+  struct writer * const ddsi_wr = ((struct dds_writer *) e)->m_wr;
+  struct whc_state whcst;
+  size_t i = 0;
+  ddsrt_mutex_lock (&ddsi_wr->e.lock);
+  whc_get_state (ddsi_wr->whc, &whcst);
+  dds_stat_add (stats, nstats, &i, "acks_received", ddsi_wr->num_acks_received);
+  dds_stat_add (stats, nstats, &i, "nacks_received", ddsi_wr->num_nacks_received);
+  dds_stat_add (stats, nstats, &i, "rexmit_count", ddsi_wr->rexmit_count);
+  dds_stat_add (stats, nstats, &i, "rexmit_bytes", ddsi_wr->rexmit_bytes);
+  dds_stat_add (stats, nstats, &i, "rexmit_lost_count", ddsi_wr->rexmit_lost_count);
+  dds_stat_add (stats, nstats, &i, "throttle_count", ddsi_wr->throttle_count);
+  dds_stat_add (stats, nstats, &i, "time_throttled", (uint64_t) ddsi_wr->time_throttled);
+  dds_stat_add (stats, nstats, &i, "whc_unacked_bytes", whcst.unacked_bytes);
+  dds_stat_add (stats, nstats, &i, "whc_seq_range", (whcst.max_seq < whcst.min_seq) ? 0 : (uint64_t) (whcst.max_seq - whcst.min_seq + 1));
+  dds_stat_add (stats, nstats, &i, "reliable_readers", (uint64_t) ddsi_wr->num_reliable_readers);
+  ddsrt_mutex_unlock (&ddsi_wr->e.lock);
+  return (dds_return_t) i;
+}
+
 static dds_return_t dds_writer_status_validate (uint32_t mask)
 {
   return (mask & ~DDS_WRITER_STATUS_MASK) ? DDS_RETCODE_BAD_PARAMETER : DDS_RETCODE_OK;
@@ -173,6 +196,163 @@ static uint32_t get_bandwidth_limit (dds_transport_priority_qospolicy_t transpor
 #endif
 }
 
+static uint32_t instance_iid_hash (const void *vtk)
+{
+  /* instance ids are TEA-encrypted counters, so the low bits are as good as any */
+  const struct ddsi_tkmap_instance *tk = vtk;
+  return (uint32_t) tk->m_iid;
+}
+
+static int instance_iid_eq (const void *va, const void *vb)
+{
+  const struct ddsi_tkmap_instance *a = va;
+  const struct ddsi_tkmap_instance *b = vb;
+  return a->m_iid == b->m_iid;
+}
+
+void dds_writer_register_instance_tk (dds_writer *wr, struct ddsi_tkmap_instance *tk)
+{
+  /* takes over the caller's reference to tk */
+  assert (thread_is_awake ());
+  if (!ddsrt_hh_add (wr->m_instances, tk))
+    ddsi_tkmap_instance_unref (tk);
+}
+
+void dds_writer_unregister_instance_tk (dds_writer *wr, dds_instance_handle_t iid)
+{
+  struct ddsi_tkmap_instance template, *tk;
+  assert (thread_is_awake ());
+  template.m_iid = iid;
+  if ((tk = ddsrt_hh_lookup (wr->m_instances, &template)) != NULL)
+  {
+    ddsrt_hh_remove (wr->m_instances, tk);
+    ddsi_tkmap_instance_unref (tk);
+  }
+}
+
+struct ddsi_tkmap_instance *dds_writer_lookup_instance_ref (dds_writer *wr, dds_instance_handle_t iid)
+{
+  struct ddsi_tkmap_instance template, *tk;
+  assert (thread_is_awake ());
+  template.m_iid = iid;
+  if ((tk = ddsrt_hh_lookup (wr->m_instances, &template)) != NULL)
+  {
+    ddsi_tkmap_instance_ref (tk);
+    return tk;
+  }
+  /* Not registered with this writer (e.g., a handle obtained via lookup_instance),
+     fall back to the (much slower) scan of the tkmap; writing registers it anyway,
+     so add it to the writer's instances to only pay for the scan once */
+  if ((tk = ddsi_tkmap_find_by_id (gv.m_tkmap, iid)) != NULL)
+  {
+    ddsi_tkmap_instance_ref (tk);
+    dds_writer_register_instance_tk (wr, tk);
+  }
+  return tk;
+}
+
+static void unref_registered_instance (void *vtk, void *varg)
+{
+  (void) varg;
+  ddsi_tkmap_instance_unref (vtk);
+}
+
+static void dds_writer_batch_flush_cb (struct xevent *xev, void *varg, nn_mtime_t tnow)
+{
+  /* Runs on the event thread, which must not block on a writer that is in use by
+     an application thread (e.g., because it is throttled): if the writer is busy,
+     try again a little later */
+  const dds_entity_t writer = (dds_entity_t) (intptr_t) varg;
+  dds_entity *e;
+  if (tnow.v == T_NEVER)
+  {
+    delete_xevent (xev);
+    return;
+  }
+  /* the claim fails once the writer is being deleted, and closing it deletes the event */
+  if (dds_entity_claim (writer, &e) != DDS_RETCODE_OK)
+    return;
+  if (!ddsrt_mutex_trylock (&e->m_mutex))
+    resched_xevent_if_earlier (xev, add_duration_to_mtime (tnow, T_MILLISECOND));
+  else
+  {
+    dds_writer * const wr = (dds_writer *) e;
+    if (wr->m_batch_tflush.v == T_NEVER)
+      ; /* flushed in the meantime */
+    else if (wr->m_batch_tflush.v > tnow.v)
+      resched_xevent_if_earlier (xev, wr->m_batch_tflush);
+    else
+    {
+      if (nn_xpack_size (wr->m_xp) > 0)
+        nn_xpack_send (wr->m_xp, false);
+      wr->m_batch_tflush.v = T_NEVER;
+    }
+    ddsrt_mutex_unlock (&e->m_mutex);
+  }
+  dds_entity_release (e);
+}
+
+static void dds_writer_set_batch_policy_locked (dds_writer *wr, uint32_t max_bytes, dds_duration_t max_delay)
+{
+  wr->m_batch_max_bytes = max_bytes;
+  wr->m_batch_max_delay = max_delay;
+  /* heartbeats requiring an answer must not force out data that is held back */
+  nn_xpack_set_hold (wr->m_xp, max_delay > 0);
+  if (wr->m_batch_xevent == NULL && max_delay > 0 && max_delay != DDS_INFINITY)
+  {
+    nn_mtime_t tnever = { T_NEVER };
+    wr->m_batch_xevent = qxev_callback (tnever, dds_writer_batch_flush_cb, (void *) (intptr_t) wr->m_entity.m_hdllink.hdl);
+  }
+  /* anything held back under the old policy gets sent now */
+  if (nn_xpack_size (wr->m_xp) > 0)
+    nn_xpack_send (wr->m_xp, false);
+  wr->m_batch_tflush.v = T_NEVER;
+}
+
+bool dds_writer_maybe_flush (dds_writer *wr)
+{
+  uint32_t sz;
+  if (config.whc_batch)
+    return false;
+  else if ((sz = nn_xpack_size (wr->m_xp)) == 0)
+  {
+    /* nothing queued, so the write didn't add anything (e.g., there are
+       no remote readers); anything batched before may have gone out while
+       writing (e.g., when the writer got throttled) */
+    wr->m_batch_tflush.v = T_NEVER;
+    return false;
+  }
+  else if (wr->m_batch_max_delay == 0 || (wr->m_batch_max_bytes > 0 && sz >= wr->m_batch_max_bytes))
+  {
+    nn_xpack_send (wr->m_xp, false);
+    wr->m_batch_tflush.v = T_NEVER;
+    return true;
+  }
+  else if (wr->m_batch_xevent && (wr->m_batch_tflush.v == T_NEVER || wr->m_batch_packetid != nn_xpack_packetid (wr->m_xp)))
+  {
+    /* first data in this packet: start the clock */
+    wr->m_batch_packetid = nn_xpack_packetid (wr->m_xp);
+    wr->m_batch_tflush = add_duration_to_mtime (now_mt (), wr->m_batch_max_delay);
+    resched_xevent_if_earlier (wr->m_batch_xevent, wr->m_batch_tflush);
+  }
+  return false;
+}
+
+dds_return_t dds_write_set_batch_policy (dds_entity_t writer, uint32_t max_bytes, dds_duration_t max_delay)
+{
+  dds_writer *wr;
+  dds_return_t ret;
+  if (max_delay < 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return ret;
+  thread_state_awake (lookup_thread_state ());
+  dds_writer_set_batch_policy_locked (wr, max_bytes, max_delay);
+  thread_state_asleep (lookup_thread_state ());
+  dds_writer_unlock (wr);
+  return DDS_RETCODE_OK;
+}
+
 static dds_return_t dds_writer_close (dds_entity *e) ddsrt_nonnull_all;
 
 static dds_return_t dds_writer_close (dds_entity *e)
@@ -180,7 +360,12 @@ static dds_return_t dds_writer_close (dds_entity *e)
   dds_writer * const wr = (dds_writer *) e;
   dds_return_t ret;
   thread_state_awake (lookup_thread_state ());
+  if (wr->m_batch_xevent)
+    delete_xevent (wr->m_batch_xevent);
+  /* the flush event may still be running, holding a claim on the writer */
+  ddsrt_mutex_lock (&e->m_mutex);
   nn_xpack_send (wr->m_xp, false);
+  ddsrt_mutex_unlock (&e->m_mutex);
   if ((ret = delete_writer (&e->m_guid)) < 0)
     ret = DDS_RETCODE_ERROR;
   thread_state_asleep (lookup_thread_state ());
@@ -196,7 +381,9 @@ static dds_return_t dds_writer_delete (dds_entity *e)
   /* FIXME: not freeing WHC here because it is owned by the DDSI entity */
   thread_state_awake (lookup_thread_state ());
   nn_xpack_free (wr->m_xp);
+  ddsrt_hh_enum (wr->m_instances, unref_registered_instance, NULL);
   thread_state_asleep (lookup_thread_state ());
+  ddsrt_hh_free (wr->m_instances);
   if ((ret = dds_delete (wr->m_topic->m_entity.m_hdllink.hdl)) == DDS_RETCODE_OK)
   {
     ret = dds_delete_impl (e->m_parent->m_hdllink.hdl, true);
@@ -301,12 +488,17 @@ dds_entity_t dds_create_writer (dds_entity_t participant_or_publisher, dds_entit
   wr->m_topic = tp;
   dds_entity_add_ref_nolock (&tp->m_entity);
   wr->m_xp = nn_xpack_new (conn, get_bandwidth_limit (wqos->transport_priority), config.xpack_send_async);
+  wr->m_batch_packetid = 0;
+  wr->m_batch_tflush.v = T_NEVER;
+  wr->m_batch_xevent = NULL;
   wr->m_entity.m_deriver.close = dds_writer_close;
   wr->m_entity.m_deriver.delete = dds_writer_delete;
   wr->m_entity.m_deriver.set_qos = dds_writer_qos_set;
   wr->m_entity.m_deriver.validate_status = dds_writer_status_validate;
   wr->m_entity.m_deriver.get_instance_hdl = dds_writer_instance_hdl;
+  wr->m_entity.m_deriver.get_statistics = dds_writer_get_statistics;
   wr->m_whc = make_whc (wqos);
+  wr->m_instances = ddsrt_hh_new (1, instance_iid_hash, instance_iid_eq);
 
   /* Extra claim of this writer to make sure that the delete waits until DDSI
    * has deleted its writer as well. This can be known through the callback. */
@@ -316,6 +508,7 @@ dds_entity_t dds_create_writer (dds_entity_t participant_or_publisher, dds_entit
   ddsrt_mutex_unlock (&pub->m_entity.m_mutex);
 
   thread_state_awake (lookup_thread_state ());
+  dds_writer_set_batch_policy_locked (wr, 0, wqos->latency_budget.duration);
   rc = new_writer (&wr->m_wr, &wr->m_entity.m_guid, NULL, &pub->m_entity.m_participant->m_guid, tp->m_stopic, wqos, wr->m_whc, dds_writer_status_cb, wr);
   ddsrt_mutex_lock (&pub->m_entity.m_mutex);
   ddsrt_mutex_lock (&tp->m_entity.m_mutex);
@@ -363,6 +363,29 @@ CU_Test(ddsc_entity, delete, .init = create_entity)
     entity = 0;
 }
 
+CU_Test(ddsc_entity, stale_handle, .init = create_entity, .fini = delete_entity)
+{
+    dds_return_t status;
+    dds_entity_t pub1, pub2;
+
+    /* A deleted entity's handle must remain invalid, also when the
+       handle administration reuses its slot for a new entity. */
+    for (int i = 0; i < 300; i++) {
+        pub1 = dds_create_publisher(entity, NULL, NULL);
+        CU_ASSERT_FATAL(pub1 > 0);
+        status = dds_delete(pub1);
+        CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+        pub2 = dds_create_publisher(entity, NULL, NULL);
+        CU_ASSERT_FATAL(pub2 > 0);
+        CU_ASSERT_FATAL(pub2 != pub1);
+        status = dds_get_parent(pub1);
+        CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+        CU_ASSERT_EQUAL_FATAL(dds_get_parent(pub2), entity);
+        status = dds_delete(pub2);
+        CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    }
+}
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "CUnit/Test.h"
+#include "dds/dds.h"
+#include "dds/version.h"
+#include "dds/ddsrt/environ.h"
+#include "Space.h"
+
+static dds_entity_t participant = 0;
+static dds_entity_t topic = 0;
+static dds_entity_t reader = 0;
+static dds_entity_t writer = 0;
+
+static void
+setup(void)
+{
+    participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(participant > 0);
+    topic = dds_create_topic(participant, &Space_Type1_desc, "ddsc_statistics", NULL, NULL);
+    CU_ASSERT_FATAL(topic > 0);
+    reader = dds_create_reader(participant, topic, NULL, NULL);
+    CU_ASSERT_FATAL(reader > 0);
+    writer = dds_create_writer(participant, topic, NULL, NULL);
+    CU_ASSERT_FATAL(writer > 0);
+}
+
+static void
+setup_latency_stages(void)
+{
+    ddsrt_setenv(DDS_PROJECT_NAME_NOSPACE_CAPS"_URI", "<Internal><MeasureLatencyStages>true</MeasureLatencyStages></Internal>");
+    setup();
+}
+
+static void
+teardown(void)
+{
+    dds_delete(participant);
+}
+
+static uint64_t
+lookup(const dds_stat_keyvalue_t *stats, dds_return_t n, const char *name)
+{
+    for (dds_return_t i = 0; i < n; i++) {
+        if (strcmp(stats[i].name, name) == 0) {
+            return stats[i].value;
+        }
+    }
+    CU_FAIL_FATAL("counter not found");
+    return 0;
+}
+
+CU_Test(ddsc_statistics, bad_param, .init = setup, .fini = teardown)
+{
+    dds_return_t ret;
+    ret = dds_get_statistics(writer, NULL, 1);
+    CU_ASSERT_EQUAL(ret, DDS_RETCODE_BAD_PARAMETER);
+    ret = dds_get_statistics(0, NULL, 0);
+    CU_ASSERT_EQUAL(ret, DDS_RETCODE_BAD_PARAMETER);
+    ret = dds_get_statistics(dds_create_subscriber(participant, NULL, NULL), NULL, 0);
+    CU_ASSERT_EQUAL(ret, DDS_RETCODE_ILLEGAL_OPERATION);
+}
+
+CU_Test(ddsc_statistics, count_only, .init = setup, .fini = teardown)
+{
+    dds_stat_keyvalue_t stats[1];
+    dds_return_t n, m;
+    n = dds_get_statistics(writer, NULL, 0);
+    CU_ASSERT_FATAL(n > 1);
+    m = dds_get_statistics(writer, stats, 1);
+    CU_ASSERT_EQUAL(m, n);
+    CU_ASSERT_PTR_NOT_NULL(stats[0].name);
+    n = dds_get_statistics(participant, NULL, 0);
+    CU_ASSERT(n > 0);
+}
+
+CU_Test(ddsc_statistics, reader_writer, .init = setup, .fini = teardown)
+{
+    dds_stat_keyvalue_t stats[32];
+    dds_return_t n, ret;
+    for (int32_t i = 0; i < 3; i++) {
+        Space_Type1 sample = { i, 0, 0 };
+        ret = dds_write(writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+
+    n = dds_get_statistics(reader, stats, sizeof(stats) / sizeof(stats[0]));
+    CU_ASSERT_FATAL(n > 0 && n <= 32);
+    CU_ASSERT_EQUAL(lookup(stats, n, "rhc_instances"), 3);
+    CU_ASSERT_EQUAL(lookup(stats, n, "rhc_samples"), 3);
+    CU_ASSERT_EQUAL(lookup(stats, n, "samples_rejected"), 0);
+
+    n = dds_get_statistics(writer, stats, sizeof(stats) / sizeof(stats[0]));
+    CU_ASSERT_FATAL(n > 0 && n <= 32);
+    CU_ASSERT_EQUAL(lookup(stats, n, "rexmit_count"), 0);
+    CU_ASSERT_EQUAL(lookup(stats, n, "throttle_count"), 0);
+}
+
+CU_Test(ddsc_statistics, participant, .init = setup, .fini = teardown)
+{
+    dds_stat_keyvalue_t stats[32];
+    dds_return_t n;
+    n = dds_get_statistics(participant, stats, sizeof(stats) / sizeof(stats[0]));
+    CU_ASSERT_FATAL(n > 0 && n <= 32);
+    CU_ASSERT_EQUAL(lookup(stats, n, "malformed_packets"), 0);
+    /* the flight recorder only records protocol events exchanged with remote
+       entities, so that it counts them is checked in the multi-process
+       test statistics.flightrec */
+    (void) lookup(stats, n, "flightrec_events");
+    (void) lookup(stats, n, "flightrec_est_ns");
+}
+
+CU_Test(ddsc_statistics, topic_disabled, .init = setup, .fini = teardown)
+{
+    dds_stat_keyvalue_t stats[64];
+    dds_return_t n;
+    Space_Type1 sample = { 0, 0, 0 };
+    CU_ASSERT_EQUAL_FATAL(dds_write(writer, &sample), DDS_RETCODE_OK);
+    n = dds_get_statistics(topic, stats, sizeof(stats) / sizeof(stats[0]));
+    CU_ASSERT_FATAL(n > 0 && n <= 64);
+    for (dds_return_t i = 0; i < n; i++) {
+        CU_ASSERT_EQUAL(stats[i].value, 0);
+    }
+}
+
+CU_Test(ddsc_statistics, topic_latency_stages, .init = setup_latency_stages, .fini = teardown)
+{
+    dds_stat_keyvalue_t stats[64];
+    Space_Type1 samples[10];
+    void *ptrs[10];
+    dds_sample_info_t si[10];
+    dds_return_t n, ret;
+    for (int32_t i = 0; i < 10; i++) {
+        Space_Type1 sample = { i, 0, 0 };
+        ret = dds_write(writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+        ptrs[i] = &samples[i];
+    }
+    ret = dds_take(reader, ptrs, si, 10, 10);
+    CU_ASSERT_EQUAL_FATAL(ret, 10);
+
+    n = dds_get_statistics(topic, stats, sizeof(stats) / sizeof(stats[0]));
+    CU_ASSERT_FATAL(n > 0 && n <= 64);
+    CU_ASSERT_EQUAL(lookup(stats, n, "wr_serialize_count"), 10);
+    CU_ASSERT_EQUAL(lookup(stats, n, "wr_transmit_count"), 10);
+    CU_ASSERT_EQUAL(lookup(stats, n, "end_to_end_count"), 10);
+    CU_ASSERT_EQUAL(lookup(stats, n, "rd_store_read_count"), 10);
+    CU_ASSERT(lookup(stats, n, "end_to_end_p50_ns") <= lookup(stats, n, "end_to_end_max_ns"));
+    CU_ASSERT(lookup(stats, n, "end_to_end_max_ns") > 0);
+}
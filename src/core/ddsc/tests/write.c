@@ -16,9 +16,12 @@
 #include "RoundTrip.h"
 #include "Space.h"
 #include "dds/ddsrt/misc.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/q_protocol.h"
 
 /* Tests in this file only concern themselves with very basic api tests of
-   dds_write and dds_write_ts */
+   dds_write, dds_write_ts, dds_write_n, dds_write_set_batch_policy and
+   dds_forwardcdr */
 
 static const uint32_t payloadSize = 32;
 static RoundTripModule_DataType data;
@@ -158,3 +161,331 @@ CU_Test(ddsc_write, simpletypes)
     dds_delete(top);
     dds_delete(par);
 }
+
+CU_Test(ddsc_write_instance, registered)
+{
+    dds_return_t status;
+    dds_entity_t par, top, wri, rea;
+    dds_instance_handle_t ih;
+    Space_Type1 sample = { 1, 2, 3 };
+    void *raw[2] = { NULL, NULL };
+    dds_sample_info_t si[2];
+
+    par = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(par > 0);
+    top = dds_create_topic(par, &Space_Type1_desc, "WriteInstance", NULL, NULL);
+    CU_ASSERT_FATAL(top > 0);
+    rea = dds_create_reader(par, top, NULL, NULL);
+    CU_ASSERT_FATAL(rea > 0);
+    wri = dds_create_writer(par, top, NULL, NULL);
+    CU_ASSERT_FATAL(wri > 0);
+
+    status = dds_register_instance(wri, &ih, &sample);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    sample.long_2 = 4;
+    status = dds_write_instance(wri, ih, &sample);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+
+    status = dds_take(rea, raw, si, 2, 2);
+    CU_ASSERT_EQUAL_FATAL(status, 1);
+    CU_ASSERT_EQUAL(si[0].instance_handle, ih);
+    CU_ASSERT_EQUAL(((Space_Type1 *)raw[0])->long_1, 1);
+    CU_ASSERT_EQUAL(((Space_Type1 *)raw[0])->long_2, 4);
+    dds_return_loan(rea, raw, status);
+
+    status = dds_write_instance_ts(wri, ih, &sample, -1);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    status = dds_unregister_instance_ih(wri, ih);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+
+    dds_delete(par);
+}
+
+CU_Test(ddsc_write_instance, unknown_handle, .init = setup, .fini = teardown)
+{
+    dds_return_t status;
+
+    status = dds_write_instance(writer, 1, &data);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_PRECONDITION_NOT_MET);
+}
+
+CU_Test(ddsc_write_n, basic)
+{
+    dds_return_t status;
+    dds_entity_t par, top, wri, rea;
+    Space_Type1 samples[3] = { { 0, 1, 2 }, { 1, 2, 3 }, { 2, 3, 4 } };
+    const void *ptrs[3] = { &samples[0], &samples[1], &samples[2] };
+    const dds_time_t ts[3] = { 1000, 2000, 3000 };
+    void *raw[4] = { NULL, NULL, NULL, NULL };
+    dds_sample_info_t si[4];
+
+    par = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(par > 0);
+    top = dds_create_topic(par, &Space_Type1_desc, "WriteN", NULL, NULL);
+    CU_ASSERT_FATAL(top > 0);
+    rea = dds_create_reader(par, top, NULL, NULL);
+    CU_ASSERT_FATAL(rea > 0);
+    wri = dds_create_writer(par, top, NULL, NULL);
+    CU_ASSERT_FATAL(wri > 0);
+
+    status = dds_write_n(wri, ptrs, 3, ts);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_take(rea, raw, si, 4, 4);
+    CU_ASSERT_EQUAL_FATAL(status, 3);
+    for (int i = 0; i < 3; i++)
+    {
+        CU_ASSERT_EQUAL(((Space_Type1 *)raw[i])->long_1, i);
+        CU_ASSERT_EQUAL(((Space_Type1 *)raw[i])->long_2, i + 1);
+        CU_ASSERT_EQUAL(si[i].source_timestamp, ts[i]);
+    }
+    dds_return_loan(rea, raw, status);
+
+    status = dds_write_n(wri, ptrs, 0, NULL);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_write_n(wri, ptrs, 2, NULL);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_take(rea, raw, si, 4, 4);
+    CU_ASSERT_EQUAL_FATAL(status, 2);
+    CU_ASSERT_EQUAL(si[0].source_timestamp, si[1].source_timestamp);
+    dds_return_loan(rea, raw, status);
+
+    dds_delete(par);
+}
+
+CU_Test(ddsc_write_n, bad_parameters, .init = setup, .fini = teardown)
+{
+    dds_return_t status;
+    const void *ptrs[2] = { &data, NULL };
+    const dds_time_t ts[2] = { 0, -1 };
+
+    status = dds_write_n(writer, NULL, 1, NULL);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    status = dds_write_n(writer, ptrs, 2, NULL);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    ptrs[1] = &data;
+    status = dds_write_n(writer, ptrs, 2, ts);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    status = dds_write_n(publisher, ptrs, 2, NULL);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_ILLEGAL_OPERATION);
+}
+
+CU_Test(ddsc_write_set_batch_policy, basic, .init = setup, .fini = teardown)
+{
+    dds_return_t status;
+
+    status = dds_write_set_batch_policy(writer, 1024, DDS_MSECS(10));
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_write(writer, &data);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    dds_write_flush(writer);
+    status = dds_write_set_batch_policy(writer, 0, DDS_INFINITY);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_write(writer, &data);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_write_set_batch_policy(writer, 0, 0);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+}
+
+CU_Test(ddsc_write_set_batch_policy, latency_budget)
+{
+    dds_return_t status;
+    dds_entity_t par, top, wri, rea;
+    dds_qos_t *qos;
+    Space_Type1 sample = { 1, 2, 3 };
+    void *raw[2] = { NULL, NULL };
+    dds_sample_info_t si[2];
+
+    par = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(par > 0);
+    top = dds_create_topic(par, &Space_Type1_desc, "WriteBatchPolicy", NULL, NULL);
+    CU_ASSERT_FATAL(top > 0);
+    qos = dds_create_qos();
+    dds_qset_latency_budget(qos, DDS_MSECS(10));
+    rea = dds_create_reader(par, top, qos, NULL);
+    CU_ASSERT_FATAL(rea > 0);
+    wri = dds_create_writer(par, top, qos, NULL);
+    CU_ASSERT_FATAL(wri > 0);
+    dds_delete_qos(qos);
+
+    /* batching only affects the network, local readers get the data right away */
+    status = dds_write(wri, &sample);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_take(rea, raw, si, 2, 2);
+    CU_ASSERT_EQUAL_FATAL(status, 1);
+    dds_return_loan(rea, raw, status);
+
+    /* deleting the writer while the flush is pending */
+    status = dds_write(wri, &sample);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_delete(wri);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+
+    dds_delete(par);
+}
+
+CU_Test(ddsc_write_set_batch_policy, bad_parameters, .init = setup, .fini = teardown)
+{
+    dds_return_t status;
+
+    status = dds_write_set_batch_policy(writer, 0, -1);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    status = dds_write_set_batch_policy(publisher, 0, 0);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_ILLEGAL_OPERATION);
+    status = dds_write_set_batch_policy(0, 0, 0);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+}
+
+/* The serdata references handed to dds_forwardcdr may linger in the
+   writer's history for a while after it is deleted */
+static bool
+forwardcdr_wait_refc(struct ddsi_serdata *sd, uint32_t refc)
+{
+    const dds_time_t tend = dds_time() + DDS_SECS(5);
+    while (ddsrt_atomic_ld32(&sd->refc) != refc && dds_time() < tend)
+        dds_sleepfor(DDS_MSECS(10));
+    return ddsrt_atomic_ld32(&sd->refc) == refc;
+}
+
+static struct ddsi_serdata *
+forwardcdr_take_one(dds_entity_t rd, dds_time_t exp_ts)
+{
+    struct ddsi_serdata *sd = NULL;
+    dds_sample_info_t si;
+    dds_return_t status;
+
+    status = dds_takecdr(rd, &sd, 1, &si, DDS_ANY_STATE);
+    CU_ASSERT_EQUAL_FATAL(status, 1);
+    CU_ASSERT_FATAL(si.valid_data);
+    CU_ASSERT_EQUAL_FATAL(si.source_timestamp, exp_ts);
+    CU_ASSERT_EQUAL_FATAL(ddsrt_atomic_ld32(&sd->refc), 1);
+    return sd;
+}
+
+CU_Test(ddsc_forwardcdr, basic)
+{
+    const dds_time_t ts[3] = { DDS_SECS(10), DDS_SECS(20), DDS_SECS(30) };
+    dds_entity_t par, top_in, top_out, rd_in, wr_in, rd_out, wr_out;
+    struct ddsi_serdata *sd[3];
+    Space_Type1 sample, rbuf[3];
+    void *raw[3] = { &rbuf[0], &rbuf[1], &rbuf[2] };
+    dds_sample_info_t si[3];
+    dds_return_t status;
+    dds_qos_t *qos;
+
+    par = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(par > 0);
+    top_in = dds_create_topic(par, &Space_Type1_desc, "ForwardCdrIn", NULL, NULL);
+    CU_ASSERT_FATAL(top_in > 0);
+    top_out = dds_create_topic(par, &Space_Type1_desc, "ForwardCdrOut", NULL, NULL);
+    CU_ASSERT_FATAL(top_out > 0);
+    qos = dds_create_qos();
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    rd_in = dds_create_reader(par, top_in, qos, NULL);
+    CU_ASSERT_FATAL(rd_in > 0);
+    rd_out = dds_create_reader(par, top_out, qos, NULL);
+    CU_ASSERT_FATAL(rd_out > 0);
+    dds_delete_qos(qos);
+    wr_in = dds_create_writer(par, top_in, NULL, NULL);
+    CU_ASSERT_FATAL(wr_in > 0);
+    wr_out = dds_create_writer(par, top_out, NULL, NULL);
+    CU_ASSERT_FATAL(wr_out > 0);
+
+    /* a plain write, a write-dispose and, because an unregister never makes
+       it into a reader with its payload, a sample turned into an unregister
+       as it would be when received from a remote writer */
+    sample.long_1 = 0; sample.long_2 = 0; sample.long_3 = 0;
+    status = dds_write_ts(wr_in, &sample, ts[0]);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    sd[0] = forwardcdr_take_one(rd_in, ts[0]);
+    sample.long_1 = 1;
+    status = dds_writedispose_ts(wr_in, &sample, ts[1]);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    sd[1] = forwardcdr_take_one(rd_in, ts[1]);
+    CU_ASSERT_EQUAL_FATAL(sd[1]->statusinfo, NN_STATUSINFO_DISPOSE);
+    sample.long_1 = 2;
+    status = dds_write_ts(wr_in, &sample, ts[2]);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    sd[2] = forwardcdr_take_one(rd_in, ts[2]);
+    sd[2]->statusinfo = NN_STATUSINFO_UNREGISTER;
+
+    /* forwarding consumes the reference, keep one to check that */
+    for (int i = 0; i < 3; i++)
+    {
+        ddsi_serdata_ref(sd[i]);
+        status = dds_forwardcdr(wr_out, sd[i]);
+        CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    }
+
+    status = dds_take(rd_out, raw, si, 3, 3);
+    CU_ASSERT_EQUAL_FATAL(status, 3);
+    for (int i = 0; i < status; i++)
+    {
+        CU_ASSERT_FATAL(si[i].valid_data);
+        CU_ASSERT_FATAL(rbuf[i].long_1 >= 0 && rbuf[i].long_1 < 3);
+        CU_ASSERT_EQUAL(si[i].source_timestamp, ts[rbuf[i].long_1]);
+        switch (rbuf[i].long_1)
+        {
+            case 0: CU_ASSERT_EQUAL(si[i].instance_state, DDS_IST_ALIVE); break;
+            case 1: CU_ASSERT_EQUAL(si[i].instance_state, DDS_IST_NOT_ALIVE_DISPOSED); break;
+            case 2: CU_ASSERT_EQUAL(si[i].instance_state, DDS_IST_NOT_ALIVE_NO_WRITERS); break;
+        }
+    }
+
+    status = dds_delete(wr_out);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    for (int i = 0; i < 3; i++)
+    {
+        CU_ASSERT(forwardcdr_wait_refc(sd[i], 1));
+        ddsi_serdata_unref(sd[i]);
+    }
+    dds_delete(par);
+}
+
+CU_Test(ddsc_forwardcdr, bad_parameters)
+{
+    dds_entity_t par, top, top2, rd, wr, wr2;
+    Space_Type1 sample = { 1, 2, 3 };
+    struct ddsi_serdata *sd;
+    dds_return_t status;
+
+    par = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    CU_ASSERT_FATAL(par > 0);
+    top = dds_create_topic(par, &Space_Type1_desc, "ForwardCdrBad", NULL, NULL);
+    CU_ASSERT_FATAL(top > 0);
+    top2 = dds_create_topic(par, &Space_Type2_desc, "ForwardCdrBad2", NULL, NULL);
+    CU_ASSERT_FATAL(top2 > 0);
+    rd = dds_create_reader(par, top, NULL, NULL);
+    CU_ASSERT_FATAL(rd > 0);
+    wr = dds_create_writer(par, top, NULL, NULL);
+    CU_ASSERT_FATAL(wr > 0);
+    wr2 = dds_create_writer(par, top2, NULL, NULL);
+    CU_ASSERT_FATAL(wr2 > 0);
+
+    status = dds_write_ts(wr, &sample, DDS_SECS(1));
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    sd = forwardcdr_take_one(rd, DDS_SECS(1));
+
+    status = dds_forwardcdr(wr, NULL);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+
+    /* the reference is consumed also when the operation fails */
+    ddsi_serdata_ref(sd);
+    status = dds_forwardcdr(wr2, sd);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    CU_ASSERT_EQUAL_FATAL(ddsrt_atomic_ld32(&sd->refc), 1);
+
+    ddsi_serdata_ref(sd);
+    status = dds_forwardcdr(rd, sd);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_ILLEGAL_OPERATION);
+    CU_ASSERT_EQUAL_FATAL(ddsrt_atomic_ld32(&sd->refc), 1);
+
+    status = dds_delete(wr2);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    ddsi_serdata_ref(sd);
+    status = dds_forwardcdr(wr2, sd);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    CU_ASSERT_EQUAL_FATAL(ddsrt_atomic_ld32(&sd->refc), 1);
+
+    ddsi_serdata_unref(sd);
+    dds_delete(par);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_NETSIM_H
+#define DDSI_NETSIM_H
+
+#include "dds/ddsi/ddsi_tran.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Network simulation for testing (Internal/Test/NetworkSimulation): packets
+   sent and received over connectionless transports are subjected to the
+   first matching rule, which may drop, duplicate, delay, reorder and rate
+   limit them.  All random decisions come from a PRNG per rule, seeded from
+   Internal/Test/NetworkSimulationSeed, so a run can be repeated as far as
+   the timing of the application allows.
+
+   Only loss is supported for received packets, the other impairments can be
+   simulated by applying rules to the outgoing traffic of both ends. */
+
+struct ddsi_netsim;
+
+/* Parses the rules and sets gv.netsim, which remains NULL if there are none;
+   returns < 0 on an invalid configuration */
+int ddsi_netsim_init (void);
+void ddsi_netsim_fini (void);
+
+/* Starts the thread that sends delayed packets; stopping it discards the
+   packets still queued (must be done before the connections are freed) */
+dds_return_t ddsi_netsim_start (void);
+void ddsi_netsim_stop (void);
+
+/* Replacement for ddsi_conn_write when gv.netsim is set, it returns the
+   number of bytes of the packet also when it is dropped or queued */
+ssize_t ddsi_netsim_write (ddsi_tran_conn_t conn, const nn_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags);
+
+/* Whether the packet just received from "src" should be dropped */
+bool ddsi_netsim_drop_received (ddsi_tran_conn_t conn, const nn_locator_t *src, size_t size);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_NETSIM_H */
@@ -0,0 +1,62 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_PROBES_H
+#define DDSI_PROBES_H
+
+/* Static tracepoints (Linux USDT) in provider "cyclonedds", only present when
+   built with DDSC_ENABLE_USDT, otherwise they compile to nothing.
+
+   GUIDs are passed as two 64-bit integers in host byte order: the first holds
+   the first 8 bytes of the GUID prefix, the second the last 4 bytes of the
+   prefix followed by the entity id, so printing both as %016llx gives the
+   familiar representation.  Sequence numbers are 64-bit signed integers.
+
+   Probes and their arguments:
+
+     write           wr_hi wr_lo seq size
+     packet_sent     size niov
+     packet_received size src_hi src_lo
+     deliver         pwr_hi pwr_lo rd_hi rd_lo seq
+     rexmit_queued   wr_hi wr_lo rd_hi rd_lo seq size
+     acknack         wr_hi wr_lo rd_hi rd_lo base numbits
+     heartbeat       pwr_hi pwr_lo rd_hi rd_lo first last
+     throttle_begin  wr_hi wr_lo unacked_bytes
+     throttle_end    wr_hi wr_lo unacked_bytes timed_out
+     lease_expired   hi lo
+
+   A retransmit to all readers has reader GUID 0 0, a heartbeat not addressed
+   to a specific reader has a reader GUID with entity id 0. */
+
+#ifdef DDSI_INCLUDE_USDT
+
+#include <stdint.h>
+#include <sys/sdt.h>
+
+#define DDSI_PROBE_GUID(g) \
+  (((uint64_t) (g)->prefix.u[0] << 32) | (g)->prefix.u[1]), \
+  (((uint64_t) (g)->prefix.u[2] << 32) | (g)->entityid.u)
+#define DDSI_PROBE_PREFIX(p) \
+  (((uint64_t) (p)->u[0] << 32) | (p)->u[1]), \
+  ((uint64_t) (p)->u[2] << 32)
+
+/* DDSI_PROBE_GUID expands to two arguments, so the number of arguments can
+   only be counted after expansion, hence the indirection */
+#define DDSI_PROBE(name, ...) DDSI_PROBE_N (__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1) (cyclonedds, name, __VA_ARGS__)
+#define DDSI_PROBE_N(a1, a2, a3, a4, a5, a6, a7, a8, n, ...) STAP_PROBE##n
+
+#else
+
+#define DDSI_PROBE(name, ...) ((void) 0)
+
+#endif /* DDSI_INCLUDE_USDT */
+
+#endif /* DDSI_PROBES_H */
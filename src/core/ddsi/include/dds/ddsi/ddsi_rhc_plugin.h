@@ -42,6 +42,7 @@ struct ddsi_rhc_plugin
   void (*rhc_relinquish_ownership_fn)
   (struct rhc * __restrict rhc, const uint64_t wr_iid);
   void (*rhc_set_qos_fn) (struct rhc * rhc, const struct dds_qos * qos);
+  void (*rhc_get_counts_fn) (struct rhc * rhc, uint32_t *ninstances, uint32_t *nsamples);
 };
 
 DDS_EXPORT void make_proxy_writer_info(struct proxy_writer_info *pwr_info, const struct entity_common *e, const struct dds_qos *xqos);
@@ -71,6 +71,15 @@ typedef struct ddsi_serdata * (*ddsi_serdata_from_keyhash_t) (const struct ddsi_
      unless additional application knowledge is available */
 typedef struct ddsi_serdata * (*ddsi_serdata_from_sample_t) (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample);
 
+/* Construct a serdata from an application sample of which the key value is known to be
+   equal to that of "keyd", a topicless serdata as returned by to_topicless (typically the
+   one held by the key-to-instance map)
+   - this allows skipping the extraction and hashing of the key value, which for keys
+     that don't fit in a keyhash involves computing an MD5 hash
+   - the key fields of "sample" must match those of "keyd", this is not checked
+   - may be a null pointer, in which case from_sample is used instead */
+typedef struct ddsi_serdata * (*ddsi_serdata_from_sample_keyed_t) (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample, const struct ddsi_serdata *keyd);
+
 /* Construct a topic-less serdata with just a keyvalue given a normal serdata (either key or data)
    - used for mapping key values to instance ids in tkmap
    - two reasons: size (keys are typically smaller than samples), and data in tkmap
@@ -129,6 +138,7 @@ struct ddsi_serdata_ops {
   ddsi_serdata_from_ser_t from_ser;
   ddsi_serdata_from_keyhash_t from_keyhash;
   ddsi_serdata_from_sample_t from_sample;
+  ddsi_serdata_from_sample_keyed_t from_sample_keyed;
   ddsi_serdata_to_ser_t to_ser;
   ddsi_serdata_to_ser_ref_t to_ser_ref;
   ddsi_serdata_to_ser_unref_t to_ser_unref;
@@ -167,6 +177,12 @@ DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_sample (const struct dd
   return topic->serdata_ops->from_sample (topic, kind, sample);
 }
 
+DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_sample_keyed (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample, const struct ddsi_serdata *keyd) {
+  if (topic->serdata_ops->from_sample_keyed == 0 || keyd->ops != topic->serdata_ops)
+    return topic->serdata_ops->from_sample (topic, kind, sample);
+  return topic->serdata_ops->from_sample_keyed (topic, kind, sample, keyd);
+}
+
 DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_to_topicless (const struct ddsi_serdata *d) {
   return d->ops->to_topicless (d);
 }
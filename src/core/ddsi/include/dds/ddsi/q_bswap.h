@@ -93,7 +93,7 @@ nn_guid_prefix_t nn_ntoh_guid_prefix (nn_guid_prefix_t p);
 nn_entityid_t nn_hton_entityid (nn_entityid_t e);
 nn_entityid_t nn_ntoh_entityid (nn_entityid_t e);
 nn_guid_t nn_hton_guid (nn_guid_t g);
-nn_guid_t nn_ntoh_guid (nn_guid_t g);
+DDS_EXPORT nn_guid_t nn_ntoh_guid (nn_guid_t g);
 
 void bswap_sequence_number_set_hdr (nn_sequence_number_set_t *snset);
 void bswap_sequence_number_set_bitmap (nn_sequence_number_set_t *snset);
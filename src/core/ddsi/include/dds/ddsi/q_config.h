@@ -238,6 +238,7 @@ struct config
   char *tracingOutputFileName;
   int tracingTimestamps;
   int tracingAppendToFile;
+  uint32_t tracingAsyncBufferSize;
   uint32_t allowMulticast;
   int prefer_multicast;
   enum transport_selector transport_selector;
@@ -275,6 +276,8 @@ struct config
 
   unsigned delivery_queue_maxsamples;
 
+  int event_threads;
+
   int do_topic_discovery;
 
   uint32_t max_msg_size;
@@ -327,10 +330,15 @@ struct config
 
   /* debug/test/undoc features: */
   int xmit_lossiness;           /**<< fraction of packets to drop on xmit, in units of 1e-3 */
+  char *netsim;                 /**<< network simulation rules, see ddsi_netsim.h */
+  uint32_t netsim_seed;         /**<< seed for the network simulation PRNGs */
   uint32_t rmsg_chunk_size;          /**<< size of a chunk in the receive buffer */
   uint32_t rbuf_size;                /* << size of a single receiver buffer */
   enum besmode besmode;
   int meas_hb_to_ack_latency;
+  int meas_latency_stages;
+  uint32_t flightrec_size;
+  int flightrec_signal;
   int unicast_response_to_spdp_messages;
   int synchronous_delivery_priority_threshold;
   int64_t synchronous_delivery_latency_bound;
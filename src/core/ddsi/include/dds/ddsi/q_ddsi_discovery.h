@@ -12,6 +12,7 @@
 #ifndef NN_DDSI_DISCOVERY_H
 #define NN_DDSI_DISCOVERY_H
 
+#include "dds/export.h"
 #include "dds/ddsi/q_unused.h"
 
 #if defined (__cplusplus)
@@ -28,7 +29,7 @@ struct nn_plist;
 int spdp_write (struct participant *pp);
 int spdp_dispose_unregister (struct participant *pp);
 
-int sedp_write_writer (struct writer *wr);
+DDS_EXPORT int sedp_write_writer (struct writer *wr);
 int sedp_write_reader (struct reader *rd);
 int sedp_dispose_unregister_writer (struct writer *wr);
 int sedp_dispose_unregister_reader (struct reader *rd);
@@ -33,6 +33,7 @@ struct xevent;
 struct nn_reorder;
 struct nn_defrag;
 struct nn_dqueue;
+struct nn_lat_stages;
 struct nn_rsample_info;
 struct nn_rdata;
 struct addrset;
@@ -141,6 +142,8 @@ struct entity_common {
   struct ddsi_tkmap_instance *tk;
   ddsrt_mutex_t lock;
   bool onlylocal;
+  ddsrt_avl_node_t topic_avlnode; /* in topic index of ephash, only for endpoints with a topic name */
+  struct ephash_topic *topic; /* entry in topic index of ephash, null if not in index */
 };
 
 struct local_reader_ary {
@@ -259,8 +262,11 @@ struct writer
   uint32_t throttle_tracing;
   uint32_t rexmit_count; /* cum samples retransmitted (counting events; 1 sample can be counted many times) */
   uint32_t rexmit_lost_count; /* cum samples lost but retransmit requested (also counting events) */
+  uint64_t rexmit_bytes; /* cum bytes of samples retransmitted (same counting as rexmit_count) */
+  int64_t time_throttled; /* cum time spent in throttle_writer */
   struct xeventq *evq; /* timed event queue to be used by this writer */
   struct local_reader_ary rdary; /* LOCAL readers for fast-pathing; if not fast-pathed, fall back to scanning local_readers */
+  struct nn_lat_stages *lat_stages; /* latency breakdown for topic, NULL unless enabled */
 };
 
 struct reader
@@ -332,11 +338,13 @@ struct proxy_endpoint_common
   struct proxy_participant *proxypp; /* counted backref to proxy participant */
   struct proxy_endpoint_common *next_ep; /* next \ endpoint belonging to this proxy participant */
   struct proxy_endpoint_common *prev_ep; /* prev / -- this is in arbitrary ordering */
-  struct dds_qos *xqos; /* proxy endpoint QoS lives here; FIXME: local ones should have it moved to common as well */
+  const struct dds_qos *xqos; /* proxy endpoint QoS lives here, interned in gv.xqos_intern; FIXME: local ones should have it moved to common as well */
   struct ddsi_sertopic * topic; /* topic may be NULL: for built-ins, but also for never-yet matched proxies (so we don't have to know the topic; when we match, we certainly do know) */
   struct addrset *as; /* address set to use for communicating with this endpoint */
   nn_guid_t group_guid; /* 0:0:0:0 if not available */
   nn_vendorid_t vendor; /* cached from proxypp->vendor */
+  bool have_sedp_digest; /* whether sedp_digest is set, protected by entity lock */
+  unsigned char sedp_digest[16]; /* MD5 of most recent SEDP payload, for recognizing unchanged re-announcements */
 };
 
 struct proxy_writer {
@@ -363,6 +371,7 @@ struct proxy_writer {
   struct local_reader_ary rdary; /* LOCAL readers for fast-pathing; if not fast-pathed, fall back to scanning local_readers */
   ddsi2direct_directread_cb_t ddsi2direct_cb;
   void *ddsi2direct_cbarg;
+  struct nn_lat_stages *lat_stages; /* latency breakdown for topic, set with c.topic, NULL unless enabled */
 };
 
 struct proxy_reader {
@@ -12,6 +12,7 @@
 #ifndef Q_EPHASH_H
 #define Q_EPHASH_H
 
+#include <stdbool.h>
 #include "dds/ddsrt/hopscotch.h"
 
 #if defined (__cplusplus)
@@ -26,6 +27,8 @@ struct proxy_participant;
 struct proxy_reader;
 struct proxy_writer;
 struct nn_guid;
+struct entity_common;
+struct ephash_topic;
 
   enum entity_kind {
     EK_PARTICIPANT,
@@ -80,13 +83,13 @@ void ephash_remove_proxy_writer_guid (struct proxy_writer *pwr);
 void ephash_remove_proxy_reader_guid (struct proxy_reader *prd);
 
 void *ephash_lookup_guid_untyped (const struct nn_guid *guid);
-void *ephash_lookup_guid (const struct nn_guid *guid, enum entity_kind kind);
+DDS_EXPORT void *ephash_lookup_guid (const struct nn_guid *guid, enum entity_kind kind);
 
 struct participant *ephash_lookup_participant_guid (const struct nn_guid *guid);
 struct proxy_participant *ephash_lookup_proxy_participant_guid (const struct nn_guid *guid);
 struct writer *ephash_lookup_writer_guid (const struct nn_guid *guid);
 struct reader *ephash_lookup_reader_guid (const struct nn_guid *guid);
-struct proxy_writer *ephash_lookup_proxy_writer_guid (const struct nn_guid *guid);
+DDS_EXPORT struct proxy_writer *ephash_lookup_proxy_writer_guid (const struct nn_guid *guid);
 struct proxy_reader *ephash_lookup_proxy_reader_guid (const struct nn_guid *guid);
 
 
@@ -114,27 +117,50 @@ void ephash_enum_init (struct ephash_enum *st, enum entity_kind kind);
 void *ephash_enum_next (struct ephash_enum *st);
 void ephash_enum_fini (struct ephash_enum *st);
 
-void ephash_enum_writer_init (struct ephash_enum_writer *st);
+DDS_EXPORT void ephash_enum_writer_init (struct ephash_enum_writer *st);
 void ephash_enum_reader_init (struct ephash_enum_reader *st);
 void ephash_enum_proxy_writer_init (struct ephash_enum_proxy_writer *st);
 void ephash_enum_proxy_reader_init (struct ephash_enum_proxy_reader *st);
 void ephash_enum_participant_init (struct ephash_enum_participant *st);
 void ephash_enum_proxy_participant_init (struct ephash_enum_proxy_participant *st);
 
-struct writer *ephash_enum_writer_next (struct ephash_enum_writer *st);
+DDS_EXPORT struct writer *ephash_enum_writer_next (struct ephash_enum_writer *st);
 struct reader *ephash_enum_reader_next (struct ephash_enum_reader *st);
 struct proxy_writer *ephash_enum_proxy_writer_next (struct ephash_enum_proxy_writer *st);
 struct proxy_reader *ephash_enum_proxy_reader_next (struct ephash_enum_proxy_reader *st);
 struct participant *ephash_enum_participant_next (struct ephash_enum_participant *st);
 struct proxy_participant *ephash_enum_proxy_participant_next (struct ephash_enum_proxy_participant *st);
 
-void ephash_enum_writer_fini (struct ephash_enum_writer *st);
+DDS_EXPORT void ephash_enum_writer_fini (struct ephash_enum_writer *st);
 void ephash_enum_reader_fini (struct ephash_enum_reader *st);
 void ephash_enum_proxy_writer_fini (struct ephash_enum_proxy_writer *st);
 void ephash_enum_proxy_reader_fini (struct ephash_enum_proxy_reader *st);
 void ephash_enum_participant_fini (struct ephash_enum_participant *st);
 void ephash_enum_proxy_participant_fini (struct ephash_enum_proxy_participant *st);
 
+/* Enumeration of the endpoints of a kind with the same topic name as a given
+   endpoint, using the topic index that is maintained on insert/remove:
+
+   - only endpoints that have a topic name are in the index (so not the
+     built-in endpoints);
+
+   - visits all entries that were in the index at the time of calling init
+     and that have not subsequently been removed, each at most once;
+
+   - the index itself is protected by a lock that is never held while
+     calling out of the ephash code, so it is safe to call init & next
+     while holding entity locks. */
+struct ephash_enum_topic {
+  enum entity_kind kind;
+  uint32_t cursor;
+  uint32_t n;
+  struct nn_guid *guids;
+};
+
+DDS_EXPORT bool ephash_enum_topic_init (struct ephash_enum_topic *st, const struct entity_common *e, enum entity_kind kind);
+DDS_EXPORT void *ephash_enum_topic_next (struct ephash_enum_topic *st);
+DDS_EXPORT void ephash_enum_topic_fini (struct ephash_enum_topic *st);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef NN_FLIGHTREC_H
+#define NN_FLIGHTREC_H
+
+#include <stdint.h>
+#include "dds/export.h"
+#include "dds/ddsi/q_rtps.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Flight recorder: a bounded ring of recent protocol events per thread
+   (Internal/FlightRecorderSize), written without locks by the owning thread
+   and dumped on request via the debug monitor or a signal.
+
+   For each kind, "src" is the entity doing or sending something and "dst"
+   the one it is addressed to, if any. */
+enum nn_flightrec_kind {
+  NN_FR_HEARTBEAT_SENT = 1, /* wr -> prd: seq1 first, seq2 last, arg count */
+  NN_FR_HEARTBEAT_RECV,  /* pwr -> rd: seq1 first, seq2 last, arg count */
+  NN_FR_ACKNACK_SENT,    /* rd -> pwr: seq1 base, arg numbits, seq2 count */
+  NN_FR_ACKNACK_RECV,    /* prd -> wr: seq1 base, arg numbits, seq2 count */
+  NN_FR_GAP_SENT,        /* wr -> prd: seq1 start, seq2 bitmap base, arg numbits */
+  NN_FR_GAP_RECV,        /* pwr -> rd: seq1 start, seq2 bitmap base, arg numbits */
+  NN_FR_REXMIT,          /* wr -> prd (or all): seq1 seq, arg size */
+  NN_FR_THROTTLE_BEGIN,  /* wr: arg unacked bytes (KiB) */
+  NN_FR_THROTTLE_END,    /* wr: arg unacked bytes (KiB), seq2 timed out */
+  NN_FR_LEASE_SET,       /* entity: seq1 new expiry time (elapsed time clock, ns) */
+  NN_FR_LEASE_EXPIRED    /* entity */
+};
+
+DDS_EXPORT void nn_flightrec_init (void);
+DDS_EXPORT void nn_flightrec_fini (void);
+/* Starts polling for the dump signal (Internal/FlightRecorderSignal), requires
+   the event queue to exist */
+DDS_EXPORT void nn_flightrec_start (void);
+
+DDS_EXPORT void nn_flightrec_record (enum nn_flightrec_kind kind, const nn_guid_t *src, const nn_guid_t *dst, int64_t seq1, int64_t seq2, uint32_t arg);
+
+/* Calls "out" for each line of the text representation of all recorded
+   events, merged across threads and in order of time */
+DDS_EXPORT void nn_flightrec_dump (void (*out) (void *arg, const char *line), void *arg);
+
+/* Total number of events recorded and an estimate of the CPU time spent
+   recording them (in ns), for gauging the overhead */
+DDS_EXPORT void nn_flightrec_get_stats (uint64_t *nevents, uint64_t *est_ns);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* NN_FLIGHTREC_H */
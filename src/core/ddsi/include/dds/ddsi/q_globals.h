@@ -43,6 +43,7 @@ struct addrset;
 struct xeventq;
 struct gcreq_queue;
 struct ephash;
+struct nn_xqos_intern;
 struct lease;
 struct ddsi_tran_conn;
 struct ddsi_tran_listener;
@@ -50,6 +51,7 @@ struct ddsi_tran_factory;
 struct ddsrt_thread_pool_s;
 struct debug_monitor;
 struct ddsi_tkmap;
+struct ddsi_netsim;
 
 typedef struct config_in_addr_node {
    nn_locator_t loc;
@@ -86,6 +88,30 @@ struct recv_thread_arg {
   } u;
 };
 
+/* Domain-wide event counters, reported by dds_get_statistics for a
+   participant; all events are rare, so atomic increments are fine */
+struct q_globals_stats {
+  ddsrt_atomic_uint32_t malformed_packets; /* packets (partially) discarded as malformed */
+  ddsrt_atomic_uint32_t oversize_samples; /* samples dropped for exceeding MaxSampleSize */
+  ddsrt_atomic_uint32_t gaps_received; /* GAP submessages processed */
+  ddsrt_atomic_uint32_t reorder_rejects; /* samples rejected by a full reorder buffer */
+  ddsrt_atomic_uint32_t recv_errors; /* failed reads from a socket */
+  ddsrt_atomic_uint32_t send_errors; /* failed writes to a socket */
+  ddsrt_atomic_uint32_t packets_sent; /* packets written to a socket */
+  ddsrt_atomic_uint32_t packets_received; /* packets read from a socket */
+#if DDSRT_HAVE_ATOMIC64
+  ddsrt_atomic_uint64_t bytes_sent; /* bytes written to a socket */
+  ddsrt_atomic_uint64_t bytes_received; /* bytes read from a socket */
+#else
+  ddsrt_atomic_uint32_t bytes_sent; /* bytes written to a socket (wraps around) */
+  ddsrt_atomic_uint32_t bytes_received; /* bytes read from a socket (wraps around) */
+#endif
+  ddsrt_atomic_uint32_t netsim_dropped; /* packets dropped by network simulation */
+  ddsrt_atomic_uint32_t netsim_duplicated; /* packets duplicated by network simulation */
+  ddsrt_atomic_uint32_t netsim_reordered; /* packets reordered by network simulation */
+  ddsrt_atomic_uint32_t sedp_unchanged; /* SEDP re-announcements skipped as unchanged */
+};
+
 struct q_globals {
   volatile int terminate;
   volatile int exception;
@@ -100,8 +126,18 @@ struct q_globals {
      (guid_hash) */
   struct ephash *guid_hash;
 
-  /* Timed events admin */
+  /* Counters for dds_get_statistics */
+  struct q_globals_stats stats;
+
+  /* Interned QoS objects shared by proxy endpoints */
+  struct nn_xqos_intern *xqos_intern;
+
+  /* Timed events admin: xevents handles discovery and is the first of the
+     n_xevents_shards queues over which writers and proxy writers are
+     distributed by GUID (see xeventq_for_guid) */
   struct xeventq *xevents;
+  uint32_t n_xevents_shards;
+  struct xeventq **xevents_shards;
 
   /* Queue for garbage collection requests */
   struct gcreq_queue *gcreq_queue;
@@ -109,7 +145,9 @@ struct q_globals {
 
   /* Lease junk */
   ddsrt_mutex_t leaseheap_lock;
+#if ! DDSRT_HAVE_ATOMIC64
   ddsrt_mutex_t lease_locks[N_LEASE_LOCKS];
+#endif
   ddsrt_fibheap_t leaseheap;
 
   /* Transport factory */
@@ -127,6 +165,9 @@ struct q_globals {
   struct ddsi_tran_conn * disc_conn_uc;
   struct ddsi_tran_conn * data_conn_uc;
 
+  /* Network simulation (Internal/Test/NetworkSimulation), NULL if disabled */
+  struct ddsi_netsim *netsim;
+
   /* TCP listener */
 
   struct ddsi_tran_listener * listener;
@@ -0,0 +1,80 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef NN_LAT_STAGES_H
+#define NN_LAT_STAGES_H
+
+#include "dds/export.h"
+#include "dds/ddsrt/atomics.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Per-topic latency breakdown of the data path (Internal/MeasureLatencyStages).
+
+   Each stage is the time between two consecutive points on the path of a
+   sample, all measured with the wall clock so the end-to-end stage can use
+   the source timestamp.  Stages that do not apply to a sample (e.g., the
+   delivery queue with synchronous delivery) are simply not recorded. */
+enum nn_lat_stage {
+  NN_LAT_STAGE_WR_SERIALIZE,    /* write call -> serialized sample */
+  NN_LAT_STAGE_WR_TRANSMIT,     /* serialized -> packet handed to the network */
+  NN_LAT_STAGE_RD_RECV_ENQUEUE, /* packet received -> enqueued on delivery queue */
+  NN_LAT_STAGE_RD_DQUEUE,       /* enqueued -> delivery started */
+  NN_LAT_STAGE_RD_RECV_STORE,   /* packet received -> stored in reader history cache */
+  NN_LAT_STAGE_RD_STORE_READ,   /* stored -> first read or take */
+  NN_LAT_STAGE_END_TO_END       /* source timestamp -> stored in reader history cache */
+};
+#define NN_LAT_STAGE_COUNT ((int) NN_LAT_STAGE_END_TO_END + 1)
+
+/* Log-linear ("HDR-style") histogram of nanosecond values: values below
+   2^SUBBITS get their own bucket, above that, each power of two is split
+   into 2^SUBBITS linear sub-buckets, giving a relative error < 1/2^SUBBITS
+   up to 2^MAXBITS ns (~18 minutes).  Larger values go in the last bucket. */
+#define NN_LAT_HIST_SUBBITS 4
+#define NN_LAT_HIST_MAXBITS 40
+#define NN_LAT_HIST_NBUCKETS ((NN_LAT_HIST_MAXBITS - NN_LAT_HIST_SUBBITS + 1) << NN_LAT_HIST_SUBBITS)
+
+struct nn_lat_hist {
+  ddsrt_atomic_uint32_t count;
+  ddsrt_atomic_uint32_t bucket[NN_LAT_HIST_NBUCKETS];
+};
+
+struct nn_lat_stages {
+  struct nn_lat_stages *next;
+  char *topic_name;
+  struct nn_lat_hist hist[NN_LAT_STAGE_COUNT];
+};
+
+void nn_lat_stages_init (void);
+void nn_lat_stages_fini (void);
+
+/* Returns the (shared, never freed until shutdown) histograms for the named
+   topic, creating them if needed; returns NULL if measuring is disabled */
+DDS_EXPORT struct nn_lat_stages *nn_lat_stages_lookup (const char *topic_name);
+DDS_EXPORT void nn_lat_stages_enum (void (*f) (const struct nn_lat_stages *st, void *arg), void *arg);
+DDS_EXPORT const char *nn_lat_stage_name (enum nn_lat_stage stage);
+
+DDS_EXPORT void nn_lat_hist_add (struct nn_lat_hist *h, int64_t dt);
+/* Returns upper bound of bucket containing the q-quantile (0 <= q <= 1) in ns, 0 if empty */
+DDS_EXPORT int64_t nn_lat_hist_quantile (const struct nn_lat_hist *h, double q);
+
+DDS_EXPORT inline void nn_lat_stages_add (struct nn_lat_stages *st, enum nn_lat_stage stage, int64_t t0, int64_t t1) {
+  if (st != NULL && t0 != 0)
+    nn_lat_hist_add (&st->hist[stage], t1 - t0);
+}
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* NN_LAT_STAGES_H */
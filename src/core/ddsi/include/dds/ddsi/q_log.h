@@ -22,15 +22,19 @@
 extern "C" {
 #endif
 
-/* LOG_THREAD_CPUTIME must be considered private. */
+/* LOG_THREAD_CPUTIME must be considered private.  Besides tracing the
+   system time, it records the total CPU time of the calling thread in its
+   thread state for the debug monitor.  Users must include q_config.h and
+   q_thread.h. */
 #if DDSRT_HAVE_RUSAGE
 #define LOG_THREAD_CPUTIME(guard)                                        \
     do {                                                                 \
-        if (dds_get_log_mask() & DDS_LC_TIMING) {                        \
+        if ((dds_get_log_mask() & DDS_LC_TIMING) || config.monitor_port >= 0) { \
             nn_mtime_t tnowlt = now_mt();                                \
             if (tnowlt.v >= (guard).v) {                                 \
                 ddsrt_rusage_t usage;                                    \
                 if (ddsrt_getrusage(DDSRT_RUSAGE_THREAD, &usage) == 0) { \
+                    lookup_thread_state()->cputime = usage.utime + usage.stime; \
                     DDS_LOG(                                             \
                         DDS_LC_TIMING,                                   \
                         "thread_cputime %d.%09d\n",                      \
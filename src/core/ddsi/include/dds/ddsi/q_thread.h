@@ -67,6 +67,7 @@ struct logbuf;
   ddsrt_thread_t tid;                           \
   ddsrt_thread_t extTid;                        \
   enum thread_state state;                      \
+  int64_t cputime; /* updated by thread itself */ \
   char *name /* note: no semicolon! */
 
 struct thread_state_base {
@@ -39,6 +39,10 @@ int write_sample_nogc (struct thread_state1 * const ts1, struct nn_xpack *xp, st
 int write_sample_gc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
 int write_sample_nogc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
 
+/* Writes n samples in order with a single acquisition of the writer lock, stopping at the
+   first failure; all serdata are unref'd, *nwritten is set to the number written */
+int write_sample_gc_n (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, uint32_t n, struct ddsi_serdata **serdata, struct ddsi_tkmap_instance **tk, uint32_t *nwritten);
+
 /* When calling the following functions, wr->lock must be held */
 dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, struct proxy_reader *prd,struct nn_xmsg **msg, int isnew);
 int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct nn_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew);
@@ -45,6 +45,17 @@ DDS_EXPORT void xeventq_free (struct xeventq *evq);
 DDS_EXPORT dds_return_t xeventq_start (struct xeventq *evq, const char *name); /* <0 => error, =0 => ok */
 DDS_EXPORT void xeventq_stop (struct xeventq *evq);
 
+struct xeventq_state {
+  size_t non_timed_queued; /* number of non-timed events (messages, retransmits) pending */
+  size_t queued_rexmit_bytes;
+  size_t queued_rexmit_msgs;
+};
+
+DDS_EXPORT void xeventq_get_state (struct xeventq *evq, struct xeventq_state *st);
+
+/* Returns the event queue for the writer or proxy writer with the given GUID */
+DDS_EXPORT struct xeventq *xeventq_for_guid (const nn_guid_t *guid);
+
 DDS_EXPORT void qxev_msg (struct xeventq *evq, struct nn_xmsg *msg);
 DDS_EXPORT void qxev_pwr_entityid (struct proxy_writer * pwr, nn_guid_prefix_t * id);
 DDS_EXPORT void qxev_prd_entityid (struct proxy_reader * prd, nn_guid_prefix_t * id);
@@ -133,6 +133,11 @@ void nn_xpack_send (struct nn_xpack *xp, bool immediately /* unused */);
 int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flags);
 int64_t nn_xpack_maxdelay (const struct nn_xpack *xp);
 unsigned nn_xpack_packetid (const struct nn_xpack *xp);
+uint32_t nn_xpack_size (const struct nn_xpack *xp); /* 0 if empty */
+/* A held xpack is sent only by its owner, even if a heartbeat requiring an
+   answer is added to it; used for batching data in the writer */
+void nn_xpack_set_hold (struct nn_xpack *xp, bool hold);
+bool nn_xpack_hold (const struct nn_xpack *xp);
 
 /* SENDQ */
 void nn_xpack_sendq_init (void);
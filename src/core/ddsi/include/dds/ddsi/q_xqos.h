@@ -285,6 +285,14 @@ DDS_EXPORT void nn_xqos_addtomsg (struct nn_xmsg *m, const dds_qos_t *xqos, uint
 DDS_EXPORT void nn_log_xqos (uint32_t cat, const dds_qos_t *xqos);
 DDS_EXPORT dds_qos_t *nn_xqos_dup (const dds_qos_t *src);
 
+struct nn_xqos_intern;
+DDS_EXPORT struct nn_xqos_intern *nn_xqos_intern_new (void);
+DDS_EXPORT void nn_xqos_intern_free (struct nn_xqos_intern *xi);
+DDS_EXPORT const dds_qos_t *nn_xqos_intern (struct nn_xqos_intern *xi, const dds_qos_t *xqos);
+DDS_EXPORT void nn_xqos_unintern (struct nn_xqos_intern *xi, const dds_qos_t *xqos);
+/* Number of distinct QoS objects currently interned */
+DDS_EXPORT uint32_t nn_xqos_intern_count (struct nn_xqos_intern *xi);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -0,0 +1,549 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/strtod.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_time.h"
+#include "dds/ddsi/ddsi_netsim.h"
+
+/* A rule is "in" or "out", optionally followed by an address (with an
+   optional port) and then a number of key=value pairs:
+
+     out 239.255.0.1 loss=5% delay=2ms jitter=1ms
+     out loss=1% bandwidth=10Mb/s queue=64kB
+     in 10.1.1.1:7410 loss=0.1
+
+   Probabilities are given as a fraction or as a percentage. */
+struct netsim_rule {
+  bool incoming;
+  bool match_addr;
+  bool match_port;
+  nn_locator_t addr;
+  double loss, duplicate, reorder;
+  int64_t delay, jitter, reorder_delay;
+  uint64_t bandwidth; /* bits/s, 0 = unlimited */
+  uint32_t queue; /* bytes, 0 = unlimited */
+  nn_mtime_t link_free; /* time at which the last packet will have left */
+  ddsrt_prng_t prng;
+};
+
+struct netsim_packet {
+  ddsrt_fibheap_node_t heapnode;
+  nn_mtime_t due;
+  uint64_t seq;
+  ddsi_tran_conn_t conn;
+  nn_locator_t dst;
+  uint32_t flags;
+  size_t size;
+  unsigned char data[];
+};
+
+struct ddsi_netsim {
+  ddsrt_mutex_t lock;
+  ddsrt_cond_t cond;
+  int stop;
+  struct thread_state1 *ts;
+  uint32_t nrules;
+  struct netsim_rule *rules;
+  ddsrt_fibheap_t pending;
+  uint64_t seq;
+};
+
+static int compare_packet (const void *va, const void *vb)
+{
+  const struct netsim_packet *a = va;
+  const struct netsim_packet *b = vb;
+  if (a->due.v != b->due.v)
+    return (a->due.v < b->due.v) ? -1 : 1;
+  else
+    return (a->seq == b->seq) ? 0 : (a->seq < b->seq) ? -1 : 1;
+}
+
+static const ddsrt_fibheap_def_t netsim_pending_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER (offsetof (struct netsim_packet, heapnode), compare_packet);
+
+/* Connections may be closed by their owner while a packet is still queued,
+   the reference only keeps the memory alive, the owner remains responsible
+   for closing it */
+static void netsim_conn_unref (ddsi_tran_conn_t conn)
+{
+  if (ddsrt_atomic_dec32_ov (&conn->m_count) == 1)
+    (conn->m_factory->m_release_conn_fn) (conn);
+}
+
+static double netsim_random (ddsrt_prng_t *prng)
+{
+  return ddsrt_prng_random (prng) / 4294967296.0;
+}
+
+static int parse_probability (double *p, const char *value)
+{
+  char *endp;
+  double x;
+  if (ddsrt_strtod (value, &endp, &x) != DDS_RETCODE_OK || endp == value)
+    return -1;
+  if (*endp == '%')
+  {
+    x /= 100.0;
+    endp++;
+  }
+  if (*endp != 0 || !(x >= 0.0 && x <= 1.0))
+    return -1;
+  *p = x;
+  return 0;
+}
+
+struct netsim_unit {
+  const char *name;
+  double multiplier;
+};
+
+static const struct netsim_unit unittab_duration[] = {
+  { "ns", 1.0 }, { "us", 1e3 }, { "ms", 1e6 }, { "s", 1e9 }, { NULL, 0.0 }
+};
+
+static const struct netsim_unit unittab_memsize[] = {
+  { "B", 1.0 }, { "KiB", 1024.0 }, { "kB", 1024.0 }, { "MiB", 1048576.0 }, { "MB", 1048576.0 }, { NULL, 0.0 }
+};
+
+static const struct netsim_unit unittab_bandwidth_bps[] = {
+  { "b/s", 1.0 }, { "bps", 1.0 }, { "Kib/s", 1024.0 }, { "kb/s", 1e3 }, { "kbps", 1e3 },
+  { "Mib/s", 1048576.0 }, { "Mb/s", 1e6 }, { "Mbps", 1e6 }, { "Gib/s", 1073741824.0 }, { "Gb/s", 1e9 }, { "Gbps", 1e9 },
+  { "B/s", 8.0 }, { "KiB/s", 8192.0 }, { "kB/s", 8e3 }, { "MiB/s", 8388608.0 }, { "MB/s", 8e6 }, { "GiB/s", 8589934592.0 }, { "GB/s", 8e9 },
+  { NULL, 0.0 }
+};
+
+static int parse_unit (double *v, const char *value, const struct netsim_unit *unittab, double max)
+{
+  char *endp;
+  double x;
+  if (ddsrt_strtod (value, &endp, &x) != DDS_RETCODE_OK || endp == value || !(x >= 0.0))
+    return -1;
+  while (*endp == ' ')
+    endp++;
+  for (const struct netsim_unit *u = unittab; u->name; u++)
+  {
+    if (strcmp (endp, u->name) == 0)
+    {
+      x *= u->multiplier;
+      if (x > max)
+        return -1;
+      *v = x;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* Parses "ADDR" or "ADDR:PORT", where an IPv6 address must be enclosed in
+   brackets if a port is given */
+static int parse_address (struct netsim_rule *r, const char *str)
+{
+  char *copy = ddsrt_strdup (str), *port = NULL, *colon;
+  char *slash = strchr (copy, '/');
+  char *host = slash ? slash + 1 : copy;
+  int rc = -1;
+  if (*host == '[')
+  {
+    char *close = strchr (host, ']');
+    if (close == NULL || (close[1] != 0 && close[1] != ':'))
+      goto out;
+    if (close[1] == ':')
+      port = close + 2;
+    memmove (host, host + 1, (size_t) (close - host - 1));
+    close[-1] = 0;
+  }
+  else if ((colon = strchr (host, ':')) != NULL && strchr (colon + 1, ':') == NULL)
+  {
+    *colon = 0;
+    port = colon + 1;
+  }
+  if (ddsi_locator_from_string (&r->addr, copy) != AFSR_OK)
+    goto out;
+  r->match_addr = true;
+  if (port)
+  {
+    char *endp;
+    unsigned long p = strtoul (port, &endp, 10);
+    if (*port == 0 || *endp != 0 || p == 0 || p > 65535)
+      goto out;
+    r->addr.port = (uint32_t) p;
+    r->match_port = true;
+  }
+  rc = 0;
+out:
+  ddsrt_free (copy);
+  return rc;
+}
+
+static int parse_keyvalue (struct netsim_rule *r, const char *key, const char *value)
+{
+  double x;
+  if (strcmp (key, "loss") == 0)
+    return parse_probability (&r->loss, value);
+  else if (r->incoming)
+    return -1;
+  else if (strcmp (key, "duplicate") == 0)
+    return parse_probability (&r->duplicate, value);
+  else if (strcmp (key, "reorder") == 0)
+    return parse_probability (&r->reorder, value);
+  else if (strcmp (key, "delay") == 0 || strcmp (key, "jitter") == 0 || strcmp (key, "reorderdelay") == 0)
+  {
+    if (parse_unit (&x, value, unittab_duration, 3600e9) < 0)
+      return -1;
+    if (key[0] == 'd')
+      r->delay = (int64_t) x;
+    else if (key[0] == 'j')
+      r->jitter = (int64_t) x;
+    else
+      r->reorder_delay = (int64_t) x;
+    return 0;
+  }
+  else if (strcmp (key, "bandwidth") == 0)
+  {
+    if (parse_unit (&x, value, unittab_bandwidth_bps, 1e15) < 0)
+      return -1;
+    r->bandwidth = (uint64_t) x;
+    return 0;
+  }
+  else if (strcmp (key, "queue") == 0)
+  {
+    if (parse_unit (&x, value, unittab_memsize, 4294967295.0) < 0)
+      return -1;
+    r->queue = (uint32_t) x;
+    return 0;
+  }
+  else
+  {
+    return -1;
+  }
+}
+
+static int parse_rule (struct netsim_rule *r, char *str)
+{
+  char *tok, *cursor = str;
+  memset (r, 0, sizeof (*r));
+  r->reorder_delay = T_MILLISECOND;
+  if ((tok = ddsrt_strsep (&cursor, " \t")) == NULL)
+    return -1;
+  if (strcmp (tok, "in") == 0)
+    r->incoming = true;
+  else if (strcmp (tok, "out") != 0)
+    return -1;
+  while ((tok = ddsrt_strsep (&cursor, " \t")) != NULL)
+  {
+    char *eq;
+    if (*tok == 0)
+      continue;
+    else if ((eq = strchr (tok, '=')) != NULL)
+    {
+      *eq = 0;
+      if (parse_keyvalue (r, tok, eq + 1) < 0)
+        return -1;
+    }
+    else if (r->match_addr || parse_address (r, tok) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+int ddsi_netsim_init (void)
+{
+  struct ddsi_netsim *ns;
+  char *copy, *cursor, *tok;
+  gv.netsim = NULL;
+  if (config.netsim == NULL || config.netsim[0] == 0)
+    return 0;
+
+  ns = ddsrt_malloc (sizeof (*ns));
+  ns->stop = 0;
+  ns->ts = NULL;
+  ns->nrules = 0;
+  ns->rules = NULL;
+  ns->seq = 0;
+  ddsrt_fibheap_init (&netsim_pending_fhdef, &ns->pending);
+
+  copy = cursor = ddsrt_strdup (config.netsim);
+  while ((tok = ddsrt_strsep (&cursor, ";")) != NULL)
+  {
+    struct netsim_rule *r;
+    while (isspace ((unsigned char) *tok))
+      tok++;
+    if (*tok == 0)
+      continue;
+    ns->rules = ddsrt_realloc (ns->rules, (ns->nrules + 1) * sizeof (*ns->rules));
+    r = &ns->rules[ns->nrules];
+    if (parse_rule (r, tok) < 0)
+    {
+      DDS_ERROR ("Internal/Test/NetworkSimulation: invalid rule %"PRIu32"\n", ns->nrules + 1);
+      ddsrt_free (copy);
+      ddsrt_free (ns->rules);
+      ddsrt_free (ns);
+      return -1;
+    }
+    ddsrt_prng_init_simple (&r->prng, config.netsim_seed + ns->nrules);
+    ns->nrules++;
+  }
+  ddsrt_free (copy);
+  if (ns->nrules == 0)
+  {
+    ddsrt_free (ns);
+    return 0;
+  }
+
+  DDS_LOG (DDS_LC_CONFIG, "network simulation: %"PRIu32" rules, seed %"PRIu32"\n", ns->nrules, config.netsim_seed);
+  ddsrt_mutex_init (&ns->lock);
+  ddsrt_cond_init (&ns->cond);
+  gv.netsim = ns;
+  return 0;
+}
+
+static void netsim_drop_pending (struct ddsi_netsim *ns)
+{
+  struct netsim_packet *p;
+  while ((p = ddsrt_fibheap_extract_min (&netsim_pending_fhdef, &ns->pending)) != NULL)
+  {
+    netsim_conn_unref (p->conn);
+    ddsrt_free (p);
+  }
+}
+
+void ddsi_netsim_fini (void)
+{
+  struct ddsi_netsim * const ns = gv.netsim;
+  if (ns == NULL)
+    return;
+  assert (ns->ts == NULL);
+  netsim_drop_pending (ns);
+  ddsrt_cond_destroy (&ns->cond);
+  ddsrt_mutex_destroy (&ns->lock);
+  ddsrt_free (ns->rules);
+  ddsrt_free (ns);
+  gv.netsim = NULL;
+}
+
+static void netsim_send (const struct netsim_packet *p)
+{
+  ddsrt_iovec_t iov;
+  iov.iov_base = (void *) p->data;
+  iov.iov_len = (ddsrt_iov_len_t) p->size;
+  if (ddsi_conn_write (p->conn, &p->dst, 1, &iov, p->flags) < 0)
+    ddsrt_atomic_inc32 (&gv.stats.send_errors);
+}
+
+static uint32_t netsim_thread (void *vns)
+{
+  struct ddsi_netsim * const ns = vns;
+  ddsrt_mutex_lock (&ns->lock);
+  while (!ns->stop)
+  {
+    struct netsim_packet *p = ddsrt_fibheap_min (&netsim_pending_fhdef, &ns->pending);
+    nn_mtime_t tnow = now_mt ();
+    if (p == NULL)
+      ddsrt_cond_waitfor (&ns->cond, &ns->lock, T_SECOND);
+    else if (p->due.v > tnow.v)
+      ddsrt_cond_waitfor (&ns->cond, &ns->lock, p->due.v - tnow.v);
+    else
+    {
+      (void) ddsrt_fibheap_extract_min (&netsim_pending_fhdef, &ns->pending);
+      ddsrt_mutex_unlock (&ns->lock);
+      netsim_send (p);
+      netsim_conn_unref (p->conn);
+      ddsrt_free (p);
+      ddsrt_mutex_lock (&ns->lock);
+    }
+  }
+  ddsrt_mutex_unlock (&ns->lock);
+  return 0;
+}
+
+dds_return_t ddsi_netsim_start (void)
+{
+  struct ddsi_netsim * const ns = gv.netsim;
+  struct thread_state1 *ts;
+  dds_return_t rc;
+  if (ns == NULL)
+    return DDS_RETCODE_OK;
+  if ((rc = create_thread (&ts, "netsim", netsim_thread, ns)) != DDS_RETCODE_OK)
+    return rc;
+  ddsrt_mutex_lock (&ns->lock);
+  ns->ts = ts;
+  ddsrt_mutex_unlock (&ns->lock);
+  return DDS_RETCODE_OK;
+}
+
+void ddsi_netsim_stop (void)
+{
+  struct ddsi_netsim * const ns = gv.netsim;
+  struct thread_state1 *ts;
+  if (ns == NULL)
+    return;
+  ddsrt_mutex_lock (&ns->lock);
+  ns->stop = 1;
+  ddsrt_cond_broadcast (&ns->cond);
+  ts = ns->ts;
+  ddsrt_mutex_unlock (&ns->lock);
+  if (ts == NULL)
+    return;
+  join_thread (ts);
+  ddsrt_mutex_lock (&ns->lock);
+  ns->ts = NULL;
+  netsim_drop_pending (ns);
+  ddsrt_mutex_unlock (&ns->lock);
+}
+
+static struct netsim_rule *netsim_lookup (struct ddsi_netsim *ns, bool incoming, const nn_locator_t *loc)
+{
+  for (uint32_t i = 0; i < ns->nrules; i++)
+  {
+    struct netsim_rule * const r = &ns->rules[i];
+    if (r->incoming != incoming)
+      continue;
+    if (r->match_addr && (r->addr.kind != loc->kind || memcmp (r->addr.address, loc->address, sizeof (loc->address)) != 0))
+      continue;
+    if (r->match_port && r->addr.port != loc->port)
+      continue;
+    return r;
+  }
+  return NULL;
+}
+
+static void netsim_enqueue (struct ddsi_netsim *ns, ddsi_tran_conn_t conn, const nn_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, size_t size, uint32_t flags, nn_mtime_t due)
+{
+  struct netsim_packet *p = ddsrt_malloc (sizeof (*p) + size);
+  size_t pos = 0;
+  for (size_t i = 0; i < niov; i++)
+  {
+    memcpy (p->data + pos, iov[i].iov_base, iov[i].iov_len);
+    pos += iov[i].iov_len;
+  }
+  ddsi_conn_add_ref (conn);
+  p->conn = conn;
+  p->dst = *dst;
+  p->flags = flags;
+  p->size = size;
+  p->due = due;
+  p->seq = ns->seq++;
+  ddsrt_fibheap_insert (&netsim_pending_fhdef, &ns->pending, p);
+  if (ddsrt_fibheap_min (&netsim_pending_fhdef, &ns->pending) == p)
+    ddsrt_cond_broadcast (&ns->cond);
+}
+
+ssize_t ddsi_netsim_write (ddsi_tran_conn_t conn, const nn_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  struct ddsi_netsim * const ns = gv.netsim;
+  struct netsim_rule *r;
+  size_t size = 0;
+  int ncopies;
+  nn_mtime_t tnow, due;
+
+  if (!conn->m_connless)
+    return ddsi_conn_write (conn, dst, niov, iov, flags);
+  for (size_t i = 0; i < niov; i++)
+    size += iov[i].iov_len;
+
+  ddsrt_mutex_lock (&ns->lock);
+  if ((r = netsim_lookup (ns, false, dst)) == NULL)
+  {
+    ddsrt_mutex_unlock (&ns->lock);
+    return ddsi_conn_write (conn, dst, niov, iov, flags);
+  }
+
+  /* Always draw the same number of random numbers for each packet, so that
+     the outcome for a packet depends on its position in the sequence only */
+  const double u_loss = netsim_random (&r->prng);
+  const double u_dup = netsim_random (&r->prng);
+  const double u_reorder = netsim_random (&r->prng);
+  const double u_jitter = netsim_random (&r->prng);
+
+  tnow = now_mt ();
+  if (r->link_free.v < tnow.v)
+    r->link_free = tnow;
+  if (u_loss < r->loss)
+  {
+    ddsrt_atomic_inc32 (&gv.stats.netsim_dropped);
+    ddsrt_mutex_unlock (&ns->lock);
+    return (ssize_t) size;
+  }
+  if (r->bandwidth > 0)
+  {
+    /* Tail drop if the bytes waiting for the link exceed the queue size */
+    const double backlog = (double) (r->link_free.v - tnow.v) * (double) r->bandwidth / 8e9;
+    if (r->queue > 0 && backlog + (double) size > (double) r->queue)
+    {
+      ddsrt_atomic_inc32 (&gv.stats.netsim_dropped);
+      ddsrt_mutex_unlock (&ns->lock);
+      return (ssize_t) size;
+    }
+    r->link_free.v += (int64_t) ((double) size * 8e9 / (double) r->bandwidth);
+  }
+  due.v = r->link_free.v + r->delay + (int64_t) (u_jitter * (double) r->jitter);
+  if (u_reorder < r->reorder)
+  {
+    due.v += r->reorder_delay;
+    ddsrt_atomic_inc32 (&gv.stats.netsim_reordered);
+  }
+  ncopies = 1;
+  if (u_dup < r->duplicate)
+  {
+    ncopies = 2;
+    ddsrt_atomic_inc32 (&gv.stats.netsim_duplicated);
+  }
+
+  if (due.v <= tnow.v || ns->ts == NULL)
+  {
+    /* No delay, or nothing (yet or anymore) to send delayed packets: just
+       send it, duplicated if so required */
+    ssize_t ret = 0;
+    ddsrt_mutex_unlock (&ns->lock);
+    for (int i = 0; i < ncopies; i++)
+      ret = ddsi_conn_write (conn, dst, niov, iov, flags);
+    return ret;
+  }
+  else
+  {
+    for (int i = 0; i < ncopies; i++)
+      netsim_enqueue (ns, conn, dst, niov, iov, size, flags, due);
+    ddsrt_mutex_unlock (&ns->lock);
+    return (ssize_t) size;
+  }
+}
+
+bool ddsi_netsim_drop_received (ddsi_tran_conn_t conn, const nn_locator_t *src, size_t size)
+{
+  struct ddsi_netsim * const ns = gv.netsim;
+  struct netsim_rule *r;
+  bool drop = false;
+  (void) size;
+  if (!conn->m_connless)
+    return false;
+  ddsrt_mutex_lock (&ns->lock);
+  if ((r = netsim_lookup (ns, true, src)) != NULL && netsim_random (&r->prng) < r->loss)
+  {
+    ddsrt_atomic_inc32 (&gv.stats.netsim_dropped);
+    drop = true;
+  }
+  ddsrt_mutex_unlock (&ns->lock);
+  return drop;
+}
@@ -401,14 +401,23 @@ static void gen_keyhash_from_sample (const struct ddsi_sertopic_default *topic,
   }
 }
 
-static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
+static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample, const dds_keyhash_t *keyhash)
 {
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
   struct ddsi_serdata_default *d = serdata_default_new(tp, kind);
   if (d == NULL)
     return NULL;
   dds_ostream_t os;
-  gen_keyhash_from_sample (tp, &d->keyhash, sample);
+  if (keyhash == NULL)
+    gen_keyhash_from_sample (tp, &d->keyhash, sample);
+  else
+  {
+    /* keyhash is that of the instance: identical to what gen_keyhash_from_sample would produce,
+       so this is indistinguishable on the wire, but without having to serialise the key in
+       big-endian format and possibly MD5 it */
+    assert (keyhash->m_set);
+    d->keyhash = *keyhash;
+  }
   dds_ostream_from_serdata_default (&os, d);
   switch (kind)
   {
@@ -428,19 +437,36 @@ static struct ddsi_serdata_default *serdata_default_from_sample_cdr_common (cons
 static struct ddsi_serdata *serdata_default_from_sample_cdr (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
   struct ddsi_serdata_default *d;
-  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, sample)) == NULL)
+  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, sample, NULL)) == NULL)
+    return NULL;
+  return fix_serdata_default (d, tpcmn->serdata_basehash);
+}
+
+static struct ddsi_serdata *serdata_default_from_sample_cdr_keyed (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample, const struct ddsi_serdata *keydcmn)
+{
+  const struct ddsi_serdata_default *keyd = (const struct ddsi_serdata_default *)keydcmn;
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, sample, &keyd->keyhash)) == NULL)
     return NULL;
+  /* hash can't be copied from keyd: that one's based on the topic that created the instance */
   return fix_serdata_default (d, tpcmn->serdata_basehash);
 }
 
 static struct ddsi_serdata *serdata_default_from_sample_cdr_nokey (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample)
 {
   struct ddsi_serdata_default *d;
-  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, sample)) == NULL)
+  if ((d = serdata_default_from_sample_cdr_common (tpcmn, kind, sample, NULL)) == NULL)
     return NULL;
   return fix_serdata_default_nokey (d, tpcmn->serdata_basehash);
 }
 
+static struct ddsi_serdata *serdata_default_from_sample_cdr_nokey_keyed (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample, const struct ddsi_serdata *keydcmn)
+{
+  /* keyhash generation is trivial for keyless topics */
+  (void) keydcmn;
+  return serdata_default_from_sample_cdr_nokey (tpcmn, kind, sample);
+}
+
 static struct ddsi_serdata *serdata_default_from_sample_plist (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *vsample)
 {
   /* Currently restricted to DDSI discovery data (XTypes will need a rethink of the default representation and that may result in discovery data being moved to that new representation), and that means: keys are either GUIDs or an unbounded string for topics, for which MD5 is acceptable. Furthermore, these things don't get written very often, so scanning the parameter list to get the key value out is good enough for now. And at least it keeps the DDSI discovery data writing out of the internals of the sample representation */
@@ -637,6 +663,7 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr = {
   .from_ser = serdata_default_from_ser,
   .from_keyhash = ddsi_serdata_from_keyhash_cdr,
   .from_sample = serdata_default_from_sample_cdr,
+  .from_sample_keyed = serdata_default_from_sample_cdr_keyed,
   .to_ser = serdata_default_to_ser,
   .to_sample = serdata_default_to_sample_cdr,
   .to_ser_ref = serdata_default_to_ser_ref,
@@ -652,6 +679,7 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey = {
   .from_ser = serdata_default_from_ser_nokey,
   .from_keyhash = ddsi_serdata_from_keyhash_cdr_nokey,
   .from_sample = serdata_default_from_sample_cdr_nokey,
+  .from_sample_keyed = serdata_default_from_sample_cdr_nokey_keyed,
   .to_ser = serdata_default_to_ser,
   .to_sample = serdata_default_to_sample_cdr,
   .to_ser_ref = serdata_default_to_ser_ref,
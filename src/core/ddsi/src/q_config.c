@@ -142,6 +142,7 @@ DUPF(uint32);
 #endif
 DU(natint);
 DU(natint_255);
+DU(event_threads);
 DUPF(participantIndex);
 DU(port);
 DU(dyn_port);
@@ -440,6 +441,10 @@ static const struct cfgelem compatibility_cfgelems[] = {
 static const struct cfgelem unsupp_test_cfgelems[] = {
   { LEAF("XmitLossiness"), 1, "0", ABSOFF(xmit_lossiness), 0, uf_int, 0, pf_int,
     BLURB("<p>This element controls the fraction of outgoing packets to drop, specified as samples per thousand.</p>") },
+  { LEAF("NetworkSimulation"), 1, "", ABSOFF(netsim), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This element specifies a semicolon-separated list of rules for simulating an imperfect network on connectionless transports. Each rule starts with <i>in</i> or <i>out</i>, optionally followed by an address with an optional port, e.g. <i>239.255.0.1</i> or <i>127.0.0.1:7410</i>, and then any number of <i>key=value</i> pairs. The keys are: <i>loss</i>, <i>duplicate</i> and <i>reorder</i> (probabilities, either as a fraction or as a percentage); <i>delay</i>, <i>jitter</i> and <i>reorderdelay</i> (durations, the latter defaulting to 1ms); <i>bandwidth</i> (in bits or bytes per second) and <i>queue</i> (the number of bytes that may be waiting for the simulated link before packets are dropped, 0 meaning unlimited). Rules for incoming packets only support <i>loss</i>. Each packet is subject to the first rule that matches it.</p>") },
+  { LEAF("NetworkSimulationSeed"), 1, "0", ABSOFF(netsim_seed), 0, uf_uint, 0, pf_uint,
+    BLURB("<p>This element specifies the seed of the pseudo-random number generators used by the network simulation, so that runs can be repeated.</p>") },
   END_MARKER
 };
 
@@ -506,6 +511,12 @@ static const struct cfgelem unsupp_cfgelems[] = {
   { MOVED("FragmentSize", "CycloneDDS/General/FragmentSize") },
   { LEAF("DeliveryQueueMaxSamples"), 1, "256", ABSOFF(delivery_queue_maxsamples), 0, uf_uint, 0, pf_uint,
     BLURB("<p>This element controls the Maximum size of a delivery queue, expressed in samples. Once a delivery queue is full, incoming samples destined for that queue are dropped until space becomes available again.</p>") },
+  { LEAF("EventThreads"), 1, "1", ABSOFF(event_threads), 0, uf_event_threads, 0, pf_int,
+    BLURB("<p>This element sets the number of threads handling timed events (heartbeats, acknowledgements and retransmits) for writers and proxy writers that are not mapped to a network channel with its own event thread. Writers and proxy writers are distributed over these threads based on their GUIDs, so that a burst of retransmits for one writer delays the events of only a fraction of the others. Participant discovery and liveliness events are always handled by the first thread.</p>") },
+  { LEAF("FlightRecorderSize"), 1, "1024", ABSOFF(flightrec_size), 0, uf_uint, 0, pf_uint,
+    BLURB("<p>This element sets the number of protocol events (heartbeats, acknacks, gaps, retransmits, throttling and lease changes) retained per thread in the in-memory flight recorder, rounded up to a power of two. Each event takes 64 bytes and the memory is only allocated for threads that record events. The recorded events can be retrieved via the <code>/flightrec</code> page of the debug monitor or by sending the process the signal configured in Internal/FlightRecorderSignal. 0 disables the flight recorder.</p>") },
+  { LEAF("FlightRecorderSignal"), 1, "0", ABSOFF(flightrec_signal), 0, uf_natint, 0, pf_int,
+    BLURB("<p>This element sets the number of a signal that causes the contents of the flight recorder to be written to the log, or to standard error if logging is disabled (see Internal/FlightRecorderSize). The default of 0 means no signal handler is installed. Not supported on Windows.</p>") },
   { LEAF("PrimaryReorderMaxSamples"), 1, "128", ABSOFF(primary_reorder_maxsamples), 0, uf_uint, 0, pf_uint,
     BLURB("<p>This element sets the maximum size in samples of a primary re-order administration. Each proxy writer has one primary re-order administration to buffer the packet flow in case some packets arrive out of order. Old samples are forwarded to secondary re-order administrations associated with readers in need of historical data.</p>") },
   { LEAF("SecondaryReorderMaxSamples"), 1, "128", ABSOFF(secondary_reorder_maxsamples), 0, uf_uint, 0, pf_uint,
@@ -522,6 +533,8 @@ static const struct cfgelem unsupp_cfgelems[] = {
 <p>The default is <i>writers</i>, as this is thought to be compliant and reasonably efficient. <i>Minimal</i> may or may not be compliant but is most efficient, and <i>full</i> is inefficient but certain to be compliant. See also Internal/ConservativeBuiltinReaderStartup.</p>") },
   { LEAF("MeasureHbToAckLatency"), 1, "false", ABSOFF(meas_hb_to_ack_latency), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element enables heartbeat-to-ack latency among DDSI2E services by prepending timestamps to Heartbeat and AckNack messages and calculating round trip times. This is non-standard behaviour. The measured latencies are quite noisy and are currently not used anywhere.</p>") },
+  { LEAF("MeasureLatencyStages"), 1, "false", ABSOFF(meas_latency_stages), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element enables measuring where time is spent on the data path, per topic: serialization and transmission for writers; reception to delivery queue, delivery queue, reception to storing in the reader history cache and storing to the first read or take for readers; and source timestamp to storing in the reader history cache (which is only meaningful if the clocks are synchronised). The results are available as histograms via dds_get_statistics on topics and via the /metrics page of the debug monitor. It adds a few clock reads for each sample.</p>") },
   { LEAF("UnicastResponseToSPDPMessages"), 1, "true", ABSOFF(unicast_response_to_spdp_messages), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element controls whether the response to a newly discovered participant is sent as a unicasted SPDP packet, instead of rescheduling the periodic multicasted one. There is no known benefit to setting this to <i>false</i>.</p>") },
   { LEAF("SynchronousDeliveryPriorityThreshold"), 1, "0", ABSOFF(synchronous_delivery_priority_threshold), 0, uf_int, 0, pf_int,
@@ -583,11 +596,11 @@ static const struct cfgelem unsupp_cfgelems[] = {
   { LEAF("MaxSampleSize"), 1, "2147483647 B", ABSOFF(max_sample_size), 0, uf_memsize, 0, pf_memsize,
     BLURB("<p>This setting controls the maximum (CDR) serialised size of samples that DDSI2E will forward in either direction. Samples larger than this are discarded with a warning.</p>") },
   { LEAF("WriteBatch"), 1, "false", ABSOFF(whc_batch), 0, uf_boolean, 0, pf_boolean,
-    BLURB("<p>This element enables the batching of write operations. By default each write operation writes through the write cache and out onto the transport. Enabling write batching causes multiple small write operations to be aggregated within the write cache into a single larger write. This gives greater throughput at the expense of latency. Currently there is no mechanism for the write cache to automatically flush itself, so that if write batching is enabled, the application may havee to use the dds_write_flush function to ensure thta all samples are written.</p>") },
+    BLURB("<p>This element enables the batching of write operations. By default each write operation writes through the write cache and out onto the transport. Enabling write batching causes multiple small write operations to be aggregated within the write cache into a single larger write. This gives greater throughput at the expense of latency. This setting applies to all writers and there is no mechanism for the write cache to automatically flush itself, so that if write batching is enabled, the application may have to use the dds_write_flush function to ensure that all samples are written. Batching can also be enabled for individual writers by giving them a non-zero latency budget, in which case samples are held back for at most the latency budget, or by using dds_write_set_batch_policy.</p>") },
   { LEAF_W_ATTRS("LivelinessMonitoring", liveliness_monitoring_attrs), 1, "false", ABSOFF(liveliness_monitoring), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element controls whether or not implementation should internally monitor its own liveliness. If liveliness monitoring is enabled, stack traces can be dumped automatically when some thread appears to have stopped making progress.</p>") },
   { LEAF("MonitorPort"), 1, "-1", ABSOFF(monitor_port), 0, uf_int, 0, pf_int,
-    BLURB("<p>This element allows configuring a service that dumps a text description of part the internal state to TCP clients. By default (-1), this is disabled; specifying 0 means a kernel-allocated port is used; a positive number is used as the TCP port number.</p>") },
+    BLURB("<p>This element allows configuring a service that dumps a text description of part the internal state to TCP clients. By default (-1), this is disabled; specifying 0 means a kernel-allocated port is used; a positive number is used as the TCP port number.</p><p>HTTP clients requesting <code>/metrics</code> instead get a Prometheus-style set of metrics: CPU time per thread, delivery, event and send queue lengths, history cache sizes per reader and writer, and transport error counters.</p>") },
   { LEAF("AssumeMulticastCapable"), 1, "", ABSOFF(assumeMulticastCapable), 0, uf_string, ff_free, pf_string,
     BLURB("<p>This element controls which network interfaces are assumed to be capable of multicasting even when the interface flags returned by the operating system state it is not (this provides a workaround for some platforms). It is a comma-separated lists of patterns (with ? and * wildcards) against which the interface names are matched.</p>") },
   { LEAF("PrioritizeRetransmit"), 1, "true", ABSOFF(prioritize_retransmit), 0, uf_boolean, 0, pf_boolean,
@@ -771,6 +784,8 @@ static const struct cfgelem tracing_cfgelems[] = {
     BLURB("<p>This option specifies where the logging is printed to. Note that <i>stdout</i> and <i>stderr</i> are treated as special values, representing \"standard out\" and \"standard error\" respectively. No file is created unless logging categories are enabled using the Tracing/Verbosity or Tracing/EnabledCategory settings.</p>") },
   { LEAF("AppendToFile"), 1, "false", ABSOFF(tracingAppendToFile), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This option specifies whether the output is to be appended to an existing log file. The default is to create a new log file each time, which is generally the best option if a detailed log is generated.</p>") },
+  { LEAF("AsyncBufferSize"), 1, "0 B", ABSOFF(tracingAsyncBufferSize), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This option enables asynchronous writing of the log when set to a non-zero value, in which case each thread that logs queues its messages in a buffer of (at least) this size and a background thread writes them to the log file. Threads then never wait for the log file to be written, but messages are dropped when a buffer is full. Dropped messages are reported in the log. The default of 0 writes all messages synchronously.</p>") },
   { LEAF("PacketCaptureFile"), 1, "", ABSOFF(pcap_file), 0, uf_string, ff_free, pf_string,
     BLURB("<p>This option specifies the file to which received and sent packets will be logged in the \"pcap\" format suitable for analysis using common networking tools, such as WireShark. IP and UDP headers are ficitious, in particular the destination address of received packets. The TTL may be used to distinguish between sent and received packets: it is 255 for sent packets and 128 for received ones. Currently IPv4 only.</p>") },
   END_MARKER
@@ -1872,6 +1887,11 @@ static int uf_natint_255(struct cfgst *cfgst, void *parent, struct cfgelem const
   return uf_int_min_max(cfgst, parent, cfgelem, first, value, 0, 255);
 }
 
+static int uf_event_threads(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, int first, const char *value)
+{
+  return uf_int_min_max(cfgst, parent, cfgelem, first, value, 1, 64);
+}
+
 static int uf_uint (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
 {
   unsigned * const elem = cfg_address (cfgst, parent, cfgelem);
@@ -2780,6 +2800,7 @@ void config_fini (struct cfgst *cfgst)
   assert (config.valid);
 
   free_all_elements (cfgst, cfgst->cfg, root_cfgelems);
+  dds_log_async_stop ();
   dds_set_log_file (stderr);
   dds_set_trace_file (stderr);
   if (config.tracingOutputFile && config.tracingOutputFile != stdout && config.tracingOutputFile != stderr) {
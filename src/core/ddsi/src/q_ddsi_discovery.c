@@ -1266,10 +1266,10 @@ static void handle_SEDP_alive (const struct receiver_state *rst, nn_plist_t *dat
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
         {
           struct config_channel_listelem *channel = find_channel (xqos->transport_priority);
-          new_proxy_writer (&ppguid, &datap->endpoint_guid, as, datap, channel->dqueue, channel->evq ? channel->evq : gv.xevents, timestamp);
+          new_proxy_writer (&ppguid, &datap->endpoint_guid, as, datap, channel->dqueue, channel->evq ? channel->evq : xeventq_for_guid (&datap->endpoint_guid), timestamp);
         }
 #else
-        new_proxy_writer (&ppguid, &datap->endpoint_guid, as, datap, gv.user_dqueue, gv.xevents, timestamp);
+        new_proxy_writer (&ppguid, &datap->endpoint_guid, as, datap, gv.user_dqueue, xeventq_for_guid (&datap->endpoint_guid), timestamp);
 #endif
       }
     }
@@ -1318,6 +1318,67 @@ static void handle_SEDP_dead (nn_plist_t *datap, nn_wctime_t timestamp)
   DDS_LOG(DDS_LC_DISCOVERY, " %s\n", (res < 0) ? " unknown" : " delete");
 }
 
+static bool lookup_proxy_endpoint (const nn_guid_t *guid, struct entity_common **e, struct proxy_endpoint_common **c)
+{
+  if (is_writer_entityid (guid->entityid))
+  {
+    struct proxy_writer *pwr;
+    if ((pwr = ephash_lookup_proxy_writer_guid (guid)) == NULL)
+      return false;
+    *e = &pwr->e;
+    *c = &pwr->c;
+  }
+  else
+  {
+    struct proxy_reader *prd;
+    if ((prd = ephash_lookup_proxy_reader_guid (guid)) == NULL)
+      return false;
+    *e = &prd->e;
+    *c = &prd->c;
+  }
+  return true;
+}
+
+static bool handle_SEDP_unchanged (const nn_plist_src_t *src, const unsigned char digest[16])
+{
+  /* A re-announcement of a known endpoint with a payload identical to the
+     last one processed for it can't change anything: extracting just the
+     GUID is then sufficient and the full parse, update and re-matching can
+     be skipped */
+  nn_plist_t guidonly;
+  struct entity_common *e;
+  struct proxy_endpoint_common *c;
+  bool unchanged = false;
+  if (nn_plist_init_frommsg (&guidonly, NULL, PP_ENDPOINT_GUID, 0, src) < 0)
+    return false;
+  if ((guidonly.present & PP_ENDPOINT_GUID) && lookup_proxy_endpoint (&guidonly.endpoint_guid, &e, &c))
+  {
+    ddsrt_mutex_lock (&e->lock);
+    unchanged = c->have_sedp_digest && memcmp (c->sedp_digest, digest, sizeof (c->sedp_digest)) == 0;
+    ddsrt_mutex_unlock (&e->lock);
+    if (unchanged)
+    {
+      DDS_LOG(DDS_LC_DISCOVERY, " "PGUIDFMT" known unchanged\n", PGUID (guidonly.endpoint_guid));
+      ddsrt_atomic_inc32 (&gv.stats.sedp_unchanged);
+    }
+  }
+  nn_plist_fini (&guidonly);
+  return unchanged;
+}
+
+static void set_SEDP_digest (const nn_plist_t *datap, const unsigned char digest[16])
+{
+  struct entity_common *e;
+  struct proxy_endpoint_common *c;
+  if ((datap->present & PP_ENDPOINT_GUID) && lookup_proxy_endpoint (&datap->endpoint_guid, &e, &c))
+  {
+    ddsrt_mutex_lock (&e->lock);
+    memcpy (c->sedp_digest, digest, sizeof (c->sedp_digest));
+    c->have_sedp_digest = true;
+    ddsrt_mutex_unlock (&e->lock);
+  }
+}
+
 static void handle_SEDP (const struct receiver_state *rst, nn_wctime_t timestamp, unsigned statusinfo, const void *vdata, uint32_t len)
 {
   const struct CDRHeader *data = vdata; /* built-ins not deserialized (yet) */
@@ -1332,11 +1393,29 @@ static void handle_SEDP (const struct receiver_state *rst, nn_wctime_t timestamp
     nn_plist_t decoded_data;
     nn_plist_src_t src;
     dds_return_t plist_ret;
+    ddsrt_md5_byte_t digest[16];
+    bool use_digest;
     src.protocol_version = rst->protocol_version;
     src.vendorid = rst->vendor;
     src.encoding = data->identifier;
     src.buf = (unsigned char *) data + 4;
     src.bufsz = len - 4;
+
+    /* The address set depends on the source address if tcp_use_peeraddr_for_unicast
+       is set, and re-announcements via a DS rebind the proxy participant, so the
+       payload alone only determines the outcome in the other cases */
+    use_digest = ((statusinfo & (NN_STATUSINFO_DISPOSE | NN_STATUSINFO_UNREGISTER)) == 0 &&
+                  !config.tcp_use_peeraddr_for_unicast && !vendor_is_cloud (rst->vendor));
+    if (use_digest)
+    {
+      ddsrt_md5_state_t md5st;
+      ddsrt_md5_init (&md5st);
+      ddsrt_md5_append (&md5st, (const ddsrt_md5_byte_t *) data, len);
+      ddsrt_md5_finish (&md5st, digest);
+      if (handle_SEDP_unchanged (&src, digest))
+        return;
+    }
+
     if ((plist_ret = nn_plist_init_frommsg (&decoded_data, NULL, ~(uint64_t)0, ~(uint64_t)0, &src)) < 0)
     {
       if (plist_ret != DDS_RETCODE_UNSUPPORTED)
@@ -1348,6 +1427,8 @@ static void handle_SEDP (const struct receiver_state *rst, nn_wctime_t timestamp
     {
       case 0:
         handle_SEDP_alive (rst, &decoded_data, &rst->src_guid_prefix, rst->vendor, timestamp);
+        if (use_digest)
+          set_SEDP_digest (&decoded_data, digest);
         break;
 
       case NN_STATUSINFO_DISPOSE:
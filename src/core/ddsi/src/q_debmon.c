@@ -17,6 +17,8 @@
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/string.h"
 
 #include "dds/ddsrt/avl.h"
 
@@ -34,6 +36,10 @@
 #include "dds/ddsi/q_protocol.h" /* NN_ENTITYID_... */
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/q_debmon.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_xevent.h"
+#include "dds/ddsi/q_lat_stages.h"
+#include "dds/ddsi/q_flightrec.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_tran.h"
 #include "dds/ddsi/ddsi_tcp.h"
@@ -298,12 +304,439 @@ static int print_proxy_participants (struct thread_state1 * const ts1, ddsi_tran
   return x;
 }
 
+#define METRIC(conn, name, type, help) \
+  cpf (conn, "# HELP cyclonedds_" name " " help "\n# TYPE cyclonedds_" name " " type "\n")
+
+static char *label_value (const char *s)
+{
+  /* Prometheus label values are quoted strings in which backslash,
+     double quote and newline must be escaped */
+  char *v = ddsrt_malloc (2 * strlen (s) + 1), *p = v;
+  for (; *s; s++)
+  {
+    switch (*s)
+    {
+      case '\\': case '"':
+        *p++ = '\\';
+        *p++ = *s;
+        break;
+      case '\n':
+        *p++ = '\\';
+        *p++ = 'n';
+        break;
+      default:
+        *p++ = *s;
+        break;
+    }
+  }
+  *p = 0;
+  return v;
+}
+
+static int print_metrics_threads (ddsi_tran_conn_t conn)
+{
+  /* Copy the thread names and CPU times so the network writes are not done
+     while holding the thread states lock.  CPU times are only updated by
+     threads that use LOG_THREAD_CPUTIME, once per second. */
+  struct { char *name; int64_t cputime; } *tinfo;
+  uint32_t i, n = 0;
+  int x = 0;
+  ddsrt_mutex_lock (&thread_states.lock);
+  tinfo = ddsrt_malloc (thread_states.nthreads * sizeof (*tinfo));
+  for (i = 0; i < thread_states.nthreads; i++)
+  {
+    const struct thread_state1 *ts1 = &thread_states.ts[i];
+    if (ts1->state == THREAD_STATE_ALIVE && ts1->name != NULL)
+    {
+      tinfo[n].name = label_value (ts1->name);
+      tinfo[n].cputime = ts1->cputime;
+      n++;
+    }
+  }
+  ddsrt_mutex_unlock (&thread_states.lock);
+
+  x += METRIC (conn, "thread_cpu_seconds_total", "counter", "CPU time (user+system) consumed by a DDSI thread");
+  for (i = 0; i < n; i++)
+  {
+    x += cpf (conn, "cyclonedds_thread_cpu_seconds_total{thread=\"%s\"} %d.%09d\n", tinfo[i].name,
+              (int) (tinfo[i].cputime / DDS_NSECS_IN_SEC), (int) (tinfo[i].cputime % DDS_NSECS_IN_SEC));
+    ddsrt_free (tinfo[i].name);
+  }
+  ddsrt_free (tinfo);
+  return x;
+}
+
+static int print_metrics_dqueue (ddsi_tran_conn_t conn, struct nn_dqueue *q, bool max)
+{
+  const char *name;
+  uint32_t nsamples, maxsamples;
+  if (q == NULL)
+    return 0;
+  nn_dqueue_get_state (q, &name, &nsamples, &maxsamples);
+  return cpf (conn, "cyclonedds_dqueue_%s{queue=\"%s\"} %"PRIu32"\n", max ? "max_samples" : "samples", name, max ? maxsamples : nsamples);
+}
+
+static int print_metrics_dqueues (ddsi_tran_conn_t conn, bool max)
+{
+  int x = 0;
+  x += print_metrics_dqueue (conn, gv.builtins_dqueue, max);
+#ifdef DDSI_INCLUDE_NETWORK_CHANNELS
+  for (struct config_channel_listelem *chptr = config.channels; chptr; chptr = chptr->next)
+    x += print_metrics_dqueue (conn, chptr->dqueue, max);
+#else
+  x += print_metrics_dqueue (conn, gv.user_dqueue, max);
+#endif
+  return x;
+}
+
+enum xeventq_metric { XQM_QUEUED, XQM_REXMIT_MSGS, XQM_REXMIT_BYTES };
+
+static int print_metrics_xeventq (ddsi_tran_conn_t conn, const char *name, struct xeventq *evq, enum xeventq_metric m)
+{
+  struct xeventq_state st;
+  xeventq_get_state (evq, &st);
+  switch (m)
+  {
+    case XQM_QUEUED:
+      return cpf (conn, "cyclonedds_xevent_queued{queue=\"%s\"} %"PRIuSIZE"\n", name, st.non_timed_queued);
+    case XQM_REXMIT_MSGS:
+      return cpf (conn, "cyclonedds_xevent_queued_rexmit_msgs{queue=\"%s\"} %"PRIuSIZE"\n", name, st.queued_rexmit_msgs);
+    case XQM_REXMIT_BYTES:
+      return cpf (conn, "cyclonedds_xevent_queued_rexmit_bytes{queue=\"%s\"} %"PRIuSIZE"\n", name, st.queued_rexmit_bytes);
+  }
+  return 0;
+}
+
+static int print_metrics_xeventqs (ddsi_tran_conn_t conn, enum xeventq_metric m)
+{
+  int x = 0;
+  for (uint32_t i = 0; i < gv.n_xevents_shards; i++)
+  {
+    char name[16];
+    (void) snprintf (name, sizeof (name), "%"PRIu32, i);
+    x += print_metrics_xeventq (conn, name, gv.xevents_shards[i], m);
+  }
+#ifdef DDSI_INCLUDE_NETWORK_CHANNELS
+  for (struct config_channel_listelem *chptr = config.channels; chptr; chptr = chptr->next)
+    if (chptr->evq)
+      x += print_metrics_xeventq (conn, chptr->name, chptr->evq, m);
+#endif
+  return x;
+}
+
+static int print_metrics_queues (ddsi_tran_conn_t conn)
+{
+  /* Prometheus requires all samples of a metric to be grouped together,
+     hence one pass over the queues per metric */
+  unsigned sendq_length;
+  int x = 0;
+  x += METRIC (conn, "dqueue_samples", "gauge", "Number of samples waiting in a delivery queue");
+  x += print_metrics_dqueues (conn, false);
+  x += METRIC (conn, "dqueue_max_samples", "gauge", "Capacity of a delivery queue");
+  x += print_metrics_dqueues (conn, true);
+  x += METRIC (conn, "xevent_queued", "gauge", "Number of non-timed events (messages, retransmits) queued in an event queue");
+  x += print_metrics_xeventqs (conn, XQM_QUEUED);
+  x += METRIC (conn, "xevent_queued_rexmit_msgs", "gauge", "Number of retransmits queued in an event queue");
+  x += print_metrics_xeventqs (conn, XQM_REXMIT_MSGS);
+  x += METRIC (conn, "xevent_queued_rexmit_bytes", "gauge", "Bytes of retransmits queued in an event queue");
+  x += print_metrics_xeventqs (conn, XQM_REXMIT_BYTES);
+
+  ddsrt_mutex_lock (&gv.sendq_lock);
+  sendq_length = gv.sendq_length;
+  ddsrt_mutex_unlock (&gv.sendq_lock);
+  x += METRIC (conn, "sendq_length", "gauge", "Number of packets waiting in the asynchronous send queue");
+  x += cpf (conn, "cyclonedds_sendq_length %u\n", sendq_length);
+  return x;
+}
+
+static int print_metrics_writers (ddsi_tran_conn_t conn)
+{
+  struct ephash_enum_writer ew;
+  struct writer *w;
+  int x = 0;
+  x += METRIC (conn, "writer_whc_unacked_bytes", "gauge", "Bytes in the writer history cache not yet acknowledged by all readers");
+  ephash_enum_writer_init (&ew);
+  while ((w = ephash_enum_writer_next (&ew)) != NULL)
+  {
+    struct whc_state whcst;
+    if (is_builtin_entityid (w->e.guid.entityid, NN_VENDORID_ECLIPSE))
+      continue;
+    ddsrt_mutex_lock (&w->e.lock);
+    whc_get_state (w->whc, &whcst);
+    ddsrt_mutex_unlock (&w->e.lock);
+    char *topic = label_value (w->topic->name);
+    x += cpf (conn, "cyclonedds_writer_whc_unacked_bytes{guid=\"%x:%x:%x:%x\",topic=\"%s\"} %"PRIuSIZE"\n",
+              PGUID (w->e.guid), topic, whcst.unacked_bytes);
+    ddsrt_free (topic);
+  }
+  ephash_enum_writer_fini (&ew);
+  return x;
+}
+
+static int print_metrics_readers (ddsi_tran_conn_t conn, bool instances)
+{
+  struct ephash_enum_reader er;
+  struct reader *r;
+  int x = 0;
+  if (instances)
+    x += METRIC (conn, "reader_rhc_instances", "gauge", "Number of instances in the reader history cache");
+  else
+    x += METRIC (conn, "reader_rhc_samples", "gauge", "Number of samples (including invalid samples) in the reader history cache");
+  if (ddsi_plugin.rhc_plugin.rhc_get_counts_fn == 0)
+    return x;
+  ephash_enum_reader_init (&er);
+  while ((r = ephash_enum_reader_next (&er)) != NULL)
+  {
+    uint32_t ninstances, nsamples;
+    char *topic;
+    if (r->rhc == NULL || is_builtin_entityid (r->e.guid.entityid, NN_VENDORID_ECLIPSE))
+      continue;
+    /* the rhc is freed only when the reader is garbage collected, and we're awake */
+    (ddsi_plugin.rhc_plugin.rhc_get_counts_fn) (r->rhc, &ninstances, &nsamples);
+    topic = label_value (r->topic->name);
+    x += cpf (conn, "cyclonedds_reader_rhc_%s{guid=\"%x:%x:%x:%x\",topic=\"%s\"} %"PRIu32"\n",
+              instances ? "instances" : "samples", PGUID (r->e.guid), topic, instances ? ninstances : nsamples);
+    ddsrt_free (topic);
+  }
+  ephash_enum_reader_fini (&er);
+  return x;
+}
+
+static int print_metrics_endpoints (struct thread_state1 * const ts1, ddsi_tran_conn_t conn)
+{
+  int x = 0;
+  thread_state_awake (ts1);
+  x += print_metrics_writers (conn);
+  x += print_metrics_readers (conn, false);
+  x += print_metrics_readers (conn, true);
+  thread_state_asleep (ts1);
+  return x;
+}
+
+static int print_metrics_transport (ddsi_tran_conn_t conn)
+{
+  /* bytes_sent and bytes_received are 64-bit when DDSRT_HAVE_ATOMIC64 */
+  static const struct { const char *name; size_t off; bool wide; const char *help; } counters[] = {
+#define C(name, help) { #name, offsetof (struct q_globals_stats, name), false, help }
+#if DDSRT_HAVE_ATOMIC64
+#define C64(name, help) { #name, offsetof (struct q_globals_stats, name), true, help }
+#else
+#define C64(name, help) C (name, help)
+#endif
+    C (malformed_packets, "Packets (partially) discarded as malformed"),
+    C (oversize_samples, "Samples dropped for exceeding MaxSampleSize"),
+    C (gaps_received, "GAP submessages processed"),
+    C (reorder_rejects, "Samples rejected by a full reorder buffer"),
+    C (recv_errors, "Failed reads from a socket"),
+    C (send_errors, "Failed writes to a socket"),
+    C (packets_sent, "Packets written to a socket"),
+    C64 (bytes_sent, "Bytes written to a socket"),
+    C (packets_received, "Packets read from a socket"),
+    C64 (bytes_received, "Bytes read from a socket"),
+    C (netsim_dropped, "Packets dropped by network simulation"),
+    C (netsim_duplicated, "Packets duplicated by network simulation"),
+    C (netsim_reordered, "Packets reordered by network simulation"),
+    C (sedp_unchanged, "SEDP re-announcements skipped as unchanged")
+#undef C64
+#undef C
+  };
+  int x = 0;
+  for (size_t i = 0; i < sizeof (counters) / sizeof (counters[0]); i++)
+  {
+    const void *c = (const char *) &gv.stats + counters[i].off;
+    uint64_t v;
+#if DDSRT_HAVE_ATOMIC64
+    if (counters[i].wide)
+      v = ddsrt_atomic_ld64 ((const ddsrt_atomic_uint64_t *) c);
+    else
+#endif
+      v = ddsrt_atomic_ld32 ((const ddsrt_atomic_uint32_t *) c);
+    x += cpf (conn, "# HELP cyclonedds_%s_total %s\n# TYPE cyclonedds_%s_total counter\n", counters[i].name, counters[i].help, counters[i].name);
+    x += cpf (conn, "cyclonedds_%s_total %"PRIu64"\n", counters[i].name, v);
+  }
+  {
+    uint64_t nevents, est_ns;
+    nn_flightrec_get_stats (&nevents, &est_ns);
+    x += cpf (conn, "# HELP cyclonedds_flightrec_events_total Protocol events recorded in the flight recorder\n# TYPE cyclonedds_flightrec_events_total counter\n");
+    x += cpf (conn, "cyclonedds_flightrec_events_total %"PRIu64"\n", nevents);
+    x += cpf (conn, "# HELP cyclonedds_flightrec_seconds_total Estimated CPU time spent recording flight recorder events\n# TYPE cyclonedds_flightrec_seconds_total counter\n");
+    x += cpf (conn, "cyclonedds_flightrec_seconds_total %d.%09d\n", (int) (est_ns / DDS_NSECS_IN_SEC), (int) (est_ns % DDS_NSECS_IN_SEC));
+  }
+  return x;
+}
+
+struct print_metrics_lat_stages_arg {
+  ddsi_tran_conn_t conn;
+  enum nn_lat_stage stage;
+  int x;
+};
+
+static void print_metrics_lat_stages1 (const struct nn_lat_stages *st, void *varg)
+{
+  static const double qs[] = { 0.5, 0.9, 0.99, 1.0 };
+  struct print_metrics_lat_stages_arg * const arg = varg;
+  const struct nn_lat_hist *h = &st->hist[arg->stage];
+  const char *stage = nn_lat_stage_name (arg->stage);
+  char *topic;
+  if (ddsrt_atomic_ld32 (&h->count) == 0)
+    return;
+  topic = label_value (st->topic_name);
+  for (size_t i = 0; i < sizeof (qs) / sizeof (qs[0]); i++)
+  {
+    const int64_t v = nn_lat_hist_quantile (h, qs[i]);
+    arg->x += cpf (arg->conn, "cyclonedds_latency_stage_seconds{topic=\"%s\",stage=\"%s\",quantile=\"%g\"} %d.%09d\n",
+                   topic, stage, qs[i], (int) (v / DDS_NSECS_IN_SEC), (int) (v % DDS_NSECS_IN_SEC));
+  }
+  arg->x += cpf (arg->conn, "cyclonedds_latency_stage_seconds_count{topic=\"%s\",stage=\"%s\"} %"PRIu32"\n",
+                 topic, stage, ddsrt_atomic_ld32 (&h->count));
+  ddsrt_free (topic);
+}
+
+static int print_metrics_lat_stages (ddsi_tran_conn_t conn)
+{
+  /* Quantiles are upper bounds of histogram buckets, see q_lat_stages.h */
+  struct print_metrics_lat_stages_arg arg = { .conn = conn, .x = 0 };
+  if (!config.meas_latency_stages)
+    return 0;
+  arg.x += METRIC (conn, "latency_stage_seconds", "summary", "Latency per stage of the data path (Internal/MeasureLatencyStages)");
+  for (int s = 0; s < NN_LAT_STAGE_COUNT; s++)
+  {
+    arg.stage = (enum nn_lat_stage) s;
+    nn_lat_stages_enum (print_metrics_lat_stages1, &arg);
+  }
+  return arg.x;
+}
+
+#undef METRIC
+
+static int print_metrics (struct thread_state1 * const ts1, ddsi_tran_conn_t conn)
+{
+  int x = 0;
+  x += print_metrics_threads (conn);
+  if (x == 0)
+    x += print_metrics_queues (conn);
+  if (x == 0)
+    x += print_metrics_endpoints (ts1, conn);
+  if (x == 0)
+    x += print_metrics_transport (conn);
+  if (x == 0)
+    x += print_metrics_lat_stages (conn);
+  return x;
+}
+
+static bool debmon_wait_readable (ddsrt_socket_t sock, dds_duration_t timeout)
+{
+  fd_set fds;
+  int32_t ready = 0;
+  dds_return_t rc;
+  do {
+    FD_ZERO (&fds);
+#if LWIP_SOCKET == 1
+    DDSRT_WARNING_GNUC_OFF(sign-conversion)
+#endif
+    FD_SET (sock, &fds);
+#if LWIP_SOCKET == 1
+    DDSRT_WARNING_GNUC_ON(sign-conversion)
+#endif
+    rc = ddsrt_select (sock + 1, &fds, NULL, NULL, timeout, &ready);
+  } while (rc == DDS_RETCODE_INTERRUPTED);
+  return rc == DDS_RETCODE_OK && ready > 0;
+}
+
+static bool debmon_read_request (ddsi_tran_conn_t conn, char *path, size_t pathsize)
+{
+  /* Clients that simply connect and read (telnet, nc) get the plain-text
+     dump right away; HTTP clients send a request first.  So wait a little
+     while for data to show up and if it does, read the request up to the
+     empty line terminating the headers and extract the path from the
+     request line.  The reads block, so check that there is data before
+     each one, or a client that stops sending halfway through a request
+     would hang the monitor thread. */
+  const ddsrt_socket_t sock = ddsi_conn_handle (conn);
+  char line[256];
+  size_t pos = 0, nreq = 0;
+  int nlines = 0, state = 0;
+  dds_time_t tdeadline;
+
+  if (!debmon_wait_readable (sock, DDS_MSECS (100)))
+    return false;
+
+  /* state counts consecutive line terminators, ignoring CRs */
+  tdeadline = dds_time () + DDS_SECS (1);
+  while (state < 2 && nreq < 8192)
+  {
+    const dds_time_t tnow = dds_time ();
+    unsigned char c;
+    if (tnow >= tdeadline || !debmon_wait_readable (sock, tdeadline - tnow))
+      return false;
+    if (ddsi_conn_read (conn, &c, 1, false, NULL) != 1)
+      return false;
+    nreq++;
+    if (c == '\r')
+      continue;
+    else if (c == '\n')
+    {
+      if (state++ == 0)
+        nlines++;
+    }
+    else
+    {
+      state = 0;
+      if (nlines == 0 && pos < sizeof (line) - 1)
+        line[pos++] = (char) c;
+    }
+  }
+  line[pos] = 0;
+
+  if (strncmp (line, "GET ", 4) != 0)
+    return false;
+  else
+  {
+    const char *p = line + 4;
+    size_t n = strcspn (p, " ");
+    if (n >= pathsize)
+      n = pathsize - 1;
+    memcpy (path, p, n);
+    path[n] = 0;
+    return true;
+  }
+}
+
+static void print_flightrec_line (void *varg, const char *line)
+{
+  ddsi_tran_conn_t conn = varg;
+  (void) cpf (conn, "%s\n", line);
+}
+
 static void debmon_handle_connection (struct debug_monitor *dm, ddsi_tran_conn_t conn)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   struct plugin *p;
+  char path[64];
   int r = 0;
-  r += print_participants (ts1, conn);
+
+  if (debmon_read_request (conn, path, sizeof (path)))
+  {
+    if (strcmp (path, "/metrics") == 0)
+    {
+      /* Prometheus text exposition format */
+      r += cpf (conn, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+      if (r == 0)
+        (void) print_metrics (ts1, conn);
+      return;
+    }
+    else if (strcmp (path, "/flightrec") == 0)
+    {
+      r += cpf (conn, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n");
+      if (r == 0)
+        nn_flightrec_dump (print_flightrec_line, conn);
+      return;
+    }
+    r += cpf (conn, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n");
+  }
+
+  if (r == 0)
+    r += print_participants (ts1, conn);
   if (r == 0)
     r += print_proxy_participants (ts1, conn);
 
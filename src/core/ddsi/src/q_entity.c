@@ -36,6 +36,7 @@
 #include "dds/ddsi/q_ddsi_discovery.h" /* spdp_write, &c. */
 #include "dds/ddsi/q_gc.h"
 #include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_lat_stages.h"
 #include "dds/ddsi/q_protocol.h" /* NN_ENTITYID_... */
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
@@ -169,6 +170,7 @@ static void entity_common_init (struct entity_common *e, const struct nn_guid *g
   e->tupdate = tcreate;
   e->name = ddsrt_strdup (name ? name : "");
   e->onlylocal = onlylocal;
+  e->topic = NULL;
   ddsrt_mutex_init (&e->lock);
   if (ddsi_plugin.builtintopic_is_visible (guid, vendorid))
   {
@@ -375,7 +377,7 @@ static void remove_deleted_participant_guid (const struct nn_guid *guid, unsigne
 
 /* PARTICIPANT ------------------------------------------------------ */
 
-static bool update_qos_locked (struct entity_common *e, dds_qos_t *ent_qos, const dds_qos_t *xqos, nn_wctime_t timestamp)
+static uint64_t update_qos_delta (const struct entity_common *e, const dds_qos_t *ent_qos, const dds_qos_t *xqos)
 {
   uint64_t mask;
 
@@ -394,7 +396,12 @@ static bool update_qos_locked (struct entity_common *e, dds_qos_t *ent_qos, cons
   DDS_LOG (DDS_LC_DISCOVERY, "update_qos_locked "PGUIDFMT" delta=%"PRIu64" QOS={", PGUID(e->guid), mask);
   nn_log_xqos(DDS_LC_DISCOVERY, xqos);
   DDS_LOG (DDS_LC_DISCOVERY, "}\n");
+  return mask;
+}
 
+static bool update_qos_locked (struct entity_common *e, dds_qos_t *ent_qos, const dds_qos_t *xqos, nn_wctime_t timestamp)
+{
+  const uint64_t mask = update_qos_delta (e, ent_qos, xqos);
   if (mask == 0)
     /* no change, or an as-yet unsupported one */
     return false;
@@ -405,6 +412,38 @@ static bool update_qos_locked (struct entity_common *e, dds_qos_t *ent_qos, cons
   return true;
 }
 
+static void gc_unintern_qos (struct gcreq *gcreq)
+{
+  nn_xqos_unintern (gv.xqos_intern, gcreq->arg);
+  gcreq_free (gcreq);
+}
+
+static bool update_interned_qos_locked (struct entity_common *e, const dds_qos_t **ent_qos, const dds_qos_t *xqos, nn_wctime_t timestamp)
+{
+  /* interned QoS objects are shared and immutable: construct the updated
+     QoS in a private copy and switch to the interned version of that */
+  const uint64_t mask = update_qos_delta (e, *ent_qos, xqos);
+  const dds_qos_t *old_qos = *ent_qos;
+  dds_qos_t new_qos;
+  if (mask == 0)
+    return false;
+
+  nn_xqos_copy (&new_qos, old_qos);
+  nn_xqos_fini_mask (&new_qos, mask);
+  nn_xqos_mergein_missing (&new_qos, xqos, mask);
+  *ent_qos = nn_xqos_intern (gv.xqos_intern, &new_qos);
+  nn_xqos_fini (&new_qos);
+  {
+    /* readers of c.xqos don't lock the proxy endpoint, so the old one may still
+       be in use by other threads and may only be released once they're done */
+    struct gcreq *gcreq = gcreq_new (gv.gcreq_queue, gc_unintern_qos);
+    gcreq->arg = (void *) old_qos;
+    gcreq_enqueue (gcreq);
+  }
+  ddsi_plugin.builtintopic_write (e, timestamp, true);
+  return true;
+}
+
 static dds_return_t pp_allocate_entityid(nn_entityid_t *id, unsigned kind, struct participant *pp)
 {
   uint32_t id1;
@@ -1834,7 +1873,10 @@ static void proxy_writer_add_connection (struct proxy_writer *pwr, struct reader
     goto already_matched;
 
   if (pwr->c.topic == NULL && rd->topic)
+  {
     pwr->c.topic = ddsi_sertopic_ref (rd->topic);
+    pwr->lat_stages = nn_lat_stages_lookup (rd->topic->name);
+  }
   if (pwr->ddsi2direct_cb == 0 && rd->ddsi2direct_cb != 0)
   {
     pwr->ddsi2direct_cb = rd->ddsi2direct_cb;
@@ -2339,21 +2381,41 @@ static void generic_do_match (struct entity_common *e, nn_mtime_t tnow)
   enum entity_kind mkind = generic_do_match_mkind(e->kind);
   if (!is_builtin_entityid (e->guid.entityid, NN_VENDORID_ECLIPSE))
   {
-    DDS_LOG(DDS_LC_DISCOVERY, "match_%s_with_%ss(%s "PGUIDFMT") scanning all %ss\n",
-            generic_do_match_kindstr_us (e->kind), generic_do_match_kindstr_us (mkind),
-            generic_do_match_kindabbrev (e->kind), PGUID (e->guid),
-            generic_do_match_kindstr(mkind));
-    /* Note: we visit at least all proxies that existed when we called
-     init (with the -- possible -- exception of ones that were
-     deleted between our calling init and our reaching it while
-     enumerating), but we may visit a single proxy reader multiple
-     times. */
-    ephash_enum_init (&est, mkind);
-    ddsrt_rwlock_read (&gv.qoslock);
-    while ((em = ephash_enum_next (&est)) != NULL)
-      generic_do_match_connect(e, em, tnow);
-    ddsrt_rwlock_unlock (&gv.qoslock);
-    ephash_enum_fini (&est);
+    struct ephash_enum_topic est_tp;
+    if (ephash_enum_topic_init (&est_tp, e, mkind))
+    {
+      DDS_LOG(DDS_LC_DISCOVERY, "match_%s_with_%ss(%s "PGUIDFMT") scanning %"PRIu32" %ss of topic\n",
+              generic_do_match_kindstr_us (e->kind), generic_do_match_kindstr_us (mkind),
+              generic_do_match_kindabbrev (e->kind), PGUID (e->guid),
+              est_tp.n, generic_do_match_kindstr(mkind));
+      /* Note: we visit all proxies on the same topic that existed when
+       we called init (with the -- possible -- exception of ones that
+       were deleted between our calling init and our reaching it while
+       enumerating); any created later will do the matching themselves. */
+      ddsrt_rwlock_read (&gv.qoslock);
+      while ((em = ephash_enum_topic_next (&est_tp)) != NULL)
+        generic_do_match_connect(e, em, tnow);
+      ddsrt_rwlock_unlock (&gv.qoslock);
+      ephash_enum_topic_fini (&est_tp);
+    }
+    else
+    {
+      DDS_LOG(DDS_LC_DISCOVERY, "match_%s_with_%ss(%s "PGUIDFMT") scanning all %ss\n",
+              generic_do_match_kindstr_us (e->kind), generic_do_match_kindstr_us (mkind),
+              generic_do_match_kindabbrev (e->kind), PGUID (e->guid),
+              generic_do_match_kindstr(mkind));
+      /* Note: we visit at least all proxies that existed when we called
+       init (with the -- possible -- exception of ones that were
+       deleted between our calling init and our reaching it while
+       enumerating), but we may visit a single proxy reader multiple
+       times. */
+      ephash_enum_init (&est, mkind);
+      ddsrt_rwlock_read (&gv.qoslock);
+      while ((em = ephash_enum_next (&est)) != NULL)
+        generic_do_match_connect(e, em, tnow);
+      ddsrt_rwlock_unlock (&gv.qoslock);
+      ephash_enum_fini (&est);
+    }
   }
   else
   {
@@ -2385,12 +2447,26 @@ static void generic_do_match (struct entity_common *e, nn_mtime_t tnow)
 static void generic_do_local_match (struct entity_common *e, nn_mtime_t tnow)
 {
   struct ephash_enum est;
+  struct ephash_enum_topic est_tp;
   struct entity_common *em;
   enum entity_kind mkind;
   if (is_builtin_entityid (e->guid.entityid, NN_VENDORID_ECLIPSE) && !is_local_orphan_endpoint (e))
     /* never a need for local matches on discovery endpoints */
     return;
   mkind = generic_do_local_match_mkind(e->kind);
+  if (ephash_enum_topic_init (&est_tp, e, mkind))
+  {
+    DDS_LOG(DDS_LC_DISCOVERY, "match_%s_with_%ss(%s "PGUIDFMT") scanning %"PRIu32" %ss of topic\n",
+            generic_do_match_kindstr_us (e->kind), generic_do_match_kindstr_us (mkind),
+            generic_do_match_kindabbrev (e->kind), PGUID (e->guid),
+            est_tp.n, generic_do_match_kindstr(mkind));
+    ddsrt_rwlock_read (&gv.qoslock);
+    while ((em = ephash_enum_topic_next (&est_tp)) != NULL)
+      generic_do_local_match_connect(e, em, tnow);
+    ddsrt_rwlock_unlock (&gv.qoslock);
+    ephash_enum_topic_fini (&est_tp);
+    return;
+  }
   DDS_LOG(DDS_LC_DISCOVERY, "match_%s_with_%ss(%s "PGUIDFMT") scanning all %ss\n",
           generic_do_match_kindstr_us (e->kind), generic_do_match_kindstr_us (mkind),
           generic_do_match_kindabbrev (e->kind), PGUID (e->guid),
@@ -2714,6 +2790,8 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
   wr->throttle_tracing = 0;
   wr->rexmit_count = 0;
   wr->rexmit_lost_count = 0;
+  wr->rexmit_bytes = 0;
+  wr->time_throttled = 0;
 
   wr->status_cb = status_cb;
   wr->status_cb_entity = status_entity;
@@ -2743,6 +2821,7 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
     config.generate_keyhash &&
     ((wr->e.guid.entityid.u & NN_ENTITYID_KIND_MASK) == NN_ENTITYID_KIND_WRITER_WITH_KEY);
   wr->topic = ddsi_sertopic_ref (topic);
+  wr->lat_stages = nn_lat_stages_lookup (topic ? topic->name : NULL);
   wr->as = new_addrset ();
   wr->as_group = NULL;
 
@@ -2802,12 +2881,12 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
     struct config_channel_listelem *channel = find_channel (wr->xqos->transport_priority);
     DDS_LOG(DDS_LC_DISCOVERY, "writer "PGUIDFMT": transport priority %d => channel '%s' priority %d\n",
             PGUID (wr->e.guid), wr->xqos->transport_priority.value, channel->name, channel->priority);
-    wr->evq = channel->evq ? channel->evq : gv.xevents;
+    wr->evq = channel->evq ? channel->evq : xeventq_for_guid (&wr->e.guid);
   }
   else
 #endif
   {
-    wr->evq = gv.xevents;
+    wr->evq = xeventq_for_guid (&wr->e.guid);
   }
 
   /* heartbeat event will be deleted when the handler can't find a
@@ -3682,7 +3761,7 @@ void new_proxy_participant
         assert (is_builtin_entityid (guid1.entityid, proxypp->vendor));
         if (is_writer_entityid (guid1.entityid))
         {
-          new_proxy_writer (ppguid, &guid1, proxypp->as_meta, &plist_wr, gv.builtins_dqueue, gv.xevents, timestamp);
+          new_proxy_writer (ppguid, &guid1, proxypp->as_meta, &plist_wr, gv.builtins_dqueue, xeventq_for_guid (&guid1), timestamp);
         }
         else
         {
@@ -4098,10 +4177,11 @@ static void proxy_endpoint_common_init (struct entity_common *e, struct proxy_en
 
   name = (plist->present & PP_ENTITY_NAME) ? plist->entity_name : "";
   entity_common_init (e, guid, name, kind, tcreate, proxypp->vendor, false);
-  c->xqos = nn_xqos_dup (&plist->qos);
+  c->xqos = nn_xqos_intern (gv.xqos_intern, &plist->qos);
   c->as = ref_addrset (as);
   c->topic = NULL; /* set from first matching reader/writer */
   c->vendor = proxypp->vendor;
+  c->have_sedp_digest = false;
 
   if (plist->present & PP_GROUP_GUID)
     c->group_guid = plist->group_guid;
@@ -4116,8 +4196,7 @@ static void proxy_endpoint_common_fini (struct entity_common *e, struct proxy_en
   unref_proxy_participant (c->proxypp, c);
 
   ddsi_sertopic_unref (c->topic);
-  nn_xqos_fini (c->xqos);
-  ddsrt_free (c->xqos);
+  nn_xqos_unintern (gv.xqos_intern, c->xqos);
   unref_addrset (c->as);
 
   entity_common_fini (e);
@@ -4199,6 +4278,7 @@ int new_proxy_writer (const struct nn_guid *ppguid, const struct nn_guid *guid,
   pwr->dqueue = dqueue;
   pwr->evq = evq;
   pwr->ddsi2direct_cb = 0;
+  pwr->lat_stages = NULL;
   pwr->ddsi2direct_cbarg = 0;
 
   local_reader_ary_init (&pwr->rdary);
@@ -4247,7 +4327,7 @@ void update_proxy_writer (struct proxy_writer *pwr, struct addrset *as, const st
     }
   }
 
-  update_qos_locked (&pwr->e, pwr->c.xqos, xqos, timestamp);
+  update_interned_qos_locked (&pwr->e, &pwr->c.xqos, xqos, timestamp);
   ddsrt_mutex_unlock (&pwr->e.lock);
 }
 
@@ -4301,7 +4381,7 @@ void update_proxy_reader (struct proxy_reader *prd, struct addrset *as, const st
     }
   }
 
-  update_qos_locked (&prd->e, prd->c.xqos, xqos, timestamp);
+  update_interned_qos_locked (&prd->e, &prd->c.xqos, xqos, timestamp);
   ddsrt_mutex_unlock (&prd->e.lock);
 }
 
@@ -11,23 +11,48 @@
  */
 #include <stddef.h>
 #include <assert.h>
+#include <string.h>
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/avl.h"
 
 #include "dds/ddsrt/hopscotch.h"
 #include "dds/ddsi/q_ephash.h"
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_globals.h"
 #include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_xqos.h"
 #include "dds/ddsi/q_gc.h"
 #include "dds/ddsi/q_rtps.h" /* guid_t */
 #include "dds/ddsi/q_thread.h" /* for assert(thread is awake) */
 
+/* Topic index: for each topic name, the endpoints of each kind, so that matching
+   a new endpoint need only consider the endpoints on the same topic instead of all
+   endpoints of the opposite kind */
+struct ephash_topic {
+  ddsrt_avl_node_t avlnode; /* in ephash::topics */
+  char *name;
+  uint32_t n[EK_NKINDS];
+  ddsrt_avl_tree_t eps[EK_NKINDS]; /* entity_common, keyed on GUID */
+};
+
 struct ephash {
   struct ddsrt_chh *hash;
+  ddsrt_mutex_t topics_lock;
+  ddsrt_avl_tree_t topics;
 };
 
+static int compare_topic_name (const void *va, const void *vb);
+static int compare_entity_guid (const void *va, const void *vb);
+
+static const ddsrt_avl_treedef_t ephash_topics_td =
+  DDSRT_AVL_TREEDEF_INITIALIZER_INDKEY (offsetof (struct ephash_topic, avlnode), offsetof (struct ephash_topic, name), compare_topic_name, 0);
+static const ddsrt_avl_treedef_t ephash_topic_eps_td =
+  DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct entity_common, topic_avlnode), offsetof (struct entity_common, guid), compare_entity_guid, 0);
+
 static const uint64_t unihashconsts[] = {
   UINT64_C (16292676669999574021),
   UINT64_C (10242350189706880077),
@@ -62,6 +87,16 @@ static int entity_guid_eq_wrapper (const void *a, const void *b)
   return entity_guid_eq (a, b);
 }
 
+static int compare_topic_name (const void *va, const void *vb)
+{
+  return strcmp (va, vb);
+}
+
+static int compare_entity_guid (const void *va, const void *vb)
+{
+  return memcmp (va, vb, sizeof (nn_guid_t));
+}
+
 static void gc_buckets_cb (struct gcreq *gcreq)
 {
   void *bs = gcreq->arg;
@@ -85,17 +120,76 @@ struct ephash *ephash_new (void)
     ddsrt_free (ephash);
     return NULL;
   } else {
+    ddsrt_mutex_init (&ephash->topics_lock);
+    ddsrt_avl_init (&ephash_topics_td, &ephash->topics);
     return ephash;
   }
 }
 
+static void free_topic (void *vtopic)
+{
+  struct ephash_topic *topic = vtopic;
+  ddsrt_free (topic->name);
+  ddsrt_free (topic);
+}
+
 void ephash_free (struct ephash *ephash)
 {
+  /* endpoints are all gone by now, so the per-kind trees are empty */
+  ddsrt_avl_free (&ephash_topics_td, &ephash->topics, free_topic);
+  ddsrt_mutex_destroy (&ephash->topics_lock);
   ddsrt_chh_free (ephash->hash);
   ephash->hash = NULL;
   ddsrt_free (ephash);
 }
 
+static void ephash_topic_insert (struct entity_common *e, const dds_qos_t *xqos)
+{
+  struct ephash * const ephash = gv.guid_hash;
+  struct ephash_topic *topic;
+  ddsrt_avl_ipath_t path;
+  assert (e->topic == NULL);
+  if (!(xqos->present & QP_TOPIC_NAME))
+    return;
+  ddsrt_mutex_lock (&ephash->topics_lock);
+  if ((topic = ddsrt_avl_lookup_ipath (&ephash_topics_td, &ephash->topics, xqos->topic_name, &path)) == NULL)
+  {
+    topic = ddsrt_malloc (sizeof (*topic));
+    topic->name = ddsrt_strdup (xqos->topic_name);
+    for (int i = 0; i < EK_NKINDS; i++)
+    {
+      topic->n[i] = 0;
+      ddsrt_avl_init (&ephash_topic_eps_td, &topic->eps[i]);
+    }
+    ddsrt_avl_insert_ipath (&ephash_topics_td, &ephash->topics, topic, &path);
+  }
+  ddsrt_avl_insert (&ephash_topic_eps_td, &topic->eps[e->kind], e);
+  topic->n[e->kind]++;
+  e->topic = topic;
+  ddsrt_mutex_unlock (&ephash->topics_lock);
+}
+
+static void ephash_topic_remove (struct entity_common *e)
+{
+  struct ephash * const ephash = gv.guid_hash;
+  struct ephash_topic *topic;
+  if ((topic = e->topic) == NULL)
+    return;
+  ddsrt_mutex_lock (&ephash->topics_lock);
+  ddsrt_avl_delete (&ephash_topic_eps_td, &topic->eps[e->kind], e);
+  topic->n[e->kind]--;
+  e->topic = NULL;
+  int empty = 1;
+  for (int i = 0; i < EK_NKINDS && empty; i++)
+    empty = (topic->n[i] == 0);
+  if (empty)
+  {
+    ddsrt_avl_delete (&ephash_topics_td, &ephash->topics, topic);
+    free_topic (topic);
+  }
+  ddsrt_mutex_unlock (&ephash->topics_lock);
+}
+
 static void ephash_guid_insert (struct entity_common *e)
 {
   int x;
@@ -152,21 +246,25 @@ void ephash_insert_proxy_participant_guid (struct proxy_participant *proxypp)
 void ephash_insert_writer_guid (struct writer *wr)
 {
   ephash_guid_insert (&wr->e);
+  ephash_topic_insert (&wr->e, wr->xqos);
 }
 
 void ephash_insert_reader_guid (struct reader *rd)
 {
   ephash_guid_insert (&rd->e);
+  ephash_topic_insert (&rd->e, rd->xqos);
 }
 
 void ephash_insert_proxy_writer_guid (struct proxy_writer *pwr)
 {
   ephash_guid_insert (&pwr->e);
+  ephash_topic_insert (&pwr->e, pwr->c.xqos);
 }
 
 void ephash_insert_proxy_reader_guid (struct proxy_reader *prd)
 {
   ephash_guid_insert (&prd->e);
+  ephash_topic_insert (&prd->e, prd->c.xqos);
 }
 
 void ephash_remove_participant_guid (struct participant *pp)
@@ -181,21 +279,25 @@ void ephash_remove_proxy_participant_guid (struct proxy_participant *proxypp)
 
 void ephash_remove_writer_guid (struct writer *wr)
 {
+  ephash_topic_remove (&wr->e);
   ephash_guid_remove (&wr->e);
 }
 
 void ephash_remove_reader_guid (struct reader *rd)
 {
+  ephash_topic_remove (&rd->e);
   ephash_guid_remove (&rd->e);
 }
 
 void ephash_remove_proxy_writer_guid (struct proxy_writer *pwr)
 {
+  ephash_topic_remove (&pwr->e);
   ephash_guid_remove (&pwr->e);
 }
 
 void ephash_remove_proxy_reader_guid (struct proxy_reader *prd)
 {
+  ephash_topic_remove (&prd->e);
   ephash_guid_remove (&prd->e);
 }
 
@@ -368,3 +470,46 @@ void ephash_enum_proxy_participant_fini (struct ephash_enum_proxy_participant *s
 {
   ephash_enum_fini (&st->st);
 }
+
+/* Enumeration by topic */
+
+bool ephash_enum_topic_init (struct ephash_enum_topic *st, const struct entity_common *e, enum entity_kind kind)
+{
+  struct ephash * const ephash = gv.guid_hash;
+  const struct ephash_topic *topic;
+  st->kind = kind;
+  st->cursor = 0;
+  st->n = 0;
+  st->guids = NULL;
+  ddsrt_mutex_lock (&ephash->topics_lock);
+  if ((topic = e->topic) == NULL)
+  {
+    ddsrt_mutex_unlock (&ephash->topics_lock);
+    return false;
+  }
+  if (topic->n[kind] > 0)
+  {
+    ddsrt_avl_iter_t it;
+    const struct entity_common *em;
+    st->guids = ddsrt_malloc (topic->n[kind] * sizeof (*st->guids));
+    for (em = ddsrt_avl_iter_first (&ephash_topic_eps_td, &topic->eps[kind], &it); em; em = ddsrt_avl_iter_next (&it))
+      st->guids[st->n++] = em->guid;
+    assert (st->n == topic->n[kind]);
+  }
+  ddsrt_mutex_unlock (&ephash->topics_lock);
+  return true;
+}
+
+void *ephash_enum_topic_next (struct ephash_enum_topic *st)
+{
+  /* Look up each one again: it may have been deleted since the enumeration was initialised */
+  void *em = NULL;
+  while (em == NULL && st->cursor < st->n)
+    em = ephash_lookup_guid (&st->guids[st->cursor++], st->kind);
+  return em;
+}
+
+void ephash_enum_topic_fini (struct ephash_enum_topic *st)
+{
+  ddsrt_free (st->guids);
+}
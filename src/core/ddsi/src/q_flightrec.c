@@ -0,0 +1,359 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_time.h"
+#include "dds/ddsi/q_xevent.h"
+#include "dds/ddsi/q_flightrec.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+/* Each slot is written by the owning thread only: it first clears "hdr",
+   then fills in the event and finally sets "hdr" to a combination of the
+   event index and the kind.  A reader copies a slot and only accepts it if
+   "hdr" is non-zero and unchanged, which is good enough for a post-mortem
+   of the last few thousand events and costs the writer nothing more than
+   a few stores. */
+struct nn_flightrec_event {
+  ddsrt_atomic_uint32_t hdr;
+  uint32_t arg;
+  int64_t t;
+  nn_guid_t src, dst;
+  int64_t seq1, seq2;
+};
+
+#define HDR_KIND_MASK 0xffu
+#define HDR_IDX_SHIFT 8
+
+/* Cost is estimated by timing one out of every EST_PERIOD events */
+#define EST_PERIOD 1024u
+
+struct nn_flightrec_ring {
+  uint64_t next; /* written by owner only, also serves as event count */
+  uint64_t est_ns; /* written by owner only */
+  uint32_t mask;
+  struct nn_flightrec_event ev[];
+};
+
+/* Rings are indexed like thread_states.ts, a ring is allocated the first
+   time a thread records an event and stays with the slot until shutdown */
+static struct {
+  uint32_t nrings;
+  ddsrt_atomic_voidp_t *rings;
+#ifndef _WIN32
+  int signal;
+  struct sigaction oact;
+#endif
+} flightrec;
+
+static ddsrt_atomic_uint32_t flightrec_dump_requested = DDSRT_ATOMIC_UINT32_INIT (0);
+
+static const struct {
+  const char *name;
+  const char *seq1, *seq2, *arg;
+} kinds[] = {
+  [NN_FR_HEARTBEAT_SENT] = { "HEARTBEAT-SENT", "first", "last", "count" },
+  [NN_FR_HEARTBEAT_RECV] = { "HEARTBEAT-RECV", "first", "last", "count" },
+  [NN_FR_ACKNACK_SENT] = { "ACKNACK-SENT", "base", "count", "numbits" },
+  [NN_FR_ACKNACK_RECV] = { "ACKNACK-RECV", "base", "count", "numbits" },
+  [NN_FR_GAP_SENT] = { "GAP-SENT", "start", "base", "numbits" },
+  [NN_FR_GAP_RECV] = { "GAP-RECV", "start", "base", "numbits" },
+  [NN_FR_REXMIT] = { "REXMIT", "seq", NULL, "size" },
+  [NN_FR_THROTTLE_BEGIN] = { "THROTTLE-BEGIN", NULL, NULL, "unacked_kb" },
+  [NN_FR_THROTTLE_END] = { "THROTTLE-END", NULL, "timeout", "unacked_kb" },
+  [NN_FR_LEASE_SET] = { "LEASE-SET", "tend", NULL, NULL },
+  [NN_FR_LEASE_EXPIRED] = { "LEASE-EXPIRED", NULL, NULL, NULL }
+};
+
+#ifndef _WIN32
+static void flightrec_sigh (int sig)
+{
+  (void) sig;
+  ddsrt_atomic_st32 (&flightrec_dump_requested, 1);
+}
+#endif
+
+void nn_flightrec_init (void)
+{
+  flightrec.nrings = 0;
+  flightrec.rings = NULL;
+  if (config.flightrec_size == 0)
+    return;
+  flightrec.nrings = thread_states.nthreads;
+  flightrec.rings = ddsrt_malloc (flightrec.nrings * sizeof (*flightrec.rings));
+  for (uint32_t i = 0; i < flightrec.nrings; i++)
+    ddsrt_atomic_stvoidp (&flightrec.rings[i], NULL);
+#ifndef _WIN32
+  flightrec.signal = config.flightrec_signal;
+  if (flightrec.signal > 0)
+  {
+    struct sigaction act;
+    memset (&act, 0, sizeof (act));
+    act.sa_handler = flightrec_sigh;
+    sigemptyset (&act.sa_mask);
+    act.sa_flags = SA_RESTART;
+    if (sigaction (flightrec.signal, &act, &flightrec.oact) != 0)
+    {
+      DDS_WARNING ("flight recorder: failed to install handler for signal %d\n", flightrec.signal);
+      flightrec.signal = 0;
+    }
+  }
+#endif
+}
+
+void nn_flightrec_fini (void)
+{
+  if (flightrec.rings == NULL)
+    return;
+#ifndef _WIN32
+  if (flightrec.signal > 0)
+    sigaction (flightrec.signal, &flightrec.oact, NULL);
+#endif
+  for (uint32_t i = 0; i < flightrec.nrings; i++)
+    ddsrt_free (ddsrt_atomic_ldvoidp (&flightrec.rings[i]));
+  ddsrt_free (flightrec.rings);
+  flightrec.rings = NULL;
+  flightrec.nrings = 0;
+}
+
+static struct nn_flightrec_ring *new_ring (void)
+{
+  uint32_t n = 1;
+  while (n < config.flightrec_size && n < (1u << 24))
+    n *= 2;
+  struct nn_flightrec_ring *ring = ddsrt_malloc (sizeof (*ring) + n * sizeof (ring->ev[0]));
+  ring->next = 0;
+  ring->est_ns = 0;
+  ring->mask = n - 1;
+  for (uint32_t i = 0; i < n; i++)
+    ddsrt_atomic_st32 (&ring->ev[i].hdr, 0);
+  return ring;
+}
+
+void nn_flightrec_record (enum nn_flightrec_kind kind, const nn_guid_t *src, const nn_guid_t *dst, int64_t seq1, int64_t seq2, uint32_t arg)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct nn_flightrec_ring *ring;
+  uintptr_t idx;
+
+  /* threads without a slot in thread_states (i.e., before init and after
+     shutdown) don't record anything */
+  if (flightrec.rings == NULL || thread_states.ts == NULL || (uintptr_t) ts1 < (uintptr_t) thread_states.ts)
+    return;
+  if ((idx = (uintptr_t) (ts1 - thread_states.ts)) >= flightrec.nrings)
+    return;
+  if ((ring = ddsrt_atomic_ldvoidp (&flightrec.rings[idx])) == NULL)
+  {
+    ring = new_ring ();
+    ddsrt_atomic_stvoidp (&flightrec.rings[idx], ring);
+  }
+
+  const int64_t t = dds_time ();
+  const uint64_t i = ring->next++;
+  struct nn_flightrec_event * const ev = &ring->ev[i & ring->mask];
+  ddsrt_atomic_st32 (&ev->hdr, 0);
+  ddsrt_atomic_fence_rel ();
+  ev->arg = arg;
+  ev->t = t;
+  ev->src = *src;
+  if (dst)
+    ev->dst = *dst;
+  else
+    memset (&ev->dst, 0, sizeof (ev->dst));
+  ev->seq1 = seq1;
+  ev->seq2 = seq2;
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (&ev->hdr, ((uint32_t) (i + 1) << HDR_IDX_SHIFT) | (uint32_t) kind);
+  if ((i % EST_PERIOD) == EST_PERIOD - 1)
+    ring->est_ns += EST_PERIOD * (uint64_t) (dds_time () - t);
+}
+
+void nn_flightrec_get_stats (uint64_t *nevents, uint64_t *est_ns)
+{
+  *nevents = 0;
+  *est_ns = 0;
+  for (uint32_t i = 0; i < flightrec.nrings; i++)
+  {
+    const struct nn_flightrec_ring *ring = ddsrt_atomic_ldvoidp (&flightrec.rings[i]);
+    if (ring)
+    {
+      *nevents += ring->next;
+      *est_ns += ring->est_ns;
+    }
+  }
+}
+
+struct dump_event {
+  uint32_t ring;
+  struct nn_flightrec_event ev;
+};
+
+static int cmp_dump_event (const void *va, const void *vb)
+{
+  const struct dump_event *a = va;
+  const struct dump_event *b = vb;
+  return (a->ev.t == b->ev.t) ? 0 : (a->ev.t < b->ev.t) ? -1 : 1;
+}
+
+static bool guid_is_zero (const nn_guid_t *g)
+{
+  return g->prefix.u[0] == 0 && g->prefix.u[1] == 0 && g->prefix.u[2] == 0 && g->entityid.u == 0;
+}
+
+static void lineappend (char *buf, size_t bufsz, size_t *pos, const char *fmt, ...) ddsrt_attribute_format ((printf, 4, 5));
+
+static void lineappend (char *buf, size_t bufsz, size_t *pos, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+  va_start (ap, fmt);
+  n = vsnprintf (buf + *pos, bufsz - *pos, fmt, ap);
+  va_end (ap);
+  if (n > 0)
+    *pos = ((size_t) n < bufsz - *pos) ? *pos + (size_t) n : bufsz - 1;
+}
+
+static void format_event (char *buf, size_t bufsz, const char *tname, const struct nn_flightrec_event *ev, uint32_t kind)
+{
+  size_t pos = 0;
+  buf[0] = 0;
+  lineappend (buf, bufsz, &pos, "%"PRId64".%06"PRId32" %s %s "PGUIDFMT, ev->t / DDS_NSECS_IN_SEC, (int32_t) ((ev->t % DDS_NSECS_IN_SEC) / 1000), tname, kinds[kind].name, PGUID (ev->src));
+  if (!guid_is_zero (&ev->dst))
+    lineappend (buf, bufsz, &pos, " -> "PGUIDFMT, PGUID (ev->dst));
+  if (kinds[kind].seq1)
+    lineappend (buf, bufsz, &pos, " %s %"PRId64, kinds[kind].seq1, ev->seq1);
+  if (kinds[kind].seq2)
+    lineappend (buf, bufsz, &pos, " %s %"PRId64, kinds[kind].seq2, ev->seq2);
+  if (kinds[kind].arg)
+    lineappend (buf, bufsz, &pos, " %s %"PRIu32, kinds[kind].arg, ev->arg);
+}
+
+void nn_flightrec_dump (void (*out) (void *arg, const char *line), void *arg)
+{
+  struct dump_event *evs;
+  char **tnames;
+  size_t nevs = 0, maxevs = 0;
+  char line[256];
+
+  if (flightrec.rings == NULL)
+  {
+    out (arg, "flight recorder disabled");
+    return;
+  }
+
+  /* Copy the thread names: a slot may be reused while we're at it */
+  tnames = ddsrt_malloc (flightrec.nrings * sizeof (*tnames));
+  ddsrt_mutex_lock (&thread_states.lock);
+  for (uint32_t i = 0; i < flightrec.nrings; i++)
+  {
+    const struct nn_flightrec_ring *ring = ddsrt_atomic_ldvoidp (&flightrec.rings[i]);
+    tnames[i] = ddsrt_strdup (thread_states.ts[i].name ? thread_states.ts[i].name : "(exited)");
+    if (ring)
+      maxevs += ring->mask + 1;
+  }
+  ddsrt_mutex_unlock (&thread_states.lock);
+
+  evs = ddsrt_malloc ((maxevs > 0 ? maxevs : 1) * sizeof (*evs));
+  for (uint32_t i = 0; i < flightrec.nrings; i++)
+  {
+    const struct nn_flightrec_ring *ring = ddsrt_atomic_ldvoidp (&flightrec.rings[i]);
+    if (ring == NULL)
+      continue;
+    /* the ring can't have grown (its size is fixed) but another ring may
+       have been allocated since computing maxevs */
+    for (uint32_t j = 0; j <= ring->mask && nevs < maxevs; j++)
+    {
+      struct nn_flightrec_event *ev = (struct nn_flightrec_event *) &ring->ev[j];
+      const uint32_t hdr0 = ddsrt_atomic_ld32 (&ev->hdr);
+      ddsrt_atomic_fence_acq ();
+      evs[nevs].ring = i;
+      evs[nevs].ev = *ev;
+      ddsrt_atomic_fence_acq ();
+      if (hdr0 != 0 && ddsrt_atomic_ld32 (&ev->hdr) == hdr0)
+      {
+        ddsrt_atomic_st32 (&evs[nevs].ev.hdr, hdr0);
+        nevs++;
+      }
+    }
+  }
+
+  qsort (evs, nevs, sizeof (*evs), cmp_dump_event);
+  (void) snprintf (line, sizeof (line), "flight recorder: %"PRIuSIZE" events", nevs);
+  out (arg, line);
+  for (size_t i = 0; i < nevs; i++)
+  {
+    const uint32_t kind = ddsrt_atomic_ld32 (&evs[i].ev.hdr) & HDR_KIND_MASK;
+    if (kind == 0 || kind >= sizeof (kinds) / sizeof (kinds[0]))
+      continue;
+    format_event (line, sizeof (line), tnames[evs[i].ring], &evs[i].ev, kind);
+    out (arg, line);
+  }
+
+  ddsrt_free (evs);
+  for (uint32_t i = 0; i < flightrec.nrings; i++)
+    ddsrt_free (tnames[i]);
+  ddsrt_free (tnames);
+}
+
+#ifndef _WIN32
+static void dump_to_log (void *arg, const char *line)
+{
+  (void) arg;
+  DDS_LOG (~DDS_LC_FATAL, "%s\n", line);
+}
+
+static void dump_to_stderr (void *arg, const char *line)
+{
+  (void) arg;
+  fprintf (stderr, "%s\n", line);
+}
+
+static void flightrec_signal_poll (struct xevent *xev, void *arg, nn_mtime_t tnow)
+{
+  (void) arg;
+  if (tnow.v == T_NEVER)
+  {
+    delete_xevent (xev);
+    return;
+  }
+  if (ddsrt_atomic_cas32 (&flightrec_dump_requested, 1, 0))
+    nn_flightrec_dump ((dds_get_log_mask () != 0) ? dump_to_log : dump_to_stderr, NULL);
+  resched_xevent_if_earlier (xev, add_duration_to_mtime (tnow, 100 * T_MILLISECOND));
+}
+#endif
+
+void nn_flightrec_start (void)
+{
+  /* signal handler only sets a flag, the dump itself is done by the event
+     thread as formatting and logging isn't async-signal-safe */
+#ifndef _WIN32
+  if (flightrec.rings && flightrec.signal > 0)
+  {
+    if (qxev_callback (add_duration_to_mtime (now_mt (), 100 * T_MILLISECOND), flightrec_signal_poll, NULL) == NULL)
+      DDS_WARNING ("flight recorder: failed to schedule signal polling\n");
+  }
+#endif
+}
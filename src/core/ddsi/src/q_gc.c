@@ -81,20 +81,24 @@ static uint32_t gcreq_queue_thread (struct gcreq_queue *q)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   nn_mtime_t next_thread_cputime = { 0 };
-  dds_time_t shortsleep = 1 * T_MILLISECOND;
+  const dds_duration_t shortsleep_min = 50 * T_MICROSECOND;
+  const dds_duration_t shortsleep_max = 1 * T_MILLISECOND;
+  dds_duration_t shortsleep = shortsleep_min;
   int64_t delay = T_MILLISECOND; /* force evaluation after startup */
-  struct gcreq *gcreq = NULL;
+  struct gcreq *batch = NULL;
   int trace_shortsleep = 1;
   ddsrt_mutex_lock (&q->lock);
   while (!(q->terminate && q->count == 0))
   {
     LOG_THREAD_CPUTIME (next_thread_cputime);
 
-    /* If we are waiting for a gcreq to become ready, don't bother
-       looking at the queue; if we aren't, wait for a request to come
-       in.  We can't really wait until something came in because we're
-       also checking lease expirations. */
-    if (gcreq == NULL)
+    /* If we are waiting for a batch of gcreqs to become ready, don't
+       bother looking at the queue; if we aren't, wait for a request to
+       come in.  We can't really wait until something came in because
+       we're also checking lease expirations.  All queued requests are
+       taken at once, to avoid locking the queue and checking leases for
+       each request during mass deletions. */
+    if (batch == NULL)
     {
       assert (trace_shortsleep);
       if (q->first == NULL)
@@ -109,11 +113,8 @@ static uint32_t gcreq_queue_thread (struct gcreq_queue *q)
         }
         ddsrt_cond_waitfor(&q->cond, &q->lock, to);
       }
-      if (q->first)
-      {
-        gcreq = q->first;
-        q->first = q->first->next;
-      }
+      batch = q->first;
+      q->first = NULL;
     }
     ddsrt_mutex_unlock (&q->lock);
 
@@ -128,33 +129,44 @@ static uint32_t gcreq_queue_thread (struct gcreq_queue *q)
     delay = check_and_handle_lease_expiration (now_et ());
     thread_state_asleep (ts1);
 
-    if (gcreq)
+    if (batch)
     {
-      if (!threads_vtime_check (&gcreq->nvtimes, gcreq->vtimes))
+      if (!threads_vtime_check (&batch->nvtimes, batch->vtimes))
       {
         /* Not all threads made enough progress => gcreq is not ready
            yet => sleep for a bit and retry.  Note that we can't even
            terminate while this gcreq is waiting and that there is no
            condition on which to wait, so a plain sleep is quite
-           reasonable. */
+           reasonable.  Threads are typically awake only briefly, so
+           start with a short sleep and back off if that turns out to be
+           insufficient. */
         if (trace_shortsleep)
         {
-          DDS_TRACE("gc %p: not yet, shortsleep\n", (void*)gcreq);
+          DDS_TRACE("gc %p: not yet, shortsleep\n", (void*)batch);
           trace_shortsleep = 0;
         }
         dds_sleepfor (shortsleep);
+        if (shortsleep < shortsleep_max)
+          shortsleep *= 2;
       }
       else
       {
         /* Sufficient progress has been made: may now continue deleting
            it; the callback is responsible for requeueing (if complex
-           multi-phase delete) or freeing the delete request.  Reset
-           the current gcreq as this one obviously is no more.  */
-        DDS_TRACE("gc %p: deleting\n", (void*)gcreq);
+           multi-phase delete) or freeing the delete request.  The vtimes
+           in a gcreq are gathered on creation, so if one is ready, all
+           that were created before it are ready as well, and it is
+           likely that many of the ones following it in the batch are
+           ready, too. */
         thread_state_awake (ts1);
-        gcreq->cb (gcreq);
+        do {
+          struct gcreq *gcreq = batch;
+          batch = gcreq->next;
+          DDS_TRACE("gc %p: deleting\n", (void*)gcreq);
+          gcreq->cb (gcreq);
+        } while (batch && threads_vtime_check (&batch->nvtimes, batch->vtimes));
         thread_state_asleep (ts1);
-        gcreq = NULL;
+        shortsleep = shortsleep_min;
         trace_shortsleep = 1;
       }
     }
@@ -31,6 +31,7 @@
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/q_bswap.h"
 #include "dds/ddsi/q_lat_estim.h"
+#include "dds/ddsi/q_lat_stages.h"
 #include "dds/ddsi/q_bitset.h"
 #include "dds/ddsi/q_xevent.h"
 #include "dds/ddsi/q_addrset.h"
@@ -48,6 +49,7 @@
 #include "dds/ddsi/q_pcap.h"
 #include "dds/ddsi/q_feature_check.h"
 #include "dds/ddsi/q_debmon.h"
+#include "dds/ddsi/q_flightrec.h"
 #include "dds/ddsi/q_init.h"
 
 #include "dds/ddsi/ddsi_tran.h"
@@ -60,6 +62,7 @@
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds__whc.h"
 #include "dds/ddsi/ddsi_iid.h"
+#include "dds/ddsi/ddsi_netsim.h"
 
 static void add_peer_addresses (struct addrset *as, const struct config_peer_listelem *list)
 {
@@ -448,6 +451,8 @@ int rtps_config_open (void)
 
   dds_set_log_mask(config.enabled_logcats);
   dds_set_trace_file(config.tracingOutputFile);
+  if (status && config.tracingAsyncBufferSize > 0 && dds_log_async_start (config.tracingAsyncBufferSize) != DDS_RETCODE_OK)
+    DDS_WARNING("config: Tracing/AsyncBufferSize: asynchronous logging not available\n");
 
   return status;
   DDSRT_WARNING_MSVC_ON(4996);
@@ -566,19 +571,22 @@ int rtps_config_prep (struct cfgst *cfgst)
 
   /* Thread admin: need max threads, which is currently (2 or 3) for each
      configured channel plus 9: main, recv (up to 3x), dqueue.builtin,
-     lease, gc, debmon; once thread state admin has been inited, upgrade the
-     main thread one participating in the thread tracking stuff as
-     if it had been created using create_thread(). */
+     lease, gc, debmon, plus one for each additional event thread and
+     one for the network simulation if configured; once thread state
+     admin has been inited, upgrade the main thread one participating in
+     the thread tracking stuff as if it had been created using
+     create_thread(). */
 
   {
   /* Temporary: thread states for each application thread is managed using thread_states structure
   */
 #define USER_MAX_THREADS 50
+    const unsigned netsim_threads = (config.netsim != NULL && config.netsim[0] != 0) ? 1 : 0;
 
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
-    const unsigned max_threads = 9 + USER_MAX_THREADS + num_channel_threads + config.ddsi2direct_max_threads;
+    const unsigned max_threads = 9 + USER_MAX_THREADS + num_channel_threads + config.ddsi2direct_max_threads + (unsigned) (config.event_threads - 1) + netsim_threads;
 #else
-    const unsigned max_threads = 11 + USER_MAX_THREADS + config.ddsi2direct_max_threads;
+    const unsigned max_threads = 11 + USER_MAX_THREADS + config.ddsi2direct_max_threads + (unsigned) (config.event_threads - 1) + netsim_threads;
 #endif
     thread_states_init (max_threads);
   }
@@ -865,6 +873,9 @@ int rtps_init (void)
   gv.thread_pool = NULL;
   gv.debmon = NULL;
 
+  /* Counters restart from 0 for every instance */
+  memset (&gv.stats, 0, sizeof (gv.stats));
+
   /* Print start time for referencing relative times in the remainder
    of the DDS_LOG. */
   {
@@ -937,6 +948,8 @@ int rtps_init (void)
       mc_available = false;
     }
   }
+  if (ddsi_netsim_init () < 0)
+    goto err_netsim;
   if (set_recvips () < 0)
     goto err_set_recvips;
   if (set_spdp_address () < 0)
@@ -1016,6 +1029,9 @@ int rtps_init (void)
   lease_management_init ();
   deleted_participants_admin_init ();
   gv.guid_hash = ephash_new ();
+  gv.xqos_intern = nn_xqos_intern_new ();
+  nn_lat_stages_init ();
+  nn_flightrec_init ();
 
   ddsrt_mutex_init (&gv.privileged_pp_lock);
   gv.privileged_pp = NULL;
@@ -1209,17 +1225,23 @@ int rtps_init (void)
 
   /* Create event queues */
 
-  gv.xevents = xeventq_new
-  (
-    gv.tev_conn,
-    config.max_queued_rexmit_bytes,
-    config.max_queued_rexmit_msgs,
+  gv.n_xevents_shards = (uint32_t) config.event_threads;
+  gv.xevents_shards = ddsrt_malloc (gv.n_xevents_shards * sizeof (*gv.xevents_shards));
+  for (uint32_t i = 0; i < gv.n_xevents_shards; i++)
+  {
+    gv.xevents_shards[i] = xeventq_new
+    (
+      gv.tev_conn,
+      config.max_queued_rexmit_bytes,
+      config.max_queued_rexmit_msgs,
 #ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
-    config.auxiliary_bandwidth_limit
+      config.auxiliary_bandwidth_limit
 #else
-    0
+      0
 #endif
-  );
+    );
+  }
+  gv.xevents = gv.xevents_shards[0];
 
   gv.as_disc = new_addrset ();
   if (config.allowMulticast & AMC_SPDP)
@@ -1292,6 +1314,10 @@ err_unicast_sockets:
   ddsrt_mutex_destroy (&gv.privileged_pp_lock);
   ephash_free (gv.guid_hash);
   gv.guid_hash = NULL;
+  nn_xqos_intern_free (gv.xqos_intern);
+  gv.xqos_intern = NULL;
+  nn_lat_stages_fini ();
+  nn_flightrec_fini ();
   deleted_participants_admin_fini ();
   lease_management_term ();
   ddsrt_cond_destroy (&gv.participant_set_cond);
@@ -1328,6 +1354,8 @@ err_set_ext_address:
     ddsrt_free (n);
   }
 err_set_recvips:
+  ddsi_netsim_fini ();
+err_netsim:
 err_find_own_ip:
   for (int i = 0; i < gv.n_interfaces; i++)
     ddsrt_free (gv.interfaces[i].name);
@@ -1347,10 +1375,32 @@ static void stop_all_xeventq_upto (struct config_channel_listelem *chptr)
 }
 #endif
 
+static void stop_xevents_shards_upto (uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    xeventq_stop (gv.xevents_shards[i]);
+}
+
 int rtps_start (void)
 {
+  if (ddsi_netsim_start () < 0)
+    return -1;
   if (xeventq_start (gv.xevents, NULL) < 0)
+  {
+    ddsi_netsim_stop ();
     return -1;
+  }
+  for (uint32_t i = 1; i < gv.n_xevents_shards; i++)
+  {
+    char name[16];
+    (void) snprintf (name, sizeof (name), "%"PRIu32, i);
+    if (xeventq_start (gv.xevents_shards[i], name) < 0)
+    {
+      stop_xevents_shards_upto (i);
+      ddsi_netsim_stop ();
+      return -1;
+    }
+  }
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
   for (struct config_channel_listelem *chptr = config.channels; chptr; chptr = chptr->next)
   {
@@ -1359,7 +1409,8 @@ int rtps_start (void)
       if (xeventq_start (chptr->evq, chptr->name) < 0)
       {
         stop_all_xeventq_upto (chptr);
-        xeventq_stop (gv.xevents);
+        stop_xevents_shards_upto (gv.n_xevents_shards);
+        ddsi_netsim_stop ();
         return -1;
       }
     }
@@ -1371,7 +1422,8 @@ int rtps_start (void)
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
     stop_all_xeventq_upto (NULL);
 #endif
-    xeventq_stop (gv.xevents);
+    stop_xevents_shards_upto (gv.n_xevents_shards);
+    ddsi_netsim_stop ();
     return -1;
   }
   if (gv.listener)
@@ -1382,6 +1434,7 @@ int rtps_start (void)
   {
     gv.debmon = new_debug_monitor (config.monitor_port);
   }
+  nn_flightrec_start ();
   return 0;
 }
 
@@ -1425,7 +1478,7 @@ void rtps_stop (void)
     ddsi_listener_free(gv.listener);
   }
 
-  xeventq_stop (gv.xevents);
+  stop_xevents_shards_upto (gv.n_xevents_shards);
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
   for (chptr = config.channels; chptr; chptr = chptr->next)
   {
@@ -1558,13 +1611,17 @@ void rtps_fini (void)
   nn_dqueue_free (gv.user_dqueue);
 #endif
 
-  xeventq_free (gv.xevents);
+  for (uint32_t i = 0; i < gv.n_xevents_shards; i++)
+    xeventq_free (gv.xevents_shards[i]);
+  ddsrt_free (gv.xevents_shards);
+  gv.xevents = NULL;
 
   if (config.xpack_send_async)
   {
     nn_xpack_sendq_stop();
     nn_xpack_sendq_fini();
   }
+  ddsi_netsim_stop ();
 
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
   chptr = config.channels;
@@ -1627,6 +1684,11 @@ void rtps_fini (void)
 
   ephash_free (gv.guid_hash);
   gv.guid_hash = NULL;
+  nn_xqos_intern_free (gv.xqos_intern);
+  gv.xqos_intern = NULL;
+  nn_lat_stages_fini ();
+  nn_flightrec_fini ();
+  ddsi_netsim_fini ();
   deleted_participants_admin_fini ();
   lease_management_term ();
   ddsrt_mutex_destroy (&gv.participant_set_lock);
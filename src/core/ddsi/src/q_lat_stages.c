@@ -0,0 +1,149 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_lat_stages.h"
+
+/* Topics come and go rarely and lookups only happen when creating readers and
+   writers, so a list will do */
+static struct {
+  ddsrt_mutex_t lock;
+  struct nn_lat_stages *list;
+} lat_stages;
+
+extern inline void nn_lat_stages_add (struct nn_lat_stages *st, enum nn_lat_stage stage, int64_t t0, int64_t t1);
+
+void nn_lat_stages_init (void)
+{
+  ddsrt_mutex_init (&lat_stages.lock);
+  lat_stages.list = NULL;
+}
+
+void nn_lat_stages_fini (void)
+{
+  while (lat_stages.list)
+  {
+    struct nn_lat_stages *st = lat_stages.list;
+    lat_stages.list = st->next;
+    ddsrt_free (st->topic_name);
+    ddsrt_free (st);
+  }
+  ddsrt_mutex_destroy (&lat_stages.lock);
+}
+
+struct nn_lat_stages *nn_lat_stages_lookup (const char *topic_name)
+{
+  struct nn_lat_stages *st;
+  if (!config.meas_latency_stages || topic_name == NULL)
+    return NULL;
+  ddsrt_mutex_lock (&lat_stages.lock);
+  for (st = lat_stages.list; st; st = st->next)
+    if (strcmp (st->topic_name, topic_name) == 0)
+      break;
+  if (st == NULL)
+  {
+    st = ddsrt_malloc (sizeof (*st));
+    memset (st, 0, sizeof (*st));
+    st->topic_name = ddsrt_strdup (topic_name);
+    st->next = lat_stages.list;
+    lat_stages.list = st;
+  }
+  ddsrt_mutex_unlock (&lat_stages.lock);
+  return st;
+}
+
+void nn_lat_stages_enum (void (*f) (const struct nn_lat_stages *st, void *arg), void *arg)
+{
+  /* entries are never removed before shutdown, so holding the lock
+     while calling f only protects the list */
+  ddsrt_mutex_lock (&lat_stages.lock);
+  for (const struct nn_lat_stages *st = lat_stages.list; st; st = st->next)
+    f (st, arg);
+  ddsrt_mutex_unlock (&lat_stages.lock);
+}
+
+const char *nn_lat_stage_name (enum nn_lat_stage stage)
+{
+  switch (stage)
+  {
+    case NN_LAT_STAGE_WR_SERIALIZE: return "wr_serialize";
+    case NN_LAT_STAGE_WR_TRANSMIT: return "wr_transmit";
+    case NN_LAT_STAGE_RD_RECV_ENQUEUE: return "rd_recv_enqueue";
+    case NN_LAT_STAGE_RD_DQUEUE: return "rd_dqueue";
+    case NN_LAT_STAGE_RD_RECV_STORE: return "rd_recv_store";
+    case NN_LAT_STAGE_RD_STORE_READ: return "rd_store_read";
+    case NN_LAT_STAGE_END_TO_END: return "end_to_end";
+  }
+  return "?";
+}
+
+static uint32_t bucket_index (uint64_t v)
+{
+  uint32_t msb = 0, idx;
+  if (v < (1u << NN_LAT_HIST_SUBBITS))
+    return (uint32_t) v;
+  for (uint64_t x = v; x > 1; x >>= 1)
+    msb++;
+  if (msb >= NN_LAT_HIST_MAXBITS)
+    return NN_LAT_HIST_NBUCKETS - 1;
+  /* top SUBBITS+1 bits of v: leading 1 followed by the linear sub-bucket */
+  idx = (uint32_t) (v >> (msb - NN_LAT_HIST_SUBBITS));
+  return ((msb - NN_LAT_HIST_SUBBITS + 1) << NN_LAT_HIST_SUBBITS) + idx - (1u << NN_LAT_HIST_SUBBITS);
+}
+
+static int64_t bucket_upper_bound (uint32_t idx)
+{
+  uint32_t e, m;
+  if (idx < (1u << NN_LAT_HIST_SUBBITS))
+    return (int64_t) idx;
+  e = (idx >> NN_LAT_HIST_SUBBITS) - 1;
+  m = (idx & ((1u << NN_LAT_HIST_SUBBITS) - 1)) + (1u << NN_LAT_HIST_SUBBITS);
+  return (int64_t) ((((uint64_t) m + 1) << e) - 1);
+}
+
+void nn_lat_hist_add (struct nn_lat_hist *h, int64_t dt)
+{
+  /* the wall clock may step backwards, treat it as 0 rather than dropping it */
+  const uint32_t idx = bucket_index (dt < 0 ? 0 : (uint64_t) dt);
+  assert (idx < NN_LAT_HIST_NBUCKETS);
+  ddsrt_atomic_inc32 (&h->bucket[idx]);
+  ddsrt_atomic_inc32 (&h->count);
+}
+
+int64_t nn_lat_hist_quantile (const struct nn_lat_hist *h, double q)
+{
+  /* count and buckets are updated independently, so use the sum of the
+     buckets to get a consistent answer */
+  uint64_t n = 0, acc = 0, target;
+  uint32_t i;
+  for (i = 0; i < NN_LAT_HIST_NBUCKETS; i++)
+    n += ddsrt_atomic_ld32 (&h->bucket[i]);
+  if (n == 0)
+    return 0;
+  target = (uint64_t) (q * (double) n + 0.5);
+  if (target == 0)
+    target = 1;
+  else if (target > n)
+    target = n;
+  for (i = 0; i < NN_LAT_HIST_NBUCKETS; i++)
+  {
+    acc += ddsrt_atomic_ld32 (&h->bucket[i]);
+    if (acc >= target)
+      break;
+  }
+  return bucket_upper_bound (i < NN_LAT_HIST_NBUCKETS ? i : NN_LAT_HIST_NBUCKETS - 1);
+}
@@ -15,6 +15,7 @@
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/atomics.h"
 
 #include "dds/ddsrt/fibheap.h"
 
@@ -38,6 +39,8 @@
 #include "dds/ddsi/q_transmit.h"
 #include "dds/ddsi/q_lease.h"
 #include "dds/ddsi/q_gc.h"
+#include "dds/ddsi/ddsi_probes.h"
+#include "dds/ddsi/q_flightrec.h"
 
 /* This is absolute bottom for signed integers, where -x = x and yet x
    != 0 -- and note that it had better be 2's complement machine! */
@@ -46,7 +49,11 @@
 struct lease {
   ddsrt_fibheap_node_t heapnode;
   nn_etime_t tsched;  /* access guarded by leaseheap_lock */
+#if DDSRT_HAVE_ATOMIC64
+  ddsrt_atomic_uint64_t tend; /* atomically updated, see lease_renew */
+#else
   nn_etime_t tend;    /* access guarded by lock_lease/unlock_lease */
+#endif
   dds_duration_t tdur;      /* constant (renew depends on it) */
   struct entity_common *entity; /* constant */
 };
@@ -69,22 +76,55 @@ static int compare_lease_tsched (const void *va, const void *vb)
 
 void lease_management_init (void)
 {
-  int i;
   ddsrt_mutex_init (&gv.leaseheap_lock);
-  for (i = 0; i < N_LEASE_LOCKS; i++)
+#if ! DDSRT_HAVE_ATOMIC64
+  for (int i = 0; i < N_LEASE_LOCKS; i++)
     ddsrt_mutex_init (&gv.lease_locks[i]);
+#endif
   ddsrt_fibheap_init (&lease_fhdef, &gv.leaseheap);
 }
 
 void lease_management_term (void)
 {
-  int i;
   assert (ddsrt_fibheap_min (&lease_fhdef, &gv.leaseheap) == NULL);
-  for (i = 0; i < N_LEASE_LOCKS; i++)
+#if ! DDSRT_HAVE_ATOMIC64
+  for (int i = 0; i < N_LEASE_LOCKS; i++)
     ddsrt_mutex_destroy (&gv.lease_locks[i]);
+#endif
   ddsrt_mutex_destroy (&gv.leaseheap_lock);
 }
 
+/* Lease renewal happens for nearly every incoming message, and so where
+   64-bit atomics are available the expiry time is simply an atomic
+   variable, making renewing a lease a load and a CAS without touching
+   any lock.  The heap is only updated lazily: when the lease thread finds
+   a lease with a scheduled time in the past, it checks the actual expiry
+   time and reschedules it if it was renewed in the meantime. */
+#if DDSRT_HAVE_ATOMIC64
+static nn_etime_t lease_get_tend (const struct lease *l)
+{
+  nn_etime_t t;
+  t.v = (int64_t) ddsrt_atomic_ld64 (&l->tend);
+  return t;
+}
+
+static void lease_set_tend (struct lease *l, nn_etime_t t)
+{
+  ddsrt_atomic_st64 (&l->tend, (uint64_t) t.v);
+}
+
+static bool lease_renew_tend (struct lease *l, nn_etime_t tnowE, nn_etime_t tend_new)
+{
+  uint64_t tend;
+  do {
+    tend = ddsrt_atomic_ld64 (&l->tend);
+    /* do not touch tend if moving backward or if already expired */
+    if (tend_new.v <= (int64_t) tend || tnowE.v >= (int64_t) tend)
+      return false;
+  } while (!ddsrt_atomic_cas64 (&l->tend, tend, (uint64_t) tend_new.v));
+  return true;
+}
+#else
 static ddsrt_mutex_t *lock_lease_addr (struct lease const * const l)
 {
   uint32_t u = (uint16_t) ((uintptr_t) l >> 3);
@@ -103,6 +143,39 @@ static void unlock_lease (const struct lease *l)
   ddsrt_mutex_unlock (lock_lease_addr (l));
 }
 
+static nn_etime_t lease_get_tend (const struct lease *l)
+{
+  nn_etime_t t;
+  lock_lease (l);
+  t = l->tend;
+  unlock_lease (l);
+  return t;
+}
+
+static void lease_set_tend (struct lease *l, nn_etime_t t)
+{
+  lock_lease (l);
+  l->tend = t;
+  unlock_lease (l);
+}
+
+static bool lease_renew_tend (struct lease *l, nn_etime_t tnowE, nn_etime_t tend_new)
+{
+  bool did_update;
+  lock_lease (l);
+  /* do not touch tend if moving backward or if already expired */
+  if (tend_new.v <= l->tend.v || tnowE.v >= l->tend.v)
+    did_update = false;
+  else
+  {
+    l->tend = tend_new;
+    did_update = true;
+  }
+  unlock_lease (l);
+  return did_update;
+}
+#endif
+
 struct lease *lease_new (nn_etime_t texpire, dds_duration_t tdur, struct entity_common *e)
 {
   struct lease *l;
@@ -110,7 +183,11 @@ struct lease *lease_new (nn_etime_t texpire, dds_duration_t tdur, struct entity_
     return NULL;
   DDS_TRACE("lease_new(tdur %"PRId64" guid "PGUIDFMT") @ %p\n", tdur, PGUID (e->guid), (void *) l);
   l->tdur = tdur;
+#if DDSRT_HAVE_ATOMIC64
+  ddsrt_atomic_st64 (&l->tend, (uint64_t) texpire.v);
+#else
   l->tend = texpire;
+#endif
   l->tsched.v = TSCHED_NOT_ON_HEAP;
   l->entity = e;
   return l;
@@ -120,14 +197,13 @@ void lease_register (struct lease *l)
 {
   DDS_TRACE("lease_register(l %p guid "PGUIDFMT")\n", (void *) l, PGUID (l->entity->guid));
   ddsrt_mutex_lock (&gv.leaseheap_lock);
-  lock_lease (l);
   assert (l->tsched.v == TSCHED_NOT_ON_HEAP);
-  if (l->tend.v != T_NEVER)
+  const nn_etime_t tend = lease_get_tend (l);
+  if (tend.v != T_NEVER)
   {
-    l->tsched = l->tend;
+    l->tsched = tend;
     ddsrt_fibheap_insert (&lease_fhdef, &gv.leaseheap, l);
   }
-  unlock_lease (l);
   ddsrt_mutex_unlock (&gv.leaseheap_lock);
 
   /* check_and_handle_lease_expiration runs on GC thread and the only way to be sure that it wakes up in time is by forcing re-evaluation (strictly speaking only needed if this is the first lease to expire, but this operation is quite rare anyway) */
@@ -150,19 +226,9 @@ void lease_free (struct lease *l)
 void lease_renew (struct lease *l, nn_etime_t tnowE)
 {
   nn_etime_t tend_new = add_duration_to_etime (tnowE, l->tdur);
-  int did_update;
-  lock_lease (l);
-  /* do not touch tend if moving forward or if already expired */
-  if (tend_new.v <= l->tend.v || tnowE.v >= l->tend.v)
-    did_update = 0;
-  else
-  {
-    l->tend = tend_new;
-    did_update = 1;
-  }
-  unlock_lease (l);
+  const bool did_update = lease_renew_tend (l, tnowE, tend_new);
 
-  if (did_update && (dds_get_log_mask() & DDS_LC_TRACE))
+  if (did_update && DDS_LOG_ENABLED (DDS_LC_TRACE))
   {
     int32_t tsec, tusec;
     DDS_TRACE(" L(");
@@ -179,25 +245,24 @@ void lease_set_expiry (struct lease *l, nn_etime_t when)
 {
   bool trigger = false;
   assert (when.v >= 0);
+  nn_flightrec_record (NN_FR_LEASE_SET, &l->entity->guid, NULL, when.v, 0, 0);
   ddsrt_mutex_lock (&gv.leaseheap_lock);
-  lock_lease (l);
-  l->tend = when;
-  if (l->tend.v < l->tsched.v)
+  lease_set_tend (l, when);
+  if (when.v < l->tsched.v)
   {
     /* moved forward and currently scheduled (by virtue of
        TSCHED_NOT_ON_HEAP == INT64_MIN) */
-    l->tsched = l->tend;
+    l->tsched = when;
     ddsrt_fibheap_decrease_key (&lease_fhdef, &gv.leaseheap, l);
     trigger = true;
   }
-  else if (l->tsched.v == TSCHED_NOT_ON_HEAP && l->tend.v < T_NEVER)
+  else if (l->tsched.v == TSCHED_NOT_ON_HEAP && when.v < T_NEVER)
   {
     /* not currently scheduled, with a finite new expiry time */
-    l->tsched = l->tend;
+    l->tsched = when;
     ddsrt_fibheap_insert (&lease_fhdef, &gv.leaseheap, l);
     trigger = true;
   }
-  unlock_lease (l);
   ddsrt_mutex_unlock (&gv.leaseheap_lock);
 
   /* see lease_register() */
@@ -218,22 +283,22 @@ int64_t check_and_handle_lease_expiration (nn_etime_t tnowE)
     assert (l->tsched.v != TSCHED_NOT_ON_HEAP);
     ddsrt_fibheap_extract_min (&lease_fhdef, &gv.leaseheap);
 
-    lock_lease (l);
-    if (tnowE.v < l->tend.v)
+    const nn_etime_t tend = lease_get_tend (l);
+    if (tnowE.v < tend.v)
     {
-      if (l->tend.v == T_NEVER) {
+      if (tend.v == T_NEVER) {
         /* don't reinsert if it won't expire */
         l->tsched.v = TSCHED_NOT_ON_HEAP;
-        unlock_lease (l);
       } else {
-        l->tsched = l->tend;
-        unlock_lease (l);
+        l->tsched = tend;
         ddsrt_fibheap_insert (&lease_fhdef, &gv.leaseheap, l);
       }
       continue;
     }
 
-    DDS_LOG(DDS_LC_DISCOVERY, "lease expired: l %p guid "PGUIDFMT" tend %"PRId64" < now %"PRId64"\n", (void *) l, PGUID (g), l->tend.v, tnowE.v);
+    DDS_LOG(DDS_LC_DISCOVERY, "lease expired: l %p guid "PGUIDFMT" tend %"PRId64" < now %"PRId64"\n", (void *) l, PGUID (g), tend.v, tnowE.v);
+    DDSI_PROBE (lease_expired, DDSI_PROBE_GUID (&g));
+    nn_flightrec_record (NN_FR_LEASE_EXPIRED, &g, NULL, 0, 0, 0);
 
     /* If the proxy participant is relying on another participant for
        writing its discovery data (on the privileged participant,
@@ -268,15 +333,13 @@ int64_t check_and_handle_lease_expiration (nn_etime_t tnowE)
       {
         DDS_LOG(DDS_LC_DISCOVERY, "but postponing because privileged pp "PGUIDFMT" is still live\n",
                 PGUID (proxypp->privileged_pp_guid));
-        l->tsched = l->tend = add_duration_to_etime (tnowE, 200 * T_MILLISECOND);
-        unlock_lease (l);
+        l->tsched = add_duration_to_etime (tnowE, 200 * T_MILLISECOND);
+        lease_set_tend (l, l->tsched);
         ddsrt_fibheap_insert (&lease_fhdef, &gv.leaseheap, l);
         continue;
       }
     }
 
-    unlock_lease (l);
-
     l->tsched.v = TSCHED_NOT_ON_HEAP;
     ddsrt_mutex_unlock (&gv.leaseheap_lock);
 
@@ -19,6 +19,8 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/string.h"
 #include "dds/ddsrt/static_assert.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/hopscotch.h"
 
 #include "dds/ddsi/q_log.h"
 
@@ -2539,6 +2541,170 @@ dds_qos_t * nn_xqos_dup (const dds_qos_t *src)
   return dst;
 }
 
+/* Interned QoS objects: large systems tend to have many remote endpoints
+   sharing only a handful of distinct QoS settings, so rather than giving
+   each proxy endpoint a private copy, they all reference a shared,
+   immutable and refcounted one.  Equality is nn_xqos_delta() on all
+   policies, the hash is only a cheap approximation of it and collisions
+   are resolved by chaining. */
+
+struct nn_xqos_interned {
+  dds_qos_t xqos; /* must be first: interned pointers are converted back */
+  uint32_t refc;
+  struct nn_xqos_interned *next; /* next with the same hash */
+};
+
+struct nn_xqos_intern_bucket {
+  uint32_t hash;
+  struct nn_xqos_interned *first;
+};
+
+struct nn_xqos_intern {
+  ddsrt_mutex_t lock;
+  struct ddsrt_hh *buckets;
+  uint32_t count; /* number of distinct interned objects */
+};
+
+static uint32_t xqos_intern_hash_bytes (uint32_t h, const void *vbuf, size_t sz)
+{
+  /* FNV-1a */
+  const unsigned char *buf = vbuf;
+  for (size_t i = 0; i < sz; i++)
+    h = (h ^ buf[i]) * 16777619u;
+  return h;
+}
+
+static uint32_t xqos_intern_hash (const dds_qos_t *xqos)
+{
+  uint32_t h = 2166136261u;
+  h = xqos_intern_hash_bytes (h, &xqos->present, sizeof (xqos->present));
+  if (xqos->present & QP_TOPIC_NAME)
+    h = xqos_intern_hash_bytes (h, xqos->topic_name, strlen (xqos->topic_name));
+  if (xqos->present & QP_TYPE_NAME)
+    h = xqos_intern_hash_bytes (h, xqos->type_name, strlen (xqos->type_name));
+  if (xqos->present & QP_RELIABILITY)
+    h = xqos_intern_hash_bytes (h, &xqos->reliability.kind, sizeof (xqos->reliability.kind));
+  if (xqos->present & QP_DURABILITY)
+    h = xqos_intern_hash_bytes (h, &xqos->durability.kind, sizeof (xqos->durability.kind));
+  if (xqos->present & QP_USER_DATA)
+    h = xqos_intern_hash_bytes (h, xqos->user_data.value, xqos->user_data.length);
+  return h;
+}
+
+static uint32_t xqos_intern_bucket_hash (const void *vb)
+{
+  const struct nn_xqos_intern_bucket *b = vb;
+  return b->hash;
+}
+
+static int xqos_intern_bucket_equal (const void *va, const void *vb)
+{
+  const struct nn_xqos_intern_bucket *a = va;
+  const struct nn_xqos_intern_bucket *b = vb;
+  return a->hash == b->hash;
+}
+
+struct nn_xqos_intern *nn_xqos_intern_new (void)
+{
+  struct nn_xqos_intern *xi = ddsrt_malloc (sizeof (*xi));
+  ddsrt_mutex_init (&xi->lock);
+  xi->buckets = ddsrt_hh_new (32, xqos_intern_bucket_hash, xqos_intern_bucket_equal);
+  xi->count = 0;
+  return xi;
+}
+
+static void xqos_intern_free_bucket (void *vb, void *varg)
+{
+  struct nn_xqos_intern_bucket *b = vb;
+  (void) varg;
+  while (b->first)
+  {
+    struct nn_xqos_interned *n = b->first;
+    b->first = n->next;
+    nn_xqos_fini (&n->xqos);
+    ddsrt_free (n);
+  }
+  ddsrt_free (b);
+}
+
+void nn_xqos_intern_free (struct nn_xqos_intern *xi)
+{
+  ddsrt_hh_enum (xi->buckets, xqos_intern_free_bucket, NULL);
+  ddsrt_hh_free (xi->buckets);
+  ddsrt_mutex_destroy (&xi->lock);
+  ddsrt_free (xi);
+}
+
+const dds_qos_t *nn_xqos_intern (struct nn_xqos_intern *xi, const dds_qos_t *xqos)
+{
+  struct nn_xqos_intern_bucket template, *b;
+  struct nn_xqos_interned *n;
+  template.hash = xqos_intern_hash (xqos);
+  ddsrt_mutex_lock (&xi->lock);
+  if ((b = ddsrt_hh_lookup (xi->buckets, &template)) == NULL)
+  {
+    b = ddsrt_malloc (sizeof (*b));
+    b->hash = template.hash;
+    b->first = NULL;
+    ddsrt_hh_add (xi->buckets, b);
+  }
+  for (n = b->first; n; n = n->next)
+    if (n->xqos.present == xqos->present && nn_xqos_delta (&n->xqos, xqos, ~(uint64_t)0) == 0)
+      break;
+  if (n != NULL)
+    n->refc++;
+  else
+  {
+    n = ddsrt_malloc (sizeof (*n));
+    nn_xqos_copy (&n->xqos, xqos);
+    assert (n->xqos.aliased == 0);
+    n->refc = 1;
+    n->next = b->first;
+    b->first = n;
+    xi->count++;
+  }
+  ddsrt_mutex_unlock (&xi->lock);
+  return &n->xqos;
+}
+
+void nn_xqos_unintern (struct nn_xqos_intern *xi, const dds_qos_t *xqos)
+{
+  struct nn_xqos_interned *n = (struct nn_xqos_interned *) xqos;
+  struct nn_xqos_intern_bucket template, *b;
+  ddsrt_mutex_lock (&xi->lock);
+  assert (n->refc > 0);
+  if (--n->refc > 0)
+  {
+    ddsrt_mutex_unlock (&xi->lock);
+    return;
+  }
+  template.hash = xqos_intern_hash (xqos);
+  b = ddsrt_hh_lookup (xi->buckets, &template);
+  assert (b != NULL);
+  struct nn_xqos_interned **pn = &b->first;
+  while (*pn != n)
+    pn = &(*pn)->next;
+  *pn = n->next;
+  xi->count--;
+  if (b->first == NULL)
+  {
+    ddsrt_hh_remove (xi->buckets, b);
+    ddsrt_free (b);
+  }
+  ddsrt_mutex_unlock (&xi->lock);
+  nn_xqos_fini (&n->xqos);
+  ddsrt_free (n);
+}
+
+uint32_t nn_xqos_intern_count (struct nn_xqos_intern *xi)
+{
+  uint32_t count;
+  ddsrt_mutex_lock (&xi->lock);
+  count = xi->count;
+  ddsrt_mutex_unlock (&xi->lock);
+  return count;
+}
+
 static int partition_is_default (const dds_partition_qospolicy_t *a)
 {
   uint32_t i;
@@ -214,7 +214,7 @@
              deliver-to-group (pwr, sc)
          else
            for (m in out-of-sync-reader-matches)
-             sample' = nn_reorder_rsample_dup (rmsg, sample)
+             sample' = nn_reorder_rsample_dup_first (rmsg, sample)
              if nn_reorder_rsample (&sc, m->reorder, sample, &refcount_adjust)
                 == DELIVER
                deliver-to-reader (m->reader, sc)
@@ -1552,7 +1552,7 @@ int nn_defrag_nackmap (struct nn_defrag *defrag, seqno_t seq, uint32_t maxfragnu
    instance, a "secondary" reorder admin, but those can't re-use
    memory like the proxy-writer's can, because there can be any number
    of them.  Before inserting in one of these, the sample must first
-   be replicated using reorder_rsample_dup(), which fortunately is an
+   be replicated using reorder_rsample_dup_first(), which fortunately is an
    extremely cheap operation.
 
    A sample either goes to the primary one (which may store it, reject
@@ -1726,11 +1726,16 @@ static int reorder_try_append_and_discard (struct nn_reorder *reorder, struct nn
   }
 }
 
-struct nn_rsample *nn_reorder_rsample_dup (struct nn_rmsg *rmsg, struct nn_rsample *rsampleiv)
+struct nn_rsample *nn_reorder_rsample_dup_first (struct nn_rmsg *rmsg, struct nn_rsample *rsampleiv)
 {
-  /* Duplicates the rsampleiv without updating any reference counts:
-     that is left to the caller, as they do not need to be updated if
-     the duplicate ultimately doesn't get used.
+  /* Duplicates the first sample in rsampleiv without updating any
+     reference counts: that is left to the caller, as they do not need
+     to be updated if the duplicate ultimately doesn't get used.
+
+     The rsampleiv need not be a singleton anymore: if it was accepted
+     by the proxy writer's reorder admin, the samples that follow it may
+     have been appended to it.  Its first sample is always the one that
+     was just received.
 
      The rmsg is the one to allocate from, and must be the one
      currently being processed (one can only allocate memory from an
@@ -1738,7 +1743,6 @@ struct nn_rsample *nn_reorder_rsample_dup (struct nn_rmsg *rmsg, struct nn_rsamp
      rsampleiv. */
   struct nn_rsample *rsampleiv_new;
   struct nn_rsample_chain_elem *sce;
-  assert (rsample_is_singleton (&rsampleiv->u.reorder));
 #ifndef NDEBUG
   {
     struct nn_rdata *d = rsampleiv->u.reorder.sc.first->fragchain;
@@ -1755,6 +1759,8 @@ struct nn_rsample *nn_reorder_rsample_dup (struct nn_rmsg *rmsg, struct nn_rsamp
   sce->next = NULL;
   sce->sampleinfo = rsampleiv->u.reorder.sc.first->sampleinfo;
   *rsampleiv_new = *rsampleiv;
+  rsampleiv_new->u.reorder.maxp1 = rsampleiv_new->u.reorder.min + 1;
+  rsampleiv_new->u.reorder.n_samples = 1;
   rsampleiv_new->u.reorder.sc.first = rsampleiv_new->u.reorder.sc.last = sce;
   return rsampleiv_new;
 }
@@ -2541,12 +2547,23 @@ static int nn_dqueue_enqueue_locked (struct nn_dqueue *q, struct nn_rsample_chai
   return must_signal;
 }
 
+static void nn_dqueue_stamp_chain (struct nn_rsample_chain *sc)
+{
+  /* gaps have no sampleinfo; only done when measuring latency stages */
+  const nn_wctime_t tnow = now ();
+  for (struct nn_rsample_chain_elem *sce = sc->first; sce; sce = sce->next)
+    if (sce->sampleinfo)
+      sce->sampleinfo->enqueue_timestamp = tnow;
+}
+
 bool nn_dqueue_enqueue_deferred_wakeup (struct nn_dqueue *q, struct nn_rsample_chain *sc, nn_reorder_result_t rres)
 {
   bool signal;
   assert (rres > 0);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (config.meas_latency_stages)
+    nn_dqueue_stamp_chain (sc);
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
   signal = nn_dqueue_enqueue_locked (q, sc);
@@ -2566,6 +2583,8 @@ void nn_dqueue_enqueue (struct nn_dqueue *q, struct nn_rsample_chain *sc, nn_reo
   assert (rres > 0);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (config.meas_latency_stages)
+    nn_dqueue_stamp_chain (sc);
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
   if (nn_dqueue_enqueue_locked (q, sc))
@@ -2615,6 +2634,8 @@ void nn_dqueue_enqueue1 (struct nn_dqueue *q, const nn_guid_t *rdguid, struct nn
   assert (rdguid != NULL);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (config.meas_latency_stages)
+    nn_dqueue_stamp_chain (sc);
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, 1 + (uint32_t) rres);
   if (nn_dqueue_enqueue_bubble_locked (q, b))
@@ -2636,6 +2657,14 @@ int nn_dqueue_is_full (struct nn_dqueue *q)
   return (count >= q->max_samples);
 }
 
+void nn_dqueue_get_state (struct nn_dqueue *q, const char **name, uint32_t *nof_samples, uint32_t *max_samples)
+{
+  /* Same reasoning as in nn_dqueue_is_full: a slightly stale count is fine */
+  *name = q->name;
+  *nof_samples = ddsrt_atomic_ld32 (&q->nof_samples);
+  *max_samples = q->max_samples;
+}
+
 void nn_dqueue_wait_until_empty_if_full (struct nn_dqueue *q)
 {
   const uint32_t count = ddsrt_atomic_ld32 (&q->nof_samples);
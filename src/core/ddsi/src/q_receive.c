@@ -32,6 +32,7 @@
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/q_bswap.h"
 #include "dds/ddsi/q_lat_estim.h"
+#include "dds/ddsi/q_lat_stages.h"
 #include "dds/ddsi/q_bitset.h"
 #include "dds/ddsi/q_xevent.h"
 #include "dds/ddsi/q_addrset.h"
@@ -52,6 +53,9 @@
 #include "dds/ddsi/ddsi_mcgroup.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_serdata_default.h" /* FIXME: get rid of this */
+#include "dds/ddsi/ddsi_probes.h"
+#include "dds/ddsi/ddsi_netsim.h"
+#include "dds/ddsi/q_flightrec.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -544,6 +548,7 @@ static int add_Gap (struct nn_xmsg *msg, struct writer *wr, struct proxy_reader
   gap->gapList.numbits = numbits;
   memcpy (gap->gapList.bits, bits, NN_SEQUENCE_NUMBER_SET_BITS_SIZE (numbits));
   nn_xmsg_submsg_setnext (msg, sm_marker);
+  nn_flightrec_record (NN_FR_GAP_SENT, &wr->e.guid, &prd->e.guid, start, base, numbits);
   return 0;
 }
 
@@ -693,6 +698,9 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
     return 1;
   }
 
+  DDSI_PROBE (acknack, DDSI_PROBE_GUID (&dst), DDSI_PROBE_GUID (&src), seqbase, msg->readerSNState.numbits);
+  nn_flightrec_record (NN_FR_ACKNACK_RECV, &src, &dst, seqbase, *countp, msg->readerSNState.numbits);
+
   ddsrt_mutex_lock (&wr->e.lock);
   if ((rn = ddsrt_avl_lookup (&wr_readers_treedef, &wr->readers, &src)) == NULL)
   {
@@ -729,7 +737,7 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
   {
     nn_wctime_t tstamp_now = now ();
     nn_lat_estim_update (&rn->hb_to_ack_latency, tstamp_now.v - timestamp.v);
-    if ((dds_get_log_mask() & DDS_LC_TRACE) && tstamp_now.v > rn->hb_to_ack_latency_tlastlog.v + 10 * T_SECOND)
+    if (DDS_LOG_ENABLED (DDS_LC_TRACE) && tstamp_now.v > rn->hb_to_ack_latency_tlastlog.v + 10 * T_SECOND)
     {
       nn_lat_estim_log (DDS_LC_TRACE, NULL, &rn->hb_to_ack_latency);
       rn->hb_to_ack_latency_tlastlog = tstamp_now;
@@ -882,8 +890,11 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
             enqueued = (enqueue_sample_wrlock_held (wr, seq, sample.plist, sample.serdata, NULL, 0) >= 0);
             if (enqueued)
             {
+              DDSI_PROBE (rexmit_queued, DDSI_PROBE_GUID (&wr->e.guid), 0, 0, seq, ddsi_serdata_size (sample.serdata));
+              nn_flightrec_record (NN_FR_REXMIT, &wr->e.guid, NULL, seq, 0, ddsi_serdata_size (sample.serdata));
               max_seq_in_reply = seqbase + i;
               msgs_sent++;
+              wr->rexmit_bytes += ddsi_serdata_size (sample.serdata);
               sample.last_rexmit_ts = tstamp;
             }
           }
@@ -899,8 +910,11 @@ static int handle_AckNack (struct receiver_state *rst, nn_etime_t tnow, const Ac
           enqueued = (enqueue_sample_wrlock_held (wr, seq, sample.plist, sample.serdata, prd, 0) >= 0);
           if (enqueued)
           {
+            DDSI_PROBE (rexmit_queued, DDSI_PROBE_GUID (&wr->e.guid), DDSI_PROBE_GUID (&src), seq, ddsi_serdata_size (sample.serdata));
+            nn_flightrec_record (NN_FR_REXMIT, &wr->e.guid, &src, seq, 0, ddsi_serdata_size (sample.serdata));
             max_seq_in_reply = seqbase + i;
             msgs_sent++;
+            wr->rexmit_bytes += ddsi_serdata_size (sample.serdata);
             sample.rexmit_count++;
           }
         }
@@ -1154,6 +1168,8 @@ static int handle_Heartbeat (struct receiver_state *rst, nn_etime_t tnow, struct
   lease_renew (ddsrt_atomic_ldvoidp (&pwr->c.proxypp->lease), tnow);
 
   DDS_TRACE(PGUIDFMT" -> "PGUIDFMT":", PGUID (src), PGUID (dst));
+  DDSI_PROBE (heartbeat, DDSI_PROBE_GUID (&src), DDSI_PROBE_GUID (&dst), firstseq, lastseq);
+  nn_flightrec_record (NN_FR_HEARTBEAT_RECV, &src, &dst, firstseq, lastseq, (uint32_t) msg->count);
 
   ddsrt_mutex_lock (&pwr->e.lock);
 
@@ -1534,7 +1550,7 @@ static int handle_InfoTS (const InfoTS_t *msg, nn_wctime_t *timestamp)
   else
   {
     *timestamp = nn_wctime_from_ddsi_time (msg->time);
-    if (dds_get_log_mask() & DDS_LC_TRACE)
+    if (DDS_LOG_ENABLED (DDS_LC_TRACE))
       DDS_TRACE("%d.%09d", (int) (timestamp->v / 1000000000), (int) (timestamp->v % 1000000000));
   }
   DDS_TRACE(")");
@@ -1637,6 +1653,8 @@ static int handle_Gap (struct receiver_state *rst, nn_etime_t tnow, struct nn_rm
   gapstart = fromSN (msg->gapStart);
   listbase = fromSN (msg->gapList.bitmap_base);
   DDS_TRACE("GAP(%"PRId64"..%"PRId64"/%"PRIu32" ", gapstart, listbase, msg->gapList.numbits);
+  ddsrt_atomic_inc32 (&gv.stats.gaps_received);
+  nn_flightrec_record (NN_FR_GAP_RECV, &src, &dst, gapstart, listbase, msg->gapList.numbits);
 
   /* There is no _good_ reason for a writer to start the bitmap with a
      1 bit, but check for it just in case, to reduce the number of
@@ -1859,6 +1877,13 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
     return 0;
   }
 
+  if (pwr->lat_stages && sampleinfo->enqueue_timestamp.v)
+  {
+    const nn_wctime_t tnow = now ();
+    nn_lat_stages_add (pwr->lat_stages, NN_LAT_STAGE_RD_RECV_ENQUEUE, sampleinfo->reception_timestamp.v, sampleinfo->enqueue_timestamp.v);
+    nn_lat_stages_add (pwr->lat_stages, NN_LAT_STAGE_RD_DQUEUE, sampleinfo->enqueue_timestamp.v, tnow.v);
+  }
+
   /* NOTE: pwr->e.lock need not be held for correct processing (though
      it may be useful to hold it for maintaining order all the way to
      v_groupWrite): guid is constant, set_vmsg_header() explains about
@@ -1975,6 +2000,7 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
             if (pwr_locked) ddsrt_mutex_lock (&pwr->e.lock);
             goto retry;
           }
+          DDSI_PROBE (deliver, DDSI_PROBE_GUID (&pwr->e.guid), DDSI_PROBE_GUID (&rdary[i]->e.guid), sampleinfo->seq);
         }
         ddsrt_mutex_unlock (&pwr->rdary.rdary_lock);
       }
@@ -1998,7 +2024,8 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
           if ((rd = ephash_lookup_reader_guid (&m->rd_guid)) != NULL && m->in_sync == PRMSS_SYNC)
           {
             DDS_TRACE("reader-via-guid "PGUIDFMT"\n", PGUID (rd->e.guid));
-            (void) (ddsi_plugin.rhc_plugin.rhc_store_fn) (rd->rhc, &pwr_info, payload, tk);
+            if ((ddsi_plugin.rhc_plugin.rhc_store_fn) (rd->rhc, &pwr_info, payload, tk))
+              DDSI_PROBE (deliver, DDSI_PROBE_GUID (&pwr->e.guid), DDSI_PROBE_GUID (&rd->e.guid), sampleinfo->seq);
           }
         }
         if (!pwr_locked) ddsrt_mutex_unlock (&pwr->e.lock);
@@ -2016,8 +2043,12 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
         dds_sleepfor (DDS_MSECS (1));
         if (pwr_locked) ddsrt_mutex_lock (&pwr->e.lock);
       }
+      if (rd)
+        DDSI_PROBE (deliver, DDSI_PROBE_GUID (&pwr->e.guid), DDSI_PROBE_GUID (&rd->e.guid), sampleinfo->seq);
     }
     ddsi_tkmap_instance_unref (tk);
+    if (pwr->lat_stages)
+      nn_lat_stages_add (pwr->lat_stages, NN_LAT_STAGE_RD_RECV_STORE, sampleinfo->reception_timestamp.v, now ().v);
   }
   ddsi_serdata_unref (payload);
  no_payload:
@@ -2146,6 +2177,8 @@ static void handle_regular (struct receiver_state *rst, nn_etime_t tnow, struct
     nn_reorder_result_t rres;
 
     rres = nn_reorder_rsample (&sc, pwr->reorder, rsample, &refc_adjust, 0); // nn_dqueue_is_full (pwr->dqueue));
+    if (rres == NN_REORDER_REJECT)
+      ddsrt_atomic_inc32 (&gv.stats.reorder_rejects);
 
     if (rres == NN_REORDER_ACCEPT && pwr->n_reliable_readers == 0)
     {
@@ -2201,7 +2234,7 @@ static void handle_regular (struct receiver_state *rst, nn_etime_t tnow, struct
         if (wn->in_sync == PRMSS_SYNC)
           continue;
         if (!reuse_rsample_dup)
-          rsample_dup = nn_reorder_rsample_dup (rmsg, rsample);
+          rsample_dup = nn_reorder_rsample_dup_first (rmsg, rsample);
         rres2 = nn_reorder_rsample (&sc, wn->u.not_in_sync.reorder, rsample_dup, &refc_adjust, nn_dqueue_is_full (pwr->dqueue));
         switch (rres2)
         {
@@ -2270,6 +2303,7 @@ static int handle_SPDP (const struct nn_rsample_info *sampleinfo, struct nn_rdat
 static void drop_oversize (struct receiver_state *rst, struct nn_rmsg *rmsg, const Data_DataFrag_common_t *msg, struct nn_rsample_info *sampleinfo)
 {
   struct proxy_writer *pwr = sampleinfo->pwr;
+  ddsrt_atomic_inc32 (&gv.stats.oversize_samples);
   if (pwr == NULL)
   {
     /* No proxy writer means nothing really gets done with, unless it
@@ -2459,6 +2493,8 @@ static void malformed_packet_received_nosubmsg
   ssize_t i;
   size_t pos;
 
+  ddsrt_atomic_inc32 (&gv.stats.malformed_packets);
+
   /* Show beginning of message (as hex dumps) */
   pos = (size_t) snprintf (tmp, sizeof (tmp), "malformed packet received from vendor %u.%u state %s <", vendorid.id[0], vendorid.id[1], state);
   for (i = 0; i < 32 && i < len && pos < sizeof (tmp); i++)
@@ -2483,6 +2519,8 @@ static void malformed_packet_received
   size_t i, pos, smsize;
   assert (submsg >= msg && submsg < msg + len);
 
+  ddsrt_atomic_inc32 (&gv.stats.malformed_packets);
+
   /* Show beginning of message and of submessage (as hex dumps) */
   pos = (size_t) snprintf (tmp, sizeof (tmp), "malformed packet received from vendor %u.%u state %s <", vendorid.id[0], vendorid.id[1], state);
   for (i = 0; i < 32 && i < len && msg + i < submsg && pos < sizeof (tmp); i++)
@@ -2777,6 +2815,7 @@ static int handle_submsg_sequence
             goto malformed;
           sampleinfo.timestamp = timestamp;
           sampleinfo.reception_timestamp = tnowWC;
+          sampleinfo.enqueue_timestamp.v = 0;
           handle_DataFrag (rst, tnowE, rmsg, &sm->datafrag, submsg_size, &sampleinfo, datap, &deferred_wakeup);
           rst_live = 1;
           ts_for_latmeas = 0;
@@ -2792,6 +2831,7 @@ static int handle_submsg_sequence
             goto malformed;
           sampleinfo.timestamp = timestamp;
           sampleinfo.reception_timestamp = tnowWC;
+          sampleinfo.enqueue_timestamp.v = 0;
           handle_Data (rst, tnowE, rmsg, &sm->data, submsg_size, &sampleinfo, datap, &deferred_wakeup);
           rst_live = 1;
           ts_for_latmeas = 0;
@@ -2992,8 +3032,20 @@ static bool do_packet
     sz = ddsi_conn_read (conn, buff, buff_len, true, &srcloc);
   }
 
+  if (sz > 0 && gv.netsim && ddsi_netsim_drop_received (conn, &srcloc, (size_t) sz))
+  {
+    nn_rmsg_commit (rmsg);
+    return true;
+  }
+
   if (sz > 0 && !gv.deaf)
   {
+    ddsrt_atomic_inc32 (&gv.stats.packets_received);
+#if DDSRT_HAVE_ATOMIC64
+    ddsrt_atomic_add64 (&gv.stats.bytes_received, (uint64_t) sz);
+#else
+    ddsrt_atomic_add32 (&gv.stats.bytes_received, (uint32_t) sz);
+#endif
     nn_rmsg_setsize (rmsg, (uint32_t) sz);
     assert (thread_is_asleep ());
 
@@ -3013,7 +3065,7 @@ static bool do_packet
     {
       hdr->guid_prefix = nn_ntoh_guid_prefix (hdr->guid_prefix);
 
-      if (dds_get_log_mask() & DDS_LC_TRACE)
+      if (DDS_LOG_ENABLED (DDS_LC_TRACE))
       {
         char addrstr[DDSI_LOCSTRLEN];
         ddsi_locator_to_string(addrstr, sizeof(addrstr), &srcloc);
@@ -3021,9 +3073,14 @@ static bool do_packet
                   PGUIDPREFIX (hdr->guid_prefix), hdr->vendorid.id[0], hdr->vendorid.id[1], (unsigned long) sz, addrstr);
       }
 
+      DDSI_PROBE (packet_received, sz, DDSI_PROBE_PREFIX (&hdr->guid_prefix));
       handle_submsg_sequence (ts1, conn, &srcloc, now (), now_et (), &hdr->guid_prefix, guidprefix, buff, (size_t) sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg);
     }
   }
+  else if (sz < 0)
+  {
+    ddsrt_atomic_inc32 (&gv.stats.recv_errors);
+  }
   nn_rmsg_commit (rmsg);
   return (sz > 0);
 }
@@ -236,6 +236,7 @@ static struct thread_state1 *init_thread_state (const char *tname, enum thread_s
   assert (vtime_asleep_p (ts->vtime));
   ts->name = ddsrt_strdup (tname);
   ts->state = state;
+  ts->cputime = 0;
 
   return ts;
 }
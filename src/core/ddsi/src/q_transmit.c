@@ -11,6 +11,7 @@
  */
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
@@ -34,6 +35,8 @@
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_sertopic.h"
+#include "dds/ddsi/ddsi_probes.h"
+#include "dds/ddsi/q_flightrec.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -291,7 +294,8 @@ struct nn_xmsg *writer_hbcontrol_piggyback (struct writer *wr, const struct whc_
   *hbansreq = writer_hbcontrol_ack_required_generic (wr, whcst, tlast, tnow, 1);
   if (*hbansreq >= 2) {
     /* So we force a heartbeat in - but we also rely on our caller to
-       send the packet out */
+       send the packet out (or, if the xpack is held, the writer's
+       batching to do so in time) */
     msg = writer_hbcontrol_create_heartbeat (wr, whcst, tnow, *hbansreq, 1);
   } else if (last_packetid != packetid) {
     /* If we crossed a packet boundary since the previous write,
@@ -384,6 +388,14 @@ void add_Heartbeat (struct nn_xmsg *msg, struct writer *wr, const struct whc_sta
   hb->count = ++wr->hbcount;
 
   nn_xmsg_submsg_setnext (msg, sm_marker);
+
+  {
+    /* only the entity id of the destination is known here */
+    nn_guid_t dstguid;
+    memset (&dstguid.prefix, 0, sizeof (dstguid.prefix));
+    dstguid.entityid = dst;
+    nn_flightrec_record (NN_FR_HEARTBEAT_SENT, &wr->e.guid, dst.u ? &dstguid : NULL, min, max, (uint32_t) hb->count);
+  }
 }
 
 static dds_return_t create_fragment_message_simple (struct writer *wr, seqno_t seq, struct ddsi_serdata *serdata, struct nn_xmsg **pmsg)
@@ -742,7 +754,7 @@ static void transmit_sample_lgmsg_unlocked (struct nn_xpack *xp, struct writer *
     if (msg)
     {
       nn_xpack_addmsg (xp, msg, 0);
-      if (hbansreq >= 2)
+      if (hbansreq >= 2 && !nn_xpack_hold (xp))
         nn_xpack_send (xp, true);
     }
   }
@@ -785,7 +797,7 @@ static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr,
     nn_xpack_addmsg (xp, fmsg, 0);
     if(hmsg)
       nn_xpack_addmsg (xp, hmsg, 0);
-    if (hbansreq >= 2)
+    if (hbansreq >= 2 && !nn_xpack_hold (xp))
       nn_xpack_send (xp, true);
   }
 }
@@ -851,7 +863,7 @@ static int insert_sample_in_whc (struct writer *wr, seqno_t seq, struct nn_plist
 
   ASSERT_MUTEX_HELD (&wr->e.lock);
 
-  if (dds_get_log_mask() & DDS_LC_TRACE)
+  if (DDS_LOG_ENABLED (DDS_LC_TRACE))
   {
     char ppbuf[1024];
     int tmp;
@@ -937,6 +949,7 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
 
   dds_return_t result = DDS_RETCODE_OK;
   nn_mtime_t tnow = now_mt ();
+  const nn_mtime_t tstart = tnow;
   const nn_mtime_t abstimeout = add_duration_to_mtime (tnow, wr->xqos->reliability.max_blocking_time);
   struct whc_state whcst;
   whc_get_state (wr->whc, &whcst);
@@ -949,6 +962,8 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
   }
 
   DDS_LOG(DDS_LC_THROTTLE, "writer "PGUIDFMT" waiting for whc to shrink below low-water mark (whc %"PRIuSIZE" low=%"PRIu32" high=%"PRIu32")\n", PGUID (wr->e.guid), whcst.unacked_bytes, wr->whc_low, wr->whc_high);
+  DDSI_PROBE (throttle_begin, DDSI_PROBE_GUID (&wr->e.guid), whcst.unacked_bytes);
+  nn_flightrec_record (NN_FR_THROTTLE_BEGIN, &wr->e.guid, NULL, 0, 0, (uint32_t) (whcst.unacked_bytes / 1024));
   wr->throttling++;
   wr->throttle_count++;
 
@@ -988,7 +1003,10 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
     }
   }
 
+  DDSI_PROBE (throttle_end, DDSI_PROBE_GUID (&wr->e.guid), whcst.unacked_bytes, result == DDS_RETCODE_TIMEOUT);
+  nn_flightrec_record (NN_FR_THROTTLE_END, &wr->e.guid, NULL, 0, result == DDS_RETCODE_TIMEOUT, (uint32_t) (whcst.unacked_bytes / 1024));
   wr->throttling--;
+  wr->time_throttled += now_mt ().v - tstart.v;
   if (wr->state != WRST_OPERATIONAL)
   {
     /* gc_delete_writer may be waiting */
@@ -1016,17 +1034,11 @@ static int maybe_grow_whc (struct writer *wr)
   return 0;
 }
 
-static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct nn_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk, int end_of_txn, int gc_allowed)
+static int sample_is_oversize (const struct writer *wr, const struct ddsi_serdata *serdata)
 {
-  int r;
-  seqno_t seq;
-  nn_mtime_t tnow;
-
-  /* If GC not allowed, we must be sure to never block when writing.  That is only the case for (true, aggressive) KEEP_LAST writers, and also only if there is no limit to how much unacknowledged data the WHC may contain. */
-  assert(gc_allowed || (wr->xqos->history.kind == DDS_HISTORY_KEEP_LAST && wr->whc_low == INT32_MAX));
-  (void)gc_allowed;
-
-  if (ddsi_serdata_size (serdata) > config.max_sample_size)
+  if (ddsi_serdata_size (serdata) <= config.max_sample_size)
+    return 0;
+  else
   {
     char ppbuf[1024];
     int tmp;
@@ -1038,6 +1050,43 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
                  ddsi_serdata_size (serdata), config.max_sample_size,
                  PGUID (wr->e.guid), tname, ttname, ppbuf,
                  tmp < (int) sizeof (ppbuf) ? "" : " (trunc)");
+    return 1;
+  }
+}
+
+static dds_return_t throttle_writer_if_whc_full (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, int gc_allowed)
+{
+  struct whc_state whcst;
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  whc_get_state(wr->whc, &whcst);
+  if (whcst.unacked_bytes <= wr->whc_high)
+    return DDS_RETCODE_OK;
+  assert(gc_allowed); /* also see beginning of write_sample_eot */
+  (void)gc_allowed;
+  if (config.prioritize_retransmit && wr->retransmitting)
+    return throttle_writer (ts1, xp, wr);
+  else
+  {
+    maybe_grow_whc (wr);
+    if (whcst.unacked_bytes <= wr->whc_high)
+      return DDS_RETCODE_OK;
+    else
+      return throttle_writer (ts1, xp, wr);
+  }
+}
+
+static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct nn_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk, int end_of_txn, int gc_allowed)
+{
+  int r;
+  seqno_t seq;
+  nn_mtime_t tnow;
+
+  /* If GC not allowed, we must be sure to never block when writing.  That is only the case for (true, aggressive) KEEP_LAST writers, and also only if there is no limit to how much unacknowledged data the WHC may contain. */
+  assert(gc_allowed || (wr->xqos->history.kind == DDS_HISTORY_KEEP_LAST && wr->whc_low == INT32_MAX));
+  (void)gc_allowed;
+
+  if (sample_is_oversize (wr, serdata))
+  {
     r = DDS_RETCODE_BAD_PARAMETER;
     goto drop;
   }
@@ -1050,30 +1099,11 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
   }
 
   /* If WHC overfull, block. */
+  if (throttle_writer_if_whc_full (ts1, xp, wr, gc_allowed) == DDS_RETCODE_TIMEOUT)
   {
-    struct whc_state whcst;
-    whc_get_state(wr->whc, &whcst);
-    if (whcst.unacked_bytes > wr->whc_high)
-    {
-      dds_return_t ores;
-      assert(gc_allowed); /* also see beginning of the function */
-      if (config.prioritize_retransmit && wr->retransmitting)
-        ores = throttle_writer (ts1, xp, wr);
-      else
-      {
-        maybe_grow_whc (wr);
-        if (whcst.unacked_bytes <= wr->whc_high)
-          ores = DDS_RETCODE_OK;
-        else
-          ores = throttle_writer (ts1, xp, wr);
-      }
-      if (ores == DDS_RETCODE_TIMEOUT)
-      {
-        ddsrt_mutex_unlock (&wr->e.lock);
-        r = DDS_RETCODE_TIMEOUT;
-        goto drop;
-      }
-    }
+    ddsrt_mutex_unlock (&wr->e.lock);
+    r = DDS_RETCODE_TIMEOUT;
+    goto drop;
   }
 
   /* Always use the current monotonic time */
@@ -1081,6 +1111,7 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
   serdata->twrite = tnow;
 
   seq = ++wr->seq;
+  DDSI_PROBE (write, DDSI_PROBE_GUID (&wr->e.guid), seq, ddsi_serdata_size (serdata));
   if (wr->cs_seq != 0)
   {
     if (plist == NULL)
@@ -1156,6 +1187,123 @@ drop:
   return r;
 }
 
+static void add_pending_msgs (struct nn_xpack *xp, struct nn_xmsg **msgs, uint32_t *nmsgs)
+{
+  for (uint32_t i = 0; i < *nmsgs; i++)
+    nn_xpack_addmsg (xp, msgs[i], 0);
+  *nmsgs = 0;
+}
+
+int write_sample_gc_n (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, uint32_t n, struct ddsi_serdata **serdata, struct ddsi_tkmap_instance **tk, uint32_t *nwritten)
+{
+  /* Variant of write_sample_gc for a batch of samples that takes the writer lock
+     once for all of them: the messages for small samples are constructed with the
+     lock held and added to the xpack after releasing it, with (at most) a single
+     piggy-backed heartbeat for the whole batch.  Large samples go through the
+     regular path, which must drop the lock to send the fragments, as does
+     throttling, which requires the pending messages to be sent first.
+
+     Writes the samples in order and stops at the first failure; *nwritten is set
+     to the number of samples written and all samples are unref'd. */
+  struct nn_xmsg **msgs = NULL;
+  uint32_t i, nmsgs = 0;
+  nn_mtime_t tlast = { 0 };
+  int r = 0;
+
+  if (xp)
+    msgs = ddsrt_malloc (n * sizeof (*msgs));
+  ddsrt_mutex_lock (&wr->e.lock);
+  for (i = 0; i < n; i++)
+  {
+    struct ddsi_serdata * const d = serdata[i];
+    seqno_t seq;
+
+    if (sample_is_oversize (wr, d))
+    {
+      r = DDS_RETCODE_BAD_PARAMETER;
+      break;
+    }
+
+    if (xp && nmsgs > 0)
+    {
+      struct whc_state whcst;
+      whc_get_state (wr->whc, &whcst);
+      if (whcst.unacked_bytes > wr->whc_high)
+      {
+        ddsrt_mutex_unlock (&wr->e.lock);
+        add_pending_msgs (xp, msgs, &nmsgs);
+        ddsrt_mutex_lock (&wr->e.lock);
+      }
+    }
+    if (throttle_writer_if_whc_full (ts1, xp, wr, 1) == DDS_RETCODE_TIMEOUT)
+    {
+      r = DDS_RETCODE_TIMEOUT;
+      break;
+    }
+
+    d->twrite = tlast = now_mt ();
+    seq = ++wr->seq;
+    DDSI_PROBE (write, DDSI_PROBE_GUID (&wr->e.guid), seq, ddsi_serdata_size (d));
+    assert (wr->cs_seq == 0);
+    if ((r = insert_sample_in_whc (wr, seq, NULL, d, tk[i])) < 0)
+      break;
+
+    if (xp == NULL)
+    {
+      if (wr->heartbeat_xevent)
+        writer_hbcontrol_note_asyncwrite (wr, tlast);
+      enqueue_sample_wrlock_held (wr, seq, NULL, d, NULL, 1);
+    }
+    else if (ddsi_serdata_size (d) <= config.fragment_size)
+    {
+      if (create_fragment_message_simple (wr, seq, d, &msgs[nmsgs]) >= 0)
+        nmsgs++;
+    }
+    else
+    {
+      struct whc_state whcst, *whcstptr;
+      const uint32_t nfrags = (ddsi_serdata_size (d) + config.fragment_size - 1) / config.fragment_size;
+      if (wr->heartbeat_xevent == NULL)
+        whcstptr = NULL;
+      else
+      {
+        whc_get_state (wr->whc, &whcst);
+        whcstptr = &whcst;
+      }
+      ddsrt_mutex_unlock (&wr->e.lock);
+      add_pending_msgs (xp, msgs, &nmsgs);
+      transmit_sample_lgmsg_unlocked (xp, wr, whcstptr, seq, NULL, d, NULL, 1, nfrags);
+      ddsrt_mutex_lock (&wr->e.lock);
+    }
+  }
+  *nwritten = i;
+
+  if (xp == NULL)
+    ddsrt_mutex_unlock (&wr->e.lock);
+  else
+  {
+    struct nn_xmsg *hmsg = NULL;
+    int hbansreq = 0;
+    if (nmsgs > 0 && wr->heartbeat_xevent)
+    {
+      struct whc_state whcst;
+      whc_get_state (wr->whc, &whcst);
+      hmsg = writer_hbcontrol_piggyback (wr, &whcst, tlast, nn_xpack_packetid (xp), &hbansreq);
+    }
+    ddsrt_mutex_unlock (&wr->e.lock);
+    add_pending_msgs (xp, msgs, &nmsgs);
+    if (hmsg)
+      nn_xpack_addmsg (xp, hmsg, 0);
+    if (hbansreq >= 2 && !nn_xpack_hold (xp))
+      nn_xpack_send (xp, true);
+    ddsrt_free (msgs);
+  }
+
+  for (i = 0; i < n; i++)
+    ddsi_serdata_unref (serdata[i]);
+  return r < 0 ? r : 0;
+}
+
 int write_sample_gc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
 {
   return write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 1);
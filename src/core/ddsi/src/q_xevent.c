@@ -23,6 +23,7 @@
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_addrset.h"
 #include "dds/ddsi/q_xmsg.h"
+#include "dds/ddsi/q_flightrec.h"
 #include "dds/ddsi/q_xevent.h"
 #include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_config.h"
@@ -141,6 +142,7 @@ struct xeventq {
   ddsrt_avl_tree_t msg_xevents;
   struct xevent_nt *non_timed_xmit_list_oldest;
   struct xevent_nt *non_timed_xmit_list_newest; /* undefined if ..._oldest == NULL */
+  size_t non_timed_xmit_list_length;
   size_t queued_rexmit_bytes;
   size_t queued_rexmit_msgs;
   size_t max_queued_rexmit_bytes;
@@ -231,6 +233,7 @@ static void add_to_non_timed_xmit_list (struct xeventq *evq, struct xevent_nt *e
     evq->non_timed_xmit_list_newest->listnode.next = ev;
   }
   evq->non_timed_xmit_list_newest = ev;
+  evq->non_timed_xmit_list_length++;
 
   if (ev->kind == XEVK_MSG_REXMIT)
     remember_msg (evq, ev);
@@ -246,6 +249,8 @@ static struct xevent_nt *getnext_from_non_timed_xmit_list  (struct xeventq *evq)
   if (ev != NULL)
   {
     evq->non_timed_xmit_list_oldest = ev->listnode.next;
+    assert (evq->non_timed_xmit_list_length > 0);
+    evq->non_timed_xmit_list_length--;
 
     if (ev->kind == XEVK_MSG_REXMIT)
     {
@@ -262,22 +267,6 @@ static int non_timed_xmit_list_is_empty (struct xeventq *evq)
   return (evq->non_timed_xmit_list_oldest == NULL);
 }
 
-static int compute_non_timed_xmit_list_size (struct xeventq *evq)
-{
-  /* returns how many "non-timed" xevents are pending by counting the
-     number of events in the list -- it'd be easy to compute the
-     length incrementally in the add_... and next_... functions, but
-     it isn't really being used anywhere, so why bother? */
-  struct xevent_nt *current = evq->non_timed_xmit_list_oldest;
-  int i = 0;
-  while (current)
-  {
-    current = current->listnode.next;
-    i++;
-  }
-  return i;
-}
-
 #ifndef NDEBUG
 static int nontimed_xevent_in_queue (struct xeventq *evq, struct xevent_nt *ev)
 {
@@ -439,7 +428,7 @@ static void qxev_insert_nt (struct xevent_nt *ev)
   struct xeventq *evq = ev->evq;
   ASSERT_MUTEX_HELD (&evq->lock);
   add_to_non_timed_xmit_list (evq, ev);
-  DDS_TRACE("non-timed queue now has %d items\n", compute_non_timed_xmit_list_size (evq));
+  DDS_TRACE("non-timed queue now has %"PRIuSIZE" items\n", evq->non_timed_xmit_list_length);
 }
 
 static int msg_xevents_cmp (const void *a, const void *b)
@@ -462,6 +451,7 @@ struct xeventq * xeventq_new
   ddsrt_fibheap_init (&evq_xevents_fhdef, &evq->xevents);
   ddsrt_avl_init (&msg_xevents_treedef, &evq->msg_xevents);
   evq->non_timed_xmit_list_oldest = NULL;
+  evq->non_timed_xmit_list_length = 0;
   evq->non_timed_xmit_list_newest = NULL;
   evq->terminate = 0;
   evq->ts = NULL;
@@ -510,6 +500,26 @@ void xeventq_stop (struct xeventq *evq)
   evq->ts = NULL;
 }
 
+void xeventq_get_state (struct xeventq *evq, struct xeventq_state *st)
+{
+  ddsrt_mutex_lock (&evq->lock);
+  st->non_timed_queued = evq->non_timed_xmit_list_length;
+  st->queued_rexmit_bytes = evq->queued_rexmit_bytes;
+  st->queued_rexmit_msgs = evq->queued_rexmit_msgs;
+  ddsrt_mutex_unlock (&evq->lock);
+}
+
+struct xeventq *xeventq_for_guid (const nn_guid_t *guid)
+{
+  /* the GUID prefix of a remote participant is often largely fixed, and the
+     entity ids of a participant are mostly sequential, so mix them all */
+  uint32_t h;
+  if (gv.n_xevents_shards <= 1)
+    return gv.xevents;
+  h = (guid->prefix.u[0] ^ guid->prefix.u[1] ^ guid->prefix.u[2] ^ guid->entityid.u) * 0x9e3779b1u;
+  return gv.xevents_shards[(uint32_t) (((uint64_t) h * gv.n_xevents_shards) >> 32)];
+}
+
 void xeventq_free (struct xeventq *evq)
 {
   struct xevent *ev;
@@ -798,6 +808,7 @@ static void add_AckNack (struct nn_xmsg *msg, struct proxy_writer *pwr, struct p
       (nn_count_t *) ((char *) an + offsetof (AckNack_t, readerSNState) +
                       NN_SEQUENCE_NUMBER_SET_SIZE (an->readerSNState.numbits));
     *countp = ++rwn->count;
+    nn_flightrec_record (NN_FR_ACKNACK_SENT, &rwn->rd_guid, &pwr->e.guid, base, *countp, an->readerSNState.numbits);
 
     /* Reset submessage size, now that we know the real size, and update
        the offset to the next submessage. */
@@ -38,9 +38,12 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_ephash.h"
 #include "dds/ddsi/q_freelist.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_probes.h"
+#include "dds/ddsi/ddsi_netsim.h"
 
 #define NN_XMSG_MAX_ALIGN 8
 #define NN_XMSG_CHUNK_SIZE 128
@@ -189,6 +192,7 @@ struct nn_xpack
 {
   struct nn_xpack *sendq_next;
   bool async_mode;
+  bool hold;
   Header_t hdr;
   MsgLen_t msg_len;
   nn_guid_prefix_t *last_src;
@@ -1038,7 +1042,7 @@ static ssize_t nn_xpack_send1 (const nn_locator_t *loc, void * varg)
   struct nn_xpack * xp = varg;
   ssize_t nbytes = 0;
 
-  if (dds_get_log_mask() & DDS_LC_TRACE)
+  if (DDS_LOG_ENABLED (DDS_LC_TRACE))
   {
     char buf[DDSI_LOCSTRLEN];
     DDS_TRACE(" %s", ddsi_locator_to_string (buf, sizeof(buf), loc));
@@ -1068,7 +1072,22 @@ static ssize_t nn_xpack_send1 (const nn_locator_t *loc, void * varg)
   {
     if (!gv.mute)
     {
-      nbytes = ddsi_conn_write (xp->conn, loc, xp->niov, xp->iov, xp->call_flags);
+      if (gv.netsim)
+        nbytes = ddsi_netsim_write (xp->conn, loc, xp->niov, xp->iov, xp->call_flags);
+      else
+        nbytes = ddsi_conn_write (xp->conn, loc, xp->niov, xp->iov, xp->call_flags);
+      if (nbytes < 0)
+        ddsrt_atomic_inc32 (&gv.stats.send_errors);
+      else
+      {
+        ddsrt_atomic_inc32 (&gv.stats.packets_sent);
+#if DDSRT_HAVE_ATOMIC64
+        ddsrt_atomic_add64 (&gv.stats.bytes_sent, (uint64_t) nbytes);
+#else
+        ddsrt_atomic_add32 (&gv.stats.bytes_sent, (uint32_t) nbytes);
+#endif
+      }
+      DDSI_PROBE (packet_sent, nbytes, xp->niov);
 #ifndef NDEBUG
       {
         size_t i, len;
@@ -1143,7 +1162,7 @@ static void nn_xpack_send_real (struct nn_xpack * xp)
 
   assert (xp->dstmode != NN_XMSG_DST_UNSET);
 
-  if (dds_get_log_mask() & DDS_LC_TRACE)
+  if (DDS_LOG_ENABLED (DDS_LC_TRACE))
   {
     int i;
     DDS_TRACE("nn_xpack_send %"PRIu32":", xp->msg_len.length);
@@ -1211,10 +1230,12 @@ static void nn_xpack_send_real (struct nn_xpack * xp)
 
 static uint32_t nn_xpack_sendq_thread (UNUSED_ARG (void *arg))
 {
+  nn_mtime_t next_thread_cputime = { 0 };
   ddsrt_mutex_lock (&gv.sendq_lock);
   while (!(gv.sendq_stop && gv.sendq_head == NULL))
   {
     struct nn_xpack *xp;
+    LOG_THREAD_CPUTIME (next_thread_cputime);
     if ((xp = gv.sendq_head) == NULL)
     {
       ddsrt_cond_waitfor (&gv.sendq_cond, &gv.sendq_lock, 1000000);
@@ -1596,3 +1617,18 @@ unsigned nn_xpack_packetid (const struct nn_xpack *xp)
 {
   return xp->packetid;
 }
+
+uint32_t nn_xpack_size (const struct nn_xpack *xp)
+{
+  return xp->msg_len.length;
+}
+
+void nn_xpack_set_hold (struct nn_xpack *xp, bool hold)
+{
+  xp->hold = hold;
+}
+
+bool nn_xpack_hold (const struct nn_xpack *xp)
+{
+  return xp->hold;
+}
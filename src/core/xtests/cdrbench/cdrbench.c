@@ -0,0 +1,626 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/time.h"
+#include "dds__entity.h"
+#include "dds__topic.h"
+#include "dds__stream.h"
+
+#include "CdrBenchTypes.h"
+
+/* Microbenchmark of the CDR (de)serializer: for each type in CdrBenchTypes.idl
+   and, for the variable-size ones, each requested payload size, it measures
+   the cost per sample of serializing (write), deserializing into a reused
+   sample (read), validating a received payload in native and in swapped byte
+   order (norm, norm-bswap), extracting the key (key) and computing the key
+   hash (keyhash).  Each measurement runs for at least a configurable amount
+   of time and the result is reported in ns/sample and in MB/s of serialized
+   payload. */
+
+enum op {
+  OP_WRITE,
+  OP_READ,
+  OP_NORM,
+  OP_NORM_BSWAP,
+  OP_KEY,
+  OP_KEYHASH
+};
+#define OP_N (OP_KEYHASH + 1)
+
+static const char *opnames[OP_N] = {
+  "write", "read", "norm", "norm-bswap", "key", "keyhash"
+};
+
+struct bench_type {
+  const char *name;
+  const dds_topic_descriptor_t *desc;
+  bool sized; /* false: size parameter doesn't apply */
+  void (*fill) (void *sample, uint32_t size);
+};
+
+struct bench_state {
+  const struct ddsi_sertopic_default *tp;
+  const void *sample;      /* source sample for write */
+  void *rsample;           /* target sample for read */
+  const unsigned char *native; /* serialized sample */
+  const unsigned char *swapped; /* same, but in the other byte order */
+  unsigned char *work;     /* scratch copy for normalize (modifies in-place) */
+  uint32_t size;           /* size of serialized sample */
+  dds_ostream_t os;
+};
+
+static double mintime = 0.2;
+static volatile unsigned char sink;
+
+/**********************************************************************
+ **
+ **  Generating samples
+ **
+ **********************************************************************/
+
+static char *make_string (uint32_t len, char c)
+{
+  char *s = dds_string_alloc (len);
+  memset (s, c, len);
+  s[len] = 0;
+  return s;
+}
+
+static void *make_seqbuf (dds_sequence_t *seq, uint32_t n, size_t elemsize)
+{
+  seq->_maximum = seq->_length = n;
+  seq->_buffer = dds_alloc (n * elemsize > 0 ? n * elemsize : 1);
+  seq->_release = true;
+  return seq->_buffer;
+}
+
+static void make_point (CdrBench_Point *p, uint32_t i)
+{
+  p->x = 1.0 * i;
+  p->y = 2.0 * i;
+  p->z = 3.0 * i;
+}
+
+static void fill_prim (void *vs, uint32_t size)
+{
+  CdrBench_Prim *s = vs;
+  (void) size;
+  s->k = 1;
+  s->o = 2;
+  s->s = 3;
+  s->l = 4;
+  s->ll = 5;
+  s->d = 6.0;
+}
+
+static void fill_nested (void *vs, uint32_t size)
+{
+  CdrBench_Nested *s = vs;
+  (void) size;
+  s->k = 1;
+  make_point (&s->a, 1);
+  make_point (&s->b, 2);
+  make_point (&s->c, 3);
+  make_point (&s->d, 4);
+}
+
+static void fill_arrdouble (void *vs, uint32_t size)
+{
+  CdrBench_ArrDouble *s = vs;
+  (void) size;
+  s->k = 1;
+  for (uint32_t i = 0; i < sizeof (s->a) / sizeof (s->a[0]); i++)
+    s->a[i] = 1.0 * i;
+}
+
+static void fill_seqoctet (void *vs, uint32_t size)
+{
+  CdrBench_SeqOctet *s = vs;
+  s->k = 1;
+  unsigned char *b = make_seqbuf ((dds_sequence_t *) &s->s, size, 1);
+  for (uint32_t i = 0; i < size; i++)
+    b[i] = (unsigned char) i;
+}
+
+static void fill_strkey (void *vs, uint32_t size)
+{
+  CdrBench_StrKey *s = vs;
+  s->k = make_string (15, 'k');
+  s->s1 = make_string (size / 2, 'a');
+  s->s2 = make_string (size - size / 2, 'b');
+}
+
+static void fill_seqstruct (void *vs, uint32_t size)
+{
+  CdrBench_SeqStruct *s = vs;
+  const uint32_t n = size / (uint32_t) sizeof (CdrBench_Point);
+  s->k = 1;
+  CdrBench_Point *ps = make_seqbuf ((dds_sequence_t *) &s->s, n, sizeof (CdrBench_Point));
+  for (uint32_t i = 0; i < n; i++)
+    make_point (&ps[i], i);
+}
+
+static void fill_sequnion (void *vs, uint32_t size)
+{
+  /* a mix of all cases, averaging roughly 16 bytes per element */
+  CdrBench_SeqUnion *s = vs;
+  const uint32_t n = size / 16;
+  s->k = 1;
+  CdrBench_U *us = make_seqbuf ((dds_sequence_t *) &s->s, n, sizeof (CdrBench_U));
+  for (uint32_t i = 0; i < n; i++)
+  {
+    us[i]._d = (int32_t) (i % 4);
+    switch (i % 4)
+    {
+      case 0: us[i]._u.l = (int32_t) i; break;
+      case 1: us[i]._u.d = 1.0 * i; break;
+      case 2: us[i]._u.s = make_string (7, 's'); break;
+      case 3: make_point (&us[i]._u.p, i); break;
+    }
+  }
+}
+
+static void fill_multikey (void *vs, uint32_t size)
+{
+  CdrBench_MultiKey *s = vs;
+  s->k1 = 1;
+  s->k2 = make_string (15, 'k');
+  s->k3 = 3;
+  unsigned char *b = make_seqbuf ((dds_sequence_t *) &s->s, size, 1);
+  for (uint32_t i = 0; i < size; i++)
+    b[i] = (unsigned char) i;
+}
+
+static const struct bench_type types[] = {
+  { "Prim", &CdrBench_Prim_desc, false, fill_prim },
+  { "Nested", &CdrBench_Nested_desc, false, fill_nested },
+  { "ArrDouble", &CdrBench_ArrDouble_desc, false, fill_arrdouble },
+  { "SeqOctet", &CdrBench_SeqOctet_desc, true, fill_seqoctet },
+  { "StrKey", &CdrBench_StrKey_desc, true, fill_strkey },
+  { "SeqStruct", &CdrBench_SeqStruct_desc, true, fill_seqstruct },
+  { "SeqUnion", &CdrBench_SeqUnion_desc, true, fill_sequnion },
+  { "MultiKey", &CdrBench_MultiKey_desc, true, fill_multikey }
+};
+
+/**********************************************************************
+ **
+ **  Byte-swapping serialized data
+ **
+ **  dds_stream_normalize can only swap data that is in the non-native
+ **  byte order (it needs the lengths), so the input for measuring it
+ **  is constructed by walking the type's ops and swapping everything
+ **  in a copy of the native representation.
+ **
+ **********************************************************************/
+
+static uint32_t bswap_prim (unsigned char *data, uint32_t off, uint32_t size)
+{
+  off = (off + size - 1) & ~(size - 1);
+  for (uint32_t i = 0; i < size / 2; i++)
+  {
+    const unsigned char t = data[off + i];
+    data[off + i] = data[off + size - 1 - i];
+    data[off + size - 1 - i] = t;
+  }
+  return off + size;
+}
+
+/* Returns the native value of the uint32_t at *off, swapping it in the buffer */
+static uint32_t bswap_uint32 (unsigned char *data, uint32_t *off)
+{
+  uint32_t x;
+  *off = (*off + 3) & ~3u;
+  memcpy (&x, data + *off, 4);
+  *off = bswap_prim (data, *off, 4);
+  return x;
+}
+
+static uint32_t bswap_string (unsigned char *data, uint32_t off)
+{
+  const uint32_t len = bswap_uint32 (data, &off);
+  return off + len;
+}
+
+static uint32_t primsize (enum dds_stream_typecode type)
+{
+  switch (type)
+  {
+    case DDS_OP_VAL_1BY: return 1;
+    case DDS_OP_VAL_2BY: return 2;
+    case DDS_OP_VAL_4BY: return 4;
+    case DDS_OP_VAL_8BY: return 8;
+    default: abort (); return 0;
+  }
+}
+
+static uint32_t bswap_ops (unsigned char *data, uint32_t off, const uint32_t *ops);
+
+static const uint32_t *bswap_collection (unsigned char *data, uint32_t *off, const uint32_t *ops, uint32_t num, uint32_t primskip, uint32_t cplxskip)
+{
+  const enum dds_stream_typecode subtype = DDS_OP_SUBTYPE (ops[0]);
+  switch (subtype)
+  {
+    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
+      for (uint32_t i = 0; i < num; i++)
+        *off = bswap_prim (data, *off, primsize (subtype));
+      return ops + primskip;
+    case DDS_OP_VAL_STR:
+      for (uint32_t i = 0; i < num; i++)
+        *off = bswap_string (data, *off);
+      return ops + primskip;
+    case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU: {
+      const uint32_t jmp = DDS_OP_ADR_JMP (ops[3]);
+      for (uint32_t i = 0; i < num; i++)
+        *off = bswap_ops (data, *off, ops + DDS_OP_ADR_JSR (ops[3]));
+      return ops + (jmp ? jmp : cplxskip);
+    }
+    default:
+      abort ();
+      return NULL;
+  }
+}
+
+static const uint32_t *bswap_uni (unsigned char *data, uint32_t *off, const uint32_t *ops)
+{
+  const enum dds_stream_typecode disctype = DDS_OP_SUBTYPE (ops[0]);
+  uint32_t disc;
+  switch (disctype)
+  {
+    case DDS_OP_VAL_1BY: disc = data[*off]; (*off)++; break;
+    case DDS_OP_VAL_2BY: { uint16_t x; *off = (*off + 1) & ~1u; memcpy (&x, data + *off, 2); disc = x; *off = bswap_prim (data, *off, 2); break; }
+    case DDS_OP_VAL_4BY: disc = bswap_uint32 (data, off); break;
+    default: abort (); return NULL;
+  }
+  const bool has_default = ops[0] & DDS_OP_FLAG_DEF;
+  const uint32_t numcases = ops[2];
+  const uint32_t *jeq_op = ops + DDS_OP_ADR_JSR (ops[3]);
+  uint32_t ci;
+  for (ci = 0; ci < numcases - (has_default ? 1 : 0); ci++, jeq_op += 3)
+    if (jeq_op[1] == disc)
+      break;
+  if (ci < numcases)
+  {
+    const enum dds_stream_typecode valtype = DDS_JEQ_TYPE (jeq_op[0]);
+    switch (valtype)
+    {
+      case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
+        *off = bswap_prim (data, *off, primsize (valtype));
+        break;
+      case DDS_OP_VAL_STR:
+        *off = bswap_string (data, *off);
+        break;
+      default:
+        *off = bswap_ops (data, *off, jeq_op + DDS_OP_ADR_JSR (jeq_op[0]));
+        break;
+    }
+  }
+  return ops + DDS_OP_ADR_JMP (ops[3]);
+}
+
+static uint32_t bswap_ops (unsigned char *data, uint32_t off, const uint32_t *ops)
+{
+  uint32_t insn;
+  while ((insn = *ops) != DDS_OP_RTS)
+  {
+    switch (DDS_OP (insn))
+    {
+      case DDS_OP_ADR:
+        switch (DDS_OP_TYPE (insn))
+        {
+          case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
+            off = bswap_prim (data, off, primsize (DDS_OP_TYPE (insn)));
+            ops += 2;
+            break;
+          case DDS_OP_VAL_STR:
+            off = bswap_string (data, off);
+            ops += 2;
+            break;
+          case DDS_OP_VAL_SEQ: {
+            const uint32_t num = bswap_uint32 (data, &off);
+            ops = bswap_collection (data, &off, ops, num, 2, 4);
+            break;
+          }
+          case DDS_OP_VAL_ARR:
+            ops = bswap_collection (data, &off, ops, ops[2], 3, 5);
+            break;
+          case DDS_OP_VAL_UNI:
+            ops = bswap_uni (data, &off, ops);
+            break;
+          default:
+            /* bounded strings are not used in CdrBenchTypes */
+            abort ();
+        }
+        break;
+      case DDS_OP_JSR:
+        off = bswap_ops (data, off, ops + DDS_OP_JUMP (insn));
+        ops++;
+        break;
+      default:
+        abort ();
+    }
+  }
+  return off;
+}
+
+/**********************************************************************
+ **
+ **  Measuring
+ **
+ **********************************************************************/
+
+static void run_op (struct bench_state *st, enum op op, uint32_t n)
+{
+  const struct ddsi_sertopic_default *tp = st->tp;
+  dds_istream_t is = { .m_buffer = st->native, .m_size = st->size, .m_index = 0 };
+  switch (op)
+  {
+    case OP_WRITE:
+      for (uint32_t i = 0; i < n; i++)
+      {
+        st->os.m_index = 0;
+        dds_stream_write_sample (&st->os, st->sample, tp);
+      }
+      break;
+    case OP_READ:
+      for (uint32_t i = 0; i < n; i++)
+      {
+        is.m_index = 0;
+        dds_stream_read_sample (&is, st->rsample, tp);
+      }
+      break;
+    case OP_NORM:
+      /* no byte swapping: the data is not modified */
+      memcpy (st->work, st->native, st->size);
+      for (uint32_t i = 0; i < n; i++)
+        if (!dds_stream_normalize (st->work, st->size, false, tp, false))
+          abort ();
+      break;
+    case OP_NORM_BSWAP:
+      for (uint32_t i = 0; i < n; i++)
+      {
+        memcpy (st->work, st->swapped, st->size);
+        if (!dds_stream_normalize (st->work, st->size, true, tp, false))
+          abort ();
+      }
+      break;
+    case OP_KEY:
+      for (uint32_t i = 0; i < n; i++)
+      {
+        is.m_index = 0;
+        st->os.m_index = 0;
+        dds_stream_extract_key_from_data (&is, &st->os, tp);
+      }
+      break;
+    case OP_KEYHASH:
+      for (uint32_t i = 0; i < n; i++)
+      {
+        dds_keyhash_t kh;
+        is.m_index = 0;
+        dds_stream_extract_keyhash (&is, &kh, tp, false);
+      }
+      break;
+  }
+}
+
+static void run_memcpy (struct bench_state *st, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+  {
+    memcpy (st->work, st->native, st->size);
+    /* prevent the compiler from optimizing away the copies */
+    sink ^= st->work[i % st->size];
+  }
+}
+
+/* Returns time per operation in ns, doubling the number of iterations
+   until a batch takes at least "mintime" seconds */
+static double measure (struct bench_state *st, int op)
+{
+  uint32_t n = 1;
+  while (true)
+  {
+    const dds_time_t t0 = ddsrt_time_monotonic ();
+    if (op < 0)
+      run_memcpy (st, n);
+    else
+      run_op (st, (enum op) op, n);
+    const dds_time_t t1 = ddsrt_time_monotonic ();
+    if ((double) (t1 - t0) >= mintime * 1e9 || n >= UINT32_MAX / 2)
+      return (double) (t1 - t0) / n;
+    n *= 2;
+  }
+}
+
+static void bench (const struct bench_type *bt, const struct ddsi_sertopic_default *tp, uint32_t size)
+{
+  struct bench_state st;
+  void *sample = ddsrt_malloc (bt->desc->m_size);
+  memset (sample, 0, bt->desc->m_size);
+  bt->fill (sample, size);
+  st.tp = tp;
+  st.sample = sample;
+  st.rsample = ddsrt_malloc (bt->desc->m_size);
+  memset (st.rsample, 0, bt->desc->m_size);
+
+  dds_ostream_init (&st.os, 0);
+  dds_stream_write_sample (&st.os, sample, tp);
+  st.size = st.os.m_index;
+  unsigned char *native = ddsrt_malloc (st.size);
+  unsigned char *swapped = ddsrt_malloc (st.size);
+  memcpy (native, st.os.m_buffer, st.size);
+  memcpy (swapped, st.os.m_buffer, st.size);
+  if (bswap_ops (swapped, 0, bt->desc->m_ops) != st.size)
+    abort ();
+  st.native = native;
+  st.swapped = swapped;
+  st.work = ddsrt_malloc (st.size);
+
+  /* check the byte-swapped version before measuring anything */
+  memcpy (st.work, swapped, st.size);
+  if (!dds_stream_normalize (st.work, st.size, true, tp, false) || memcmp (st.work, native, st.size) != 0)
+  {
+    fprintf (stderr, "%s: byte-swapped representation doesn't normalize to native one\n", bt->name);
+    exit (1);
+  }
+
+  /* byte swapping modifies the data in-place and so operates on a fresh
+     copy every time, the time of which is subtracted */
+  const double t_memcpy = measure (&st, -1);
+  for (int op = 0; op < OP_N; op++)
+  {
+    double t = measure (&st, op);
+    if (op == OP_NORM_BSWAP)
+      t = (t > t_memcpy) ? t - t_memcpy : 0.0;
+    printf ("%-10s %8"PRIu32" %8"PRIu32" %-10s %12.1f %10.1f\n",
+            bt->name, bt->sized ? size : 0, st.size, opnames[op], t, (t > 0.0) ? 1e3 * st.size / t : 0.0);
+    fflush (stdout);
+  }
+
+  dds_ostream_fini (&st.os);
+  ddsrt_free (st.work);
+  ddsrt_free (swapped);
+  ddsrt_free (native);
+  dds_sample_free (st.rsample, bt->desc, DDS_FREE_ALL);
+  dds_sample_free (sample, bt->desc, DDS_FREE_ALL);
+}
+
+static void usage (const char *argv0)
+{
+  printf ("\
+%s [OPTIONS]\n\
+\n\
+OPTIONS:\n\
+  -t SECS     minimum duration of a single measurement (default %g)\n\
+  -s S1,S2,.. payload sizes in bytes for variable-size types\n\
+              (default 16,256,4096,65536)\n\
+  -T TYPE     only TYPE (may be repeated), one of:\n\
+             ", argv0, mintime);
+  for (size_t i = 0; i < sizeof (types) / sizeof (types[0]); i++)
+    printf (" %s", types[i].name);
+  printf ("\n\
+\n\
+Prints for each combination of type, size and operation the time per\n\
+sample in ns and the throughput in MB/s of serialized data. \"size\" is\n\
+the requested payload size, \"bytes\" the actual size of the CDR data.\n\
+Operations:\n\
+  write       serialize sample\n\
+  read        deserialize into a previously used sample\n\
+  norm        validate native-endian data\n\
+  norm-bswap  validate and byte-swap other-endian data (excluding the\n\
+              time needed for copying the input)\n\
+  key         extract serialized key from data\n\
+  keyhash     compute key hash from data\n");
+  exit (1);
+}
+
+int main (int argc, char **argv)
+{
+  uint32_t sizes[32] = { 16, 256, 4096, 65536 };
+  uint32_t nsizes = 4;
+  bool typesel[sizeof (types) / sizeof (types[0])];
+  bool anytypesel = false;
+  int opt;
+
+  memset (typesel, 0, sizeof (typesel));
+  while ((opt = getopt (argc, argv, "s:t:T:h")) != EOF)
+  {
+    switch (opt)
+    {
+      case 't':
+        mintime = atof (optarg);
+        if (mintime < 0.0)
+          usage (argv[0]);
+        break;
+      case 's': {
+        char *copy = ddsrt_strdup (optarg), *cursor = copy, *tok;
+        nsizes = 0;
+        while ((tok = ddsrt_strsep (&cursor, ",")) != NULL)
+        {
+          int pos;
+          unsigned long v;
+          if (nsizes == sizeof (sizes) / sizeof (sizes[0]) || sscanf (tok, "%lu%n", &v, &pos) != 1 || tok[pos] != 0 || v > (1u << 24))
+            usage (argv[0]);
+          sizes[nsizes++] = (uint32_t) v;
+        }
+        ddsrt_free (copy);
+        if (nsizes == 0)
+          usage (argv[0]);
+        break;
+      }
+      case 'T': {
+        size_t i;
+        for (i = 0; i < sizeof (types) / sizeof (types[0]); i++)
+          if (strcmp (optarg, types[i].name) == 0)
+            break;
+        if (i == sizeof (types) / sizeof (types[0]))
+          usage (argv[0]);
+        typesel[i] = anytypesel = true;
+        break;
+      }
+      default:
+        usage (argv[0]);
+    }
+  }
+  if (optind != argc)
+    usage (argv[0]);
+
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  if (pp < 0)
+  {
+    fprintf (stderr, "dds_create_participant: %s\n", dds_strretcode (pp));
+    return 1;
+  }
+
+  printf ("%-10s %8s %8s %-10s %12s %10s\n", "type", "size", "bytes", "op", "ns/sample", "MB/s");
+  for (size_t i = 0; i < sizeof (types) / sizeof (types[0]); i++)
+  {
+    const struct bench_type *bt = &types[i];
+    if (anytypesel && !typesel[i])
+      continue;
+
+    char tpname[64];
+    snprintf (tpname, sizeof (tpname), "cdrbench_%s", bt->name);
+    const dds_entity_t tp = dds_create_topic (pp, bt->desc, tpname, NULL, NULL);
+    if (tp < 0)
+    {
+      fprintf (stderr, "dds_create_topic(%s): %s\n", tpname, dds_strretcode (tp));
+      return 1;
+    }
+    const struct ddsi_sertopic_default *stp;
+    {
+      struct dds_entity *x;
+      if (dds_entity_lock (tp, DDS_KIND_TOPIC, &x) < 0) abort ();
+      stp = (const struct ddsi_sertopic_default *) dds_topic_lookup (x->m_domain, tpname);
+      dds_entity_unlock (x);
+    }
+
+    if (!bt->sized)
+      bench (bt, stp, 0);
+    else
+    {
+      for (uint32_t j = 0; j < nsizes; j++)
+        bench (bt, stp, sizes[j]);
+    }
+  }
+
+  dds_delete (pp);
+  return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/rusage.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/time.h"
+#include "DiscBenchTypes.h"
+
+/* Discovery scalability: for each combination of a number of processes P
+   and a number of endpoints E this spawns P processes that all start at the
+   same moment, each creating a participant with E topics and a writer and
+   a reader for each topic.  Every process then waits until each of its
+   writers and readers is matched with the P corresponding endpoints
+   (including its own) and reports:
+
+   - time-to-full-match: from the common start time until all its endpoints
+     are matched;
+   - CPU time spent in the process during that interval;
+   - the increase in the maximum resident set size divided by the number of
+     proxy endpoints, (P-1) * 2E, an upper bound on the memory cost of a
+     proxy endpoint as it includes the process' own entities;
+   - the discovery traffic: the bytes sent and received by the process.
+
+   The results are passed to the parent in files in the current directory.
+
+   The processes run on a single machine and normally discover each other
+   using multicast.  If multicast is not available, the participant index
+   is used for unicast discovery, which limits the number of processes to
+   120 (see Discovery/ParticipantIndex). */
+
+#define MAX_LIST 32
+
+static uint32_t nprocs_list[MAX_LIST] = { 2, 4, 8 };
+static uint32_t nnprocs = 3;
+static uint32_t neps_list[MAX_LIST] = { 10, 100 };
+static uint32_t nneps = 2;
+static double timeout = 60.0;
+static bool verbose = false;
+
+struct result {
+  dds_duration_t match;
+  dds_duration_t cpu;
+  uint64_t rss;
+  uint64_t packets_sent, bytes_sent;
+  uint64_t packets_received, bytes_received;
+};
+
+static void oops (const char *file, int line)
+{
+  fflush (stdout);
+  fprintf (stderr, "%s:%d\n", file, line);
+  abort ();
+}
+
+#define oops() oops(__FILE__, __LINE__)
+
+static uint64_t get_stat (dds_entity_t e, const char *name)
+{
+  dds_stat_keyvalue_t stats[32];
+  dds_return_t n;
+  if ((n = dds_get_statistics (e, stats, sizeof (stats) / sizeof (stats[0]))) < 0)
+    oops ();
+  for (dds_return_t i = 0; i < n && i < (dds_return_t) (sizeof (stats) / sizeof (stats[0])); i++)
+    if (strcmp (stats[i].name, name) == 0)
+      return stats[i].value;
+  return 0;
+}
+
+static char *result_file_name (const char *prefix, uint32_t idx)
+{
+  char *name;
+  (void) ddsrt_asprintf (&name, "%s-%"PRIu32".txt", prefix, idx);
+  return name;
+}
+
+static bool all_matched (uint32_t neps, const dds_entity_t *wrs, const dds_entity_t *rds, bool *done, uint32_t nprocs)
+{
+  bool all = true;
+  for (uint32_t i = 0; i < neps; i++)
+  {
+    dds_publication_matched_status_t pst;
+    dds_subscription_matched_status_t sst;
+    if (done[i])
+      continue;
+    if (dds_get_publication_matched_status (wrs[i], &pst) < 0)
+      oops ();
+    if (dds_get_subscription_matched_status (rds[i], &sst) < 0)
+      oops ();
+    if (pst.current_count >= nprocs && sst.current_count >= nprocs)
+      done[i] = true;
+    else
+      all = false;
+  }
+  return all;
+}
+
+/* Child: waits until tstart, creates the entities, waits for all of them
+   to be matched, writes the result file and then lingers until it is killed
+   by the parent (or the timeout expires), because the others still need to
+   discover it.  Exit code is 0 if all was matched, 1 if not. */
+static int child (uint32_t idx, uint32_t nprocs, uint32_t neps, dds_time_t tstart, const char *prefix)
+{
+  const dds_time_t tend = tstart + (dds_duration_t) (timeout * 1e9);
+  dds_entity_t pp, ws;
+  dds_entity_t *wrs, *rds;
+  bool *done;
+  ddsrt_rusage_t u0, u1;
+  struct result r;
+  bool matched;
+
+  dds_sleepuntil (tstart);
+  if (ddsrt_getrusage (DDSRT_RUSAGE_SELF, &u0) != DDS_RETCODE_OK)
+    oops ();
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    oops ();
+  if ((ws = dds_create_waitset (pp)) < 0)
+    oops ();
+  wrs = ddsrt_malloc (neps * sizeof (*wrs));
+  rds = ddsrt_malloc (neps * sizeof (*rds));
+  done = ddsrt_malloc (neps * sizeof (*done));
+  for (uint32_t i = 0; i < neps; i++)
+  {
+    char name[32];
+    dds_entity_t tp;
+    (void) snprintf (name, sizeof (name), "discbench_%"PRIu32, i);
+    if ((tp = dds_create_topic (pp, &DiscBench_Data_desc, name, NULL, NULL)) < 0)
+      oops ();
+    if ((wrs[i] = dds_create_writer (pp, tp, NULL, NULL)) < 0)
+      oops ();
+    if ((rds[i] = dds_create_reader (pp, tp, NULL, NULL)) < 0)
+      oops ();
+    if (dds_set_status_mask (wrs[i], DDS_PUBLICATION_MATCHED_STATUS) < 0)
+      oops ();
+    if (dds_set_status_mask (rds[i], DDS_SUBSCRIPTION_MATCHED_STATUS) < 0)
+      oops ();
+    if (dds_waitset_attach (ws, wrs[i], 0) < 0)
+      oops ();
+    if (dds_waitset_attach (ws, rds[i], 0) < 0)
+      oops ();
+    done[i] = false;
+  }
+
+  while (!(matched = all_matched (neps, wrs, rds, done, nprocs)) && dds_time () < tend)
+    (void) dds_waitset_wait_until (ws, NULL, 0, tend);
+  r.match = dds_time () - tstart;
+  if (ddsrt_getrusage (DDSRT_RUSAGE_SELF, &u1) != DDS_RETCODE_OK)
+    oops ();
+  r.cpu = (u1.utime + u1.stime) - (u0.utime + u0.stime);
+  r.rss = (uint64_t) (u1.maxrss - u0.maxrss);
+  r.packets_sent = get_stat (pp, "packets_sent");
+  r.bytes_sent = get_stat (pp, "bytes_sent");
+  r.packets_received = get_stat (pp, "packets_received");
+  r.bytes_received = get_stat (pp, "bytes_received");
+  ddsrt_free (done);
+  ddsrt_free (rds);
+  ddsrt_free (wrs);
+
+  if (matched)
+  {
+    /* write to a temporary file and rename it so the parent never sees a
+       partially written one */
+    char *name = result_file_name (prefix, idx), *tmpname;
+    FILE *fp;
+    (void) ddsrt_asprintf (&tmpname, "%s.tmp", name);
+    if ((fp = fopen (tmpname, "w")) == NULL)
+      oops ();
+    fprintf (fp, "%"PRId64" %"PRId64" %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64"\n",
+             r.match, r.cpu, r.rss, r.packets_sent, r.bytes_sent, r.packets_received, r.bytes_received);
+    fclose (fp);
+    if (rename (tmpname, name) != 0)
+      oops ();
+    ddsrt_free (tmpname);
+    ddsrt_free (name);
+  }
+
+  dds_sleepuntil (tend);
+  dds_delete (pp);
+  return matched ? 0 : 1;
+}
+
+static bool read_result (const char *prefix, uint32_t idx, struct result *r)
+{
+  char *name = result_file_name (prefix, idx);
+  FILE *fp;
+  int n = 0;
+  if ((fp = fopen (name, "r")) != NULL)
+  {
+    n = fscanf (fp, "%"SCNd64" %"SCNd64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64,
+                &r->match, &r->cpu, &r->rss, &r->packets_sent, &r->bytes_sent, &r->packets_received, &r->bytes_received);
+    fclose (fp);
+  }
+  ddsrt_free (name);
+  return n == 7;
+}
+
+static void remove_result (const char *prefix, uint32_t idx)
+{
+  char *name = result_file_name (prefix, idx);
+  (void) remove (name);
+  ddsrt_free (name);
+}
+
+static bool run_config (const char *exe, const char *base_uri, uint32_t nprocs, uint32_t neps)
+{
+  /* give all processes time to start before the common start time */
+  const dds_time_t tstart = dds_time () + DDS_SECS (1) + (dds_duration_t) nprocs * DDS_MSECS (50);
+  const dds_time_t tend = tstart + (dds_duration_t) (timeout * 1e9);
+  char *uri, *prefix, idxstr[16], nprocsstr[16], nepsstr[16], tstartstr[32], timeoutstr[32];
+  char *argv[] = { "-c", idxstr, "-P", nprocsstr, "-E", nepsstr, "-T", tstartstr, "-t", timeoutstr, "-o", NULL, NULL };
+  ddsrt_pid_t *pids;
+  struct result *rs;
+  bool *have;
+  uint32_t nhave = 0;
+
+  /* unicast discovery needs participant indices for all processes, that
+     setting is ignored if multicast is used */
+  (void) ddsrt_asprintf (&uri, "%s%s<Discovery><MaxAutoParticipantIndex>%"PRIu32"</MaxAutoParticipantIndex></Discovery>", base_uri ? base_uri : "", (base_uri && *base_uri) ? "," : "", (nprocs + 9 < 119) ? nprocs + 9 : 119);
+  if (ddsrt_setenv ("CYCLONEDDS_URI", uri) != DDS_RETCODE_OK)
+    oops ();
+  ddsrt_free (uri);
+
+  (void) ddsrt_asprintf (&prefix, "discbench-%"PRIdPID, ddsrt_getpid ());
+  argv[11] = prefix;
+  (void) snprintf (nprocsstr, sizeof (nprocsstr), "%"PRIu32, nprocs);
+  (void) snprintf (nepsstr, sizeof (nepsstr), "%"PRIu32, neps);
+  (void) snprintf (tstartstr, sizeof (tstartstr), "%"PRId64, tstart);
+  (void) snprintf (timeoutstr, sizeof (timeoutstr), "%f", timeout);
+  pids = ddsrt_malloc (nprocs * sizeof (*pids));
+  rs = ddsrt_malloc (nprocs * sizeof (*rs));
+  have = ddsrt_malloc (nprocs * sizeof (*have));
+  for (uint32_t i = 0; i < nprocs; i++)
+  {
+    remove_result (prefix, i);
+    have[i] = false;
+    (void) snprintf (idxstr, sizeof (idxstr), "%"PRIu32, i);
+    if (ddsrt_proc_create (exe, argv, &pids[i]) != DDS_RETCODE_OK)
+    {
+      fprintf (stderr, "failed to start process %s\n", exe);
+      for (uint32_t j = 0; j < i; j++)
+      {
+        (void) ddsrt_proc_kill (pids[j]);
+        (void) ddsrt_proc_waitpid (pids[j], DDS_SECS (10), NULL);
+      }
+      ddsrt_free (have);
+      ddsrt_free (rs);
+      ddsrt_free (pids);
+      ddsrt_free (prefix);
+      return false;
+    }
+  }
+
+  while (nhave < nprocs && dds_time () < tend)
+  {
+    for (uint32_t i = 0; i < nprocs; i++)
+    {
+      if (!have[i] && read_result (prefix, i, &rs[i]))
+      {
+        have[i] = true;
+        nhave++;
+      }
+    }
+    if (nhave < nprocs)
+      dds_sleepfor (DDS_MSECS (10));
+  }
+
+  for (uint32_t i = 0; i < nprocs; i++)
+  {
+    (void) ddsrt_proc_kill (pids[i]);
+    (void) ddsrt_proc_waitpid (pids[i], DDS_SECS (10), NULL);
+    remove_result (prefix, i);
+  }
+
+  dds_duration_t match_max = 0, cpu_max = 0;
+  double match_sum = 0.0, cpu_sum = 0.0, rss_sum = 0.0, tx_sum = 0.0, rx_sum = 0.0;
+  const uint64_t nproxies = (uint64_t) (nprocs - 1) * 2 * neps;
+  for (uint32_t i = 0; i < nprocs; i++)
+  {
+    if (!have[i])
+      continue;
+    if (verbose)
+      printf ("#   %3"PRIu32": match %.3fs cpu %.3fs rss %"PRIu64"kB tx %"PRIu64"/%"PRIu64"B rx %"PRIu64"/%"PRIu64"B\n",
+              i, (double) rs[i].match / 1e9, (double) rs[i].cpu / 1e9, rs[i].rss / 1024,
+              rs[i].packets_sent, rs[i].bytes_sent, rs[i].packets_received, rs[i].bytes_received);
+    if (rs[i].match > match_max)
+      match_max = rs[i].match;
+    if (rs[i].cpu > cpu_max)
+      cpu_max = rs[i].cpu;
+    match_sum += (double) rs[i].match;
+    cpu_sum += (double) rs[i].cpu;
+    rss_sum += (double) rs[i].rss;
+    tx_sum += (double) rs[i].bytes_sent;
+    rx_sum += (double) rs[i].bytes_received;
+  }
+  const double n = (nhave > 0) ? (double) nhave : 1.0;
+  printf ("%6"PRIu32" %6"PRIu32" %10.1f %10.1f %10.1f %10.1f %10.0f %10.1f %10.1f %s\n",
+          nprocs, neps,
+          (double) match_max / 1e6, match_sum / n / 1e6,
+          (double) cpu_max / 1e6, cpu_sum / n / 1e6,
+          nproxies > 0 ? rss_sum / n / (double) nproxies : 0.0,
+          tx_sum / n / 1024.0, rx_sum / n / 1024.0,
+          (nhave == nprocs) ? "ok" : "TIME");
+  fflush (stdout);
+  ddsrt_free (have);
+  ddsrt_free (rs);
+  ddsrt_free (pids);
+  ddsrt_free (prefix);
+  return nhave == nprocs;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [OPTIONS]\n\
+\n\
+OPTIONS:\n\
+  -P N,...    numbers of processes (default 2,4,8)\n\
+  -E N,...    numbers of topics per process, each with a writer and a\n\
+              reader (default 10,100)\n\
+  -t TIMEOUT  timeout per configuration in seconds (default %.0f)\n\
+  -v          also print the results for the individual processes\n\
+\n\
+Runs every combination of the number of processes and the number of topics.\n\
+\n\
+Output columns: number of processes; number of topics; maximum and mean time\n\
+to full match in ms; maximum and mean CPU time in ms; increase in maximum\n\
+resident set size per proxy endpoint in bytes; mean number of KiB sent and\n\
+received per process; status.\n", argv0, timeout);
+  exit (2);
+}
+
+static uint32_t parse_list (uint32_t *list, const char *arg)
+{
+  uint32_t n = 0;
+  char *end;
+  do {
+    if (n == MAX_LIST)
+      return 0;
+    list[n] = (uint32_t) strtoul (arg, &end, 0);
+    if (end == arg || list[n] == 0)
+      return 0;
+    n++;
+    arg = end + 1;
+  } while (*end == ',');
+  return (*end == 0) ? n : 0;
+}
+
+int main (int argc, char **argv)
+{
+  int64_t child_idx = -1;
+  dds_time_t tstart = 0;
+  const char *prefix = NULL;
+  int opt;
+  while ((opt = getopt (argc, argv, "c:E:o:P:t:T:v")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'c': child_idx = atoll (optarg); break;
+      case 'E': if ((nneps = parse_list (neps_list, optarg)) == 0) usage (argv[0]); break;
+      case 'o': prefix = optarg; break;
+      case 'P': if ((nnprocs = parse_list (nprocs_list, optarg)) == 0) usage (argv[0]); break;
+      case 't': timeout = atof (optarg); break;
+      case 'T': tstart = atoll (optarg); break;
+      case 'v': verbose = true; break;
+      default: usage (argv[0]);
+    }
+  }
+  if (timeout <= 0.0 || optind != argc)
+    usage (argv[0]);
+  if (child_idx >= 0)
+  {
+    if (prefix == NULL)
+      usage (argv[0]);
+    return child ((uint32_t) child_idx, nprocs_list[0], neps_list[0], tstart, prefix);
+  }
+
+#if ! DDSRT_HAVE_MULTI_PROCESS
+  fprintf (stderr, "%s: requires support for multiple processes\n", argv[0]);
+  return 0;
+#else
+  char *base_uri = NULL;
+  bool ok = true;
+  if (ddsrt_getenv ("CYCLONEDDS_URI", &base_uri) == DDS_RETCODE_OK)
+    base_uri = ddsrt_strdup (base_uri);
+  printf ("# %4s %6s %10s %10s %10s %10s %10s %10s %10s %s\n", "procs", "topics", "match[ms]", "mean[ms]", "cpu[ms]", "mean[ms]", "rss/pep[B]", "tx[KiB]", "rx[KiB]", "status");
+  for (uint32_t i = 0; i < nnprocs; i++)
+    for (uint32_t j = 0; j < nneps; j++)
+      if (!run_config (argv[0], base_uri, nprocs_list[i], neps_list[j]))
+        ok = false;
+  ddsrt_free (base_uri);
+  return ok ? 0 : 1;
+#endif
+}
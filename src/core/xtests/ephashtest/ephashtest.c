@@ -0,0 +1,241 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dds/ddsrt/sockets.h"
+#include "dds/dds.h"
+#include "dds__entity.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_ephash.h"
+#include "dds/ddsi/q_entity.h"
+
+#include "EphashTypes.h"
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit (1); \
+    } \
+  } while (0)
+
+#define NTOPICS 50
+#define NDELETE 16
+#define NLATE 4
+
+static nn_guid_t get_guid (dds_entity_t hdl)
+{
+  struct dds_entity *x;
+  nn_guid_t guid;
+  CHECK (dds_entity_lock (hdl, DDS_KIND_DONTCARE, &x) == DDS_RETCODE_OK);
+  guid = x->m_guid;
+  dds_entity_unlock (x);
+  return guid;
+}
+
+static bool guid_in (const nn_guid_t *guid, const nn_guid_t *guids, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    if (memcmp (&guids[i], guid, sizeof (*guid)) == 0)
+      return true;
+  return false;
+}
+
+/* Number of endpoints of the given kind in the topic index entry of
+   endpoint "hdl", checking that all of them really are in that entry */
+static uint32_t count_on_topic (dds_entity_t hdl, enum entity_kind epkind, enum entity_kind kind)
+{
+  const nn_guid_t guid = get_guid (hdl);
+  struct ephash_enum_topic st;
+  const struct entity_common *e, *em;
+  uint32_t n = 0;
+  thread_state_awake (lookup_thread_state ());
+  CHECK ((e = ephash_lookup_guid (&guid, epkind)) != NULL);
+  CHECK (e->topic != NULL);
+  CHECK (ephash_enum_topic_init (&st, e, kind));
+  while ((em = ephash_enum_topic_next (&st)) != NULL)
+  {
+    CHECK (em->kind == kind);
+    CHECK (em->topic == e->topic);
+    n++;
+  }
+  ephash_enum_topic_fini (&st);
+  thread_state_asleep (lookup_thread_state ());
+  return n;
+}
+
+static const struct ephash_topic *topic_entry (dds_entity_t hdl, enum entity_kind epkind)
+{
+  const nn_guid_t guid = get_guid (hdl);
+  const struct entity_common *e;
+  const struct ephash_topic *topic;
+  thread_state_awake (lookup_thread_state ());
+  CHECK ((e = ephash_lookup_guid (&guid, epkind)) != NULL);
+  topic = e->topic;
+  thread_state_asleep (lookup_thread_state ());
+  return topic;
+}
+
+static uint32_t matched_readers (dds_entity_t wr)
+{
+  dds_publication_matched_status_t st;
+  CHECK (dds_get_publication_matched_status (wr, &st) == DDS_RETCODE_OK);
+  return st.current_count;
+}
+
+/* Endpoints on many topics, with the number of readers and writers varying
+   per topic; the names include ones that are prefixes of others */
+static void many_topics (void)
+{
+  dds_entity_t pp, tp[NTOPICS], wr[NTOPICS][3], rd[NTOPICS][4];
+  CHECK ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) > 0);
+  for (uint32_t i = 0; i < NTOPICS; i++)
+  {
+    char name[32];
+    snprintf (name, sizeof (name), "ephashtest_%u", i);
+    CHECK ((tp[i] = dds_create_topic (pp, &EphashTypes_Data_desc, name, NULL, NULL)) > 0);
+    for (uint32_t j = 0; j < i % 4; j++)
+      CHECK ((rd[i][j] = dds_create_reader (pp, tp[i], NULL, NULL)) > 0);
+    for (uint32_t j = 0; j < 1 + i % 3; j++)
+      CHECK ((wr[i][j] = dds_create_writer (pp, tp[i], NULL, NULL)) > 0);
+  }
+  for (uint32_t i = 0; i < NTOPICS; i++)
+  {
+    for (uint32_t j = 0; j < 1 + i % 3; j++)
+    {
+      CHECK (count_on_topic (wr[i][j], EK_WRITER, EK_READER) == i % 4);
+      CHECK (count_on_topic (wr[i][j], EK_WRITER, EK_WRITER) == 1 + i % 3);
+      /* local matching goes through the index */
+      CHECK (matched_readers (wr[i][j]) == i % 4);
+    }
+    for (uint32_t j = 0; j < i % 4; j++)
+      CHECK (count_on_topic (rd[i][j], EK_READER, EK_WRITER) == 1 + i % 3);
+  }
+  CHECK (dds_delete (pp) == DDS_RETCODE_OK);
+}
+
+/* Names that differ only in case, in a trailing character or only at the
+   end of a long common prefix must all get their own entry */
+static void similar_names (void)
+{
+  dds_entity_t pp;
+  char long0[258], long1[258];
+  memset (long0, 'x', 256);
+  memcpy (long1, long0, 256);
+  memcpy (long0 + 256, "0", 2);
+  memcpy (long1 + 256, "1", 2);
+  const char *names[] = { "similar", "similar_", "similaR", "Similar", "similar_similar", long0, long1 };
+  const uint32_t nnames = (uint32_t) (sizeof (names) / sizeof (names[0]));
+  dds_entity_t tp[sizeof (names) / sizeof (names[0])];
+  dds_entity_t wr[sizeof (names) / sizeof (names[0])];
+  dds_entity_t rd[sizeof (names) / sizeof (names[0])][sizeof (names) / sizeof (names[0])];
+  CHECK ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) > 0);
+  for (uint32_t i = 0; i < nnames; i++)
+  {
+    CHECK ((tp[i] = dds_create_topic (pp, &EphashTypes_Data_desc, names[i], NULL, NULL)) > 0);
+    CHECK ((wr[i] = dds_create_writer (pp, tp[i], NULL, NULL)) > 0);
+    for (uint32_t j = 0; j <= i; j++)
+      CHECK ((rd[i][j] = dds_create_reader (pp, tp[i], NULL, NULL)) > 0);
+  }
+  for (uint32_t i = 0; i < nnames; i++)
+  {
+    CHECK (count_on_topic (wr[i], EK_WRITER, EK_READER) == i + 1);
+    CHECK (matched_readers (wr[i]) == i + 1);
+    for (uint32_t j = 0; j <= i; j++)
+      CHECK (topic_entry (rd[i][j], EK_READER) == topic_entry (wr[i], EK_WRITER));
+    for (uint32_t j = 0; j < i; j++)
+      CHECK (topic_entry (wr[i], EK_WRITER) != topic_entry (wr[j], EK_WRITER));
+  }
+  CHECK (dds_delete (pp) == DDS_RETCODE_OK);
+}
+
+/* Deleting endpoints while the index is being enumerated: the deleted ones
+   must be skipped and the ones created after init not be visited; and once
+   the last endpoint on the topic is gone, the next one must get a fresh
+   entry */
+static void delete_while_enumerating (void)
+{
+  dds_entity_t pp, tp, wr, rd[NDELETE], rdlate[NLATE];
+  nn_guid_t wrguid, rdguid[NDELETE], keepguid[NDELETE / 2];
+  struct ephash_enum_topic st;
+  const struct entity_common *e;
+  uint32_t n = 0;
+  bool first_kept;
+
+  CHECK ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) > 0);
+  CHECK ((tp = dds_create_topic (pp, &EphashTypes_Data_desc, "ephashtest_delete", NULL, NULL)) > 0);
+  CHECK ((wr = dds_create_writer (pp, tp, NULL, NULL)) > 0);
+  wrguid = get_guid (wr);
+  for (uint32_t i = 0; i < NDELETE; i++)
+  {
+    CHECK ((rd[i] = dds_create_reader (pp, tp, NULL, NULL)) > 0);
+    rdguid[i] = get_guid (rd[i]);
+    if (i % 2)
+      keepguid[i / 2] = rdguid[i];
+  }
+
+  thread_state_awake (lookup_thread_state ());
+  CHECK ((e = ephash_lookup_guid (&wrguid, EK_WRITER)) != NULL);
+  CHECK (ephash_enum_topic_init (&st, e, EK_READER));
+  /* the first one is visited before any deletions */
+  CHECK ((e = ephash_enum_topic_next (&st)) != NULL);
+  CHECK (guid_in (&e->guid, rdguid, NDELETE));
+  first_kept = guid_in (&e->guid, keepguid, NDELETE / 2);
+  thread_state_asleep (lookup_thread_state ());
+
+  for (uint32_t i = 0; i < NDELETE; i += 2)
+    CHECK (dds_delete (rd[i]) == DDS_RETCODE_OK);
+  for (uint32_t i = 0; i < NLATE; i++)
+    CHECK ((rdlate[i] = dds_create_reader (pp, tp, NULL, NULL)) > 0);
+
+  thread_state_awake (lookup_thread_state ());
+  while ((e = ephash_enum_topic_next (&st)) != NULL)
+  {
+    CHECK (guid_in (&e->guid, keepguid, NDELETE / 2));
+    n++;
+  }
+  ephash_enum_topic_fini (&st);
+  thread_state_asleep (lookup_thread_state ());
+  CHECK (n == (first_kept ? NDELETE / 2 - 1 : NDELETE / 2));
+
+  CHECK (count_on_topic (wr, EK_WRITER, EK_READER) == NDELETE / 2 + NLATE);
+  CHECK (matched_readers (wr) == NDELETE / 2 + NLATE);
+
+  CHECK (dds_delete (wr) == DDS_RETCODE_OK);
+  for (uint32_t i = 1; i < NDELETE; i += 2)
+    CHECK (dds_delete (rd[i]) == DDS_RETCODE_OK);
+  for (uint32_t i = 0; i < NLATE; i++)
+    CHECK (dds_delete (rdlate[i]) == DDS_RETCODE_OK);
+  CHECK ((rd[0] = dds_create_reader (pp, tp, NULL, NULL)) > 0);
+  CHECK (count_on_topic (rd[0], EK_READER, EK_READER) == 1);
+  CHECK (count_on_topic (rd[0], EK_READER, EK_WRITER) == 0);
+  CHECK ((wr = dds_create_writer (pp, tp, NULL, NULL)) > 0);
+  CHECK (count_on_topic (rd[0], EK_READER, EK_WRITER) == 1);
+  CHECK (matched_readers (wr) == 1);
+  CHECK (dds_delete (pp) == DDS_RETCODE_OK);
+}
+
+int main (int argc, char **argv)
+{
+  (void) argc;
+  (void) argv;
+
+  many_topics ();
+  printf ("many topics ok\n");
+  similar_names ();
+  printf ("similar names ok\n");
+  delete_while_enumerating ();
+  printf ("delete while enumerating ok\n");
+  printf ("ok\n");
+  return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/time.h"
+#include "LossBenchTypes.h"
+
+/* Reliability under a simulated lossy network: for each scenario (a set of
+   Internal/Test/NetworkSimulation rules, applied to both processes) this
+   spawns a subscriber, publishes a fixed number of samples over a reliable
+   KEEP_ALL writer and waits for all of them to be acknowledged.  It reports:
+
+   - goodput: payload bits per second, from the first write until all data
+     has been acknowledged;
+   - retransmit overhead: bytes retransmitted as a percentage of the payload;
+   - recovery time: the time from the last write until all data has been
+     acknowledged, i.e., the time it takes to repair the final losses.
+
+   The simulation is seeded (-s) so the packet fates are the same from run
+   to run, only the timing of the application and the OS vary. */
+
+#define TOPICNAME "lossbench"
+
+static const char *default_scenarios[] = {
+  "",
+  "out loss=1%",
+  "out loss=5%",
+  "out loss=10%",
+  "out loss=1% reorder=5% delay=1ms",
+  "out loss=5% duplicate=5% delay=2ms jitter=2ms",
+  "out bandwidth=100Mb/s queue=256kB delay=5ms loss=1%"
+};
+
+static uint32_t count = 10000;
+static uint32_t size = 1024;
+static uint32_t seed = 1;
+static double timeout = 60.0;
+
+static void oops (const char *file, int line)
+{
+  fflush (stdout);
+  fprintf (stderr, "%s:%d\n", file, line);
+  abort ();
+}
+
+#define oops() oops(__FILE__, __LINE__)
+
+static uint64_t get_stat (dds_entity_t e, const char *name)
+{
+  dds_stat_keyvalue_t stats[32];
+  dds_return_t n;
+  if ((n = dds_get_statistics (e, stats, sizeof (stats) / sizeof (stats[0]))) < 0)
+    oops ();
+  for (dds_return_t i = 0; i < n && i < (dds_return_t) (sizeof (stats) / sizeof (stats[0])); i++)
+    if (strcmp (stats[i].name, name) == 0)
+      return stats[i].value;
+  return 0;
+}
+
+static dds_qos_t *make_qos (void)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_SECS (10));
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  return qos;
+}
+
+/* Exit code: 0 if all samples were received in order, 1 if some are
+   missing, 2 if they arrived out of order */
+static int subscriber (void)
+{
+  const dds_time_t tend = dds_time () + (dds_duration_t) (timeout * 1e9);
+  dds_entity_t pp, tp, rd, rdcond, ws;
+  dds_qos_t *qos;
+  uint32_t next = 0;
+  bool out_of_order = false;
+  uint32_t nmatched = 0;
+  LossBench_Data samples[100];
+  void *raw[100];
+  dds_sample_info_t si[100];
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    oops ();
+  if ((tp = dds_create_topic (pp, &LossBench_Data_desc, TOPICNAME, NULL, NULL)) < 0)
+    oops ();
+  qos = make_qos ();
+  if ((rd = dds_create_reader (pp, tp, qos, NULL)) < 0)
+    oops ();
+  dds_delete_qos (qos);
+  if ((ws = dds_create_waitset (pp)) < 0)
+    oops ();
+  if ((rdcond = dds_create_readcondition (rd, DDS_ANY_STATE)) < 0)
+    oops ();
+  if (dds_waitset_attach (ws, rdcond, 0) < 0)
+    oops ();
+  if (dds_set_status_mask (rd, DDS_SUBSCRIPTION_MATCHED_STATUS) < 0)
+    oops ();
+  if (dds_waitset_attach (ws, rd, 0) < 0)
+    oops ();
+  memset (samples, 0, sizeof (samples));
+  for (size_t i = 0; i < sizeof (samples) / sizeof (samples[0]); i++)
+    raw[i] = &samples[i];
+
+  /* Receive everything, then hang around until the publisher has deleted
+     its writer so that our final acknowledgements don't get lost in the
+     shutdown */
+  while (dds_time () < tend)
+  {
+    dds_subscription_matched_status_t st;
+    int32_t n;
+    if (dds_get_subscription_matched_status (rd, &st) < 0)
+      oops ();
+    if (st.current_count > nmatched)
+      nmatched = st.current_count;
+    else if (nmatched > 0 && st.current_count == 0)
+      break;
+    if ((n = dds_take (rd, raw, si, sizeof (samples) / sizeof (samples[0]), sizeof (samples) / sizeof (samples[0]))) < 0)
+      oops ();
+    for (int32_t i = 0; i < n; i++)
+    {
+      if (!si[i].valid_data)
+        continue;
+      if (samples[i].seq != next)
+        out_of_order = true;
+      next = samples[i].seq + 1;
+    }
+    if (n == 0)
+      (void) dds_waitset_wait_until (ws, NULL, 0, tend);
+  }
+  for (size_t i = 0; i < sizeof (samples) / sizeof (samples[0]); i++)
+    dds_sample_free (&samples[i], &LossBench_Data_desc, DDS_FREE_CONTENTS);
+  dds_delete (pp);
+  if (out_of_order)
+    return 2;
+  else
+    return (next == count) ? 0 : 1;
+}
+
+static bool wait_for_reader (dds_entity_t wr, dds_time_t tend)
+{
+  dds_entity_t ws;
+  dds_publication_matched_status_t st;
+  bool matched = false;
+  if ((ws = dds_create_waitset (dds_get_participant (wr))) < 0)
+    oops ();
+  if (dds_set_status_mask (wr, DDS_PUBLICATION_MATCHED_STATUS) < 0)
+    oops ();
+  if (dds_waitset_attach (ws, wr, 0) < 0)
+    oops ();
+  while (!matched && dds_time () < tend)
+  {
+    if (dds_get_publication_matched_status (wr, &st) < 0)
+      oops ();
+    if (st.current_count > 0)
+      matched = true;
+    else
+      (void) dds_waitset_wait_until (ws, NULL, 0, tend);
+  }
+  dds_delete (ws);
+  return matched;
+}
+
+/* dds_wait_for_acks is not implemented, but the writer statistics track
+   the amount of unacknowledged data */
+static bool wait_for_acks (dds_entity_t wr, dds_time_t tend)
+{
+  while (get_stat (wr, "whc_unacked_bytes") > 0)
+  {
+    if (dds_time () >= tend)
+      return false;
+    dds_sleepfor (DDS_MSECS (1));
+  }
+  return true;
+}
+
+static bool run_scenario (const char *exe, const char *base_uri, const char *scenario)
+{
+  const dds_time_t tend = dds_time () + (dds_duration_t) (timeout * 1e9);
+  char *uri, countstr[16], timeoutstr[32];
+  char *argv[] = { "-r", "-n", countstr, "-t", timeoutstr, NULL };
+  ddsrt_pid_t pid;
+  int32_t code = -1;
+  dds_entity_t pp, tp, wr;
+  dds_qos_t *qos;
+  LossBench_Data sample;
+  dds_time_t tstart, tlast, tacked;
+  uint64_t dropped0;
+  bool acked;
+
+  (void) ddsrt_asprintf (&uri, "%s%s<Internal><Test><NetworkSimulation>%s</NetworkSimulation><NetworkSimulationSeed>%"PRIu32"</NetworkSimulationSeed></Test></Internal>", base_uri ? base_uri : "", (base_uri && *base_uri) ? "," : "", scenario, seed);
+  if (ddsrt_setenv ("CYCLONEDDS_URI", uri) != DDS_RETCODE_OK)
+    oops ();
+  ddsrt_free (uri);
+
+  (void) snprintf (countstr, sizeof (countstr), "%"PRIu32, count);
+  (void) snprintf (timeoutstr, sizeof (timeoutstr), "%f", timeout);
+  if (ddsrt_proc_create (exe, argv, &pid) != DDS_RETCODE_OK)
+  {
+    fprintf (stderr, "failed to start subscriber %s\n", exe);
+    return false;
+  }
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    oops ();
+  if ((tp = dds_create_topic (pp, &LossBench_Data_desc, TOPICNAME, NULL, NULL)) < 0)
+    oops ();
+  qos = make_qos ();
+  if ((wr = dds_create_writer (pp, tp, qos, NULL)) < 0)
+    oops ();
+  dds_delete_qos (qos);
+  dropped0 = get_stat (pp, "netsim_dropped");
+
+  if (!wait_for_reader (wr, tend))
+  {
+    fprintf (stderr, "\"%s\": no subscriber\n", scenario);
+    (void) ddsrt_proc_kill (pid);
+    (void) ddsrt_proc_waitpid (pid, DDS_SECS (10), &code);
+    dds_delete (pp);
+    return false;
+  }
+
+  sample.payload._length = sample.payload._maximum = size;
+  sample.payload._buffer = ddsrt_malloc (size > 0 ? size : 1);
+  sample.payload._release = false;
+  memset (sample.payload._buffer, 0x55, size);
+  tstart = dds_time ();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    sample.seq = i;
+    if (dds_write (wr, &sample) < 0)
+      oops ();
+  }
+  tlast = dds_time ();
+  acked = wait_for_acks (wr, tend);
+  tacked = dds_time ();
+  ddsrt_free (sample.payload._buffer);
+
+  const uint64_t rexmit_bytes = get_stat (wr, "rexmit_bytes");
+  const uint64_t rexmit_count = get_stat (wr, "rexmit_count");
+  const uint64_t nacks = get_stat (wr, "nacks_received");
+  const uint64_t dropped = get_stat (pp, "netsim_dropped") - dropped0;
+
+  /* deleting the writer tells the subscriber it is done */
+  dds_delete (wr);
+  if (ddsrt_proc_waitpid (pid, tend - dds_time () > 0 ? tend - dds_time () : 0, &code) != DDS_RETCODE_OK)
+  {
+    (void) ddsrt_proc_kill (pid);
+    (void) ddsrt_proc_waitpid (pid, DDS_SECS (10), &code);
+    code = -1;
+  }
+  dds_delete (pp);
+
+  const double payload = (double) count * (double) size;
+  printf ("%10.2f %8.2f %8"PRIu64" %8"PRIu64" %10.3f %8"PRIu64" %-4s \"%s\"\n",
+          acked ? payload * 8.0 / ((double) (tacked - tstart) / 1e3) : 0.0,
+          payload > 0 ? 100.0 * (double) rexmit_bytes / payload : 0.0,
+          rexmit_count, nacks,
+          acked ? (double) (tacked - tlast) / 1e6 : -1.0,
+          dropped,
+          !acked ? "TIME" : (code == 0) ? "ok" : (code == 1) ? "LOST" : (code == 2) ? "ORDR" : "FAIL",
+          scenario);
+  fflush (stdout);
+  return acked && code == 0;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr, "usage: %s [OPTIONS] [SCENARIO...]\n\
+\n\
+OPTIONS:\n\
+  -n COUNT    number of samples to publish (default %"PRIu32")\n\
+  -z SIZE     payload size in bytes (default %"PRIu32")\n\
+  -s SEED     network simulation seed (default %"PRIu32")\n\
+  -t TIMEOUT  timeout per scenario in seconds (default %.0f)\n\
+\n\
+Each SCENARIO is a set of Internal/Test/NetworkSimulation rules, e.g.,\n\
+\"out loss=5%% delay=1ms\", that is applied to both the publisher and the\n\
+subscriber. The default is to run a fixed set of scenarios.\n\
+\n\
+Output columns: goodput in Mb/s; retransmitted bytes as a percentage of the\n\
+payload; number of retransmits; number of NACKs received; recovery time in\n\
+ms (last write until all acknowledged); packets dropped by the publisher's\n\
+network simulation; status.\n", argv0, count, size, seed, timeout);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  bool subscriber_mode = false;
+  int opt;
+  while ((opt = getopt (argc, argv, "n:rs:t:z:")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'n': count = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 'r': subscriber_mode = true; break;
+      case 's': seed = (uint32_t) strtoul (optarg, NULL, 0); break;
+      case 't': timeout = atof (optarg); break;
+      case 'z': size = (uint32_t) strtoul (optarg, NULL, 0); break;
+      default: usage (argv[0]);
+    }
+  }
+  if (timeout <= 0.0)
+    usage (argv[0]);
+  if (subscriber_mode)
+    return subscriber ();
+
+#if ! DDSRT_HAVE_MULTI_PROCESS
+  fprintf (stderr, "%s: requires support for multiple processes\n", argv[0]);
+  return 0;
+#else
+  char *base_uri = NULL;
+  bool ok = true;
+  if (ddsrt_getenv ("CYCLONEDDS_URI", &base_uri) == DDS_RETCODE_OK)
+    base_uri = ddsrt_strdup (base_uri);
+  printf ("# %"PRIu32" samples of %"PRIu32" bytes, seed %"PRIu32"\n", count, size, seed);
+  printf ("# %8s %8s %8s %8s %10s %8s %-4s %s\n", "Mb/s", "rexmit%", "rexmits", "nacks", "recov[ms]", "dropped", "stat", "scenario");
+  if (optind == argc)
+  {
+    for (size_t i = 0; i < sizeof (default_scenarios) / sizeof (default_scenarios[0]); i++)
+      if (!run_scenario (argv[0], base_uri, default_scenarios[i]))
+        ok = false;
+  }
+  else
+  {
+    for (int i = optind; i < argc; i++)
+      if (!run_scenario (argv[0], base_uri, argv[i]))
+        ok = false;
+  }
+  ddsrt_free (base_uri);
+  return ok ? 0 : 1;
+#endif
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/ddsi/q_radmin.h"
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit (1); \
+    } \
+  } while (0)
+
+/* Mimics the data path of handle_regular for a proxy writer with a
+   single reader that is not yet in sync: every sample goes through the
+   proxy writer's reorder admin first and then, duplicated, through the
+   reader's own one. */
+struct rx {
+  struct nn_rbufpool *rbpool;
+  struct nn_defrag *defrag;
+  struct nn_reorder *pwr_reorder;
+  struct nn_reorder *rd_reorder;
+  seqno_t pwr_next, rd_next;
+};
+
+static void deliver (struct nn_rsample_chain *sc, nn_reorder_result_t rres, seqno_t *next)
+{
+  struct nn_rsample_chain_elem *e = sc->first;
+  nn_reorder_result_t n = 0;
+  while (e)
+  {
+    struct nn_rsample_chain_elem *e1 = e->next;
+    CHECK (e->sampleinfo != NULL);
+    CHECK (e->sampleinfo->seq == *next);
+    (*next)++;
+    n++;
+    nn_fragchain_unref (e->fragchain);
+    e = e1;
+  }
+  CHECK (n == rres);
+}
+
+static void receive (struct rx *rx, seqno_t seq, nn_reorder_result_t exp_pwr, nn_reorder_result_t exp_rd)
+{
+  struct nn_rmsg *rmsg;
+  struct nn_rdata *rdata, *fragchain;
+  struct nn_rsample_info *si;
+  struct nn_rsample *rsample, *rsample_dup;
+  struct nn_rsample_chain sc;
+  nn_reorder_result_t rres;
+  int refc_adjust = 0;
+
+  CHECK ((rmsg = nn_rmsg_new (rx->rbpool)) != NULL);
+  nn_rmsg_setsize (rmsg, 8);
+  CHECK ((rdata = nn_rdata_new (rmsg, 0, 8, 0, 0)) != NULL);
+  CHECK ((si = nn_rmsg_alloc (rmsg, sizeof (*si))) != NULL);
+  memset (si, 0, sizeof (*si));
+  si->seq = seq;
+  si->size = si->fragsize = 8;
+
+  CHECK ((rsample = nn_defrag_rsample (rx->defrag, rdata, si)) != NULL);
+  fragchain = nn_rsample_fragchain (rsample);
+  rres = nn_reorder_rsample (&sc, rx->pwr_reorder, rsample, &refc_adjust, 0);
+  printf ("seq %"PRId64": proxy writer %d", seq, (int) rres);
+  CHECK (rres == exp_pwr);
+  if (rres > 0)
+    deliver (&sc, rres, &rx->pwr_next);
+
+  if (rx->rd_reorder)
+  {
+    /* the proxy writer's admin may have appended stored samples to rsample */
+    rsample_dup = nn_reorder_rsample_dup_first (rmsg, rsample);
+    rres = nn_reorder_rsample (&sc, rx->rd_reorder, rsample_dup, &refc_adjust, 0);
+    printf (" reader %d", (int) rres);
+    CHECK (rres == exp_rd);
+    if (rres > 0)
+      deliver (&sc, rres, &rx->rd_next);
+  }
+  printf ("\n");
+
+  nn_fragchain_adjust_refcount (fragchain, refc_adjust);
+  nn_rmsg_commit (rmsg);
+}
+
+int main (int argc, char **argv)
+{
+  struct rx rx;
+  (void) argc;
+  (void) argv;
+
+  rx.rbpool = nn_rbufpool_new (65536, 1024);
+  rx.defrag = nn_defrag_new (NN_DEFRAG_DROP_LATEST, 16);
+  rx.pwr_reorder = nn_reorder_new (NN_REORDER_MODE_NORMAL, 16);
+  rx.pwr_next = rx.rd_next = 1;
+
+  /* the proxy writer delivers 1 before the reader gets matched, the
+     reader then has to wait for a retransmit of 1 */
+  rx.rd_reorder = NULL;
+  receive (&rx, 1, (nn_reorder_result_t) 1, 0);
+  rx.rd_reorder = nn_reorder_new (NN_REORDER_MODE_NORMAL, 16);
+
+  /* 3 and 4 get stored as one interval in both */
+  receive (&rx, 3, NN_REORDER_ACCEPT, NN_REORDER_ACCEPT);
+  receive (&rx, 4, NN_REORDER_ACCEPT, NN_REORDER_ACCEPT);
+  /* a duplicate of a stored sample is rejected by both */
+  receive (&rx, 3, NN_REORDER_REJECT, NN_REORDER_REJECT);
+  /* 2 makes the proxy writer deliver [2,5), after which the sample it
+     received is no longer a singleton; the reader must get only 2 */
+  receive (&rx, 2, (nn_reorder_result_t) 3, NN_REORDER_ACCEPT);
+  /* a retransmit of 1 completes the reader */
+  receive (&rx, 1, NN_REORDER_TOO_OLD, (nn_reorder_result_t) 4);
+  /* and a late duplicate of 2 is too old everywhere */
+  receive (&rx, 2, NN_REORDER_TOO_OLD, NN_REORDER_TOO_OLD);
+
+  CHECK (rx.pwr_next == 5);
+  CHECK (rx.rd_next == 5);
+  CHECK (nn_reorder_next_seq (rx.pwr_reorder) == 5);
+  CHECK (nn_reorder_next_seq (rx.rd_reorder) == 5);
+
+  nn_reorder_free (rx.rd_reorder);
+  nn_reorder_free (rx.pwr_reorder);
+  nn_defrag_free (rx.defrag);
+  nn_rbufpool_free (rx.rbpool);
+  printf ("ok\n");
+  return 0;
+}
@@ -14,11 +14,15 @@
 #include <assert.h>
 #include <string.h>
 #include <inttypes.h>
+#include <limits.h>
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/process.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/random.h"
+#include "dds/ddsrt/threads.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/time.h"
 #include "dds/dds.h"
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds__entity.h"
@@ -157,7 +161,8 @@ static struct proxy_writer *mkwr (bool auto_dispose)
 
 static void fwr (struct proxy_writer *wr)
 {
-  free (wr->c.xqos);
+  nn_xqos_fini ((dds_qos_t *) wr->c.xqos);
+  free ((dds_qos_t *) wr->c.xqos);
   free (wr);
 }
 
@@ -805,6 +810,267 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     fwr (wr[i]);
 }
 
+/* Throughput mode: a number of threads simulating delivery of data (by
+   calling dds_rhc_store like the receive path does), while a number of
+   application threads concurrently read and take from the same RHC, with
+   and without read and query conditions.  This is run for a range of
+   instance counts and history depths; it reports for each operation the
+   number of calls and samples per second and the mean and maximum duration
+   of a call.  Practically the entire call is spent holding the RHC lock, so
+   with a single thread of each kind the durations approximate the lock hold
+   times, and the increase with more threads is time spent waiting. */
+
+enum bench_op {
+  BOP_STORE,
+  BOP_READ,
+  BOP_TAKE,
+  BOP_TAKE_INST,
+  BOP_READ_COND,
+  BOP_TAKE_QCOND
+};
+#define BOP_N (BOP_TAKE_QCOND + 1)
+static const char *bench_opnames[BOP_N] = {
+  "store", "read", "take", "take_inst", "read_cond", "take_qcond"
+};
+
+#define BENCH_MAX_SAMPLES 100
+
+struct bench_opstats {
+  uint64_t ncalls;
+  uint64_t nsamples;
+  int64_t tsum;
+  int64_t tmax;
+};
+
+struct bench_arg {
+  ddsrt_thread_t tid;
+  uint32_t idx;
+  struct rhc *rhc;
+  uint32_t ninst;
+  uint64_t *iids;
+  dds_readcond *rdcond, *qcond;
+  struct proxy_writer *wr;
+  struct bench_opstats stats[BOP_N];
+};
+
+static ddsrt_atomic_uint32_t bench_stop;
+
+static void bench_account (struct bench_opstats *st, dds_time_t t0, int n)
+{
+  const dds_time_t dt = ddsrt_time_monotonic () - t0;
+  if (n < 0)
+    abort ();
+  st->ncalls++;
+  st->nsamples += (uint64_t) n;
+  st->tsum += dt;
+  if (dt > st->tmax)
+    st->tmax = dt;
+}
+
+static uint32_t bench_store_thread (void *varg)
+{
+  struct bench_arg * const arg = varg;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ddsi_serdata **sds = ddsrt_malloc (arg->ninst * sizeof (*sds));
+  struct proxy_writer_info pwr_info;
+  ddsrt_prng_t prng_local;
+
+  ddsrt_prng_init_simple (&prng_local, arg->idx + 1);
+  for (uint32_t i = 0; i < arg->ninst; i++)
+  {
+    RhcTypes_T d = { (int32_t) i, "A", (int32_t) (i + arg->idx), 0, "B" };
+    sds[i] = ddsi_serdata_from_sample (mdtopic, SDK_DATA, &d);
+    sds[i]->statusinfo = 0;
+    sds[i]->timestamp.v = dds_time ();
+  }
+  pwr_info.auto_dispose = arg->wr->c.xqos->writer_data_lifecycle.autodispose_unregistered_instances;
+  pwr_info.guid = arg->wr->e.guid;
+  pwr_info.iid = arg->wr->e.iid;
+  pwr_info.ownership_strength = arg->wr->c.xqos->ownership_strength.value;
+
+  while (!ddsrt_atomic_ld32 (&bench_stop))
+  {
+    struct ddsi_serdata * const sd = sds[ddsrt_prng_random (&prng_local) % arg->ninst];
+    thread_state_awake (ts1);
+    struct ddsi_tkmap_instance *tk = ddsi_tkmap_lookup_instance_ref (sd);
+    const dds_time_t t0 = ddsrt_time_monotonic ();
+    dds_rhc_store (arg->rhc, &pwr_info, sd, tk);
+    bench_account (&arg->stats[BOP_STORE], t0, 1);
+    ddsi_tkmap_instance_unref (tk);
+    thread_state_asleep (ts1);
+  }
+
+  for (uint32_t i = 0; i < arg->ninst; i++)
+    ddsi_serdata_unref (sds[i]);
+  ddsrt_free (sds);
+  return 0;
+}
+
+static uint32_t bench_app_thread (void *varg)
+{
+  struct bench_arg * const arg = varg;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  static const uint32_t anymask = DDS_ANY_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE;
+  dds_sample_info_t iseq[BENCH_MAX_SAMPLES];
+  RhcTypes_T mseq[BENCH_MAX_SAMPLES];
+  void *ptrs[BENCH_MAX_SAMPLES];
+  ddsrt_prng_t prng_local;
+  uint32_t i = 0;
+
+  ddsrt_prng_init_simple (&prng_local, arg->idx + 1);
+  memset (mseq, 0, sizeof (mseq));
+  for (size_t j = 0; j < BENCH_MAX_SAMPLES; j++)
+    ptrs[j] = &mseq[j];
+
+  while (!ddsrt_atomic_ld32 (&bench_stop))
+  {
+    /* mostly reads, as is typical for applications, and enough takes
+       to keep the amount of data in the RHC from saturating */
+    const enum bench_op op = (enum bench_op) (BOP_READ + (i++ % (BOP_N - BOP_READ)));
+    dds_time_t t0 = 0;
+    int n = 0;
+    thread_state_awake (ts1);
+    switch (op)
+    {
+      case BOP_READ:
+        t0 = ddsrt_time_monotonic ();
+        n = dds_rhc_read (arg->rhc, true, ptrs, iseq, BENCH_MAX_SAMPLES, anymask, 0, NULL);
+        break;
+      case BOP_TAKE:
+        t0 = ddsrt_time_monotonic ();
+        n = dds_rhc_take (arg->rhc, true, ptrs, iseq, BENCH_MAX_SAMPLES, anymask, 0, NULL);
+        break;
+      case BOP_TAKE_INST: {
+        const uint64_t iid = arg->iids[ddsrt_prng_random (&prng_local) % arg->ninst];
+        t0 = ddsrt_time_monotonic ();
+        n = dds_rhc_take (arg->rhc, true, ptrs, iseq, BENCH_MAX_SAMPLES, anymask, iid, NULL);
+        break;
+      }
+      case BOP_READ_COND:
+        t0 = ddsrt_time_monotonic ();
+        n = dds_rhc_read (arg->rhc, true, ptrs, iseq, BENCH_MAX_SAMPLES, NO_STATE_MASK_SET, 0, arg->rdcond);
+        break;
+      case BOP_TAKE_QCOND:
+        t0 = ddsrt_time_monotonic ();
+        n = dds_rhc_take (arg->rhc, true, ptrs, iseq, BENCH_MAX_SAMPLES, NO_STATE_MASK_SET, 0, arg->qcond);
+        break;
+      default:
+        abort ();
+    }
+    bench_account (&arg->stats[op], t0, n);
+    thread_state_asleep (ts1);
+  }
+
+  for (size_t j = 0; j < BENCH_MAX_SAMPLES; j++)
+    RhcTypes_T_free (&mseq[j], DDS_FREE_CONTENTS);
+  return 0;
+}
+
+static void bench_one (dds_entity_t pp, dds_entity_t tp, uint32_t nstore, uint32_t napp, double duration, uint32_t ninst, int32_t depth)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, depth);
+  dds_qset_destination_order (qos, DDS_DESTINATIONORDER_BY_RECEPTION_TIMESTAMP);
+  const dds_entity_t rd = dds_create_reader (pp, tp, qos, NULL);
+  dds_delete_qos (qos);
+  const dds_entity_t rdcond = dds_create_readcondition (rd, DDS_NOT_READ_SAMPLE_STATE | DDS_ANY_VIEW_STATE | DDS_ANY_INSTANCE_STATE);
+  const dds_entity_t qcond = dds_create_querycondition (rd, DDS_ANY_STATE, qcpred_attr2);
+  if (rd < 0 || rdcond < 0 || qcond < 0)
+    abort ();
+  struct rhc *rhc;
+  {
+    struct dds_entity *x;
+    if (dds_entity_lock (rd, DDS_KIND_READER, &x) < 0)
+      abort ();
+    rhc = ((dds_reader *) x)->m_rd->rhc;
+    dds_entity_unlock (x);
+  }
+
+  /* instance handles for take_instance, the tkmap entries are kept alive by
+     the references held here for the duration of the run */
+  struct ddsi_tkmap_instance **tks = ddsrt_malloc (ninst * sizeof (*tks));
+  uint64_t *iids = ddsrt_malloc (ninst * sizeof (*iids));
+  thread_state_awake (lookup_thread_state ());
+  for (uint32_t i = 0; i < ninst; i++)
+  {
+    RhcTypes_T d = { (int32_t) i, "A", 0, 0, "B" };
+    struct ddsi_serdata *sd = ddsi_serdata_from_sample (mdtopic, SDK_KEY, &d);
+    tks[i] = ddsi_tkmap_lookup_instance_ref (sd);
+    iids[i] = tks[i]->m_iid;
+    ddsi_serdata_unref (sd);
+  }
+  thread_state_asleep (lookup_thread_state ());
+
+  const uint32_t nthreads = nstore + napp;
+  struct bench_arg *args = ddsrt_malloc (nthreads * sizeof (*args));
+  ddsrt_threadattr_t tattr;
+  ddsrt_threadattr_init (&tattr);
+  ddsrt_atomic_st32 (&bench_stop, 0);
+  const dds_time_t tstart = ddsrt_time_monotonic ();
+  for (uint32_t i = 0; i < nthreads; i++)
+  {
+    struct bench_arg * const arg = &args[i];
+    char name[32];
+    memset (arg, 0, sizeof (*arg));
+    arg->idx = i;
+    arg->rhc = rhc;
+    arg->ninst = ninst;
+    arg->iids = iids;
+    arg->rdcond = get_condaddr (rdcond);
+    arg->qcond = get_condaddr (qcond);
+    arg->wr = (i < nstore) ? mkwr (0) : NULL;
+    snprintf (name, sizeof (name), "%s%"PRIu32, (i < nstore) ? "store" : "app", i);
+    if (ddsrt_thread_create (&arg->tid, name, &tattr, (i < nstore) ? bench_store_thread : bench_app_thread, arg) != DDS_RETCODE_OK)
+      abort ();
+  }
+  dds_sleepfor ((dds_duration_t) (duration * 1e9));
+  ddsrt_atomic_st32 (&bench_stop, 1);
+  for (uint32_t i = 0; i < nthreads; i++)
+    ddsrt_thread_join (args[i].tid, NULL);
+  const double telapsed = (double) (ddsrt_time_monotonic () - tstart) / 1e9;
+
+  for (int op = 0; op < BOP_N; op++)
+  {
+    struct bench_opstats st = { 0, 0, 0, 0 };
+    for (uint32_t i = 0; i < nthreads; i++)
+    {
+      st.ncalls += args[i].stats[op].ncalls;
+      st.nsamples += args[i].stats[op].nsamples;
+      st.tsum += args[i].stats[op].tsum;
+      if (args[i].stats[op].tmax > st.tmax)
+        st.tmax = args[i].stats[op].tmax;
+    }
+    printf ("%6"PRIu32" %5"PRId32" %-10s %10.0f %10.0f %9.2f %9.2f\n",
+            ninst, depth, bench_opnames[op], (double) st.ncalls / telapsed, (double) st.nsamples / telapsed,
+            st.ncalls ? (double) st.tsum / (double) st.ncalls / 1e3 : 0.0, (double) st.tmax / 1e3);
+  }
+  fflush (stdout);
+
+  for (uint32_t i = 0; i < nstore; i++)
+    fwr (args[i].wr);
+  ddsrt_free (args);
+  /* deleting the reader frees the RHC, the tkmap references can only be
+     released after it no longer references them */
+  dds_delete (rd);
+  thread_state_awake (lookup_thread_state ());
+  for (uint32_t i = 0; i < ninst; i++)
+    ddsi_tkmap_instance_unref (tks[i]);
+  thread_state_asleep (lookup_thread_state ());
+  ddsrt_free (tks);
+  ddsrt_free (iids);
+}
+
+static void bench (dds_entity_t pp, dds_entity_t tp, uint32_t nstore, uint32_t napp, double duration)
+{
+  static const uint32_t ninsts[] = { 1, 16, 256, 4096 };
+  static const int32_t depths[] = { 1, 8, 64 };
+  printf ("store threads %"PRIu32" app threads %"PRIu32" duration %gs\n", nstore, napp, duration);
+  printf ("%6s %5s %-10s %10s %10s %9s %9s\n", "ninst", "depth", "op", "calls/s", "samples/s", "mean[us]", "max[us]");
+  for (size_t i = 0; i < sizeof (ninsts) / sizeof (ninsts[0]); i++)
+    for (size_t j = 0; j < sizeof (depths) / sizeof (depths[0]); j++)
+      bench_one (pp, tp, nstore, napp, duration, ninsts[i], depths[j]);
+}
+
 int main (int argc, char **argv)
 {
   dds_entity_t pp = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
@@ -813,22 +1079,42 @@ int main (int argc, char **argv)
   unsigned seed = 0;
   bool print = false;
   int first = 0, count = 10000;
+  bool bench_mode = false;
+  uint32_t nstore = 2, napp = 2;
+  double duration = 1.0;
 
   ddsrt_mutex_init (&wait_gc_cycle_lock);
   ddsrt_cond_init (&wait_gc_cycle_cond);
 
-  if (argc > 1)
-    seed = (unsigned) atoi (argv[1]);
-  if (seed == 0)
-    seed = (unsigned) ddsrt_getpid ();
-  if (argc > 2)
-    first = atoi (argv[2]);
-  if (argc > 3)
-    count = atoi (argv[3]);
-  if (argc > 4)
-    print = (atoi (argv[4]) != 0);
-
-  printf ("prng seed %u first %d count %d print %d\n", seed, first, count, print);
+  if (argc > 1 && strcmp (argv[1], "bench") == 0)
+  {
+    if (argc > 2)
+      nstore = (uint32_t) atoi (argv[2]);
+    if (argc > 3)
+      napp = (uint32_t) atoi (argv[3]);
+    if (argc > 4)
+      duration = atof (argv[4]);
+    if (nstore == 0 || napp == 0 || duration <= 0.0)
+    {
+      fprintf (stderr, "usage: %s bench [NSTORE [NAPP [SECS]]]\n", argv[0]);
+      return 1;
+    }
+    bench_mode = true;
+  }
+  else
+  {
+    if (argc > 1)
+      seed = (unsigned) atoi (argv[1]);
+    if (seed == 0)
+      seed = (unsigned) ddsrt_getpid ();
+    if (argc > 2)
+      first = atoi (argv[2]);
+    if (argc > 3)
+      count = atoi (argv[3]);
+    if (argc > 4)
+      print = (atoi (argv[4]) != 0);
+    printf ("prng seed %u first %d count %d print %d\n", seed, first, count, print);
+  }
   ddsrt_prng_init_simple (&prng, seed);
 
   memset (rres_mseq, 0, sizeof (rres_mseq));
@@ -844,6 +1130,12 @@ int main (int argc, char **argv)
     dds_entity_unlock(x);
   }
 
+  if (bench_mode)
+  {
+    bench (pp, tp, nstore, napp, duration);
+    first = INT_MAX; /* skip the correctness tests */
+  }
+
   if (0 >= first)
   {
     if (print)
@@ -111,4 +111,10 @@
 # define ddsrt_attribute_packed
 #endif
 
+#if defined(__GNUC__)
+# define ddsrt_expect_false(x) __builtin_expect(!!(x), 0)
+#else
+# define ddsrt_expect_false(x) (x)
+#endif
+
 #endif /* DDSRT_ATTRIBUTES_H */
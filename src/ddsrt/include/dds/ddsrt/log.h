@@ -26,6 +26,7 @@
 
 #include "dds/export.h"
 #include "dds/ddsrt/attributes.h"
+#include "dds/ddsrt/retcode.h"
 
 #if defined (__cplusplus)
 extern "C" {
@@ -82,6 +83,19 @@ extern "C" {
      DDS_LC_TIMING | DDS_LC_TRAFFIC | DDS_LC_TCP | DDS_LC_THROTTLE)
 /** @}*/
 
+/**
+ * @brief Categories compiled into the library.
+ *
+ * Log calls for other categories are eliminated at compile time, fatal and
+ * error messages are always retained. Set using the LOG_CATEGORIES build
+ * option.
+ */
+#ifndef DDSRT_LOG_CATEGORIES
+#define DDSRT_LOG_CATEGORIES (~0u)
+#endif
+#define DDS_LOG_COMPILED_MASK \
+    (DDSRT_LOG_CATEGORIES | DDS_LC_FATAL | DDS_LC_ERROR)
+
 #define DDS_LOG_MASK \
     (DDS_LC_FATAL | DDS_LC_ERROR | DDS_LC_WARNING | DDS_LC_INFO)
 
@@ -109,17 +123,40 @@ typedef void(*dds_log_write_fn_t)(void *, const dds_log_data_t *);
 
 DDS_EXPORT extern uint32_t *const dds_log_mask;
 
+#if defined(ddsc_EXPORTS)
+/* Within the library the mask is read directly, instead of through the
+   exported pointer, saving the indirection (and the GOT lookup) on every
+   check of the log mask. */
+DDS_NO_EXPORT extern uint32_t ddsrt_log_mask;
+#define DDSRT_LOG_MASK_VALUE (ddsrt_log_mask)
+#else
+#define DDSRT_LOG_MASK_VALUE (*dds_log_mask)
+#endif
+
 /**
  * @brief Get currently enabled log and trace categories.
  *
+ * Categories that were not compiled in are never reported as enabled, so
+ * that tests of the mask against those categories are eliminated by the
+ * compiler.
+ *
  * @returns A uint32_t with enabled categories set.
  */
 inline uint32_t
 dds_get_log_mask(void)
 {
-    return *dds_log_mask;
+    return DDSRT_LOG_MASK_VALUE & DDS_LOG_COMPILED_MASK;
 }
 
+/**
+ * @brief Test whether any of the categories in cat is enabled.
+ *
+ * Tracing is generally disabled, and the test is marked as expected to fail
+ * so the compiler moves the logging code out of the way.
+ */
+#define DDS_LOG_ENABLED(cat) \
+    ddsrt_expect_false(dds_get_log_mask() & (cat))
+
 /**
  * @brief Set enabled log and trace categories.
  *
@@ -185,6 +222,38 @@ dds_set_trace_sink(
     dds_log_write_fn_t callback,
     void *userdata);
 
+/**
+ * @brief Start writing log and trace messages asynchronously
+ *
+ * Once started, log and trace messages are queued in a per-thread buffer of
+ * (approximately) bufsize bytes and written to the sinks by a background
+ * thread, in timestamp order. Logging threads never block on the sinks:
+ * messages that do not fit in the buffer are dropped and the number of
+ * dropped messages is reported in the log. Fatal messages are always
+ * written synchronously.
+ *
+ * @param[in]  bufsize  Per-thread buffer size in bytes (at least 16kB is used).
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             Asynchronous logging started.
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET
+ *             Asynchronous logging was already started.
+ */
+DDS_EXPORT dds_return_t
+dds_log_async_start(
+    uint32_t bufsize);
+
+/**
+ * @brief Stop writing log and trace messages asynchronously
+ *
+ * Writes all queued messages before returning, once it returns all messages
+ * are written synchronously again.
+ */
+DDS_EXPORT void
+dds_log_async_stop(void);
+
 /**
  * @brief Write a log or trace message.
  *
@@ -278,7 +347,7 @@ dds_log(
  * separate from logging, if only cosmetic.
  */
 #define DDS_LOG(cat, ...) \
-    ((dds_get_log_mask() & (cat)) ? \
+    (DDS_LOG_ENABLED(cat) ? \
       dds_log(cat, __FILE__, __LINE__, DDS_FUNCTION, __VA_ARGS__) : 0)
 
 /** Write a log message of type #DDS_LC_INFO. */
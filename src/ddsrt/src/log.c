@@ -10,14 +10,18 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 #include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/threads.h"
+#include "dds/ddsrt/time.h"
 
 #define MAX_TIMESTAMP_LEN (10 + 1 + 6)
 #define MAX_TID_LEN (10)
@@ -41,7 +45,7 @@ static ddsrt_thread_local log_buffer_t log_buffer;
 static ddsrt_once_t lock_inited = DDSRT_ONCE_INIT;
 static ddsrt_rwlock_t lock;
 
-static uint32_t log_mask = DDS_LC_ERROR | DDS_LC_WARNING;
+uint32_t ddsrt_log_mask = DDS_LC_ERROR | DDS_LC_WARNING;
 
 static void default_sink(void *ptr, const dds_log_data_t *data)
 {
@@ -49,6 +53,49 @@ static void default_sink(void *ptr, const dds_log_data_t *data)
   fflush((FILE *)ptr);
 }
 
+/* Asynchronous logging: every thread that logs gets its own single-producer,
+   single-consumer ring of formatted lines, which a background thread merges
+   on timestamp (of the lines queued at that time) and writes to the sinks. Producers never block: when a ring
+   is full the line is dropped and counted, and the writer reports the number
+   of lost lines. Rings are never freed while the process runs, a ring whose
+   thread terminated is recycled for the next thread that starts logging. */
+struct log_ring_rec {
+  uint32_t len; /* length of text, including header and newline */
+  uint32_t cat;
+  uint32_t line;
+  const char *file;
+  const char *func;
+  dds_time_t tstamp;
+};
+
+#define LOG_RING_ALIGN(x) (((x) + 7u) & ~(size_t)7u)
+#define LOG_RING_MIN_SIZE 16384u
+
+struct log_ring {
+  struct log_ring *next;
+  ddsrt_atomic_uint32_t busy;
+  ddsrt_atomic_uint32_t orphan;
+  ddsrt_atomic_uint32_t lost;
+  ddsrt_atomic_uint32_t head; /* written by producer only */
+  ddsrt_atomic_uint32_t tail; /* written by consumer only */
+  uint32_t size; /* power of 2 */
+  char name[MAX_TID_LEN + 1];
+  char *buf;
+};
+
+static ddsrt_thread_local struct log_ring *log_ring;
+
+static struct {
+  ddsrt_atomic_uint32_t enabled;
+  ddsrt_mutex_t lock;
+  ddsrt_cond_t cond;
+  struct log_ring *rings;
+  uint32_t ring_size;
+  int terminate;
+  int running;
+  ddsrt_thread_t tid;
+} async;
+
 static void nop_sink(void *ptr, const dds_log_data_t *data)
 {
   (void)ptr;
@@ -68,7 +115,7 @@ static log_sink_t sinks[] = {
   { .funcs = { nop_sink,     default_sink }, .ptr = NULL, .out = NULL }
 };
 
-uint32_t *const dds_log_mask = &log_mask;
+uint32_t *const dds_log_mask = &ddsrt_log_mask;
 
 #define RDLOCK (1)
 #define WRLOCK (2)
@@ -76,6 +123,8 @@ uint32_t *const dds_log_mask = &log_mask;
 static void init_lock(void)
 {
   ddsrt_rwlock_init(&lock);
+  ddsrt_mutex_init(&async.lock);
+  ddsrt_cond_init(&async.cond);
   sinks[LOG].ptr = sinks[TRACE].ptr = stderr;
   sinks[LOG].out = sinks[TRACE].out = stderr;
 }
@@ -190,18 +239,16 @@ dds_set_log_mask(uint32_t cats)
   unlock_sink();
 }
 
-static void print_header(char *str)
+static void print_header(char *str, dds_time_t time)
 {
   int cnt;
   char *tid, buf[MAX_TID_LEN+1] = { 0 };
   static const char fmt[] = "%10u.%06d/%*.*s:";
-  dds_time_t time;
   unsigned sec;
   int usec;
 
   (void)ddsrt_thread_getname(buf, sizeof(buf));
   tid = (buf[0] == '\0' ? "(anon)" : buf);
-  time = dds_time();
   sec = (unsigned)(time / DDS_NSECS_IN_SEC);
   usec = (int)((time % DDS_NSECS_IN_SEC) / DDS_NSECS_IN_USEC);
 
@@ -211,6 +258,281 @@ static void print_header(char *str)
   str[cnt] = ' '; /* Replace snprintf null byte by space. */
 }
 
+/* Must be called with the sink lock held. If batch is set, the default sink
+   doesn't flush and the caller is responsible for flushing the FILEs. */
+static void write_to_sinks(const dds_log_data_t *data, int batch)
+{
+  for (size_t i = (data->priority & DDS_LOG_MASK) ? LOG : TRACE;
+              i < sizeof(sinks) / sizeof(sinks[0]);
+              i++)
+  {
+    if (batch && sinks[i].funcs[USE] == default_sink) {
+      fwrite(data->message - HDR_LEN, 1, HDR_LEN + data->size + 1, (FILE *)sinks[i].ptr);
+    } else {
+      sinks[i].funcs[USE](sinks[i].ptr, data);
+    }
+  }
+}
+
+static void log_ring_cleanup(void *arg)
+{
+  struct log_ring *r = arg;
+  ddsrt_atomic_st32(&r->orphan, 1);
+}
+
+static struct log_ring *log_ring_get(void)
+{
+  struct log_ring *r;
+  if ((r = log_ring) != NULL) {
+    return r;
+  }
+  ddsrt_mutex_lock(&async.lock);
+  for (r = async.rings; r != NULL; r = r->next) {
+    if (ddsrt_atomic_ld32(&r->orphan)) {
+      break;
+    }
+  }
+  if (r == NULL) {
+    if ((r = ddsrt_malloc_s(sizeof(*r))) == NULL ||
+        (r->buf = ddsrt_malloc_s(async.ring_size)) == NULL) {
+      ddsrt_free(r);
+      ddsrt_mutex_unlock(&async.lock);
+      return NULL;
+    }
+    ddsrt_atomic_st32(&r->busy, 0);
+    ddsrt_atomic_st32(&r->lost, 0);
+    ddsrt_atomic_st32(&r->head, 0);
+    ddsrt_atomic_st32(&r->tail, 0);
+    r->size = async.ring_size;
+    r->next = async.rings;
+    async.rings = r;
+  }
+  ddsrt_atomic_st32(&r->orphan, 0);
+  (void)ddsrt_thread_getname(r->name, sizeof(r->name));
+  ddsrt_mutex_unlock(&async.lock);
+  if (ddsrt_thread_cleanup_push(log_ring_cleanup, r) != DDS_RETCODE_OK) {
+    log_ring_cleanup(r);
+    return NULL;
+  }
+  log_ring = r;
+  return r;
+}
+
+static void log_ring_copyin(struct log_ring *r, uint32_t pos, const void *src, size_t n)
+{
+  const uint32_t off = pos & (r->size - 1);
+  const size_t n1 = (n <= r->size - off) ? n : r->size - off;
+  memcpy(r->buf + off, src, n1);
+  memcpy(r->buf, (const char *)src + n1, n - n1);
+}
+
+static void log_ring_copyout(const struct log_ring *r, uint32_t pos, void *dst, size_t n)
+{
+  const uint32_t off = pos & (r->size - 1);
+  const size_t n1 = (n <= r->size - off) ? n : r->size - off;
+  memcpy(dst, r->buf + off, n1);
+  memcpy((char *)dst + n1, r->buf, n - n1);
+}
+
+/* Returns 0 if asynchronous logging is disabled, and the caller has to write
+   the line to the sinks itself. A line that doesn't fit is dropped. */
+static int log_ring_enqueue(const dds_log_data_t *data, dds_time_t tstamp)
+{
+  struct log_ring *r;
+  struct log_ring_rec rec;
+  uint32_t head, used, need;
+
+  if (!ddsrt_atomic_ld32(&async.enabled) || (r = log_ring_get()) == NULL) {
+    return 0;
+  }
+
+  /* Stopping clears "enabled" and then waits for "busy" to be cleared on all
+     rings, the full fence orders the two so a stop can't miss an enqueue. */
+  ddsrt_atomic_st32(&r->busy, 1);
+  ddsrt_atomic_fence();
+  if (!ddsrt_atomic_ld32(&async.enabled)) {
+    ddsrt_atomic_st32(&r->busy, 0);
+    return 0;
+  }
+
+  rec.len = (uint32_t)(HDR_LEN + data->size + 1);
+  rec.cat = data->priority;
+  rec.line = data->line;
+  rec.file = data->file;
+  rec.func = data->function;
+  rec.tstamp = tstamp;
+  need = (uint32_t)LOG_RING_ALIGN(sizeof(rec) + rec.len);
+  head = ddsrt_atomic_ld32(&r->head);
+  used = head - ddsrt_atomic_ld32(&r->tail);
+  if (need > r->size - used) {
+    ddsrt_atomic_inc32(&r->lost);
+  } else {
+    log_ring_copyin(r, head, &rec, sizeof(rec));
+    log_ring_copyin(r, head + (uint32_t)sizeof(rec), data->message - HDR_LEN, rec.len);
+    ddsrt_atomic_fence_rel();
+    ddsrt_atomic_st32(&r->head, head + need);
+    if (used + need > r->size / 2) {
+      ddsrt_cond_signal(&async.cond);
+    }
+  }
+  ddsrt_atomic_fence_rel();
+  ddsrt_atomic_st32(&r->busy, 0);
+  return 1;
+}
+
+/* Writes all lines queued at the time of the call, merging the rings on
+   timestamp. Must be called with async.lock held, which makes the caller the
+   only consumer. */
+static void log_rings_drain(void)
+{
+  struct log_ring *r, *min;
+  struct log_ring_rec rec, minrec;
+  char buf[HDR_LEN + sizeof(log_buffer.buf) + 1];
+  dds_log_data_t data;
+  int any = 0;
+
+  lock_sink(RDLOCK);
+  for (r = async.rings; r != NULL; r = r->next) {
+    uint32_t lost;
+    if ((lost = ddsrt_atomic_ld32(&r->lost)) > 0) {
+      int n;
+      ddsrt_atomic_sub32(&r->lost, lost);
+      print_header(buf, dds_time());
+      n = snprintf(buf + HDR_LEN, sizeof(buf) - HDR_LEN, "%"PRIu32" lines from thread %s lost\n", lost, r->name);
+      data.priority = DDS_LC_WARNING;
+      data.file = __FILE__;
+      data.function = "log_rings_drain";
+      data.line = __LINE__;
+      data.message = buf + HDR_LEN;
+      data.size = (size_t)n - 1;
+      write_to_sinks(&data, 1);
+      any = 1;
+    }
+  }
+
+  do {
+    min = NULL;
+    for (r = async.rings; r != NULL; r = r->next) {
+      const uint32_t tail = ddsrt_atomic_ld32(&r->tail);
+      if (tail != ddsrt_atomic_ld32(&r->head)) {
+        ddsrt_atomic_fence_acq();
+        log_ring_copyout(r, tail, &rec, sizeof(rec));
+        if (min == NULL || rec.tstamp < minrec.tstamp) {
+          min = r;
+          minrec = rec;
+        }
+      }
+    }
+    if (min != NULL) {
+      const uint32_t tail = ddsrt_atomic_ld32(&min->tail);
+      assert(minrec.len <= sizeof(buf));
+      log_ring_copyout(min, tail + (uint32_t)sizeof(minrec), buf, minrec.len);
+      data.priority = minrec.cat;
+      data.file = minrec.file;
+      data.function = minrec.func;
+      data.line = minrec.line;
+      data.message = buf + HDR_LEN;
+      data.size = minrec.len - HDR_LEN - 1;
+      write_to_sinks(&data, 1);
+      any = 1;
+      ddsrt_atomic_fence_rel();
+      ddsrt_atomic_st32(&min->tail, tail + (uint32_t)LOG_RING_ALIGN(sizeof(minrec) + minrec.len));
+    }
+  } while (min != NULL);
+
+  if (any) {
+    if (sinks[LOG].funcs[USE] == default_sink) {
+      fflush((FILE *)sinks[LOG].ptr);
+    }
+    if (sinks[TRACE].funcs[USE] == default_sink) {
+      fflush((FILE *)sinks[TRACE].ptr);
+    }
+  }
+  unlock_sink();
+}
+
+static uint32_t log_writer_thread(void *arg)
+{
+  (void)arg;
+  /* Claim a ring before taking the lock, a sink that logs would otherwise
+     deadlock trying to register this thread while the writer holds it */
+  (void)log_ring_get();
+  ddsrt_mutex_lock(&async.lock);
+  while (!async.terminate) {
+    log_rings_drain();
+    (void)ddsrt_cond_waitfor(&async.cond, &async.lock, DDS_MSECS(10));
+  }
+  ddsrt_mutex_unlock(&async.lock);
+  return 0;
+}
+
+dds_return_t dds_log_async_start(uint32_t bufsize)
+{
+  dds_return_t ret = DDS_RETCODE_OK;
+  ddsrt_threadattr_t attr;
+  uint32_t size = LOG_RING_MIN_SIZE;
+
+  while (size < bufsize && size < (UINT32_MAX >> 1) + 1) {
+    size <<= 1;
+  }
+
+  ddsrt_once(&lock_inited, &init_lock);
+  ddsrt_mutex_lock(&async.lock);
+  if (async.running) {
+    ret = DDS_RETCODE_PRECONDITION_NOT_MET;
+  } else {
+    /* Existing rings keep their size, which only matters if asynchronous
+       logging gets restarted with a different buffer size. */
+    async.ring_size = size;
+    async.terminate = 0;
+    ddsrt_threadattr_init(&attr);
+    if ((ret = ddsrt_thread_create(&async.tid, "log", &attr, log_writer_thread, NULL)) == DDS_RETCODE_OK) {
+      async.running = 1;
+      ddsrt_atomic_st32(&async.enabled, 1);
+    }
+  }
+  ddsrt_mutex_unlock(&async.lock);
+  return ret;
+}
+
+void dds_log_async_stop(void)
+{
+  struct log_ring *r;
+
+  ddsrt_once(&lock_inited, &init_lock);
+  ddsrt_mutex_lock(&async.lock);
+  if (!async.running) {
+    ddsrt_mutex_unlock(&async.lock);
+    return;
+  }
+  ddsrt_atomic_st32(&async.enabled, 0);
+  ddsrt_atomic_fence();
+  for (r = async.rings; r != NULL; r = r->next) {
+    while (ddsrt_atomic_ld32(&r->busy)) {
+      dds_sleepfor(DDS_USECS(10));
+    }
+  }
+  async.terminate = 1;
+  ddsrt_cond_broadcast(&async.cond);
+  ddsrt_mutex_unlock(&async.lock);
+  (void)ddsrt_thread_join(async.tid, NULL);
+
+  ddsrt_mutex_lock(&async.lock);
+  log_rings_drain();
+  async.running = 0;
+  ddsrt_mutex_unlock(&async.lock);
+}
+
+static void log_async_flush(void)
+{
+  if (ddsrt_atomic_ld32(&async.enabled)) {
+    (void)log_ring_get();
+    ddsrt_mutex_lock(&async.lock);
+    log_rings_drain();
+    ddsrt_mutex_unlock(&async.lock);
+  }
+}
+
 static void vlog(
   uint32_t cat,
   const char *file,
@@ -223,12 +545,12 @@ static void vlog(
   size_t nrem;
   log_buffer_t *lb;
   dds_log_data_t data;
+  dds_time_t tstamp;
 
   if (*fmt == 0) {
     return;
   }
 
-  lock_sink(RDLOCK);
   lb = &log_buffer;
 
   /* Thread-local buffer is always initialized with all zeroes. The pos
@@ -256,7 +578,8 @@ static void vlog(
   }
 
   if (fmt[strlen (fmt) - 1] == '\n') {
-    print_header(lb->buf);
+    tstamp = dds_time();
+    print_header(lb->buf, tstamp);
 
     data.priority = cat;
     data.file = file;
@@ -265,18 +588,20 @@ static void vlog(
     data.message = lb->buf + BUF_OFFSET;
     data.size = strlen(data.message) - 1;
 
-    for (size_t i = (cat & DDS_LOG_MASK) ? LOG : TRACE;
-                i < sizeof(sinks) / sizeof(sinks[0]);
-                i++)
-    {
-      sinks[i].funcs[USE](sinks[i].ptr, &data);
+    /* Fatal messages are written synchronously, as the process is about to
+       be aborted, after first writing whatever is still queued. */
+    if ((cat & DDS_LC_FATAL) || !log_ring_enqueue(&data, tstamp)) {
+      if (cat & DDS_LC_FATAL) {
+        log_async_flush();
+      }
+      lock_sink(RDLOCK);
+      write_to_sinks(&data, 0);
+      unlock_sink();
     }
 
     lb->pos = BUF_OFFSET;
     lb->buf[lb->pos] = 0;
   }
-
-  unlock_sink();
 }
 
 int
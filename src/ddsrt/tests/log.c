@@ -368,3 +368,60 @@ CU_Test(dds_log, synchronous_sink_changes, .fini=reset)
   CU_ASSERT(arg.before < arg.after);
   CU_ASSERT(arg.after < dds_time());
 }
+
+struct async_arg {
+  ddsrt_mutex_t *mutex;
+  uint32_t written;
+  uint32_t lost;
+};
+
+static void async_count(void *ptr, const dds_log_data_t *data)
+{
+  struct async_arg *arg = (struct async_arg *)ptr;
+  unsigned lost;
+  ddsrt_mutex_lock(arg->mutex);
+  if (strstr(data->message, "foobar") != NULL) {
+    arg->written++;
+  } else if (sscanf(data->message, "%u lines from thread", &lost) == 1) {
+    arg->lost += lost;
+  }
+  ddsrt_mutex_unlock(arg->mutex);
+}
+
+/* Asynchronous logging must either write a message or account for it in the
+   number of lost messages, blocking the writer (by blocking the sink) forces
+   messages to be dropped. */
+CU_Test(dds_log, async_loss_accounting, .fini=reset)
+{
+  struct async_arg arg;
+  dds_return_t ret;
+  const uint32_t n = 1000;
+
+  ddsrt_mutex_init(&mutex);
+  (void)memset(&arg, 0, sizeof(arg));
+  arg.mutex = &mutex;
+
+  dds_set_log_mask(DDS_LC_ERROR | DDS_LC_WARNING | DDS_LC_TRACE);
+  dds_set_log_sink(&dummy, NULL);
+  dds_set_trace_sink(&async_count, &arg);
+  ret = dds_log_async_start(0);
+  CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+  ret = dds_log_async_start(0);
+  CU_ASSERT_EQUAL(ret, DDS_RETCODE_PRECONDITION_NOT_MET);
+
+  ddsrt_mutex_lock(&mutex);
+  for (uint32_t i = 0; i < n; i++) {
+    DDS_TRACE("foobar %u\n", (unsigned)i);
+  }
+  ddsrt_mutex_unlock(&mutex);
+  dds_log_async_stop();
+
+  CU_ASSERT(arg.lost > 0);
+  CU_ASSERT_EQUAL(arg.written + arg.lost, n);
+
+  /* Once stopped, messages are written synchronously again. */
+  arg.written = 0;
+  DDS_TRACE("foobar\n");
+  CU_ASSERT_EQUAL(arg.written, 1);
+  ddsrt_mutex_destroy(&mutex);
+}
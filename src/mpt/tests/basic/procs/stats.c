@@ -0,0 +1,253 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mpt/mpt.h"
+
+#include "dds/dds.h"
+
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/process.h"
+
+#include "stats.h"
+#include "helloworlddata.h"
+
+static bool
+get_stat(dds_entity_t entity, const char *name, uint64_t *value)
+{
+  dds_stat_keyvalue_t stats[32];
+  dds_return_t n = dds_get_statistics(entity, stats, sizeof(stats) / sizeof(stats[0]));
+  for (dds_return_t i = 0; i < n; i++) {
+    if (strcmp(stats[i].name, name) == 0) {
+      *value = stats[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Publisher that checks the flight recorder records the protocol events of
+ * a reliable write: it waits for the subscriber(s), writes a sample, waits
+ * until the sample has been acknowledged and then checks that the number of
+ * recorded events went up.  The heartbeats and acknowledgements that are
+ * recorded are only exchanged with remote readers, hence the separate
+ * processes.
+ */
+MPT_ProcessEntry(stats_publisher,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int sub_cnt,
+                          const char *text))
+{
+  dds_publication_matched_status_t pm;
+  HelloWorldData_Msg msg;
+  dds_entity_t participant;
+  dds_entity_t topic;
+  dds_entity_t writer;
+  dds_return_t rc;
+  dds_qos_t *qos;
+  dds_time_t tdeadline;
+  uint64_t nevents0, nevents1, unacked, nreaders;
+  int id = (int)ddsrt_getpid();
+
+  assert(topic_name);
+  assert(text);
+
+  printf("=== [Publisher(%d)] Start(%d) ...\n", id, domainid);
+
+  qos = dds_create_qos();
+  dds_qset_durability(qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(10));
+
+  participant = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT(participant, 0, "Could not create participant: %s\n", dds_strretcode(-participant));
+  topic = dds_create_topic (
+            participant, &HelloWorldData_Msg_desc, topic_name, qos, NULL);
+  MPT_ASSERT_FATAL_GT(topic, 0, "Could not create topic: %s\n", dds_strretcode(-topic));
+  writer = dds_create_writer (participant, topic, qos, NULL);
+  MPT_ASSERT_FATAL_GT(writer, 0, "Could not create writer: %s\n", dds_strretcode(-writer));
+
+  /* Wait for expected nr of subscriber(s), all of which are reliable. */
+  tdeadline = dds_time() + DDS_SECS(10);
+  do {
+    rc = dds_get_publication_matched_status(writer, &pm);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not get publication matched status\n");
+    MPT_ASSERT_FATAL_LT(dds_time(), tdeadline, "No subscriber(s) found\n");
+    dds_sleepfor(DDS_MSECS(10));
+  } while (pm.current_count != (uint32_t)sub_cnt);
+  MPT_ASSERT_FATAL(get_stat(writer, "reliable_readers", &nreaders), "No reliable_readers statistic\n");
+  MPT_ASSERT_FATAL_EQ(nreaders, (uint64_t)sub_cnt, "Unexpected number of reliable readers\n");
+
+  MPT_ASSERT_FATAL(get_stat(participant, "flightrec_events", &nevents0), "No flightrec_events statistic\n");
+
+  /* Write sample and wait until all readers have acknowledged it: the
+     sample is unacknowledged from the moment it is written, so once
+     nothing is left unacknowledged, an acknowledgement must have arrived
+     after the write. */
+  msg.userID = (int32_t)id;
+  msg.message = (char*)text;
+  printf("=== [Publisher(%d)] Send: { %d, %s }\n", id, msg.userID, msg.message);
+  rc = dds_write (writer, &msg);
+  MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not write sample\n");
+  tdeadline = dds_time() + DDS_SECS(10);
+  do {
+    MPT_ASSERT_FATAL(get_stat(writer, "whc_unacked_bytes", &unacked), "No whc_unacked_bytes statistic\n");
+    MPT_ASSERT_FATAL_LT(dds_time(), tdeadline, "Sample not acknowledged\n");
+    if (unacked > 0) {
+      dds_sleepfor(DDS_MSECS(10));
+    }
+  } while (unacked > 0);
+
+  /* Sending the heartbeat and receiving the acknowledgement are both
+     recorded. */
+  MPT_ASSERT_FATAL(get_stat(participant, "flightrec_events", &nevents1), "No flightrec_events statistic\n");
+  printf("=== [Publisher(%d)] Flight recorder events: %llu -> %llu\n", id,
+         (unsigned long long)nevents0, (unsigned long long)nevents1);
+  MPT_ASSERT_GT(nevents1, nevents0, "No flight recorder events for an acknowledged write\n");
+
+  /* Wait for subscriber(s) to have finished. */
+  do {
+    rc = dds_get_publication_matched_status(writer, &pm);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not get publication matched status\n");
+    dds_sleepfor(DDS_MSECS(10));
+  } while (pm.current_count != 0);
+
+  rc = dds_delete (participant);
+  MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Teardown failed\n");
+
+  dds_delete_qos(qos);
+
+  printf("=== [Publisher(%d)] Done\n", id);
+}
+
+
+/*
+ * Publisher that checks write batching with the packets_sent statistic of
+ * the participant: with a latency budget, writes are held back until the
+ * budget expires and then go out in a single packet; reaching max_bytes
+ * sends the packet immediately.  Only data for remote readers is sent,
+ * hence the separate processes.  All but the last of the sample_cnt
+ * samples are written with the latency budget, the last with max_bytes.
+ */
+#define BATCH_BUDGET DDS_MSECS(50)
+
+MPT_ProcessEntry(batch_publisher,
+                 MPT_Args(dds_domainid_t domainid,
+                          const char *topic_name,
+                          int sample_cnt,
+                          const char *text))
+{
+  dds_publication_matched_status_t pm;
+  HelloWorldData_Msg msg;
+  dds_entity_t participant;
+  dds_entity_t topic;
+  dds_entity_t writer;
+  dds_return_t rc;
+  dds_qos_t *qos;
+  dds_time_t tdeadline, twrite, tsent;
+  uint64_t npackets0, npackets1, unacked;
+  int id = (int)ddsrt_getpid();
+
+  assert(topic_name);
+  assert(text);
+  assert(sample_cnt >= 2);
+
+  printf("=== [Publisher(%d)] Start(%d) ...\n", id, domainid);
+
+  qos = dds_create_qos();
+  dds_qset_durability(qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(10));
+
+  participant = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT(participant, 0, "Could not create participant: %s\n", dds_strretcode(-participant));
+  topic = dds_create_topic (
+            participant, &HelloWorldData_Msg_desc, topic_name, qos, NULL);
+  MPT_ASSERT_FATAL_GT(topic, 0, "Could not create topic: %s\n", dds_strretcode(-topic));
+  writer = dds_create_writer (participant, topic, qos, NULL);
+  MPT_ASSERT_FATAL_GT(writer, 0, "Could not create writer: %s\n", dds_strretcode(-writer));
+
+  /* Wait for the subscriber and give discovery some time to quiet down,
+     so that the writer is the only source of packets. */
+  tdeadline = dds_time() + DDS_SECS(10);
+  do {
+    rc = dds_get_publication_matched_status(writer, &pm);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not get publication matched status\n");
+    MPT_ASSERT_FATAL_LT(dds_time(), tdeadline, "No subscriber found\n");
+    dds_sleepfor(DDS_MSECS(10));
+  } while (pm.current_count != 1);
+  dds_sleepfor(DDS_SECS(1));
+
+  /* Latency budget, no size limit: nothing goes out until the budget
+     expires, then everything goes out in one packet.  Each sample has a
+     key of its own so the subscriber gets all of them. */
+  rc = dds_write_set_batch_policy(writer, 0, BATCH_BUDGET);
+  MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not set batch policy\n");
+  msg.message = (char*)text;
+  MPT_ASSERT_FATAL(get_stat(participant, "packets_sent", &npackets0), "No packets_sent statistic\n");
+  twrite = dds_time();
+  for (int i = 0; i < sample_cnt - 1; i++) {
+    msg.userID = (int32_t)i;
+    rc = dds_write (writer, &msg);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not write sample\n");
+  }
+  MPT_ASSERT_FATAL(get_stat(participant, "packets_sent", &npackets1), "No packets_sent statistic\n");
+  MPT_ASSERT_EQ(npackets1, npackets0, "Packet sent before the latency budget expired\n");
+  tdeadline = twrite + DDS_SECS(1);
+  do {
+    dds_sleepfor(DDS_MSECS(1));
+    MPT_ASSERT_FATAL(get_stat(participant, "packets_sent", &npackets1), "No packets_sent statistic\n");
+    MPT_ASSERT_FATAL_LT(dds_time(), tdeadline, "Nothing sent after the latency budget expired\n");
+  } while (npackets1 == npackets0);
+  tsent = dds_time();
+  printf("=== [Publisher(%d)] Batch of %d sent after %lldus in %llu packet(s)\n", id, sample_cnt - 1,
+         (long long)((tsent - twrite) / 1000), (unsigned long long)(npackets1 - npackets0));
+  MPT_ASSERT_GEQ(tsent - twrite, BATCH_BUDGET, "Batch sent before the latency budget expired\n");
+  MPT_ASSERT_EQ(npackets1, npackets0 + 1, "Batch not sent in a single packet\n");
+
+  /* Any data reaches max_bytes = 1, so the packet goes out immediately
+     regardless of the (long) latency budget. */
+  rc = dds_write_set_batch_policy(writer, 1, DDS_SECS(10));
+  MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not set batch policy\n");
+  MPT_ASSERT_FATAL(get_stat(participant, "packets_sent", &npackets0), "No packets_sent statistic\n");
+  msg.userID = (int32_t)(sample_cnt - 1);
+  rc = dds_write (writer, &msg);
+  MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not write sample\n");
+  MPT_ASSERT_FATAL(get_stat(participant, "packets_sent", &npackets1), "No packets_sent statistic\n");
+  MPT_ASSERT_EQ(npackets1, npackets0 + 1, "Packet not sent on reaching max_bytes\n");
+
+  /* Everything must arrive. */
+  tdeadline = dds_time() + DDS_SECS(10);
+  do {
+    MPT_ASSERT_FATAL(get_stat(writer, "whc_unacked_bytes", &unacked), "No whc_unacked_bytes statistic\n");
+    MPT_ASSERT_FATAL_LT(dds_time(), tdeadline, "Samples not acknowledged\n");
+    if (unacked > 0) {
+      dds_sleepfor(DDS_MSECS(10));
+    }
+  } while (unacked > 0);
+
+  /* Wait for subscriber to have finished. */
+  do {
+    rc = dds_get_publication_matched_status(writer, &pm);
+    MPT_ASSERT_FATAL_EQ(rc, DDS_RETCODE_OK, "Could not get publication matched status\n");
+    dds_sleepfor(DDS_MSECS(10));
+  } while (pm.current_count != 0);
+
+  rc = dds_delete (participant);
+  MPT_ASSERT_EQ(rc, DDS_RETCODE_OK, "Teardown failed\n");
+
+  dds_delete_qos(qos);
+
+  printf("=== [Publisher(%d)] Done\n", id);
+}
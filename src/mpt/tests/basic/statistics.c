@@ -0,0 +1,32 @@
+#include "mpt/mpt.h"
+#include "procs/hello.h" /* subscriber entry point. */
+#include "procs/stats.h" /* publisher entry point. */
+
+
+/*
+ * Tests to check the statistics that can only be verified with remote
+ * entities.
+ */
+
+
+/*
+ * The publisher checks that the flight recorder records the heartbeat and
+ * acknowledgement of a reliable write matched by the subscriber.
+ */
+#define TEST_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "stats_flightrec", 1, "flight recorder")
+MPT_TestProcess(statistics, flightrec, pub, stats_publisher,  TEST_ARGS);
+MPT_TestProcess(statistics, flightrec, sub, hello_subscriber, TEST_ARGS);
+MPT_Test(statistics, flightrec, .init=hello_init, .fini=hello_fini);
+#undef TEST_ARGS
+
+
+/*
+ * The publisher checks with the packets_sent statistic that write batching
+ * holds back the data until the latency budget expires or max_bytes is
+ * reached, and the subscriber checks that all of it arrives.
+ */
+#define TEST_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "stats_batch", 4, "write batching")
+MPT_TestProcess(statistics, batch, pub, batch_publisher,  TEST_ARGS);
+MPT_TestProcess(statistics, batch, sub, hello_subscriber, TEST_ARGS);
+MPT_Test(statistics, batch, .init=hello_init, .fini=hello_fini);
+#undef TEST_ARGS
@@ -0,0 +1,25 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "mpt/mpt.h"
+#include "procs/intern.h"
+
+
+/*
+ * Checks that proxy writers with equal QoS share an interned copy that is
+ * released with the last one, that unchanged SEDP re-announcements are
+ * skipped and that changed ones are not.
+ */
+#define TEST_ARGS MPT_ArgValues(DDS_DOMAIN_DEFAULT, "qos_interning")
+MPT_TestProcess(qos, interning, announcer, intern_announcer, TEST_ARGS);
+MPT_TestProcess(qos, interning, observer, intern_observer, TEST_ARGS);
+MPT_Test(qos, interning, .init=intern_init, .fini=intern_fini);
+#undef TEST_ARGS
@@ -0,0 +1,315 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mpt/mpt.h"
+
+#include "dds/dds.h"
+
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/heap.h"
+
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_bswap.h"
+#include "dds/ddsi/q_ephash.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_globals.h"
+#include "dds/ddsi/q_xqos.h"
+#include "dds/ddsi/q_ddsi_discovery.h"
+
+#include "intern.h"
+#include "rwdata.h"
+
+/* The announcer has three writers, the first two with user data "a" and
+   the third with "b"; it announces them again without any change, then
+   changes the second one to "b" and finally deletes the second and the
+   third one.  The observer follows along with
+   dds_get_matched_publication_data and checks the interned QoS objects of
+   the corresponding proxy writers.  The processes advance in lock step:
+   the observer signals the announcer by adding a reader, and the
+   announcer tracks the number of readers matched by its first writer. */
+
+#define NWRITERS 3
+#define TIMEOUT DDS_SECS (10)
+
+void intern_init (void) { }
+void intern_fini (void) { }
+
+static bool wait_for_matched_readers (dds_entity_t wr, uint32_t count)
+{
+  const dds_time_t tdeadline = dds_time () + TIMEOUT;
+  dds_publication_matched_status_t st;
+  while (dds_get_publication_matched_status (wr, &st) == 0 && dds_time () < tdeadline)
+  {
+    if (st.current_count == count)
+      return true;
+    dds_sleepfor (DDS_MSECS (10));
+  }
+  return false;
+}
+
+/* Publishes the discovery data of the writers on the topic again without
+   any change, like some implementations do periodically */
+static void reannounce_writers (const char *topic_name)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ephash_enum_writer est;
+  struct writer *wr;
+  thread_state_awake (ts1);
+  ephash_enum_writer_init (&est);
+  while ((wr = ephash_enum_writer_next (&est)) != NULL)
+  {
+    if (wr->xqos->topic_name == NULL || strcmp (wr->xqos->topic_name, topic_name) != 0)
+      continue;
+    ddsrt_mutex_lock (&wr->e.lock);
+    sedp_write_writer (wr);
+    ddsrt_mutex_unlock (&wr->e.lock);
+  }
+  ephash_enum_writer_fini (&est);
+  thread_state_asleep (ts1);
+}
+
+MPT_ProcessEntry (intern_announcer,
+                  MPT_Args (dds_domainid_t domainid,
+                            const char *topic_name))
+{
+  dds_entity_t dp, tp, wr[NWRITERS];
+  dds_qos_t *qos_a, *qos_b;
+  dds_return_t rc;
+  int id = (int) ddsrt_getpid ();
+
+  printf ("=== [Announcer(%d)] Start(%d) ...\n", id, (int) domainid);
+
+  qos_a = dds_create_qos ();
+  dds_qset_userdata (qos_a, "a", 1);
+  qos_b = dds_create_qos ();
+  dds_qset_userdata (qos_b, "b", 1);
+  dp = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (dp, 0, "Could not create participant: %s\n", dds_strretcode (dp));
+  tp = dds_create_topic (dp, &RWData_Msg_desc, topic_name, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (tp, 0, "Could not create topic: %s\n", dds_strretcode (tp));
+  for (int i = 0; i < NWRITERS; i++)
+  {
+    wr[i] = dds_create_writer (dp, tp, (i < 2) ? qos_a : qos_b, NULL);
+    MPT_ASSERT_FATAL_GT (wr[i], 0, "Could not create writer %d: %s\n", i, dds_strretcode (wr[i]));
+  }
+
+  /* the observer has seen the writers */
+  MPT_ASSERT_FATAL (wait_for_matched_readers (wr[0], 2), "Timeout waiting for the observer (step 1)\n");
+  reannounce_writers (topic_name);
+
+  /* the observer has seen the unchanged re-announcements */
+  MPT_ASSERT_FATAL (wait_for_matched_readers (wr[0], 3), "Timeout waiting for the observer (step 2)\n");
+  rc = dds_set_qos (wr[1], qos_b);
+  MPT_ASSERT_FATAL_EQ (rc, DDS_RETCODE_OK, "Set QoS failed: %s\n", dds_strretcode (rc));
+
+  /* the observer has seen the change */
+  MPT_ASSERT_FATAL (wait_for_matched_readers (wr[0], 4), "Timeout waiting for the observer (step 3)\n");
+  rc = dds_delete (wr[1]);
+  MPT_ASSERT_FATAL_EQ (rc, DDS_RETCODE_OK, "Could not delete writer 1: %s\n", dds_strretcode (rc));
+
+  /* the observer has seen the first deletion */
+  MPT_ASSERT_FATAL (wait_for_matched_readers (wr[0], 5), "Timeout waiting for the observer (step 4)\n");
+  rc = dds_delete (wr[2]);
+  MPT_ASSERT_FATAL_EQ (rc, DDS_RETCODE_OK, "Could not delete writer 2: %s\n", dds_strretcode (rc));
+
+  /* the observer is done */
+  MPT_ASSERT (wait_for_matched_readers (wr[0], 0), "Timeout waiting for the observer to finish\n");
+
+  dds_delete_qos (qos_a);
+  dds_delete_qos (qos_b);
+  rc = dds_delete (dp);
+  MPT_ASSERT_EQ (rc, DDS_RETCODE_OK, "teardown failed\n");
+  printf ("=== [Announcer(%d)] Done\n", id);
+}
+
+struct matched_writer {
+  dds_builtintopic_guid_t key;
+  char ud;
+};
+
+/* Fills mw with the writers matched by rd and counts those with user data
+   "a" and "b", returns whether that gives exp_na and exp_nb */
+static bool check_matched_writers (dds_entity_t rd, struct matched_writer *mw, int exp_na, int exp_nb)
+{
+  dds_instance_handle_t ihs[NWRITERS];
+  dds_return_t n;
+  int na = 0, nb = 0;
+  if ((n = dds_get_matched_publications (rd, ihs, NWRITERS)) != exp_na + exp_nb)
+    return false;
+  for (int32_t i = 0; i < n; i++)
+  {
+    dds_builtintopic_endpoint_t *ep;
+    void *ud = NULL;
+    size_t usz = 0;
+    if ((ep = dds_get_matched_publication_data (rd, ihs[i])) == NULL)
+      return false;
+    mw[i].key = ep->key;
+    if (dds_qget_userdata (ep->qos, &ud, &usz) && usz == 1)
+      mw[i].ud = *(char *) ud;
+    else
+      mw[i].ud = 0;
+    if (mw[i].ud == 'a')
+      na++;
+    else if (mw[i].ud == 'b')
+      nb++;
+    dds_free (ud);
+    dds_delete_qos (ep->qos);
+    dds_free (ep->topic_name);
+    dds_free (ep->type_name);
+    dds_free (ep);
+  }
+  return na == exp_na && nb == exp_nb;
+}
+
+static bool wait_for_matched_writers (dds_entity_t rd, struct matched_writer *mw, int exp_na, int exp_nb)
+{
+  const dds_time_t tdeadline = dds_time () + TIMEOUT;
+  while (!check_matched_writers (rd, mw, exp_na, exp_nb))
+  {
+    if (dds_time () >= tdeadline)
+      return false;
+    dds_sleepfor (DDS_MSECS (10));
+  }
+  return true;
+}
+
+static const dds_qos_t *proxy_writer_qos (const struct matched_writer *mw)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct proxy_writer *pwr;
+  const dds_qos_t *xqos;
+  nn_guid_t guid;
+  memcpy (&guid, &mw->key, sizeof (guid));
+  guid = nn_ntoh_guid (guid);
+  thread_state_awake (ts1);
+  xqos = ((pwr = ephash_lookup_proxy_writer_guid (&guid)) != NULL) ? pwr->c.xqos : NULL;
+  thread_state_asleep (ts1);
+  return xqos;
+}
+
+/* Returns whether all n writers with the same user data share a single
+   interned QoS object and those with different user data don't, the
+   objects for "a" and "b" are returned in qos_a and qos_b */
+static bool check_interned (const struct matched_writer *mw, int n, const dds_qos_t **qos_a, const dds_qos_t **qos_b)
+{
+  *qos_a = *qos_b = NULL;
+  for (int i = 0; i < n; i++)
+  {
+    const dds_qos_t **exp = (mw[i].ud == 'a') ? qos_a : qos_b;
+    const dds_qos_t *xqos;
+    if ((xqos = proxy_writer_qos (&mw[i])) == NULL)
+      return false;
+    if (*exp == NULL)
+      *exp = xqos;
+    else if (xqos != *exp)
+      return false;
+  }
+  return *qos_a != *qos_b;
+}
+
+static bool get_sedp_unchanged (dds_entity_t dp, uint64_t *value)
+{
+  dds_stat_keyvalue_t stats[32];
+  dds_return_t n = dds_get_statistics (dp, stats, sizeof (stats) / sizeof (stats[0]));
+  for (dds_return_t i = 0; i < n; i++)
+  {
+    if (strcmp (stats[i].name, "sedp_unchanged") == 0)
+    {
+      *value = stats[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+MPT_ProcessEntry (intern_observer,
+                  MPT_Args (dds_domainid_t domainid,
+                            const char *topic_name))
+{
+  dds_entity_t dp, tp, rd, rdsig;
+  struct matched_writer mw[NWRITERS];
+  const dds_qos_t *qos_a, *qos_b, *qos_a1, *qos_b1;
+  uint64_t nunchanged0, nunchanged1;
+  uint32_t ninterned0;
+  dds_time_t tdeadline;
+  dds_return_t rc;
+  int id = (int) ddsrt_getpid ();
+
+  printf ("=== [Observer(%d)] Start(%d) ...\n", id, (int) domainid);
+
+  dp = dds_create_participant (domainid, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (dp, 0, "Could not create participant: %s\n", dds_strretcode (dp));
+  tp = dds_create_topic (dp, &RWData_Msg_desc, topic_name, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (tp, 0, "Could not create topic: %s\n", dds_strretcode (tp));
+  rd = dds_create_reader (dp, tp, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (rd, 0, "Could not create reader: %s\n", dds_strretcode (rd));
+
+  /* proxy writers with equal QoS share it */
+  MPT_ASSERT_FATAL (wait_for_matched_writers (rd, mw, 2, 1), "Timeout waiting for the writers\n");
+  MPT_ASSERT_FATAL (check_interned (mw, NWRITERS, &qos_a, &qos_b), "Proxy writers don't share equal QoS\n");
+
+  /* identical re-announcements of the writers are recognized as unchanged
+     and leave the proxy writers as they are */
+  MPT_ASSERT_FATAL (get_sedp_unchanged (dp, &nunchanged0), "No sedp_unchanged statistic\n");
+  rdsig = dds_create_reader (dp, tp, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (rdsig, 0, "Could not create reader: %s\n", dds_strretcode (rdsig));
+  tdeadline = dds_time () + TIMEOUT;
+  do {
+    MPT_ASSERT_FATAL_LT (dds_time (), tdeadline, "Timeout waiting for unchanged SEDP re-announcements\n");
+    dds_sleepfor (DDS_MSECS (10));
+    MPT_ASSERT_FATAL (get_sedp_unchanged (dp, &nunchanged1), "No sedp_unchanged statistic\n");
+  } while (nunchanged1 < nunchanged0 + NWRITERS);
+  MPT_ASSERT_FATAL_EQ (nunchanged1, nunchanged0 + NWRITERS, "Unexpected unchanged SEDP re-announcements\n");
+  MPT_ASSERT_FATAL (check_interned (mw, NWRITERS, &qos_a1, &qos_b1), "Proxy writers don't share equal QoS\n");
+  MPT_ASSERT_FATAL (qos_a1 == qos_a && qos_b1 == qos_b, "QoS of proxy writers changed by unchanged SEDP re-announcements\n");
+
+  /* a changed SEDP sample is processed and the proxy writer switches to the
+     interned QoS it now has in common with the third one */
+  rdsig = dds_create_reader (dp, tp, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (rdsig, 0, "Could not create reader: %s\n", dds_strretcode (rdsig));
+  MPT_ASSERT_FATAL (wait_for_matched_writers (rd, mw, 1, 2), "Timeout waiting for the QoS change\n");
+  MPT_ASSERT_FATAL (check_interned (mw, NWRITERS, &qos_a1, &qos_b1), "Proxy writers don't share equal QoS\n");
+  MPT_ASSERT_FATAL (qos_a1 == qos_a && qos_b1 == qos_b, "Changed proxy writer didn't switch to the existing interned QoS\n");
+  MPT_ASSERT_FATAL (get_sedp_unchanged (dp, &nunchanged1), "No sedp_unchanged statistic\n");
+  MPT_ASSERT_FATAL_EQ (nunchanged1, nunchanged0 + NWRITERS, "Changed SEDP sample counted as unchanged\n");
+
+  /* deleting one of the proxy writers referencing "b" keeps it */
+  ninterned0 = nn_xqos_intern_count (gv.xqos_intern);
+  rdsig = dds_create_reader (dp, tp, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (rdsig, 0, "Could not create reader: %s\n", dds_strretcode (rdsig));
+  MPT_ASSERT_FATAL (wait_for_matched_writers (rd, mw, 1, 1), "Timeout waiting for the first deletion\n");
+  MPT_ASSERT_FATAL (check_interned (mw, 2, &qos_a1, &qos_b1), "Proxy writers don't share equal QoS\n");
+  MPT_ASSERT_FATAL (qos_a1 == qos_a && qos_b1 == qos_b, "Interned QoS changed by deleting a proxy writer\n");
+  dds_sleepfor (DDS_MSECS (100));
+  MPT_ASSERT_FATAL_EQ (nn_xqos_intern_count (gv.xqos_intern), ninterned0, "Interned QoS released while still in use\n");
+
+  /* deleting the last one releases it, but proxy writers are freed
+     asynchronously */
+  rdsig = dds_create_reader (dp, tp, NULL, NULL);
+  MPT_ASSERT_FATAL_GT (rdsig, 0, "Could not create reader: %s\n", dds_strretcode (rdsig));
+  MPT_ASSERT_FATAL (wait_for_matched_writers (rd, mw, 1, 0), "Timeout waiting for the second deletion\n");
+  tdeadline = dds_time () + TIMEOUT;
+  while (nn_xqos_intern_count (gv.xqos_intern) != ninterned0 - 1)
+  {
+    MPT_ASSERT_FATAL_LT (dds_time (), tdeadline, "Timeout waiting for the interned QoS to be released\n");
+    dds_sleepfor (DDS_MSECS (10));
+  }
+
+  rc = dds_delete (dp);
+  MPT_ASSERT_EQ (rc, DDS_RETCODE_OK, "teardown failed\n");
+  printf ("=== [Observer(%d)] Done\n", id);
+}
@@ -0,0 +1,476 @@
+/*
+ * Copyright(c) 2019 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#define _ISOC99_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "dds/dds.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "ddsperf_types.h"
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/threads.h"
+
+#if !defined(_WIN32) && !defined(LWIP_SOCKET)
+#include <errno.h>
+#endif
+
+/* Forwards samples from readers to writers of the same type, where a route
+   may change the partition, the topic name or both.  Samples are taken in
+   batches with dds_takecdr and the serialized samples are handed to the
+   writer with dds_forwardcdr, so the payload received from the network is
+   sent out again without being copied or deserialized.
+
+   Invalid samples (those that only convey a change in instance state) have
+   a key but no payload, those are turned into a dispose or an unregister of
+   the same instance on the outgoing side. */
+
+struct route {
+  char *in_partition, *in_topic;
+  char *out_partition, *out_topic;
+  dds_entity_t tp_in, tp_out, rd, wr;
+  const struct ddsi_sertopic *sertopic; /* of the reader, see forward_invalid */
+  /* statistics since the previous report */
+  uint64_t nsamples, nbytes, nbatches;
+};
+
+static const char *argv0;
+static volatile sig_atomic_t termflag = 0;
+static dds_entity_t termcond;
+
+static const dds_topic_descriptor_t *tp_desc = &KeyedSeq_desc;
+static bool reliable = true;
+static int32_t histdepth = 0;
+static uint32_t batchsize = 256;
+static bool quiet = false;
+
+static void verrorx (int exitcode, const char *fmt, va_list ap) ddsrt_attribute_noreturn;
+static void error2 (const char *fmt, ...) ddsrt_attribute_format ((printf, 1, 2)) ddsrt_attribute_noreturn;
+static void error3 (const char *fmt, ...) ddsrt_attribute_format ((printf, 1, 2)) ddsrt_attribute_noreturn;
+
+static void verrorx (int exitcode, const char *fmt, va_list ap)
+{
+  vprintf (fmt, ap);
+  fflush (stdout);
+  exit (exitcode);
+}
+
+static void error2 (const char *fmt, ...)
+{
+  va_list ap;
+  va_start (ap, fmt);
+  verrorx (2, fmt, ap);
+}
+
+static void error3 (const char *fmt, ...)
+{
+  va_list ap;
+  va_start (ap, fmt);
+  verrorx (3, fmt, ap);
+}
+
+#if !DDSRT_WITH_FREERTOS
+static void signal_handler (int sig)
+{
+  (void) sig;
+  termflag = 1;
+  dds_set_guardcondition (termcond, true);
+}
+#endif
+
+#if !_WIN32 && !DDSRT_WITH_FREERTOS
+static uint32_t sigthread (void *varg)
+{
+  sigset_t *set = varg;
+  int sig;
+  if (sigwait (set, &sig) == 0)
+    signal_handler (sig);
+  else
+    error2 ("sigwait failed: %d\n", errno);
+  return 0;
+}
+#endif
+
+static void usage (void)
+{
+  printf ("\
+%s help\n\
+%s [OPTIONS] ROUTE...\n\
+\n\
+OPTIONS:\n\
+  -T KS|K32|K256|OU|KN|SK|KA|KU|KSS\n\
+                      type of the topics, as in ddsperf (default KS)\n\
+  -u                  best-effort instead of reliable\n\
+  -k all|N            keep-all (default) or keep-last-N\n\
+  -b N                take at most N samples at a time (default %"PRIu32")\n\
+  -D DUR              run for at most DUR seconds\n\
+  -q                  do not print statistics every second\n\
+\n\
+Each ROUTE is of the form [PART:]TOPIC[=[PART:][TOPIC]] and forwards data\n\
+published on TOPIC in partition PART to the topic and partition following\n\
+the \"=\".  An omitted partition is the default partition, an omitted output\n\
+topic is the same as the input topic.  E.g., to run \"ddsperf -p A pub\"\n\
+through the bridge to \"ddsperf -p B sub\":\n\
+\n\
+  %s A:DDSPerfRDataKS=B:\n\
+\n\
+Routes that together form a cycle, either within one bridge or through\n\
+several, forward samples forever.\n\
+", argv0, argv0, batchsize, argv0);
+  fflush (stdout);
+  exit (3);
+}
+
+static char *substr (const char *s, size_t len)
+{
+  char *x;
+  if (len == 0)
+    return NULL;
+  x = ddsrt_malloc (len + 1);
+  memcpy (x, s, len);
+  x[len] = 0;
+  return x;
+}
+
+static void parse_endpoint (const char *spec, size_t len, char **partition, char **topic)
+{
+  const char *colon = memchr (spec, ':', len);
+  if (colon == NULL)
+  {
+    *partition = NULL;
+    *topic = substr (spec, len);
+  }
+  else
+  {
+    const size_t plen = (size_t) (colon - spec);
+    *partition = substr (spec, plen);
+    *topic = substr (colon + 1, len - plen - 1);
+  }
+}
+
+static void parse_route (struct route *r, const char *spec)
+{
+  const char *eq = strchr (spec, '=');
+  memset (r, 0, sizeof (*r));
+  if (eq == NULL)
+  {
+    parse_endpoint (spec, strlen (spec), &r->in_partition, &r->in_topic);
+    r->out_partition = r->in_partition ? ddsrt_strdup (r->in_partition) : NULL;
+  }
+  else
+  {
+    parse_endpoint (spec, (size_t) (eq - spec), &r->in_partition, &r->in_topic);
+    parse_endpoint (eq + 1, strlen (eq + 1), &r->out_partition, &r->out_topic);
+  }
+  if (r->in_topic == NULL)
+    error3 ("%s: route without topic\n", spec);
+  if (r->out_topic == NULL)
+    r->out_topic = ddsrt_strdup (r->in_topic);
+}
+
+/* dds_find_topic returns a new reference to the topic that deleting the
+   participant doesn't clean up, so keep track of the topics ourselves */
+static dds_entity_t find_or_create_topic (dds_entity_t pp, const struct route *routes, size_t nroutes, const char *name)
+{
+  dds_entity_t tp;
+  dds_qos_t *qos;
+  for (size_t i = 0; i < nroutes; i++)
+  {
+    if (strcmp (routes[i].in_topic, name) == 0)
+      return routes[i].tp_in;
+    if (strcmp (routes[i].out_topic, name) == 0)
+      return routes[i].tp_out;
+  }
+  qos = dds_create_qos ();
+  dds_qset_reliability (qos, reliable ? DDS_RELIABILITY_RELIABLE : DDS_RELIABILITY_BEST_EFFORT, DDS_SECS (1));
+  if ((tp = dds_create_topic (pp, tp_desc, name, qos, NULL)) < 0)
+    error2 ("dds_create_topic(%s) failed: %d\n", name, (int) tp);
+  dds_delete_qos (qos);
+  return tp;
+}
+
+/* creates the reader and writer for routes[idx], given that those for
+   routes[0 .. idx-1] have already been created */
+static void create_route (dds_entity_t pp, struct route *routes, size_t idx)
+{
+  struct route * const r = &routes[idx];
+  dds_entity_t sub, pub;
+  dds_qos_t *qos;
+
+  r->tp_in = find_or_create_topic (pp, routes, idx, r->in_topic);
+  if (strcmp (r->in_topic, r->out_topic) == 0)
+    r->tp_out = r->tp_in;
+  else
+    r->tp_out = find_or_create_topic (pp, routes, idx, r->out_topic);
+
+  qos = dds_create_qos ();
+  if (r->in_partition)
+    dds_qset_partition1 (qos, r->in_partition);
+  if ((sub = dds_create_subscriber (pp, qos, NULL)) < 0)
+    error2 ("dds_create_subscriber failed: %d\n", (int) sub);
+  dds_delete_qos (qos);
+  qos = dds_create_qos ();
+  if (r->out_partition)
+    dds_qset_partition1 (qos, r->out_partition);
+  if ((pub = dds_create_publisher (pp, qos, NULL)) < 0)
+    error2 ("dds_create_publisher failed: %d\n", (int) pub);
+  dds_delete_qos (qos);
+
+  /* ignoring local endpoints prevents the routes within this bridge from
+     forming a cycle */
+  qos = dds_create_qos ();
+  dds_qset_reliability (qos, reliable ? DDS_RELIABILITY_RELIABLE : DDS_RELIABILITY_BEST_EFFORT, DDS_SECS (10));
+  if (histdepth == 0)
+    dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  else
+    dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, histdepth);
+  dds_qset_ignorelocal (qos, DDS_IGNORELOCAL_PARTICIPANT);
+  if ((r->rd = dds_create_reader (sub, r->tp_in, qos, NULL)) < 0)
+    error2 ("dds_create_reader(%s) failed: %d\n", r->in_topic, (int) r->rd);
+  if ((r->wr = dds_create_writer (pub, r->tp_out, qos, NULL)) < 0)
+    error2 ("dds_create_writer(%s) failed: %d\n", r->out_topic, (int) r->wr);
+  dds_delete_qos (qos);
+  if (dds_set_status_mask (r->rd, DDS_DATA_AVAILABLE_STATUS) < 0)
+    error2 ("dds_set_status_mask(%s) failed\n", r->in_topic);
+}
+
+/* The instance may no longer exist by the time the invalid sample has been
+   taken (e.g., when the writer was deleted), so the key is extracted from the
+   serdata rather than relying on the instance handle.  That serdata is the
+   "topicless" key of the instance, so converting it requires the reader's
+   sertopic, which is only known once a valid sample has been received. */
+static dds_return_t forward_invalid (struct route *r, struct ddsi_serdata *d, const dds_sample_info_t *si, void *keysample)
+{
+  dds_return_t rc = DDS_RETCODE_OK;
+  if (si->instance_state == DDS_IST_ALIVE)
+    ;
+  else if (r->sertopic == NULL)
+  {
+    if (si->instance_state == DDS_IST_NOT_ALIVE_DISPOSED)
+      rc = dds_dispose_ih_ts (r->wr, si->instance_handle, si->source_timestamp);
+    else
+      rc = dds_unregister_instance_ih_ts (r->wr, si->instance_handle, si->source_timestamp);
+  }
+  else
+  {
+    memset (keysample, 0, tp_desc->m_size);
+    if (!ddsi_serdata_topicless_to_sample (r->sertopic, d, keysample, NULL, NULL))
+      rc = DDS_RETCODE_ERROR;
+    else if (si->instance_state == DDS_IST_NOT_ALIVE_DISPOSED)
+      rc = dds_dispose_ts (r->wr, keysample, si->source_timestamp);
+    else
+      rc = dds_unregister_instance_ts (r->wr, keysample, si->source_timestamp);
+    dds_sample_free (keysample, tp_desc, DDS_FREE_CONTENTS);
+  }
+  ddsi_serdata_unref (d);
+  return rc;
+}
+
+static void forward (struct route *r, struct ddsi_serdata **buf, dds_sample_info_t *si, void *keysample)
+{
+  dds_return_t n, rc;
+  do {
+    if ((n = dds_takecdr (r->rd, buf, batchsize, si, DDS_ANY_STATE)) < 0)
+      error2 ("dds_takecdr(%s) failed: %d\n", r->in_topic, (int) n);
+    for (int32_t i = 0; i < n; i++)
+    {
+      if (si[i].valid_data)
+      {
+        if (r->sertopic == NULL)
+          r->sertopic = buf[i]->topic;
+        r->nbytes += ddsi_serdata_size (buf[i]);
+        rc = dds_forwardcdr (r->wr, buf[i]);
+      }
+      else
+      {
+        rc = forward_invalid (r, buf[i], &si[i], keysample);
+      }
+      /* unregistering an instance that was never written is not an error
+         worth stopping for */
+      if (rc != DDS_RETCODE_OK && rc != DDS_RETCODE_TIMEOUT && rc != DDS_RETCODE_PRECONDITION_NOT_MET)
+        error2 ("forwarding on %s failed: %d\n", r->out_topic, (int) rc);
+    }
+    if (n > 0)
+    {
+      dds_write_flush (r->wr);
+      r->nsamples += (uint64_t) n;
+      r->nbatches++;
+    }
+  } while (n == (int32_t) batchsize);
+}
+
+static void print_stats (struct route *routes, size_t nroutes, double dt)
+{
+  for (size_t i = 0; i < nroutes; i++)
+  {
+    struct route * const r = &routes[i];
+    printf ("[%"PRIdPID"] %s:%s => %s:%s: %.0f samples/s %.2f Mb/s batch %.1f\n",
+            ddsrt_getpid (),
+            r->in_partition ? r->in_partition : "", r->in_topic,
+            r->out_partition ? r->out_partition : "", r->out_topic,
+            (double) r->nsamples / dt, (double) r->nbytes * 8.0 / dt / 1e6,
+            r->nbatches ? (double) r->nsamples / (double) r->nbatches : 0.0);
+    r->nsamples = r->nbytes = r->nbatches = 0;
+  }
+  fflush (stdout);
+}
+
+int main (int argc, char **argv)
+{
+  dds_entity_t pp, ws;
+  dds_return_t rc;
+  double dur = HUGE_VAL;
+  struct route *routes;
+  size_t nroutes;
+  dds_attach_t *triggered;
+  struct ddsi_serdata **buf;
+  dds_sample_info_t *si;
+  void *keysample;
+  int opt;
+#if !_WIN32 && !DDSRT_WITH_FREERTOS
+  sigset_t sigset, osigset;
+  ddsrt_thread_t sigtid;
+  ddsrt_threadattr_t attr;
+  ddsrt_threadattr_init (&attr);
+#endif
+
+  argv0 = argv[0];
+
+  if (argc == 2 && strcmp (argv[1], "help") == 0)
+    usage ();
+  while ((opt = getopt (argc, argv, "b:D:k:qT:uh")) != EOF)
+  {
+    switch (opt)
+    {
+      case 'b': batchsize = (uint32_t) atoi (optarg); if (batchsize == 0) batchsize = 1; break;
+      case 'D': dur = atof (optarg); if (dur <= 0) dur = HUGE_VAL; break;
+      case 'k': histdepth = atoi (optarg); if (histdepth < 0) histdepth = 0; break;
+      case 'q': quiet = true; break;
+      case 'u': reliable = false; break;
+      case 'T':
+        if (strcmp (optarg, "KS") == 0) tp_desc = &KeyedSeq_desc;
+        else if (strcmp (optarg, "K32") == 0) tp_desc = &Keyed32_desc;
+        else if (strcmp (optarg, "K256") == 0) tp_desc = &Keyed256_desc;
+        else if (strcmp (optarg, "OU") == 0) tp_desc = &OneULong_desc;
+        else if (strcmp (optarg, "KN") == 0) tp_desc = &KeyedNested_desc;
+        else if (strcmp (optarg, "SK") == 0) tp_desc = &StringKeyed_desc;
+        else if (strcmp (optarg, "KA") == 0) tp_desc = &KeyedArray_desc;
+        else if (strcmp (optarg, "KU") == 0) tp_desc = &KeyedUnion_desc;
+        else if (strcmp (optarg, "KSS") == 0) tp_desc = &KeyedSeqStruct_desc;
+        else error3 ("%s: unknown topic\n", optarg);
+        break;
+      case 'h': default: usage (); break;
+    }
+  }
+  if (optind == argc)
+    usage ();
+
+  nroutes = (size_t) (argc - optind);
+  routes = malloc (nroutes * sizeof (*routes));
+  for (size_t i = 0; i < nroutes; i++)
+    parse_route (&routes[i], argv[optind + (int) i]);
+
+  if ((pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL)) < 0)
+    error2 ("dds_create_participant failed: %d\n", (int) pp);
+  /* packing the forwarded samples of a batch in as few messages as
+     possible is the point of taking them in batches */
+  dds_write_set_batch (true);
+  for (size_t i = 0; i < nroutes; i++)
+    create_route (pp, routes, i);
+
+  if ((termcond = dds_create_guardcondition (pp)) < 0)
+    error2 ("dds_create_guardcondition(termcond) failed: %d\n", (int) termcond);
+  if ((ws = dds_create_waitset (pp)) < 0)
+    error2 ("dds_create_waitset failed: %d\n", (int) ws);
+  if ((rc = dds_waitset_attach (ws, termcond, 0)) < 0)
+    error2 ("dds_waitset_attach(termcond) failed: %d\n", (int) rc);
+  for (size_t i = 0; i < nroutes; i++)
+    if ((rc = dds_waitset_attach (ws, routes[i].rd, (dds_attach_t) (i + 1))) < 0)
+      error2 ("dds_waitset_attach(%s) failed: %d\n", routes[i].in_topic, (int) rc);
+
+#ifdef _WIN32
+  signal (SIGINT, signal_handler);
+#elif !DDSRT_WITH_FREERTOS
+  sigemptyset (&sigset);
+  sigaddset (&sigset, SIGINT);
+  sigaddset (&sigset, SIGTERM);
+  sigprocmask (SIG_BLOCK, &sigset, &osigset);
+  ddsrt_thread_create (&sigtid, "sigthread", &attr, sigthread, &sigset);
+#endif
+
+  triggered = malloc ((nroutes + 1) * sizeof (*triggered));
+  buf = malloc (batchsize * sizeof (*buf));
+  si = malloc (batchsize * sizeof (*si));
+  keysample = malloc (tp_desc->m_size);
+  const dds_time_t tstart = dds_time ();
+  const dds_time_t tstop = (dur == HUGE_VAL) ? DDS_NEVER : tstart + (dds_duration_t) (dur * 1e9);
+  dds_time_t tlast = tstart, tnext = tstart + DDS_SECS (1);
+  while (!termflag)
+  {
+    const dds_time_t tnow = dds_time ();
+    if (tnow >= tstop)
+      break;
+    if (tnow >= tnext)
+    {
+      if (!quiet)
+        print_stats (routes, nroutes, (double) (tnow - tlast) / 1e9);
+      tlast = tnow;
+      tnext = tnow + DDS_SECS (1);
+    }
+    if ((rc = dds_waitset_wait_until (ws, triggered, nroutes + 1, (tnext < tstop) ? tnext : tstop)) < 0)
+      error2 ("dds_waitset_wait_until failed: %d\n", (int) rc);
+    for (int32_t i = 0; i < rc; i++)
+      if (triggered[i] > 0)
+        forward (&routes[triggered[i] - 1], buf, si, keysample);
+  }
+
+#if _WIN32
+  signal_handler (SIGINT);
+#elif !DDSRT_WITH_FREERTOS
+  {
+    /* get the attention of the signal handler thread */
+    void (*osigint) (int);
+    void (*osigterm) (int);
+    kill (getpid (), SIGTERM);
+    ddsrt_thread_join (sigtid, NULL);
+    osigint = signal (SIGINT, SIG_IGN);
+    osigterm = signal (SIGTERM, SIG_IGN);
+    sigprocmask (SIG_SETMASK, &osigset, NULL);
+    signal (SIGINT, osigint);
+    signal (SIGTERM, osigterm);
+  }
+#endif
+
+  if ((rc = dds_delete (pp)) < 0)
+    error2 ("dds_delete(participant) failed: %d\n", (int) rc);
+  for (size_t i = 0; i < nroutes; i++)
+  {
+    ddsrt_free (routes[i].in_partition);
+    ddsrt_free (routes[i].in_topic);
+    ddsrt_free (routes[i].out_partition);
+    ddsrt_free (routes[i].out_topic);
+  }
+  free (routes);
+  free (triggered);
+  free (buf);
+  free (si);
+  free (keysample);
+  return 0;
+}
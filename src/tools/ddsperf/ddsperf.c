@@ -32,6 +32,7 @@
 #include "dds/ddsrt/random.h"
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/rusage.h"
 
 #if !defined(_WIN32) && !defined(LWIP_SOCKET)
 #include <errno.h>
@@ -46,7 +47,18 @@ enum topicsel {
   KS,   /* KeyedSeq type: seq#, key, sequence-of-octet */
   K32,  /* Keyed32  type: seq#, key, array-of-24-octet (sizeof = 32) */
   K256, /* Keyed256 type: seq#, key, array-of-248-octet (sizeof = 256) */
-  OU    /* OneULong type: seq# */
+  OU,   /* OneULong type: seq# */
+  KN,   /* KeyedNested type: seq#, key, two nested Pose structs (sizeof = 120) */
+  SK,   /* StringKeyed type: seq#, key value, string key */
+  KA,   /* KeyedArray type: seq#, key, array-of-1024-double (sizeof = 8200) */
+  KU,   /* KeyedUnion type: seq#, key, union of long, double, string, Point */
+  KSS   /* KeyedSeqStruct type: seq#, key, sequence-of-Point */
+};
+
+enum outputfmt {
+  OF_TEXT, /* human-readable text */
+  OF_JSON, /* one JSON object per line for each record */
+  OF_CSV   /* one line for each record, all records have the same columns */
 };
 
 enum submode {
@@ -70,9 +82,20 @@ static dds_entity_t rd_participants, rd_subscriptions, rd_publications;
 
 /* Topics, readers, writers (except for pong writers: there are
    many of those) */
-static dds_entity_t tp_data, tp_ping, tp_pong;
-static char tpname_data[32], tpname_ping[32], tpname_pong[32];
-static dds_entity_t sub, pub, wr_data, wr_ping, rd_data, rd_ping, rd_pong;
+static dds_entity_t tp_ping, tp_pong;
+static char tpname_ping[32], tpname_pong[32];
+static dds_entity_t sub, pub, wr_ping, rd_ping, rd_pong;
+
+/* Data topics and readers: one per topic (-m), all of the same type,
+   rd_data[i] is 0 if there is no subscriber.  Data writers: the first
+   ntopics are one per topic, any further ones are created for publisher
+   threads in excess of the number of topics */
+#define MAX_TOPICS 10000
+static uint32_t ntopics = 1;
+static dds_entity_t *tp_data, *rd_data;
+static char (*tpname_data)[40];
+static uint32_t nwr_data;
+static dds_entity_t *wr_data;
 
 /* Number of different key values to use (must be 1 for OU type) */
 static unsigned nkeyvals = 1;
@@ -84,9 +107,13 @@ static enum topicsel topicsel = OU;
 static enum submode submode = SM_LISTENER;
 static enum submode pingpongmode = SM_LISTENER;
 
-/* Size of the sequence in KeyedSeq type in bytes */
+/* Size of the sequence in KeyedSeq type in bytes, or of the sequence of
+   Points in the KeyedSeqStruct type */
 static unsigned baggagesize = 0;
 
+/* Key strings for the StringKeyed type, indexed by key value */
+static char **keynames;
+
 /* Whether or not to register instances prior to writing */
 static bool register_instances = true;
 
@@ -113,9 +140,26 @@ static uint32_t matchtimeout = 0;
 /* Data is published in bursts of this many samples */
 static unsigned burstsize = 1;
 
+/* Number of publishing threads, each writing round-robin to its share
+   of the data topics at pub_rate */
+static uint32_t npubthreads = 1;
+
+/* Publishing alternates between pub_on ns of publishing and pub_off ns
+   of silence, unless pub_off is 0 */
+static dds_duration_t pub_on = 0, pub_off = 0;
+
 /* Whether to use reliable or best-effort readers/writers */
 static bool reliable = true;
 
+/* Whether to print the statistics counters of the participant and the
+   data writer/reader along with the other statistics */
+static bool print_ddsstats = false;
+
+/* Format of the periodic statistics and the file the JSON/CSV records
+   are written to */
+static enum outputfmt outputfmt = OF_TEXT;
+static FILE *outfp;
+
 /* History depth for throughput data reader and writer; 0 is
    KEEP_ALL, otherwise it is KEEP_LAST histdepth.  Ping/pong
    always uses KEEP_LAST 1. */
@@ -134,6 +178,10 @@ static uint32_t ping_frac = 0;
    that would otherwise match */
 static dds_ignorelocal_kind_t ignorelocal = DDS_IGNORELOCAL_PARTICIPANT;
 
+/* Partition for the publisher and subscriber, NULL means the default
+   partition */
+static const char *partition = NULL;
+
 /* Pinging interval for roundtrip testing, 0 means as fast as
    possible, DDS_INFINITY means never */
 static dds_duration_t ping_intv;
@@ -310,6 +358,11 @@ union data {
   Keyed32 k32;
   Keyed256 k256;
   OneULong ou;
+  KeyedNested kn;
+  StringKeyed sk;
+  KeyedArray ka;
+  KeyedUnion ku;
+  KeyedSeqStruct kss;
 };
 
 static void verrorx (int exitcode, const char *fmt, va_list ap)
@@ -486,6 +539,158 @@ static void hist_print (const char *prefix, struct hist *h, dds_time_t dt, int r
     hist_reset (h);
 }
 
+/* Machine-readable output: every record is a set of values for the columns
+   below, of which time, pid and kind are always present.  The JSON format
+   only includes the other columns if they apply to the kind of record, the
+   CSV format has an empty value for those. */
+enum outcol {
+  OC_TIME, OC_PID, OC_KIND, OC_PEER, OC_NAME, OC_VALUE,
+  OC_COUNT, OC_RATE, OC_SIZE, OC_TOTAL, OC_LOST, OC_MBPS,
+  OC_MEAN_US, OC_MIN_US, OC_P50_US, OC_P90_US, OC_P99_US, OC_MAX_US,
+  OC_UTIME_PCT, OC_STIME_PCT, OC_MAXRSS, OC_NVCSW, OC_NIVCSW, OC_OVERHEAD_PCT
+};
+#define OC_N (OC_OVERHEAD_PCT + 1)
+
+static const char *outcol_names[OC_N] = {
+  "time", "pid", "kind", "peer", "name", "value",
+  "count", "rate", "size", "total", "lost", "mbps",
+  "mean_us", "min_us", "p50_us", "p90_us", "p99_us", "max_us",
+  "utime_pct", "stime_pct", "maxrss", "nvcsw", "nivcsw", "overhead_pct"
+};
+
+struct outrec {
+  char val[OC_N][128];
+  bool isstr[OC_N];
+};
+
+static void outrec_set (struct outrec *r, enum outcol c, bool isstr, const char *fmt, ...) ddsrt_attribute_format ((printf, 4, 5));
+
+static void outrec_set (struct outrec *r, enum outcol c, bool isstr, const char *fmt, ...)
+{
+  va_list ap;
+  va_start (ap, fmt);
+  vsnprintf (r->val[c], sizeof (r->val[c]), fmt, ap);
+  va_end (ap);
+  r->isstr[c] = isstr;
+}
+
+static void outrec_init (struct outrec *r, double ts, const char *kind)
+{
+  for (int c = 0; c < OC_N; c++)
+    r->val[c][0] = 0;
+  outrec_set (r, OC_TIME, false, "%.3f", ts);
+  outrec_set (r, OC_PID, false, "%"PRIdPID, ddsrt_getpid ());
+  outrec_set (r, OC_KIND, true, "%s", kind);
+}
+
+static void outrec_u64 (struct outrec *r, enum outcol c, uint64_t v)
+{
+  outrec_set (r, c, false, "%"PRIu64, v);
+}
+
+static void outrec_dbl (struct outrec *r, enum outcol c, double v)
+{
+  outrec_set (r, c, false, "%.3f", v);
+}
+
+static void outrec_print (const struct outrec *r)
+{
+  /* strings are host names, entity kinds and statistics names, so only
+     quotes and backslashes need to be dealt with */
+  if (outputfmt == OF_JSON)
+  {
+    const char *sep = "{";
+    for (int c = 0; c < OC_N; c++)
+    {
+      if (r->val[c][0] == 0)
+        continue;
+      fprintf (outfp, "%s\"%s\":", sep, outcol_names[c]);
+      if (!r->isstr[c])
+        fputs (r->val[c], outfp);
+      else
+      {
+        fputc ('"', outfp);
+        for (const char *s = r->val[c]; *s; s++)
+        {
+          if (*s == '"' || *s == '\\')
+            fputc ('\\', outfp);
+          fputc (*s, outfp);
+        }
+        fputc ('"', outfp);
+      }
+      sep = ",";
+    }
+    fputs ("}\n", outfp);
+  }
+  else
+  {
+    for (int c = 0; c < OC_N; c++)
+    {
+      if (c > 0)
+        fputc (',', outfp);
+      if (!r->isstr[c] || strpbrk (r->val[c], ",\"") == NULL)
+        fputs (r->val[c], outfp);
+      else
+      {
+        fputc ('"', outfp);
+        for (const char *s = r->val[c]; *s; s++)
+        {
+          if (*s == '"')
+            fputc ('"', outfp);
+          fputc (*s, outfp);
+        }
+        fputc ('"', outfp);
+      }
+    }
+    fputc ('\n', outfp);
+  }
+}
+
+static void outrec_print_csv_header (void)
+{
+  for (int c = 0; c < OC_N; c++)
+    fprintf (outfp, "%s%s", (c > 0) ? "," : "", outcol_names[c]);
+  fputc ('\n', outfp);
+}
+
+static uint64_t hist_percentile (const struct hist *h, uint64_t cnt, uint64_t pct)
+{
+  /* upper bound of the bin containing the percentile, values below bin0 are
+     attributed to bin0 and those above binN to the maximum */
+  const uint64_t target = (cnt * pct + 99) / 100;
+  uint64_t acc = h->under;
+  if (acc >= target)
+    return h->bin0;
+  for (unsigned i = 0; i < h->nbins; i++)
+  {
+    if ((acc += h->bins[i]) >= target)
+      return h->bin0 + (i + 1) * h->binwidth;
+  }
+  return h->max;
+}
+
+static void hist_output (double ts, const char *kind, struct hist *h, dds_time_t dt, int reset)
+{
+  struct outrec r;
+  uint64_t cnt = h->under + h->over;
+  for (unsigned i = 0; i < h->nbins; i++)
+    cnt += h->bins[i];
+  outrec_init (&r, ts, kind);
+  outrec_u64 (&r, OC_COUNT, cnt);
+  outrec_dbl (&r, OC_RATE, (double) cnt * 1e9 / (double) dt);
+  if (cnt > 0)
+  {
+    outrec_dbl (&r, OC_MIN_US, (double) h->min / 1e3);
+    outrec_dbl (&r, OC_P50_US, (double) hist_percentile (h, cnt, 50) / 1e3);
+    outrec_dbl (&r, OC_P90_US, (double) hist_percentile (h, cnt, 90) / 1e3);
+    outrec_dbl (&r, OC_P99_US, (double) hist_percentile (h, cnt, 99) / 1e3);
+    outrec_dbl (&r, OC_MAX_US, (double) h->max / 1e3);
+  }
+  outrec_print (&r);
+  if (reset)
+    hist_reset (h);
+}
+
 static void *make_baggage (dds_sequence_t *b, unsigned cnt)
 {
   b->_maximum = b->_length = cnt;
@@ -499,6 +704,37 @@ static void *make_baggage (dds_sequence_t *b, unsigned cnt)
   return b->_buffer;
 }
 
+static void init_pose (Pose *pose, uint32_t seq)
+{
+  pose->position.x = pose->position.y = pose->position.z = (double) seq;
+  pose->velocity.x = pose->velocity.y = pose->velocity.z = 1.0;
+  pose->stamp = seq;
+}
+
+static void set_variant (Variant *v, uint32_t seq)
+{
+  /* cycle through the cases so that all get exercised */
+  switch ((v->_d = (int32_t) (seq % 4)))
+  {
+    case 0: v->_u.l = (int32_t) seq; break;
+    case 1: v->_u.d = (double) seq; break;
+    case 2: v->_u.s = "the quick brown fox jumps over the lazy dog"; break;
+    case 3: v->_u.p.x = v->_u.p.y = v->_u.p.z = (double) seq; break;
+  }
+}
+
+static void set_seq_keyval (union data *data, uint32_t seq, uint32_t keyval)
+{
+  data->seq_keyval.seq = seq;
+  data->seq_keyval.keyval = (int32_t) keyval;
+  switch (topicsel)
+  {
+    case SK: data->sk.name = keynames[keyval]; break;
+    case KU: set_variant (&data->ku.v, seq); break;
+    default: break;
+  }
+}
+
 static void *init_sample (union data *data, uint32_t seq)
 {
   void *baggage = NULL;
@@ -522,45 +758,93 @@ static void *init_sample (union data *data, uint32_t seq)
     case OU:
       data->ou.seq = seq;
       break;
+    case KN:
+      init_pose (&data->kn.pose, seq);
+      init_pose (&data->kn.target, seq);
+      break;
+    case SK:
+      break;
+    case KA:
+      for (size_t i = 0; i < sizeof (data->ka.values) / sizeof (data->ka.values[0]); i++)
+        data->ka.values[i] = (double) i;
+      break;
+    case KU:
+      break;
+    case KSS: {
+      const uint32_t n = baggagesize / (uint32_t) sizeof (Point);
+      data->kss.points._maximum = data->kss.points._length = n;
+      data->kss.points._buffer = baggage = (n == 0) ? NULL : malloc (n * sizeof (Point));
+      for (uint32_t i = 0; i < n; i++)
+      {
+        Point * const p = (Point *) baggage + i;
+        p->x = p->y = p->z = (double) i;
+      }
+      break;
+    }
   }
+  set_seq_keyval (data, seq, 0);
   return baggage;
 }
 
+/* Each publisher thread has its own writers and its own sample for each,
+   so every writer has its own sequence of sequence numbers */
+struct pubwr {
+  dds_entity_t wr;
+  union data data;
+  void *baggage;
+};
+
+struct pubthread_arg {
+  uint32_t nwr;
+  struct pubwr *wrs;
+};
+
+static void pubthread_flush (const struct pubthread_arg *arg)
+{
+  /* FIXME: flushing manually because batching is not yet implemented properly */
+  for (uint32_t w = 0; w < arg->nwr; w++)
+    dds_write_flush (arg->wrs[w].wr);
+}
+
 static uint32_t pubthread (void *varg)
 {
+  struct pubthread_arg * const arg = varg;
   int result;
   dds_instance_handle_t *ihs;
-  dds_time_t ntot = 0, tfirst, tfirst0;
-  union data data;
+  dds_time_t ntot = 0, tfirst0, tidle = 0;
   uint64_t timeouts = 0;
-  void *baggage = NULL;
-  (void) varg;
 
-  memset (&data, 0, sizeof (data));
   assert (nkeyvals > 0);
   assert (topicsel != OU || nkeyvals == 1);
 
-  baggage = init_sample (&data, 0);
   ihs = malloc (nkeyvals * sizeof (dds_instance_handle_t));
-  for (unsigned k = 0; k < nkeyvals; k++)
+  for (uint32_t w = 0; w < arg->nwr; w++)
   {
-    data.seq_keyval.keyval = (int32_t) k;
-    if (register_instances)
-      dds_register_instance (wr_data, &ihs[k], &data);
-    else
-      ihs[k] = 0;
+    struct pubwr * const pw = &arg->wrs[w];
+    memset (&pw->data, 0, sizeof (pw->data));
+    pw->baggage = init_sample (&pw->data, 0);
+    for (unsigned k = 0; k < nkeyvals; k++)
+    {
+      set_seq_keyval (&pw->data, 0, k);
+      if (register_instances)
+        dds_register_instance (pw->wr, &ihs[k], &pw->data);
+      else
+        ihs[k] = 0;
+    }
+    set_seq_keyval (&pw->data, 0, 0);
   }
-  data.seq_keyval.keyval = 0;
 
-  tfirst0 = tfirst = dds_time();
+  tfirst0 = dds_time();
 
   unsigned bi = 0;
+  uint32_t wi = 0;
   while (!termflag)
   {
+    struct pubwr * const pw = &arg->wrs[wi];
     /* lsb of timestamp is abused to signal whether the sample is a ping requiring a response or not */
     bool reqresp = (ping_frac == 0) ? 0 : (ping_frac == UINT32_MAX) ? 1 : (ddsrt_random () <= ping_frac);
     const dds_time_t t_write = (dds_time () & ~1) | reqresp;
-    if ((result = dds_write_ts (wr_data, &data, t_write)) != DDS_RETCODE_OK)
+    if ((result = dds_write_ts (pw->wr, &pw->data, t_write)) != DDS_RETCODE_OK)
     {
       printf ("write error: %d\n", result);
       fflush (stdout);
@@ -573,7 +857,7 @@ static uint32_t pubthread (void *varg)
     }
     if (reqresp)
     {
-      dds_write_flush (wr_data);
+      dds_write_flush (pw->wr);
     }
 
     const dds_time_t t_post_write = dds_time ();
@@ -583,27 +867,47 @@ static uint32_t pubthread (void *varg)
     ntot++;
     ddsrt_mutex_unlock (&pubstat_lock);
 
-    data.seq_keyval.keyval = (data.seq_keyval.keyval + 1) % (int32_t) nkeyvals;
-    data.seq++;
+    set_seq_keyval (&pw->data, pw->data.seq + 1, ((uint32_t) pw->data.seq_keyval.keyval + 1) % nkeyvals);
+    if (++wi == arg->nwr)
+      wi = 0;
 
     if (pub_rate < HUGE_VAL)
     {
       if (++bi == burstsize)
       {
         /* FIXME: should average rate over a short-ish period, rather than over the entire run */
-        while (((double) (ntot / burstsize) / ((double) (t - tfirst0) / 1e9 + 5e-3)) > pub_rate && !termflag)
+        while (((double) (ntot / burstsize) / ((double) (t - tfirst0 - tidle) / 1e9 + 5e-3)) > pub_rate && !termflag)
         {
-          /* FIXME: flushing manually because batching is not yet implemented properly */
-          dds_write_flush (wr_data);
+          pubthread_flush (arg);
           dds_sleepfor (DDS_MSECS (1));
           t = dds_time ();
         }
         bi = 0;
       }
     }
+
+    if (pub_off > 0)
+    {
+      /* Silent part of the on/off cycle: the time spent waiting doesn't count
+         for the publishing rate, or it would publish faster during the next
+         "on" period to make up for it */
+      const dds_time_t tcycle = (t - tfirst0) % (pub_on + pub_off);
+      if (tcycle >= pub_on)
+      {
+        const dds_time_t tresume = t + (pub_on + pub_off - tcycle);
+        const dds_time_t tpause = t;
+        pubthread_flush (arg);
+        while (!termflag && (t = dds_time ()) < tresume)
+          dds_sleepfor ((tresume - t < DDS_MSECS (100)) ? tresume - t : DDS_MSECS (100));
+        tidle += t - tpause;
+      }
+    }
+  }
+  for (uint32_t w = 0; w < arg->nwr; w++)
+  {
+    if (arg->wrs[w].baggage)
+      free (arg->wrs[w].baggage);
   }
-  if (baggage)
-    free (baggage);
   free (ihs);
   return 0;
 }
@@ -773,6 +1077,18 @@ static dds_entity_t get_pong_writer (dds_instance_handle_t pubhandle)
   return wr_pong;
 }
 
+static uint32_t variant_size (const Variant *v)
+{
+  switch (v->_d)
+  {
+    case 0: return 4;
+    case 1: return 8;
+    case 2: return 5 + (uint32_t) strlen (v->_u.s);
+    case 3: return 24;
+  }
+  return 0;
+}
+
 static bool process_data (dds_entity_t rd, struct subthread_arg *arg)
 {
   uint32_t max_samples = arg->max_samples;
@@ -792,6 +1108,11 @@ static bool process_data (dds_entity_t rd, struct subthread_arg *arg)
         case K32:  { Keyed32 *d  = (Keyed32 *)  mseq[i]; keyval = d->keyval; seq = d->seq; size = 32; } break;
         case K256: { Keyed256 *d = (Keyed256 *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 256; } break;
         case OU:   { OneULong *d = (OneULong *) mseq[i]; keyval = 0;         seq = d->seq; size = 4; } break;
+        case KN:   { KeyedNested *d = (KeyedNested *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 120; } break;
+        case SK:   { StringKeyed *d = (StringKeyed *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 13 + (uint32_t) strlen (d->name); } break;
+        case KA:   { KeyedArray *d = (KeyedArray *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 8200; } break;
+        case KU:   { KeyedUnion *d = (KeyedUnion *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 12 + variant_size (&d->v); } break;
+        case KSS:  { KeyedSeqStruct *d = (KeyedSeqStruct *) mseq[i]; keyval = d->keyval; seq = d->seq; size = 12 + 24 * d->points._length; } break;
       }
       (void) check_eseq (&eseq_admin, seq, keyval, size, iseq[i].publication_handle);
       if (iseq[i].source_timestamp & 1)
@@ -926,19 +1247,26 @@ static void maybe_send_new_ping (dds_time_t tnow, dds_time_t *tnextping)
 
 static uint32_t subthread_waitset (void *varg)
 {
+  /* argument is an array of ntopics, one for each data reader */
   struct subthread_arg * const arg = varg;
   dds_entity_t ws;
   int32_t rc;
   ws = dds_create_waitset (dp);
   if ((rc = dds_waitset_attach (ws, termcond, 0)) < 0)
     error2 ("dds_waitset_attach (termcond, 0): %d\n", (int) rc);
-  if ((rc = dds_set_status_mask (rd_data, DDS_DATA_AVAILABLE_STATUS)) < 0)
-    error2 ("dds_set_status_mask (rd_data, DDS_DATA_AVAILABLE_STATUS): %d\n", (int) rc);
-  if ((rc = dds_waitset_attach (ws, rd_data, 1)) < 0)
-    error2 ("dds_waitset_attach (ws, rd_data, 1): %d\n", (int) rc);
+  for (uint32_t i = 0; i < ntopics; i++)
+  {
+    if ((rc = dds_set_status_mask (rd_data[i], DDS_DATA_AVAILABLE_STATUS)) < 0)
+      error2 ("dds_set_status_mask (rd_data, DDS_DATA_AVAILABLE_STATUS): %d\n", (int) rc);
+    if ((rc = dds_waitset_attach (ws, rd_data[i], 1)) < 0)
+      error2 ("dds_waitset_attach (ws, rd_data, 1): %d\n", (int) rc);
+  }
   while (!termflag)
   {
-    if (!process_data (rd_data, arg))
+    bool gotdata = false;
+    for (uint32_t i = 0; i < ntopics; i++)
+      gotdata = process_data (rd_data[i], &arg[i]) || gotdata;
+    if (!gotdata)
     {
       /* when we use DATA_AVAILABLE, we must read until nothing remains, or we would deadlock
          if more than max_samples were available and nothing further is received */
@@ -996,10 +1324,14 @@ static uint32_t subpongthread_waitset (void *varg)
 
 static uint32_t subthread_polling (void *varg)
 {
+  /* argument is an array of ntopics, one for each data reader */
   struct subthread_arg * const arg = varg;
   while (!termflag)
   {
-    if (!process_data (rd_data, arg))
+    bool gotdata = false;
+    for (uint32_t i = 0; i < ntopics; i++)
+      gotdata = process_data (rd_data[i], &arg[i]) || gotdata;
+    if (!gotdata)
       dds_sleepfor (DDS_MSECS (1));
   }
   return 0;
@@ -1148,7 +1480,7 @@ static void participant_data_listener (dds_entity_t rd, void *arg)
             pp->tdisc = dds_time ();
             pp->tdeadline = pp->tdisc + DDS_SECS (5);
             if (pp->handle != dp_handle || ignorelocal == DDS_IGNORELOCAL_NONE)
-              pp->unmatched = MM_ALL & ~(has_reader ? 0 : MM_RD_DATA) & ~(rd_data ? 0 : MM_WR_DATA);
+              pp->unmatched = MM_ALL & ~(has_reader ? 0 : MM_RD_DATA) & ~((rd_data && rd_data[0]) ? 0 : MM_WR_DATA);
             else
               pp->unmatched = 0;
             ddsrt_fibheap_insert (&ppants_to_match_fhd, &ppants_to_match, pp);
@@ -1304,6 +1636,105 @@ static int cmp_uint64 (const void *va, const void *vb)
   return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
 }
 
+static void print_entity_stats (const char *prefix, double ts, const char *label, const dds_entity_t *es, uint32_t nes)
+{
+  /* entities are all of the same kind, and so have the same counters in the
+     same order: print the sum over all of them */
+  dds_stat_keyvalue_t stats[32], stats1[32];
+  const size_t maxstats = sizeof (stats) / sizeof (stats[0]);
+  dds_return_t n;
+  if (nes == 0 || es[0] == 0 || (n = dds_get_statistics (es[0], stats, maxstats)) <= 0)
+    return;
+  for (uint32_t j = 1; j < nes; j++)
+  {
+    dds_return_t n1;
+    if ((n1 = dds_get_statistics (es[j], stats1, maxstats)) != n)
+      continue;
+    for (size_t i = 0; i < (size_t) n && i < maxstats; i++)
+      if (strcmp (stats[i].name, stats1[i].name) == 0)
+        stats[i].value += stats1[i].value;
+  }
+  if (outputfmt != OF_TEXT)
+  {
+    for (size_t i = 0; i < (size_t) n && i < maxstats; i++)
+    {
+      struct outrec r;
+      outrec_init (&r, ts, "stat");
+      outrec_set (&r, OC_PEER, true, "%s", label);
+      outrec_set (&r, OC_NAME, true, "%s", stats[i].name);
+      outrec_u64 (&r, OC_VALUE, stats[i].value);
+      outrec_print (&r);
+    }
+    return;
+  }
+  printf ("%s %s", prefix, label);
+  for (size_t i = 0; i < (size_t) n && i < maxstats; i++)
+    printf (" %s %"PRIu64, stats[i].name, stats[i].value);
+  printf ("\n");
+}
+
+static void print_flightrec_overhead (const char *prefix, double ts, dds_time_t dt)
+{
+  /* Flight recorder counters are reported by the participant */
+  static uint64_t nevents_prev = 0, est_ns_prev = 0;
+  dds_stat_keyvalue_t stats[32];
+  const size_t maxstats = sizeof (stats) / sizeof (stats[0]);
+  uint64_t nevents = 0, est_ns = 0;
+  dds_return_t n;
+  if ((n = dds_get_statistics (dp, stats, maxstats)) <= 0)
+    return;
+  for (size_t i = 0; i < (size_t) n && i < maxstats; i++)
+  {
+    if (strcmp (stats[i].name, "flightrec_events") == 0)
+      nevents = stats[i].value;
+    else if (strcmp (stats[i].name, "flightrec_est_ns") == 0)
+      est_ns = stats[i].value;
+  }
+  if (outputfmt == OF_TEXT)
+  {
+    printf ("%s flightrec events %"PRIu64" (%.0f/s) est. overhead %.4f%% of a core\n", prefix,
+            nevents - nevents_prev, (double) (nevents - nevents_prev) * 1e9 / (double) dt,
+            100.0 * (double) (est_ns - est_ns_prev) / (double) dt);
+  }
+  else
+  {
+    struct outrec r;
+    outrec_init (&r, ts, "flightrec");
+    outrec_u64 (&r, OC_COUNT, nevents - nevents_prev);
+    outrec_dbl (&r, OC_RATE, (double) (nevents - nevents_prev) * 1e9 / (double) dt);
+    outrec_set (&r, OC_OVERHEAD_PCT, false, "%.4f", 100.0 * (double) (est_ns - est_ns_prev) / (double) dt);
+    outrec_print (&r);
+  }
+  nevents_prev = nevents;
+  est_ns_prev = est_ns;
+}
+
+#if DDSRT_HAVE_RUSAGE
+static ddsrt_rusage_t rusage_prev;
+#endif
+
+static void print_rusage (double ts, dds_time_t dt)
+{
+#if DDSRT_HAVE_RUSAGE
+  ddsrt_rusage_t * const prev = &rusage_prev;
+  ddsrt_rusage_t u;
+  struct outrec r;
+  if (ddsrt_getrusage (DDSRT_RUSAGE_SELF, &u) != DDS_RETCODE_OK)
+    return;
+  outrec_init (&r, ts, "cpu");
+  outrec_dbl (&r, OC_UTIME_PCT, 100.0 * (double) (u.utime - prev->utime) / (double) dt);
+  outrec_dbl (&r, OC_STIME_PCT, 100.0 * (double) (u.stime - prev->stime) / (double) dt);
+  outrec_u64 (&r, OC_MAXRSS, u.maxrss);
+  outrec_u64 (&r, OC_NVCSW, u.nvcsw - prev->nvcsw);
+  outrec_u64 (&r, OC_NIVCSW, u.nivcsw - prev->nivcsw);
+  outrec_print (&r);
+  *prev = u;
+#else
+  (void) ts;
+  (void) dt;
+#endif
+}
+
 static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
 {
   char prefix[128];
@@ -1313,7 +1744,10 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
   if (pub_rate > 0)
   {
     ddsrt_mutex_lock (&pubstat_lock);
-    hist_print (prefix, pubstat_hist, tnow - tprev, 1);
+    if (outputfmt == OF_TEXT)
+      hist_print (prefix, pubstat_hist, tnow - tprev, 1);
+    else
+      hist_output (ts, "pub", pubstat_hist, tnow - tprev, 1);
     ddsrt_mutex_unlock (&pubstat_lock);
   }
 
@@ -1337,11 +1771,23 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
     }
     ddsrt_mutex_unlock (&ea->lock);
 
-    if (nrecv > 0)
+    if (nrecv > 0 && outputfmt == OF_TEXT)
     {
       printf ("%s size %"PRIu32" ntot %"PRIu64" delta: %"PRIu64" lost %"PRIu64" rate %.2f Mb/s\n",
               prefix, last_size, tot_nrecv, nrecv, nlost, (double) nrecv_bytes * 8 * 1e3 / (double) (tnow - tprev));
     }
+    else if (outputfmt != OF_TEXT)
+    {
+      struct outrec r;
+      outrec_init (&r, ts, "sub");
+      outrec_u64 (&r, OC_COUNT, nrecv);
+      outrec_dbl (&r, OC_RATE, (double) nrecv * 1e9 / (double) (tnow - tprev));
+      outrec_u64 (&r, OC_SIZE, last_size);
+      outrec_u64 (&r, OC_TOTAL, tot_nrecv);
+      outrec_u64 (&r, OC_LOST, nlost);
+      outrec_dbl (&r, OC_MBPS, (double) nrecv_bytes * 8 * 1e3 / (double) (tnow - tprev));
+      outrec_print (&r);
+    }
   }
 
   uint64_t *newraw = malloc (PINGPONG_RAWSIZE * sizeof (*newraw));
@@ -1370,15 +1816,32 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
       ddsrt_mutex_unlock (&disc_lock);
 
       qsort (y.raw, rawcnt, sizeof (*y.raw), cmp_uint64);
-      printf ("%s  %s mean %.3fus min %.3fus 50%% %.3fus 90%% %.3fus 99%% %.3fus max %.3fus cnt %"PRIu32"\n",
-              prefix, ppinfo,
-              (double) y.sum / (double) y.cnt / 1e3,
-              (double) y.min / 1e3,
-              (double) y.raw[rawcnt - (rawcnt + 1) / 2] / 1e3,
-              (double) y.raw[rawcnt - (rawcnt + 9) / 10] / 1e3,
-              (double) y.raw[rawcnt - (rawcnt + 99) / 100] / 1e3,
-              (double) y.max / 1e3,
-              y.cnt);
+      if (outputfmt == OF_TEXT)
+      {
+        printf ("%s  %s mean %.3fus min %.3fus 50%% %.3fus 90%% %.3fus 99%% %.3fus max %.3fus cnt %"PRIu32"\n",
+                prefix, ppinfo,
+                (double) y.sum / (double) y.cnt / 1e3,
+                (double) y.min / 1e3,
+                (double) y.raw[rawcnt - (rawcnt + 1) / 2] / 1e3,
+                (double) y.raw[rawcnt - (rawcnt + 9) / 10] / 1e3,
+                (double) y.raw[rawcnt - (rawcnt + 99) / 100] / 1e3,
+                (double) y.max / 1e3,
+                y.cnt);
+      }
+      else
+      {
+        struct outrec r;
+        outrec_init (&r, ts, "lat");
+        outrec_set (&r, OC_PEER, true, "%s", ppinfo);
+        outrec_u64 (&r, OC_COUNT, y.cnt);
+        outrec_dbl (&r, OC_MEAN_US, (double) y.sum / (double) y.cnt / 1e3);
+        outrec_dbl (&r, OC_MIN_US, (double) y.min / 1e3);
+        outrec_dbl (&r, OC_P50_US, (double) y.raw[rawcnt - (rawcnt + 1) / 2] / 1e3);
+        outrec_dbl (&r, OC_P90_US, (double) y.raw[rawcnt - (rawcnt + 9) / 10] / 1e3);
+        outrec_dbl (&r, OC_P99_US, (double) y.raw[rawcnt - (rawcnt + 99) / 100] / 1e3);
+        outrec_dbl (&r, OC_MAX_US, (double) y.max / 1e3);
+        outrec_print (&r);
+      }
     }
     newraw = y.raw;
 
@@ -1386,6 +1849,19 @@ static void print_stats (dds_time_t tstart, dds_time_t tnow, dds_time_t tprev)
   }
   ddsrt_mutex_unlock (&pongstat_lock);
   free (newraw);
+
+  if (print_ddsstats)
+  {
+    print_entity_stats (prefix, ts, "participant", &dp, 1);
+    print_entity_stats (prefix, ts, "writer", wr_data, nwr_data);
+    print_entity_stats (prefix, ts, "reader", rd_data, ntopics);
+    print_flightrec_overhead (prefix, ts, tnow - tprev);
+  }
+  if (outputfmt != OF_TEXT)
+  {
+    print_rusage (ts, tnow - tprev);
+    fflush (outfp);
+  }
   fflush (stdout);
 }
 
@@ -1439,20 +1915,40 @@ static void usage (void)
 %s [OPTIONS] MODE...\n\
 \n\
 OPTIONS:\n\
-  -T KS|K32|K256|OU   topic:\n\
+  -T KS|K32|K256|OU|KN|SK|KA|KU|KSS\n\
+                      topic:\n\
                         KS   seq num, key value, sequence-of-octets\n\
                         K32  seq num, key value, array of 24 octets\n\
                         K256 seq num, key value, array of 248 octets\n\
                         OU   seq num\n\
+                        KN   seq num, key value, two nested structs\n\
+                        SK   seq num, key value, string key\n\
+                        KA   seq num, key value, array of 1024 doubles\n\
+                        KU   seq num, key value, union with long, double,\n\
+                             string and struct cases\n\
+                        KSS  seq num, key value, sequence-of-structs\n\
   -L                  allow matching with local endpoints\n\
+  -p PART             use partition PART instead of the default partition\n\
+                      (e.g., to run the data through ddsbridge)\n\
   -u                  best-effort instead of reliable\n\
   -k all|N            keep-all or keep-last-N for data (ping/pong is\n\
                       always keep-last-1)\n\
   -n N                number of key values to use for data (only for\n\
                       topics with a key value)\n\
+  -m M                number of data topics (all of the same type), each\n\
+                      with its own reader and writer\n\
+  -z N                payload size in bytes for topics with a sequence\n\
+                      (KS and KSS)\n\
   -D DUR              run for at most DUR seconds\n\
   -N COUNT            require at least COUNT matching participants\n\
   -M DUR              require those participants to match within DUR seconds\n\
+  -S                  print the DDS statistics counters of the participant\n\
+                      and the data writer and reader every second, and the\n\
+                      estimated CPU time spent in the flight recorder\n\
+  -F text|json|csv    format of the periodic statistics: text (default),\n\
+                      JSON (one object per line) or CSV (with a header);\n\
+                      JSON and CSV also include CPU usage and rusage\n\
+  -o FILE             write JSON/CSV statistics to FILE instead of stdout\n\
 \n\
 MODE... is zero or more of:\n\
   ping [R[Hz]] [waitset|listener]\n\
@@ -1466,7 +1962,7 @@ MODE... is zero or more of:\n\
   sub [waitset|listener|polling]\n\
     Subscribe to data, with calls to take occurring either in a listener\n\
     (default), when a waitset is triggered, or by polling at 1kHz.\n\
-  pub [R[Hz]] [burst N] [[ping] X%%]\n\
+  pub [R[Hz]] [burst N] [[ping] X%%] [threads N] [onoff T1 T2]\n\
     Publish bursts of data at rate R, optionally suffixed with Hz.  If\n\
     no rate is given or R is \"inf\", data is published as fast as\n\
     possible.  Each burst is a single sample by default, but can be set\n\
@@ -1474,8 +1970,18 @@ MODE... is zero or more of:\n\
     If desired, a fraction of the samples can be treated as if it were a\n\
     ping, for this, specify a percentage either as \"ping X%%\" (the\n\
     \"ping\" keyword is optional, the %% sign is not).\n\
+    \"threads N\" publishes from N threads, each at rate R and with its\n\
+    own writers, spreading the data topics over the threads (if there\n\
+    are more threads than topics, topics get multiple writers).\n\
+    \"onoff T1 T2\" alternates T1 seconds of publishing with T2 seconds\n\
+    of silence.\n\
 \n\
 If no MODE specified, it defaults to a 1Hz ping + responding to any pings.\n\
+\n\
+Combining ping with pub measures the round-trip latency while the data\n\
+saturates the network and the queues shared with the ping/pong traffic,\n\
+e.g. \"-m 10 -n 100 ping 100Hz pub threads 4\" on one side and \"sub\" on\n\
+the other.\n\
 ", argv0, argv0);
   fflush (stdout);
   exit (3);
@@ -1591,6 +2097,8 @@ static void set_mode_pub (int *xoptind, int xargc, char * const xargv[])
   pub_rate = HUGE_VAL;
   burstsize = 1;
   ping_frac = 0;
+  npubthreads = 1;
+  pub_on = pub_off = 0;
   while (*xoptind < xargc && exact_string_int_map_lookup (modestrings, "mode string", xargv[*xoptind], false) == -1)
   {
     int pos = 0;
@@ -1614,6 +2122,29 @@ static void set_mode_pub (int *xoptind, int xargc, char * const xargv[])
       else
         error3 ("%s: invalid burst size specification\n", xargv[*xoptind]);
     }
+    else if (strcmp (xargv[*xoptind], "threads") == 0)
+    {
+      unsigned n;
+      if (++(*xoptind) == xargc)
+        error3 ("argument missing in threads specification\n");
+      if (sscanf (xargv[*xoptind], "%u%n", &n, &pos) == 1 && xargv[*xoptind][pos] == 0 && n > 0)
+        npubthreads = n;
+      else
+        error3 ("%s: invalid number of threads\n", xargv[*xoptind]);
+    }
+    else if (strcmp (xargv[*xoptind], "onoff") == 0)
+    {
+      double ton, toff;
+      if (*xoptind + 2 >= xargc)
+        error3 ("argument missing in on/off specification\n");
+      if (sscanf (xargv[*xoptind + 1], "%lf%n", &ton, &pos) != 1 || xargv[*xoptind + 1][pos] != 0 || ton <= 0)
+        error3 ("%s: invalid on duration\n", xargv[*xoptind + 1]);
+      if (sscanf (xargv[*xoptind + 2], "%lf%n", &toff, &pos) != 1 || xargv[*xoptind + 2][pos] != 0 || toff < 0)
+        error3 ("%s: invalid off duration\n", xargv[*xoptind + 2]);
+      pub_on = (dds_duration_t) (ton * 1e9 + 0.5);
+      pub_off = (dds_duration_t) (toff * 1e9 + 0.5);
+      *xoptind += 2;
+    }
     else if (sscanf (xargv[*xoptind], "%lf%n", &r, &pos) == 1 && strcmp (xargv[*xoptind] + pos, "%") == 0)
     {
       if (r < 0 || r > 100) error3 ("%s: ping fraction out of range\n", xargv[*xoptind]);
@@ -1666,7 +2197,8 @@ int main (int argc, char *argv[])
   dds_listener_t *listener;
   int opt;
   ddsrt_threadattr_t attr;
-  ddsrt_thread_t pubtid, subtid, subpingtid, subpongtid;
+  ddsrt_thread_t *pubtid, subtid, subpingtid, subpongtid;
+  struct pubthread_arg *pubarg;
 #if !_WIN32 && !DDSRT_WITH_FREERTOS
   sigset_t sigset, osigset;
   ddsrt_thread_t sigtid;
@@ -1677,20 +2209,49 @@ int main (int argc, char *argv[])
 
   if (argc == 2 && strcmp (argv[1], "help") == 0)
     usage ();
-  while ((opt = getopt (argc, argv, "D:n:z:k:uLT:M:N:h")) != EOF)
+  while ((opt = getopt (argc, argv, "D:F:m:n:o:p:z:k:uLST:M:N:h")) != EOF)
   {
     switch (opt)
     {
       case 'D': dur = atof (optarg); if (dur <= 0) dur = HUGE_VAL; break;
+      case 'm': {
+        char *endp;
+        unsigned long n;
+        errno = 0;
+        n = strtoul (optarg, &endp, 10);
+        if (!(*optarg >= '0' && *optarg <= '9') || *endp != 0 || errno == ERANGE || n > MAX_TOPICS)
+          error3 ("%s: invalid number of topics (at most %d)\n", optarg, MAX_TOPICS);
+        ntopics = (n == 0) ? 1 : (uint32_t) n;
+        break;
+      }
       case 'n': nkeyvals = (unsigned) atoi (optarg); break;
       case 'u': reliable = false; break;
       case 'k': histdepth = atoi (optarg); if (histdepth < 0) histdepth = 0; break;
       case 'L': ignorelocal = DDS_IGNORELOCAL_NONE; break;
+      case 'S': print_ddsstats = true; break;
+      case 'F':
+        if (strcmp (optarg, "text") == 0) outputfmt = OF_TEXT;
+        else if (strcmp (optarg, "json") == 0) outputfmt = OF_JSON;
+        else if (strcmp (optarg, "csv") == 0) outputfmt = OF_CSV;
+        else error3 ("%s: unknown output format\n", optarg);
+        break;
+      case 'p': partition = optarg; break;
+      case 'o':
+        if (outfp != NULL && outfp != stdout)
+          fclose (outfp);
+        if ((outfp = fopen (optarg, "w")) == NULL)
+          error3 ("%s: cannot open for writing\n", optarg);
+        break;
       case 'T':
         if (strcmp (optarg, "KS") == 0) topicsel = KS;
         else if (strcmp (optarg, "K32") == 0) topicsel = K32;
         else if (strcmp (optarg, "K256") == 0) topicsel = K256;
         else if (strcmp (optarg, "OU") == 0) topicsel = OU;
+        else if (strcmp (optarg, "KN") == 0) topicsel = KN;
+        else if (strcmp (optarg, "SK") == 0) topicsel = SK;
+        else if (strcmp (optarg, "KA") == 0) topicsel = KA;
+        else if (strcmp (optarg, "KU") == 0) topicsel = KU;
+        else if (strcmp (optarg, "KSS") == 0) topicsel = KSS;
         else error3 ("%s: unknown topic\n", optarg);
         break;
       case 'M': maxwait = atof (optarg); if (maxwait <= 0) maxwait = HUGE_VAL; break;
@@ -1706,12 +2267,25 @@ int main (int argc, char *argv[])
     nkeyvals = 1;
   if (topicsel == OU && nkeyvals != 1)
     error3 ("-n%u invalid: topic OU has no key\n", nkeyvals);
-  if (topicsel != KS && baggagesize != 0)
-    error3 ("-z%u invalid: only topic KS has a sequence\n", baggagesize);
+  if (topicsel != KS && topicsel != KSS && baggagesize != 0)
+    error3 ("-z%u invalid: only topics KS and KSS have a sequence\n", baggagesize);
   if (baggagesize != 0 && baggagesize < 12)
     error3 ("-z%u invalid: too small to allow for overhead\n", baggagesize);
   else if (baggagesize > 0)
     baggagesize -= 12;
+  if (outfp == NULL)
+    outfp = stdout;
+  if (outfp != stdout && outputfmt == OF_TEXT)
+    error3 ("-o invalid: only JSON and CSV output can be written to a file\n");
+  if (topicsel == SK)
+  {
+    keynames = malloc (nkeyvals * sizeof (*keynames));
+    for (unsigned k = 0; k < nkeyvals; k++)
+    {
+      keynames[k] = malloc (16);
+      snprintf (keynames[k], 16, "key%u", k);
+    }
+  }
 
   ddsrt_avl_init (&ppants_td, &ppants);
   ddsrt_fibheap_init (&ppants_to_match_fhd, &ppants_to_match);
@@ -1743,10 +2317,11 @@ int main (int argc, char *argv[])
     error2 ("dds_get_instance_handle(participant) failed: %d\n", (int) rc);
 
   qos = dds_create_qos ();
-  dds_qset_partition1 (qos, "DDSPerf");
-  if ((sub = dds_create_subscriber (dp, NULL, NULL)) < 0)
+  if (partition)
+    dds_qset_partition1 (qos, partition);
+  if ((sub = dds_create_subscriber (dp, qos, NULL)) < 0)
     error2 ("dds_create_subscriber failed: %d\n", (int) dp);
-  if ((pub = dds_create_publisher (dp, NULL, NULL)) < 0)
+  if ((pub = dds_create_publisher (dp, qos, NULL)) < 0)
     error2 ("dds_create_publisher failed: %d\n", (int) dp);
   dds_delete_qos (qos);
 
@@ -1759,14 +2334,29 @@ int main (int argc, char *argv[])
       case K32:  tp_suf = "K32";  tp_desc = &Keyed32_desc;  break;
       case K256: tp_suf = "K256"; tp_desc = &Keyed256_desc; break;
       case OU:   tp_suf = "OU";   tp_desc = &OneULong_desc; break;
+      case KN:   tp_suf = "KN";   tp_desc = &KeyedNested_desc; break;
+      case SK:   tp_suf = "SK";   tp_desc = &StringKeyed_desc; break;
+      case KA:   tp_suf = "KA";   tp_desc = &KeyedArray_desc; break;
+      case KU:   tp_suf = "KU";   tp_desc = &KeyedUnion_desc; break;
+      case KSS:  tp_suf = "KSS";  tp_desc = &KeyedSeqStruct_desc; break;
+    }
+    tp_data = malloc (ntopics * sizeof (*tp_data));
+    tpname_data = malloc (ntopics * sizeof (*tpname_data));
+    for (uint32_t i = 0; i < ntopics; i++)
+    {
+      /* the name of the only topic is the same as it was before there could be more */
+      if (ntopics == 1)
+        snprintf (tpname_data[i], sizeof (tpname_data[i]), "DDSPerf%cData%s", reliable ? 'R' : 'U', tp_suf);
+      else
+        snprintf (tpname_data[i], sizeof (tpname_data[i]), "DDSPerf%cData%s_%"PRIu32, reliable ? 'R' : 'U', tp_suf, i);
     }
-    snprintf (tpname_data, sizeof (tpname_data), "DDSPerf%cData%s", reliable ? 'R' : 'U', tp_suf);
     snprintf (tpname_ping, sizeof (tpname_ping), "DDSPerf%cPing%s", reliable ? 'R' : 'U', tp_suf);
     snprintf (tpname_pong, sizeof (tpname_pong), "DDSPerf%cPong%s", reliable ? 'R' : 'U', tp_suf);
     qos = dds_create_qos ();
     dds_qset_reliability (qos, reliable ? DDS_RELIABILITY_RELIABLE : DDS_RELIABILITY_BEST_EFFORT, DDS_SECS (1));
-    if ((tp_data = dds_create_topic (dp, tp_desc, tpname_data, qos, NULL)) < 0)
-      error2 ("dds_create_topic(%s) failed: %d\n", tpname_data, (int) tp_data);
+    for (uint32_t i = 0; i < ntopics; i++)
+      if ((tp_data[i] = dds_create_topic (dp, tp_desc, tpname_data[i], qos, NULL)) < 0)
+        error2 ("dds_create_topic(%s) failed: %d\n", tpname_data[i], (int) tp_data[i]);
     if ((tp_ping = dds_create_topic (dp, tp_desc, tpname_ping, qos, NULL)) < 0)
       error2 ("dds_create_topic(%s) failed: %d\n", tpname_ping, (int) tp_ping);
     if ((tp_pong = dds_create_topic (dp, tp_desc, tpname_pong, qos, NULL)) < 0)
@@ -1813,13 +2403,22 @@ int main (int argc, char *argv[])
   dds_qset_ignorelocal (qos, ignorelocal);
   listener = dds_create_listener ((void *) (uintptr_t) MM_WR_DATA);
   dds_lset_subscription_matched (listener, subscription_matched_listener);
-  if (submode != SM_NONE && (rd_data = dds_create_reader (sub, tp_data, qos, listener)) < 0)
-    error2 ("dds_create_reader(%s) failed: %d\n", tpname_data, (int) rd_data);
+  rd_data = calloc (ntopics, sizeof (*rd_data));
+  for (uint32_t i = 0; i < ntopics && submode != SM_NONE; i++)
+    if ((rd_data[i] = dds_create_reader (sub, tp_data[i], qos, listener)) < 0)
+      error2 ("dds_create_reader(%s) failed: %d\n", tpname_data[i], (int) rd_data[i]);
   dds_delete_listener (listener);
+  /* one writer per topic, plus one for each publisher thread in excess of
+     the number of topics; thread t writes to topics t, t + npubthreads, ...,
+     using writers t, t + npubthreads, ..., so the threads never share a
+     writer */
   listener = dds_create_listener ((void *) (uintptr_t) MM_RD_DATA);
   dds_lset_publication_matched (listener, publication_matched_listener);
-  if ((wr_data = dds_create_writer (pub, tp_data, qos, listener)) < 0)
-    error2 ("dds_create_writer(%s) failed: %d\n", tpname_data, (int) wr_data);
+  nwr_data = (pub_rate > 0 && npubthreads > ntopics) ? npubthreads : ntopics;
+  wr_data = malloc (nwr_data * sizeof (*wr_data));
+  for (uint32_t i = 0; i < nwr_data; i++)
+    if ((wr_data[i] = dds_create_writer (pub, tp_data[i % ntopics], qos, listener)) < 0)
+      error2 ("dds_create_writer(%s) failed: %d\n", tpname_data[i % ntopics], (int) wr_data[i]);
   dds_delete_listener (listener);
 
   /* We only need a pong reader when sending data with a non-zero probability
@@ -1877,9 +2476,11 @@ int main (int argc, char *argv[])
   /* Make publisher & subscriber thread arguments and start the threads we
      need (so what if we allocate memory for reading data even if we don't
      have a reader or will never really be receiving data) */
-  struct subthread_arg subarg_data, subarg_ping, subarg_pong;
+  struct subthread_arg *subarg_data, subarg_ping, subarg_pong;
   init_eseq_admin (&eseq_admin, nkeyvals);
-  subthread_arg_init (&subarg_data, rd_data, 100);
+  subarg_data = malloc (ntopics * sizeof (*subarg_data));
+  for (uint32_t i = 0; i < ntopics; i++)
+    subthread_arg_init (&subarg_data[i], rd_data[i], 100);
   subthread_arg_init (&subarg_ping, rd_ping, 100);
   subthread_arg_init (&subarg_pong, rd_pong, 100);
   uint32_t (*subthread_func) (void *arg) = 0;
@@ -1890,16 +2491,26 @@ int main (int argc, char *argv[])
     case SM_POLLING:  subthread_func = subthread_polling; break;
     case SM_LISTENER: break;
   }
-  memset (&pubtid, 0, sizeof (pubtid));
   memset (&subtid, 0, sizeof (subtid));
   memset (&subpingtid, 0, sizeof (subpingtid));
   memset (&subpongtid, 0, sizeof (subpongtid));
-  if (pub_rate > 0)
-    ddsrt_thread_create (&pubtid, "pub", &attr, pubthread, NULL);
+  pubtid = malloc (npubthreads * sizeof (*pubtid));
+  pubarg = malloc (npubthreads * sizeof (*pubarg));
+  for (uint32_t t = 0; t < npubthreads && pub_rate > 0; t++)
+  {
+    pubarg[t].nwr = (nwr_data - t + npubthreads - 1) / npubthreads;
+    pubarg[t].wrs = malloc (pubarg[t].nwr * sizeof (*pubarg[t].wrs));
+    for (uint32_t w = 0; w < pubarg[t].nwr; w++)
+      pubarg[t].wrs[w].wr = wr_data[t + w * npubthreads];
+    ddsrt_thread_create (&pubtid[t], "pub", &attr, pubthread, &pubarg[t]);
+  }
   if (subthread_func != 0)
-    ddsrt_thread_create (&subtid, "sub", &attr, subthread_func, &subarg_data);
+    ddsrt_thread_create (&subtid, "sub", &attr, subthread_func, subarg_data);
   else if (submode == SM_LISTENER)
-    set_data_available_listener (rd_data, "rd_data", data_available_listener, &subarg_data);
+  {
+    for (uint32_t i = 0; i < ntopics; i++)
+      set_data_available_listener (rd_data[i], "rd_data", data_available_listener, &subarg_data[i]);
+  }
   /* Need to handle incoming "pong"s only if we can be sending "ping"s (whether that
      be pings from the "ping" mode (i.e. ping_intv != DDS_NEVER), or pings embedded
      in the published data stream (i.e. rate > 0 && ping_frac > 0).  The trouble with
@@ -1928,6 +2539,11 @@ int main (int argc, char *argv[])
   dds_time_t tnext = tstart + DDS_SECS (1);
   dds_time_t tlast = tstart;
   dds_time_t tnextping = (ping_intv == DDS_INFINITY) ? DDS_NEVER : (ping_intv == 0) ? tstart + DDS_SECS (1) : tstart + ping_intv;
+  if (outputfmt == OF_CSV)
+    outrec_print_csv_header ();
+#if DDSRT_HAVE_RUSAGE
+  (void) ddsrt_getrusage (DDSRT_RUSAGE_SELF, &rusage_prev);
+#endif
   while (!termflag && tnow < tstop)
   {
     dds_time_t twakeup = DDS_NEVER;
@@ -2029,8 +2645,13 @@ int main (int argc, char *argv[])
   }
 #endif
 
-  if (pub_rate > 0)
-    ddsrt_thread_join (pubtid, NULL);
+  for (uint32_t t = 0; t < npubthreads && pub_rate > 0; t++)
+  {
+    ddsrt_thread_join (pubtid[t], NULL);
+    free (pubarg[t].wrs);
+  }
+  free (pubtid);
+  free (pubarg);
   if (subthread_func != 0)
     ddsrt_thread_join (subtid, NULL);
   if (pingpong_waitset)
@@ -2044,7 +2665,8 @@ int main (int argc, char *argv[])
      (not quite good, but ...) */
   dds_set_listener (rd_ping, NULL);
   dds_set_listener (rd_pong, NULL);
-  dds_set_listener (rd_data, NULL);
+  for (uint32_t i = 0; i < ntopics; i++)
+    dds_set_listener (rd_data[i], NULL);
   dds_set_listener (rd_participants, NULL);
   dds_set_listener (rd_subscriptions, NULL);
   dds_set_listener (rd_publications, NULL);
@@ -2061,13 +2683,16 @@ int main (int argc, char *argv[])
      The fix is to eliminate the waiting and retrying, and instead
      flip the reader's state to out-of-sync and rely on retransmits
      to let it make progress once room is available again.  */
-  dds_delete (rd_data);
+  for (uint32_t i = 0; i < ntopics; i++)
+    dds_delete (rd_data[i]);
 
   uint64_t nlost = 0;
   for (uint32_t i = 0; i < eseq_admin.nph; i++)
     nlost += eseq_admin.stats[i].nlost;
   fini_eseq_admin (&eseq_admin);
-  subthread_arg_fini (&subarg_data);
+  for (uint32_t i = 0; i < ntopics; i++)
+    subthread_arg_fini (&subarg_data[i]);
+  free (subarg_data);
   subthread_arg_fini (&subarg_ping);
   subthread_arg_fini (&subarg_pong);
   dds_delete (dp);
@@ -2080,6 +2705,18 @@ int main (int argc, char *argv[])
   for (uint32_t i = 0; i < npongstat; i++)
     free (pongstat[i].raw);
   free (pongstat);
+  free (tp_data);
+  free (tpname_data);
+  free (rd_data);
+  free (wr_data);
+  if (keynames)
+  {
+    for (unsigned k = 0; k < nkeyvals; k++)
+      free (keynames[k]);
+    free (keynames);
+  }
+  if (outfp != stdout)
+    fclose (outfp);
 
   bool ok = true;
 